@@ -36,6 +36,10 @@ GType config_get_type (void);
 
 Configuration *config_get_instance (void);
 
+void config_set_instance (Configuration *config);
+
+void config_cleanup (void);
+
 gboolean config_load_from_file (Configuration *config, const gchar *path, GList **messages, GError **error);
 
 gboolean config_load_from_standard_locations (Configuration *config, const gchar *config_path, GList **messages);
@@ -48,6 +52,8 @@ gchar **config_get_keys (Configuration *config, const gchar *group_name);
 
 gboolean config_has_key (Configuration *config, const gchar *section, const gchar *key);
 
+void config_remove_key (Configuration *config, const gchar *section, const gchar *key);
+
 GList *config_get_sources (Configuration *config);
 
 const gchar *config_get_source (Configuration *config, const gchar *section, const gchar *key);
@@ -0,0 +1,907 @@
+/* -*- Mode: C; indent-tabs-mode:nil; tab-width:4 -*-
+ *
+ * Copyright (C) 2010-2016 Robert Ancell.
+ * Author: Robert Ancell <robert.ancell@canonical.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2 or version 3 of the License.
+ * See http://www.gnu.org/copyleft/lgpl.html the full text of the license.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "session-list.h"
+
+/* The session catalogue is stored in the cache directory as a serialized
+ * GVariant so greeters don't have to parse the session .desktop files each
+ * time they start. The cache is valid as long as the directories it was built
+ * from and the modification times and sizes of the files in them are
+ * unchanged. The cache directory is writable by greeters so the daemon never
+ * reads the cache, it always parses the files itself. */
+#define CACHE_VERSION 2
+#define CACHE_ENTRY_TYPE "(usssmsmsmsmsa{ss}msa{ss}asmsbb)"
+#define CACHE_ENTRY_FORMAT "(usssmsmsmsms@a{ss}ms@a{ss}^asmsbb)"
+#define CACHE_TYPE "(ua(sx)a(sxt)a" CACHE_ENTRY_TYPE ")"
+#define CACHE_FORMAT "(ua(sx)@a(sxt)a" CACHE_ENTRY_TYPE ")"
+
+/* Delay writing the cache after a session file changes so we only write once
+ * when a package installs / removes multiple sessions */
+#define CACHE_WRITE_DELAY 1
+
+enum
+{
+    SESSION_ADDED,
+    SESSION_REMOVED,
+    LAST_LIST_SIGNAL
+};
+static guint list_signals[LAST_LIST_SIGNAL] = { 0 };
+
+typedef struct
+{
+    /* Directories to load sessions from, in priority order */
+    gchar **dirs;
+
+    /* File to store parsed sessions in or NULL if not caching */
+    gchar *cache_path;
+
+    /* Monitors for changes to each session directory */
+    GPtrArray *monitors;
+
+    /* Timeout to write the cache after a change */
+    guint cache_timeout;
+
+    /* TRUE if have loaded sessions */
+    gboolean have_sessions;
+
+    /* Sessions ordered by directory priority */
+    GList *entries;
+} CommonSessionListPrivate;
+
+typedef struct
+{
+    /* Index of the directory this session was loaded from */
+    guint dir_index;
+
+    /* Session key, i.e. the filename without the .desktop suffix */
+    gchar *key;
+
+    /* Path to the .desktop file */
+    gchar *path;
+
+    /* Session type */
+    gchar *session_type;
+
+    /* Command to run or NULL if not runnable */
+    gchar *command;
+
+    /* Program required to run this session */
+    gchar *try_exec;
+
+    /* Gettext domain for translations */
+    gchar *domain;
+
+    /* Untranslated name and translations keyed by locale */
+    gchar *name;
+    GVariant *names;
+
+    /* Untranslated comment and translations keyed by locale */
+    gchar *comment;
+    GVariant *comments;
+
+    /* Desktop names */
+    gchar **desktop_names;
+
+    /* PAM service to use for remote sessions */
+    gchar *pam_service;
+
+    /* TRUE if can run a greeter inside the session */
+    gboolean allow_greeter;
+
+    /* TRUE if this session should not be shown */
+    gboolean hidden;
+} CommonSessionEntryPrivate;
+
+G_DEFINE_TYPE (CommonSessionList, common_session_list, G_TYPE_OBJECT)
+G_DEFINE_TYPE (CommonSessionEntry, common_session_entry, G_TYPE_OBJECT)
+
+#define GET_LIST_PRIVATE(obj) G_TYPE_INSTANCE_GET_PRIVATE ((obj), COMMON_TYPE_SESSION_LIST, CommonSessionListPrivate)
+#define GET_ENTRY_PRIVATE(obj) G_TYPE_INSTANCE_GET_PRIVATE ((obj), COMMON_TYPE_SESSION_ENTRY, CommonSessionEntryPrivate)
+
+static GHashTable *instances = NULL;
+
+/**
+ * common_session_list_get_instance:
+ * @sessions_dir: Colon separated list of directories to load sessions from
+ * @cache_dir: (allow-none): Directory to cache sessions in or %NULL
+ *
+ * Get the list of sessions available in the given directories.
+ *
+ * Return value: (transfer none): the #CommonSessionList
+ **/
+CommonSessionList *
+common_session_list_get_instance (const gchar *sessions_dir, const gchar *cache_dir)
+{
+    g_return_val_if_fail (sessions_dir != NULL, NULL);
+
+    if (!instances)
+        instances = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+
+    CommonSessionList *session_list = g_hash_table_lookup (instances, sessions_dir);
+    if (session_list)
+        return session_list;
+
+    session_list = g_object_new (COMMON_TYPE_SESSION_LIST, NULL);
+    CommonSessionListPrivate *priv = GET_LIST_PRIVATE (session_list);
+    priv->dirs = g_strsplit (sessions_dir, ":", -1);
+    if (cache_dir)
+    {
+        g_autofree gchar *checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, sessions_dir, -1);
+        g_autofree gchar *filename = g_strdup_printf ("%s.cache", checksum);
+        priv->cache_path = g_build_filename (cache_dir, "sessions", filename, NULL);
+    }
+    g_hash_table_insert (instances, g_strdup (sessions_dir), session_list);
+
+    return session_list;
+}
+
+void
+common_session_list_cleanup (void)
+{
+    g_clear_pointer (&instances, g_hash_table_unref);
+}
+
+static const gchar *
+get_default_session_type (const gchar *dir)
+{
+    if (strcmp (dir, WAYLAND_SESSIONS_DIR) == 0)
+        return "wayland";
+    return "x";
+}
+
+static gint64
+get_stat_mtime (const GStatBuf *buf)
+{
+    return (gint64) buf->st_mtim.tv_sec * G_USEC_PER_SEC + buf->st_mtim.tv_nsec / 1000;
+}
+
+static gint64
+get_directory_mtime (const gchar *path)
+{
+    GStatBuf buf;
+    if (g_stat (path, &buf) < 0)
+        return -1;
+    return get_stat_mtime (&buf);
+}
+
+static gint
+compare_entry (gconstpointer a, gconstpointer b)
+{
+    CommonSessionEntryPrivate *priv_a = GET_ENTRY_PRIVATE (a);
+    CommonSessionEntryPrivate *priv_b = GET_ENTRY_PRIVATE (b);
+
+    if (priv_a->dir_index != priv_b->dir_index)
+        return priv_a->dir_index < priv_b->dir_index ? -1 : 1;
+    return strcmp (priv_a->key, priv_b->key);
+}
+
+static GVariant *
+load_translations (GKeyFile *key_file, const gchar *key)
+{
+    GVariantBuilder builder;
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{ss}"));
+
+    g_auto(GStrv) keys = g_key_file_get_keys (key_file, G_KEY_FILE_DESKTOP_GROUP, NULL, NULL);
+    size_t key_length = strlen (key);
+    for (int i = 0; keys && keys[i]; i++)
+    {
+        size_t length = strlen (keys[i]);
+        if (length < key_length + 3 ||
+            strncmp (keys[i], key, key_length) != 0 ||
+            keys[i][key_length] != '[' ||
+            keys[i][length - 1] != ']')
+            continue;
+
+        g_autofree gchar *locale = g_strndup (keys[i] + key_length + 1, length - key_length - 2);
+        g_autofree gchar *value = g_key_file_get_string (key_file, G_KEY_FILE_DESKTOP_GROUP, keys[i], NULL);
+        if (value)
+            g_variant_builder_add (&builder, "{ss}", locale, value);
+    }
+
+    return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+static CommonSessionEntry *
+load_entry (guint dir_index, const gchar *dir, const gchar *filename)
+{
+    g_autofree gchar *path = g_build_filename (dir, filename, NULL);
+    g_autoptr(GKeyFile) key_file = g_key_file_new ();
+    g_autoptr(GError) error = NULL;
+    if (!g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, &error))
+    {
+        if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+            g_warning ("Failed to load session file %s: %s", path, error->message);
+        return NULL;
+    }
+
+    CommonSessionEntry *entry = g_object_new (COMMON_TYPE_SESSION_ENTRY, NULL);
+    CommonSessionEntryPrivate *priv = GET_ENTRY_PRIVATE (entry);
+
+    priv->dir_index = dir_index;
+    priv->key = g_strndup (filename, strlen (filename) - strlen (".desktop"));
+    priv->path = g_steal_pointer (&path);
+    priv->session_type = g_key_file_get_string (key_file, G_KEY_FILE_DESKTOP_GROUP, "X-LightDM-Session-Type", NULL);
+    if (!priv->session_type)
+        priv->session_type = g_strdup (get_default_session_type (dir));
+    priv->command = g_key_file_get_string (key_file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_EXEC, NULL);
+    priv->try_exec = g_key_file_get_string (key_file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_TRY_EXEC, NULL);
+#ifdef G_KEY_FILE_DESKTOP_KEY_GETTEXT_DOMAIN
+    priv->domain = g_key_file_get_string (key_file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_GETTEXT_DOMAIN, NULL);
+#else
+    priv->domain = g_key_file_get_string (key_file, G_KEY_FILE_DESKTOP_GROUP, "X-GNOME-Gettext-Domain", NULL);
+#endif
+    priv->name = g_key_file_get_string (key_file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_NAME, NULL);
+    priv->names = load_translations (key_file, G_KEY_FILE_DESKTOP_KEY_NAME);
+    priv->comment = g_key_file_get_string (key_file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_COMMENT, NULL);
+    priv->comments = load_translations (key_file, G_KEY_FILE_DESKTOP_KEY_COMMENT);
+    priv->desktop_names = g_key_file_get_string_list (key_file, G_KEY_FILE_DESKTOP_GROUP, "DesktopNames", NULL, NULL);
+    if (!priv->desktop_names)
+    {
+        gchar *name = g_key_file_get_string (key_file, G_KEY_FILE_DESKTOP_GROUP, "X-LightDM-DesktopName", NULL);
+        if (name)
+        {
+            priv->desktop_names = g_malloc (sizeof (gchar *) * 2);
+            priv->desktop_names[0] = name;
+            priv->desktop_names[1] = NULL;
+        }
+    }
+    priv->pam_service = g_key_file_get_string (key_file, G_KEY_FILE_DESKTOP_GROUP, "X-LightDM-PAM-Service", NULL);
+    priv->allow_greeter = g_key_file_get_boolean (key_file, G_KEY_FILE_DESKTOP_GROUP, "X-LightDM-Allow-Greeter", NULL);
+    priv->hidden = g_key_file_get_boolean (key_file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_NO_DISPLAY, NULL) ||
+                   g_key_file_get_boolean (key_file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_HIDDEN, NULL);
+
+    return entry;
+}
+
+static GVariant *
+entry_to_variant (CommonSessionEntry *entry)
+{
+    CommonSessionEntryPrivate *priv = GET_ENTRY_PRIVATE (entry);
+    static const gchar *no_desktop_names[] = { NULL };
+
+    return g_variant_new (CACHE_ENTRY_FORMAT,
+                          priv->dir_index,
+                          priv->key,
+                          priv->path,
+                          priv->session_type,
+                          priv->command,
+                          priv->try_exec,
+                          priv->domain,
+                          priv->name,
+                          priv->names,
+                          priv->comment,
+                          priv->comments,
+                          priv->desktop_names ? (const gchar * const *) priv->desktop_names : no_desktop_names,
+                          priv->pam_service,
+                          priv->allow_greeter,
+                          priv->hidden);
+}
+
+static CommonSessionEntry *
+entry_from_variant (GVariant *value)
+{
+    CommonSessionEntry *entry = g_object_new (COMMON_TYPE_SESSION_ENTRY, NULL);
+    CommonSessionEntryPrivate *priv = GET_ENTRY_PRIVATE (entry);
+
+    g_variant_get (value, CACHE_ENTRY_FORMAT,
+                   &priv->dir_index,
+                   &priv->key,
+                   &priv->path,
+                   &priv->session_type,
+                   &priv->command,
+                   &priv->try_exec,
+                   &priv->domain,
+                   &priv->name,
+                   &priv->names,
+                   &priv->comment,
+                   &priv->comments,
+                   &priv->desktop_names,
+                   &priv->pam_service,
+                   &priv->allow_greeter,
+                   &priv->hidden);
+    if (priv->desktop_names[0] == NULL)
+        g_clear_pointer (&priv->desktop_names, g_strfreev);
+
+    return entry;
+}
+
+static gboolean
+entry_equal (CommonSessionEntry *a, CommonSessionEntry *b)
+{
+    g_autoptr(GVariant) value_a = g_variant_ref_sink (entry_to_variant (a));
+    g_autoptr(GVariant) value_b = g_variant_ref_sink (entry_to_variant (b));
+    return g_variant_equal (value_a, value_b);
+}
+
+static gboolean
+load_cache (CommonSessionList *session_list, const gint64 *mtimes, GVariant *files)
+{
+    CommonSessionListPrivate *priv = GET_LIST_PRIVATE (session_list);
+
+    if (!priv->cache_path)
+        return FALSE;
+
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GMappedFile) file = g_mapped_file_new (priv->cache_path, FALSE, &error);
+    if (!file)
+    {
+        if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+            g_debug ("Failed to open session cache %s: %s", priv->cache_path, error->message);
+        return FALSE;
+    }
+
+    g_autoptr(GBytes) data = g_mapped_file_get_bytes (file);
+    g_autoptr(GVariant) cache = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (CACHE_TYPE), data, FALSE));
+
+    guint32 version;
+    g_autoptr(GVariantIter) dir_iter = NULL;
+    g_autoptr(GVariant) cached_files = NULL;
+    g_autoptr(GVariantIter) entry_iter = NULL;
+    g_variant_get (cache, CACHE_FORMAT, &version, &dir_iter, &cached_files, &entry_iter);
+    if (version != CACHE_VERSION)
+    {
+        g_debug ("Ignoring session cache %s with unsupported version %u", priv->cache_path, version);
+        return FALSE;
+    }
+
+    /* Check the directories haven't changed since the cache was written */
+    const gchar *dir;
+    gint64 mtime;
+    guint n_dirs = 0;
+    while (g_variant_iter_next (dir_iter, "(&sx)", &dir, &mtime))
+    {
+        if (priv->dirs[n_dirs] == NULL || strcmp (priv->dirs[n_dirs], dir) != 0 || mtimes[n_dirs] != mtime)
+        {
+            g_debug ("Session cache %s is out of date", priv->cache_path);
+            return FALSE;
+        }
+        n_dirs++;
+    }
+    if (n_dirs != g_strv_length (priv->dirs))
+        return FALSE;
+
+    /* Check no session file has been modified in place */
+    if (!g_variant_equal (cached_files, files))
+    {
+        g_debug ("Session cache %s is out of date", priv->cache_path);
+        return FALSE;
+    }
+
+    GVariant *value;
+    GList *entries = NULL;
+    while ((value = g_variant_iter_next_value (entry_iter)))
+    {
+        CommonSessionEntry *entry = entry_from_variant (value);
+        g_variant_unref (value);
+
+        if (GET_ENTRY_PRIVATE (entry)->dir_index >= n_dirs)
+        {
+            g_object_unref (entry);
+            g_list_free_full (entries, g_object_unref);
+            return FALSE;
+        }
+        entries = g_list_prepend (entries, entry);
+    }
+    priv->entries = g_list_sort (entries, compare_entry);
+
+    g_debug ("Loaded %u sessions from cache %s", g_list_length (priv->entries), priv->cache_path);
+
+    return TRUE;
+}
+
+static void
+write_cache (CommonSessionList *session_list, const gint64 *mtimes, GVariant *files)
+{
+    CommonSessionListPrivate *priv = GET_LIST_PRIVATE (session_list);
+
+    if (!priv->cache_path)
+        return;
+
+    GVariantBuilder dirs, entries;
+    g_variant_builder_init (&dirs, G_VARIANT_TYPE ("a(sx)"));
+    for (int i = 0; priv->dirs[i]; i++)
+        g_variant_builder_add (&dirs, "(sx)", priv->dirs[i], mtimes[i]);
+    g_variant_builder_init (&entries, G_VARIANT_TYPE ("a" CACHE_ENTRY_TYPE));
+    for (GList *link = priv->entries; link; link = link->next)
+        g_variant_builder_add_value (&entries, entry_to_variant (link->data));
+    g_autoptr(GVariant) cache = g_variant_ref_sink (g_variant_new (CACHE_FORMAT, CACHE_VERSION, &dirs, files, &entries));
+
+    g_autofree gchar *dir = g_path_get_dirname (priv->cache_path);
+    if (g_mkdir_with_parents (dir, 0755) < 0)
+    {
+        g_debug ("Failed to make session cache directory %s: %s", dir, strerror (errno));
+        return;
+    }
+
+    g_autoptr(GError) error = NULL;
+    if (!g_file_set_contents (priv->cache_path, g_variant_get_data (cache), g_variant_get_size (cache), &error))
+        g_debug ("Failed to write session cache: %s", error->message);
+}
+
+static gint64 *
+get_directory_mtimes (CommonSessionList *session_list)
+{
+    CommonSessionListPrivate *priv = GET_LIST_PRIVATE (session_list);
+
+    gint64 *mtimes = g_new (gint64, g_strv_length (priv->dirs));
+    for (int i = 0; priv->dirs[i]; i++)
+        mtimes[i] = get_directory_mtime (priv->dirs[i]);
+
+    return mtimes;
+}
+
+static gint
+compare_strings (gconstpointer a, gconstpointer b)
+{
+    return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+/* Get the path, modification time and size of every session file */
+static GVariant *
+get_file_stamps (CommonSessionList *session_list)
+{
+    CommonSessionListPrivate *priv = GET_LIST_PRIVATE (session_list);
+
+    GVariantBuilder builder;
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sxt)"));
+    for (int i = 0; priv->dirs[i]; i++)
+    {
+        GDir *directory = g_dir_open (priv->dirs[i], 0, NULL);
+        if (!directory)
+            continue;
+
+        g_autoptr(GPtrArray) filenames = g_ptr_array_new_with_free_func (g_free);
+        const gchar *filename;
+        while ((filename = g_dir_read_name (directory)))
+        {
+            if (g_str_has_suffix (filename, ".desktop"))
+                g_ptr_array_add (filenames, g_strdup (filename));
+        }
+        g_dir_close (directory);
+        g_ptr_array_sort (filenames, compare_strings);
+
+        for (guint j = 0; j < filenames->len; j++)
+        {
+            g_autofree gchar *path = g_build_filename (priv->dirs[i], filenames->pdata[j], NULL);
+            GStatBuf buf;
+            if (g_stat (path, &buf) < 0)
+                continue;
+            g_variant_builder_add (&builder, "(sxt)", path, get_stat_mtime (&buf), (guint64) buf.st_size);
+        }
+    }
+
+    return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+static gboolean
+cache_timeout_cb (gpointer data)
+{
+    CommonSessionList *session_list = data;
+    CommonSessionListPrivate *priv = GET_LIST_PRIVATE (session_list);
+
+    priv->cache_timeout = 0;
+    g_autofree gint64 *mtimes = get_directory_mtimes (session_list);
+    g_autoptr(GVariant) files = get_file_stamps (session_list);
+    write_cache (session_list, mtimes, files);
+
+    return G_SOURCE_REMOVE;
+}
+
+static GList *
+find_entry_by_path (CommonSessionList *session_list, const gchar *path)
+{
+    CommonSessionListPrivate *priv = GET_LIST_PRIVATE (session_list);
+
+    for (GList *link = priv->entries; link; link = link->next)
+    {
+        if (strcmp (GET_ENTRY_PRIVATE (link->data)->path, path) == 0)
+            return link;
+    }
+
+    return NULL;
+}
+
+static void
+reload_entry (CommonSessionList *session_list, guint dir_index, const gchar *filename)
+{
+    CommonSessionListPrivate *priv = GET_LIST_PRIVATE (session_list);
+
+    if (!g_str_has_suffix (filename, ".desktop"))
+        return;
+
+    g_autoptr(CommonSessionEntry) entry = load_entry (dir_index, priv->dirs[dir_index], filename);
+    g_autofree gchar *path = g_build_filename (priv->dirs[dir_index], filename, NULL);
+    GList *link = find_entry_by_path (session_list, path);
+    CommonSessionEntry *old_entry = link ? link->data : NULL;
+
+    if (old_entry && entry && entry_equal (old_entry, entry))
+        return;
+
+    if (old_entry)
+    {
+        g_debug ("Session %s removed", path);
+        priv->entries = g_list_delete_link (priv->entries, link);
+        g_signal_emit (session_list, list_signals[SESSION_REMOVED], 0, old_entry);
+        g_object_unref (old_entry);
+    }
+    if (entry)
+    {
+        g_debug ("Session %s added", path);
+        priv->entries = g_list_insert_sorted (priv->entries, g_object_ref (entry), compare_entry);
+        g_signal_emit (session_list, list_signals[SESSION_ADDED], 0, entry);
+    }
+
+    if (priv->cache_path)
+    {
+        if (priv->cache_timeout)
+            g_source_remove (priv->cache_timeout);
+        priv->cache_timeout = g_timeout_add_seconds (CACHE_WRITE_DELAY, cache_timeout_cb, session_list);
+    }
+}
+
+static void
+sessions_dir_changed_cb (GFileMonitor *monitor, GFile *file, GFile *other_file, GFileMonitorEvent event_type, CommonSessionList *session_list)
+{
+    if (event_type != G_FILE_MONITOR_EVENT_CREATED &&
+        event_type != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT &&
+        event_type != G_FILE_MONITOR_EVENT_DELETED)
+        return;
+
+    g_autofree gchar *filename = g_file_get_basename (file);
+    reload_entry (session_list, GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (monitor), "dir-index")), filename);
+}
+
+static void
+load_sessions_dir (CommonSessionList *session_list, guint dir_index)
+{
+    CommonSessionListPrivate *priv = GET_LIST_PRIVATE (session_list);
+    const gchar *sessions_dir = priv->dirs[dir_index];
+
+    g_autoptr(GError) error = NULL;
+    GDir *directory = g_dir_open (sessions_dir, 0, &error);
+    if (error && !g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        g_warning ("Failed to open sessions directory: %s", error->message);
+    if (!directory)
+        return;
+
+    while (TRUE)
+    {
+        const gchar *filename = g_dir_read_name (directory);
+        if (filename == NULL)
+            break;
+
+        if (!g_str_has_suffix (filename, ".desktop"))
+            continue;
+
+        CommonSessionEntry *entry = load_entry (dir_index, sessions_dir, filename);
+        if (entry)
+            priv->entries = g_list_insert_sorted (priv->entries, entry, compare_entry);
+    }
+
+    g_dir_close (directory);
+}
+
+static void
+load_sessions (CommonSessionList *session_list)
+{
+    CommonSessionListPrivate *priv = GET_LIST_PRIVATE (session_list);
+
+    if (priv->have_sessions)
+        return;
+    priv->have_sessions = TRUE;
+
+    /* Watch for sessions being installed / removed */
+    for (guint i = 0; priv->dirs[i]; i++)
+    {
+        g_autoptr(GFile) dir = g_file_new_for_path (priv->dirs[i]);
+        g_autoptr(GError) error = NULL;
+        GFileMonitor *monitor = g_file_monitor_directory (dir, G_FILE_MONITOR_NONE, NULL, &error);
+        if (!monitor)
+        {
+            g_debug ("Error monitoring sessions directory %s: %s", priv->dirs[i], error->message);
+            continue;
+        }
+        g_object_set_data (G_OBJECT (monitor), "dir-index", GUINT_TO_POINTER (i));
+        g_signal_connect (monitor, "changed", G_CALLBACK (sessions_dir_changed_cb), session_list);
+        g_ptr_array_add (priv->monitors, monitor);
+    }
+
+    if (!priv->cache_path)
+    {
+        for (guint i = 0; priv->dirs[i]; i++)
+            load_sessions_dir (session_list, i);
+        return;
+    }
+
+    g_autofree gint64 *mtimes = get_directory_mtimes (session_list);
+    g_autoptr(GVariant) files = get_file_stamps (session_list);
+    if (load_cache (session_list, mtimes, files))
+        return;
+
+    for (guint i = 0; priv->dirs[i]; i++)
+        load_sessions_dir (session_list, i);
+    write_cache (session_list, mtimes, files);
+}
+
+/**
+ * common_session_list_get_entries:
+ * @session_list: A #CommonSessionList
+ *
+ * Get all the sessions in this list, including hidden ones. Sessions from
+ * higher priority directories are first.
+ *
+ * Return value: (element-type CommonSessionEntry) (transfer none): A list of #CommonSessionEntry
+ **/
+GList *
+common_session_list_get_entries (CommonSessionList *session_list)
+{
+    g_return_val_if_fail (COMMON_IS_SESSION_LIST (session_list), NULL);
+    load_sessions (session_list);
+    return GET_LIST_PRIVATE (session_list)->entries;
+}
+
+/**
+ * common_session_list_get_entry:
+ * @session_list: A #CommonSessionList
+ * @key: Session key
+ *
+ * Get the highest priority runnable session with the given key.
+ *
+ * Return value: (transfer none): A #CommonSessionEntry or %NULL if no session with this key.
+ **/
+CommonSessionEntry *
+common_session_list_get_entry (CommonSessionList *session_list, const gchar *key)
+{
+    g_return_val_if_fail (COMMON_IS_SESSION_LIST (session_list), NULL);
+    g_return_val_if_fail (key != NULL, NULL);
+
+    load_sessions (session_list);
+
+    for (GList *link = GET_LIST_PRIVATE (session_list)->entries; link; link = link->next)
+    {
+        CommonSessionEntryPrivate *priv = GET_ENTRY_PRIVATE (link->data);
+        if (strcmp (priv->key, key) == 0 && priv->command)
+            return link->data;
+    }
+
+    return NULL;
+}
+
+static void
+common_session_list_init (CommonSessionList *session_list)
+{
+    CommonSessionListPrivate *priv = GET_LIST_PRIVATE (session_list);
+
+    priv->monitors = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+}
+
+static void
+common_session_list_finalize (GObject *object)
+{
+    CommonSessionList *self = (CommonSessionList *) object;
+    CommonSessionListPrivate *priv = GET_LIST_PRIVATE (self);
+
+    if (priv->cache_timeout)
+    {
+        g_source_remove (priv->cache_timeout);
+        cache_timeout_cb (self);
+    }
+
+    for (guint i = 0; i < priv->monitors->len; i++)
+        g_signal_handlers_disconnect_matched (priv->monitors->pdata[i], G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, self);
+    g_ptr_array_unref (priv->monitors);
+    g_strfreev (priv->dirs);
+    g_free (priv->cache_path);
+    g_list_free_full (priv->entries, g_object_unref);
+
+    G_OBJECT_CLASS (common_session_list_parent_class)->finalize (object);
+}
+
+static void
+common_session_list_class_init (CommonSessionListClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    g_type_class_add_private (klass, sizeof (CommonSessionListPrivate));
+
+    object_class->finalize = common_session_list_finalize;
+
+    /**
+     * CommonSessionList::session-added:
+     * @session_list: A #CommonSessionList
+     * @entry: The #CommonSessionEntry that has been added.
+     *
+     * The ::session-added signal gets emitted when a session is installed or modified.
+     **/
+    list_signals[SESSION_ADDED] =
+        g_signal_new (SESSION_LIST_SIGNAL_SESSION_ADDED,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (CommonSessionListClass, session_added),
+                      NULL, NULL,
+                      NULL,
+                      G_TYPE_NONE, 1, COMMON_TYPE_SESSION_ENTRY);
+
+    /**
+     * CommonSessionList::session-removed:
+     * @session_list: A #CommonSessionList
+     * @entry: The #CommonSessionEntry that has been removed.
+     *
+     * The ::session-removed signal gets emitted when a session is removed or modified.
+     **/
+    list_signals[SESSION_REMOVED] =
+        g_signal_new (SESSION_LIST_SIGNAL_SESSION_REMOVED,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (CommonSessionListClass, session_removed),
+                      NULL, NULL,
+                      NULL,
+                      G_TYPE_NONE, 1, COMMON_TYPE_SESSION_ENTRY);
+}
+
+static const gchar *
+get_translation (GVariant *translations, const gchar *domain, const gchar *untranslated)
+{
+    /* Match the lookup done by g_key_file_get_locale_string () */
+    g_auto(GStrv) domain_variants = domain ? g_get_locale_variants (domain) : NULL;
+    const gchar * const *locales = domain_variants ? (const gchar * const *) domain_variants : g_get_language_names ();
+    for (int i = 0; locales[i]; i++)
+    {
+        const gchar *value;
+        if (g_variant_lookup (translations, locales[i], "&s", &value))
+            return value;
+    }
+
+    return untranslated;
+}
+
+const gchar *
+common_session_entry_get_key (CommonSessionEntry *entry)
+{
+    g_return_val_if_fail (COMMON_IS_SESSION_ENTRY (entry), NULL);
+    return GET_ENTRY_PRIVATE (entry)->key;
+}
+
+const gchar *
+common_session_entry_get_path (CommonSessionEntry *entry)
+{
+    g_return_val_if_fail (COMMON_IS_SESSION_ENTRY (entry), NULL);
+    return GET_ENTRY_PRIVATE (entry)->path;
+}
+
+const gchar *
+common_session_entry_get_session_type (CommonSessionEntry *entry)
+{
+    g_return_val_if_fail (COMMON_IS_SESSION_ENTRY (entry), NULL);
+    return GET_ENTRY_PRIVATE (entry)->session_type;
+}
+
+const gchar *
+common_session_entry_get_command (CommonSessionEntry *entry)
+{
+    g_return_val_if_fail (COMMON_IS_SESSION_ENTRY (entry), NULL);
+    return GET_ENTRY_PRIVATE (entry)->command;
+}
+
+const gchar *
+common_session_entry_get_try_exec (CommonSessionEntry *entry)
+{
+    g_return_val_if_fail (COMMON_IS_SESSION_ENTRY (entry), NULL);
+    return GET_ENTRY_PRIVATE (entry)->try_exec;
+}
+
+/**
+ * common_session_entry_get_name:
+ * @entry: A #CommonSessionEntry
+ *
+ * Get the name of this session translated to the current locale.
+ *
+ * Return value: The session name or %NULL if the session has no name.
+ **/
+const gchar *
+common_session_entry_get_name (CommonSessionEntry *entry)
+{
+    g_return_val_if_fail (COMMON_IS_SESSION_ENTRY (entry), NULL);
+    CommonSessionEntryPrivate *priv = GET_ENTRY_PRIVATE (entry);
+    if (!priv->name)
+        return NULL;
+    return get_translation (priv->names, priv->domain, priv->name);
+}
+
+/**
+ * common_session_entry_get_comment:
+ * @entry: A #CommonSessionEntry
+ *
+ * Get the comment for this session translated to the current locale.
+ *
+ * Return value: The session comment or %NULL if the session has no comment.
+ **/
+const gchar *
+common_session_entry_get_comment (CommonSessionEntry *entry)
+{
+    g_return_val_if_fail (COMMON_IS_SESSION_ENTRY (entry), NULL);
+    CommonSessionEntryPrivate *priv = GET_ENTRY_PRIVATE (entry);
+    if (!priv->comment)
+        return NULL;
+    return get_translation (priv->comments, priv->domain, priv->comment);
+}
+
+gchar **
+common_session_entry_get_desktop_names (CommonSessionEntry *entry)
+{
+    g_return_val_if_fail (COMMON_IS_SESSION_ENTRY (entry), NULL);
+    return GET_ENTRY_PRIVATE (entry)->desktop_names;
+}
+
+const gchar *
+common_session_entry_get_pam_service (CommonSessionEntry *entry)
+{
+    g_return_val_if_fail (COMMON_IS_SESSION_ENTRY (entry), NULL);
+    return GET_ENTRY_PRIVATE (entry)->pam_service;
+}
+
+gboolean
+common_session_entry_get_allow_greeter (CommonSessionEntry *entry)
+{
+    g_return_val_if_fail (COMMON_IS_SESSION_ENTRY (entry), FALSE);
+    return GET_ENTRY_PRIVATE (entry)->allow_greeter;
+}
+
+gboolean
+common_session_entry_get_hidden (CommonSessionEntry *entry)
+{
+    g_return_val_if_fail (COMMON_IS_SESSION_ENTRY (entry), FALSE);
+    return GET_ENTRY_PRIVATE (entry)->hidden;
+}
+
+static void
+common_session_entry_init (CommonSessionEntry *entry)
+{
+}
+
+static void
+common_session_entry_finalize (GObject *object)
+{
+    CommonSessionEntry *self = (CommonSessionEntry *) object;
+    CommonSessionEntryPrivate *priv = GET_ENTRY_PRIVATE (self);
+
+    g_free (priv->key);
+    g_free (priv->path);
+    g_free (priv->session_type);
+    g_free (priv->command);
+    g_free (priv->try_exec);
+    g_free (priv->domain);
+    g_free (priv->name);
+    g_clear_pointer (&priv->names, g_variant_unref);
+    g_free (priv->comment);
+    g_clear_pointer (&priv->comments, g_variant_unref);
+    g_strfreev (priv->desktop_names);
+    g_free (priv->pam_service);
+
+    G_OBJECT_CLASS (common_session_entry_parent_class)->finalize (object);
+}
+
+static void
+common_session_entry_class_init (CommonSessionEntryClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    g_type_class_add_private (klass, sizeof (CommonSessionEntryPrivate));
+
+    object_class->finalize = common_session_entry_finalize;
+}
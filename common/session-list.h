@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2010-2016 Robert Ancell.
+ * Author: Robert Ancell <robert.ancell@canonical.com>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2 or version 3 of the License.
+ * See http://www.gnu.org/copyleft/lgpl.html the full text of the license.
+ */
+
+#ifndef COMMON_SESSION_LIST_H_
+#define COMMON_SESSION_LIST_H_
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define COMMON_TYPE_SESSION_LIST            (common_session_list_get_type())
+#define COMMON_SESSION_LIST(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), COMMON_TYPE_SESSION_LIST, CommonSessionList));
+#define COMMON_SESSION_LIST_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), COMMON_TYPE_SESSION_LIST, CommonSessionListClass))
+#define COMMON_IS_SESSION_LIST(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), COMMON_TYPE_SESSION_LIST))
+#define COMMON_IS_SESSION_LIST_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), COMMON_TYPE_SESSION_LIST))
+#define COMMON_SESSION_LIST_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), COMMON_TYPE_SESSION_LIST, CommonSessionListClass))
+
+#define COMMON_TYPE_SESSION_ENTRY            (common_session_entry_get_type())
+#define COMMON_SESSION_ENTRY(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), COMMON_TYPE_SESSION_ENTRY, CommonSessionEntry));
+#define COMMON_SESSION_ENTRY_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), COMMON_TYPE_SESSION_ENTRY, CommonSessionEntryClass))
+#define COMMON_IS_SESSION_ENTRY(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), COMMON_TYPE_SESSION_ENTRY))
+#define COMMON_IS_SESSION_ENTRY_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), COMMON_TYPE_SESSION_ENTRY))
+#define COMMON_SESSION_ENTRY_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), COMMON_TYPE_SESSION_ENTRY, CommonSessionEntryClass))
+
+#define SESSION_LIST_SIGNAL_SESSION_ADDED   "session-added"
+#define SESSION_LIST_SIGNAL_SESSION_REMOVED "session-removed"
+
+typedef struct
+{
+    GObject parent_instance;
+} CommonSessionEntry;
+
+typedef struct
+{
+    GObjectClass parent_class;
+} CommonSessionEntryClass;
+
+typedef struct
+{
+    GObject parent_instance;
+} CommonSessionList;
+
+typedef struct
+{
+    GObjectClass parent_class;
+
+    void (*session_added)(CommonSessionList *session_list, CommonSessionEntry *entry);
+    void (*session_removed)(CommonSessionList *session_list, CommonSessionEntry *entry);
+} CommonSessionListClass;
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (CommonSessionEntry, g_object_unref)
+
+GType common_session_list_get_type (void);
+
+GType common_session_entry_get_type (void);
+
+CommonSessionList *common_session_list_get_instance (const gchar *sessions_dir, const gchar *cache_dir);
+
+void common_session_list_cleanup (void);
+
+GList *common_session_list_get_entries (CommonSessionList *session_list);
+
+CommonSessionEntry *common_session_list_get_entry (CommonSessionList *session_list, const gchar *key);
+
+const gchar *common_session_entry_get_key (CommonSessionEntry *entry);
+
+const gchar *common_session_entry_get_path (CommonSessionEntry *entry);
+
+const gchar *common_session_entry_get_session_type (CommonSessionEntry *entry);
+
+const gchar *common_session_entry_get_command (CommonSessionEntry *entry);
+
+const gchar *common_session_entry_get_try_exec (CommonSessionEntry *entry);
+
+const gchar *common_session_entry_get_name (CommonSessionEntry *entry);
+
+const gchar *common_session_entry_get_comment (CommonSessionEntry *entry);
+
+gchar **common_session_entry_get_desktop_names (CommonSessionEntry *entry);
+
+const gchar *common_session_entry_get_pam_service (CommonSessionEntry *entry);
+
+gboolean common_session_entry_get_allow_greeter (CommonSessionEntry *entry);
+
+gboolean common_session_entry_get_hidden (CommonSessionEntry *entry);
+
+G_END_DECLS
+
+#endif /* COMMON_SESSION_LIST_H_ */
@@ -83,6 +83,9 @@ typedef struct
     /* TRUE if have scanned users */
     gboolean have_users;
 
+    /* TRUE if users and sessions are fed to us rather than loaded */
+    gboolean fed;
+
     /* List of users */
     GList *users;
 
@@ -139,6 +142,9 @@ typedef struct
 
     /* User default session */
     gchar *session;
+
+    /* Properties last fed for this user */
+    GVariant *properties;
 } CommonUserPrivate;
 
 typedef struct
@@ -246,6 +252,9 @@ update_passwd_user (CommonUser *user, const gchar *real_name, const gchar *home_
     g_free (priv->image);
     priv->image = g_strdup (image);
 
+    /* The home directory may have moved, so read .dmrc again when next needed */
+    priv->loaded_dmrc = FALSE;
+
     return TRUE;
 }
 
@@ -257,7 +266,7 @@ get_logged_in_cb (CommonUser *user, CommonUserList *user_list)
     CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
 
     // Lazily decide to load/listen to sessions
-    if (priv->session_added_signal == 0)
+    if (!priv->fed && priv->session_added_signal == 0)
         load_sessions (user_list);
 
     const gchar *username = GET_USER_PRIVATE (user)->name;
@@ -389,6 +398,8 @@ load_passwd_file (CommonUserList *user_list, gboolean emit_add_signal)
         }
         if (!link)
         {
+            g_signal_connect (user, USER_SIGNAL_CHANGED, G_CALLBACK (user_changed_cb), user_list);
+
             /* Only notify once we have loaded the user list */
             if (priv->have_users)
                 new_users = g_list_insert_sorted (new_users, user, compare_user);
@@ -410,7 +421,6 @@ load_passwd_file (CommonUserList *user_list, gboolean emit_add_signal)
     {
         CommonUser *info = link->data;
         g_debug ("User %s added", common_user_get_name (info));
-        g_signal_connect (info, USER_SIGNAL_CHANGED, G_CALLBACK (user_changed_cb), user_list);
         if (emit_add_signal)
             g_signal_emit (user_list, list_signals[USER_ADDED], 0, info);
     }
@@ -689,6 +699,102 @@ accounts_user_deleted_cb (GDBusConnection *connection,
     }
 }
 
+static CommonSession *
+add_session (CommonUserList *user_list, const gchar *path, GVariant *properties)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    const gchar *name;
+    if (!g_variant_lookup (properties, "UserName", "&s", &name))
+        return NULL;
+
+    g_debug ("Loaded session %s (%s)", path, name);
+    CommonSession *session = g_object_new (common_session_get_type (), NULL);
+    session->username = g_strdup (name);
+    session->path = g_strdup (path);
+    priv->sessions = g_list_append (priv->sessions, session);
+
+    return session;
+}
+
+static void
+remove_session (CommonUserList *user_list, const gchar *path)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    for (GList *link = priv->sessions; link; link = link->next)
+    {
+        CommonSession *session = link->data;
+        if (strcmp (session->path, path) == 0)
+        {
+            g_debug ("Session %s removed", path);
+            priv->sessions = g_list_delete_link (priv->sessions, link);
+            CommonUser *user = get_user_by_name (user_list, session->username);
+            if (user)
+                g_signal_emit (user, user_signals[CHANGED], 0);
+            g_object_unref (session);
+            break;
+        }
+    }
+}
+
+static void
+interfaces_added_cb (GDBusConnection *connection,
+                     const gchar *sender_name,
+                     const gchar *object_path,
+                     const gchar *interface_name,
+                     const gchar *signal_name,
+                     GVariant *parameters,
+                     gpointer data)
+{
+    CommonUserList *user_list = data;
+
+    if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(oa{sa{sv}})")))
+    {
+        g_warning ("Got DisplayManager signal InterfacesAdded with unknown parameters %s", g_variant_get_type_string (parameters));
+        return;
+    }
+
+    const gchar *path;
+    g_autoptr(GVariant) interfaces = NULL;
+    g_variant_get (parameters, "(&o@a{sa{sv}})", &path, &interfaces);
+    g_autoptr(GVariant) properties = g_variant_lookup_value (interfaces, "org.freedesktop.DisplayManager.Session", G_VARIANT_TYPE ("a{sv}"));
+    if (!properties)
+        return;
+
+    CommonSession *session = add_session (user_list, path, properties);
+    if (!session)
+        return;
+
+    CommonUser *user = get_user_by_name (user_list, session->username);
+    if (user)
+        g_signal_emit (user, user_signals[CHANGED], 0);
+}
+
+static void
+interfaces_removed_cb (GDBusConnection *connection,
+                       const gchar *sender_name,
+                       const gchar *object_path,
+                       const gchar *interface_name,
+                       const gchar *signal_name,
+                       GVariant *parameters,
+                       gpointer data)
+{
+    CommonUserList *user_list = data;
+
+    if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(oas)")))
+    {
+        g_warning ("Got DisplayManager signal InterfacesRemoved with unknown parameters %s", g_variant_get_type_string (parameters));
+        return;
+    }
+
+    const gchar *path;
+    g_autofree const gchar **interfaces = NULL;
+    g_variant_get (parameters, "(&o^a&s)", &path, &interfaces);
+    if (g_strv_contains ((const gchar * const *) interfaces, "org.freedesktop.DisplayManager.Session"))
+        remove_session (user_list, path);
+}
+
 static CommonSession *
 load_session (CommonUserList *user_list, const gchar *path)
 {
@@ -699,33 +805,20 @@ load_session (CommonUserList *user_list, const gchar *path)
                                                               "org.freedesktop.DisplayManager",
                                                               path,
                                                               "org.freedesktop.DBus.Properties",
-                                                              "Get",
-                                                              g_variant_new ("(ss)", "org.freedesktop.DisplayManager.Session", "UserName"),
-                                                              G_VARIANT_TYPE ("(v)"),
+                                                              "GetAll",
+                                                              g_variant_new ("(s)", "org.freedesktop.DisplayManager.Session"),
+                                                              G_VARIANT_TYPE ("(a{sv})"),
                                                               G_DBUS_CALL_FLAGS_NONE,
                                                               -1,
                                                               NULL,
                                                               &error);
     if (error)
-        g_warning ("Error getting UserName from org.freedesktop.DisplayManager.Session: %s", error->message);
+        g_warning ("Error getting properties from org.freedesktop.DisplayManager.Session: %s", error->message);
     if (!result)
         return NULL;
 
-    g_autoptr(GVariant) username = NULL;
-    g_variant_get (result, "(v)", &username);
-    if (!g_variant_is_of_type (username, G_VARIANT_TYPE_STRING))
-        return NULL;
-
-    const gchar *name;
-    g_variant_get (username, "&s", &name);
-
-    g_debug ("Loaded session %s (%s)", path, name);
-    CommonSession *session = g_object_new (common_session_get_type (), NULL);
-    session->username = g_strdup (name);
-    session->path = g_strdup (path);
-    priv->sessions = g_list_append (priv->sessions, session);
-
-    return session;
+    g_autoptr(GVariant) properties = g_variant_get_child_value (result, 0);
+    return add_session (user_list, path, properties);
 }
 
 static void
@@ -766,7 +859,6 @@ session_removed_cb (GDBusConnection *connection,
                     gpointer data)
 {
     CommonUserList *user_list = data;
-    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
 
     if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(o)")))
     {
@@ -776,28 +868,18 @@ session_removed_cb (GDBusConnection *connection,
 
     const gchar *path;
     g_variant_get (parameters, "(&o)", &path);
-
-    for (GList *link = priv->sessions; link; link = link->next)
-    {
-        CommonSession *session = link->data;
-        if (strcmp (session->path, path) == 0)
-        {
-            g_debug ("Session %s removed", path);
-            priv->sessions = g_list_delete_link (priv->sessions, link);
-            CommonUser *user = get_user_by_name (user_list, session->username);
-            if (user)
-                g_signal_emit (user, user_signals[CHANGED], 0);
-            g_object_unref (session);
-            break;
-        }
-    }
+    remove_session (user_list, path);
 }
 
+/* Used when the object manager is not available, e.g. an older daemon or a bus
+ * policy that doesn't allow it */
 static void
-load_sessions (CommonUserList *user_list)
+load_sessions_from_properties (CommonUserList *user_list)
 {
     CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
 
+    if (priv->session_added_signal)
+        g_dbus_connection_signal_unsubscribe (priv->bus, priv->session_added_signal);
     priv->session_added_signal = g_dbus_connection_signal_subscribe (priv->bus,
                                                                      "org.freedesktop.DisplayManager",
                                                                      "org.freedesktop.DisplayManager",
@@ -808,6 +890,8 @@ load_sessions (CommonUserList *user_list)
                                                                      session_added_cb,
                                                                      user_list,
                                                                      NULL);
+    if (priv->session_removed_signal)
+        g_dbus_connection_signal_unsubscribe (priv->bus, priv->session_removed_signal);
     priv->session_removed_signal = g_dbus_connection_signal_subscribe (priv->bus,
                                                                        "org.freedesktop.DisplayManager",
                                                                        "org.freedesktop.DisplayManager",
@@ -833,23 +917,81 @@ load_sessions (CommonUserList *user_list)
                                                               &error);
     if (error)
         g_warning ("Error getting session list from org.freedesktop.DisplayManager: %s", error->message);
-    if (result)
+    if (!result)
+        return;
+
+    g_autoptr(GVariant) value = NULL;
+    g_variant_get (result, "(v)", &value);
+    if (!g_variant_is_of_type (value, G_VARIANT_TYPE ("ao")))
     {
-        if (g_variant_is_of_type (result, G_VARIANT_TYPE ("(v)")))
-        {
-            g_autoptr(GVariant) value = NULL;
-            g_variant_get (result, "(v)", &value);
-
-            g_debug ("Loading sessions from org.freedesktop.DisplayManager");
-            GVariantIter *iter;
-            g_variant_get (value, "ao", &iter);
-            const gchar *path;
-            while (g_variant_iter_loop (iter, "&o", &path))
-                load_session (user_list, path);
-            g_variant_iter_free (iter);
-        }
-        else
-            g_warning ("Unexpected type from org.freedesktop.DisplayManager.Sessions: %s", g_variant_get_type_string (result));
+        g_warning ("Unexpected type from org.freedesktop.DisplayManager.Sessions: %s", g_variant_get_type_string (value));
+        return;
+    }
+
+    g_debug ("Loading sessions from org.freedesktop.DisplayManager");
+    GVariantIter iter;
+    g_variant_iter_init (&iter, value);
+    const gchar *path;
+    while (g_variant_iter_loop (&iter, "&o", &path))
+        load_session (user_list, path);
+}
+
+static void
+load_sessions (CommonUserList *user_list)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    /* Subscribe before getting the snapshot so no changes are missed */
+    priv->session_added_signal = g_dbus_connection_signal_subscribe (priv->bus,
+                                                                     "org.freedesktop.DisplayManager",
+                                                                     "org.freedesktop.DBus.ObjectManager",
+                                                                     "InterfacesAdded",
+                                                                     "/org/freedesktop/DisplayManager",
+                                                                     NULL,
+                                                                     G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                     interfaces_added_cb,
+                                                                     user_list,
+                                                                     NULL);
+    priv->session_removed_signal = g_dbus_connection_signal_subscribe (priv->bus,
+                                                                       "org.freedesktop.DisplayManager",
+                                                                       "org.freedesktop.DBus.ObjectManager",
+                                                                       "InterfacesRemoved",
+                                                                       "/org/freedesktop/DisplayManager",
+                                                                       NULL,
+                                                                       G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                       interfaces_removed_cb,
+                                                                       user_list,
+                                                                       NULL);
+
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GVariant) result = g_dbus_connection_call_sync (priv->bus,
+                                                              "org.freedesktop.DisplayManager",
+                                                              "/org/freedesktop/DisplayManager",
+                                                              "org.freedesktop.DBus.ObjectManager",
+                                                              "GetManagedObjects",
+                                                              NULL,
+                                                              G_VARIANT_TYPE ("(a{oa{sa{sv}}})"),
+                                                              G_DBUS_CALL_FLAGS_NONE,
+                                                              -1,
+                                                              NULL,
+                                                              &error);
+    if (!result)
+    {
+        g_debug ("Unable to get managed objects from org.freedesktop.DisplayManager, getting sessions individually: %s", error->message);
+        load_sessions_from_properties (user_list);
+        return;
+    }
+
+    g_debug ("Loading sessions from org.freedesktop.DisplayManager");
+    g_autoptr(GVariantIter) iter = NULL;
+    g_variant_get (result, "(a{oa{sa{sv}}})", &iter);
+    const gchar *path;
+    GVariant *interfaces;
+    while (g_variant_iter_loop (iter, "{&o@a{sa{sv}}}", &path, &interfaces))
+    {
+        g_autoptr(GVariant) properties = g_variant_lookup_value (interfaces, "org.freedesktop.DisplayManager.Session", G_VARIANT_TYPE ("a{sv}"));
+        if (properties)
+            add_session (user_list, path, properties);
     }
 }
 
@@ -993,6 +1135,317 @@ common_user_list_get_user_by_name (CommonUserList *user_list, const gchar *usern
     return NULL;
 }
 
+/* Stop loading users and sessions ourselves, they will be fed to us instead */
+static void
+stop_loading (CommonUserList *user_list)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    if (priv->fed)
+        return;
+    priv->fed = TRUE;
+    priv->have_users = TRUE;
+
+    if (priv->user_added_signal)
+        g_dbus_connection_signal_unsubscribe (priv->bus, priv->user_added_signal);
+    priv->user_added_signal = 0;
+    if (priv->user_removed_signal)
+        g_dbus_connection_signal_unsubscribe (priv->bus, priv->user_removed_signal);
+    priv->user_removed_signal = 0;
+    if (priv->session_added_signal)
+        g_dbus_connection_signal_unsubscribe (priv->bus, priv->session_added_signal);
+    priv->session_added_signal = 0;
+    if (priv->session_removed_signal)
+        g_dbus_connection_signal_unsubscribe (priv->bus, priv->session_removed_signal);
+    priv->session_removed_signal = 0;
+    if (priv->passwd_monitor)
+        g_signal_handlers_disconnect_matched (priv->passwd_monitor, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, user_list);
+    g_clear_object (&priv->passwd_monitor);
+
+    for (GList *link = priv->users; link; link = link->next)
+    {
+        CommonUserPrivate *user_priv = GET_USER_PRIVATE (link->data);
+        if (user_priv->changed_signal)
+            g_dbus_connection_signal_unsubscribe (user_priv->bus, user_priv->changed_signal);
+        user_priv->changed_signal = 0;
+    }
+}
+
+static gchar *
+lookup_string (GVariant *properties, const gchar *key)
+{
+    gchar *value = NULL;
+    g_variant_lookup (properties, key, "s", &value);
+    return value;
+}
+
+/* Update a user from properties made by common_user_serialize(), returns TRUE if anything changed */
+static gboolean
+update_fed_user (CommonUserList *user_list, CommonUser *user, GVariant *properties)
+{
+    CommonUserPrivate *priv = GET_USER_PRIVATE (user);
+
+    if (priv->properties && g_variant_equal (priv->properties, properties))
+        return FALSE;
+    g_clear_pointer (&priv->properties, g_variant_unref);
+    priv->properties = g_variant_ref (properties);
+
+    g_free (priv->name);
+    priv->name = lookup_string (properties, "Name");
+    g_free (priv->real_name);
+    priv->real_name = lookup_string (properties, "RealName");
+    g_free (priv->home_directory);
+    priv->home_directory = lookup_string (properties, "HomeDirectory");
+    g_free (priv->shell);
+    priv->shell = lookup_string (properties, "Shell");
+    g_free (priv->image);
+    priv->image = lookup_string (properties, "Image");
+    g_free (priv->background);
+    priv->background = lookup_string (properties, "Background");
+    g_free (priv->language);
+    priv->language = lookup_string (properties, "Language");
+    g_free (priv->session);
+    priv->session = lookup_string (properties, "Session");
+    g_strfreev (priv->layouts);
+    priv->layouts = NULL;
+    if (!g_variant_lookup (properties, "Layouts", "^as", &priv->layouts))
+        priv->layouts = g_new0 (gchar *, 1);
+    priv->has_messages = FALSE;
+    g_variant_lookup (properties, "HasMessages", "b", &priv->has_messages);
+    priv->uid = 0;
+    g_variant_lookup (properties, "Uid", "t", &priv->uid);
+    priv->gid = 0;
+    g_variant_lookup (properties, "Gid", "t", &priv->gid);
+
+    /* Keep the accounts service path so the language and session can still be set */
+    g_clear_pointer (&priv->path, g_free);
+    g_variant_lookup (properties, "Path", "o", &priv->path);
+    GDBusConnection *bus = GET_LIST_PRIVATE (user_list)->bus;
+    if (priv->path && !priv->bus && bus)
+        priv->bus = g_object_ref (bus);
+
+    /* The daemon doesn't send .dmrc settings, read them again when next needed */
+    priv->loaded_dmrc = FALSE;
+
+    return TRUE;
+}
+
+/* Users are matched by accounts service path where they have one, as the name can change */
+static gboolean
+fed_user_matches (CommonUser *user, GVariant *properties)
+{
+    const gchar *path, *name;
+    if (g_variant_lookup (properties, "Path", "&o", &path))
+        return g_strcmp0 (GET_USER_PRIVATE (user)->path, path) == 0;
+    if (g_variant_lookup (properties, "Name", "&s", &name))
+        return g_strcmp0 (GET_USER_PRIVATE (user)->name, name) == 0;
+    return FALSE;
+}
+
+static GList *
+find_fed_user (GList *users, GVariant *properties)
+{
+    for (GList *link = users; link; link = link->next)
+    {
+        if (fed_user_matches (link->data, properties))
+            return link;
+    }
+
+    return NULL;
+}
+
+static CommonUser *
+make_fed_user (CommonUserList *user_list, GVariant *properties)
+{
+    CommonUser *user = g_object_new (COMMON_TYPE_USER, NULL);
+
+    g_signal_connect (user, USER_SIGNAL_CHANGED, G_CALLBACK (user_changed_cb), user_list);
+    g_signal_connect (user, "get-logged-in", G_CALLBACK (get_logged_in_cb), user_list);
+    update_fed_user (user_list, user, properties);
+
+    return user;
+}
+
+/**
+ * common_user_list_set_snapshot:
+ * @user_list: A #CommonUserList
+ * @snapshot: A (aa{sv}a(ss)) variant of user properties and (session id, username) pairs
+ *
+ * Replace the users and sessions with a snapshot from the daemon.  From now on
+ * the list is only updated with the common_user_list_update_user() family of calls.
+ **/
+void
+common_user_list_set_snapshot (CommonUserList *user_list, GVariant *snapshot)
+{
+    g_return_if_fail (COMMON_IS_USER_LIST (user_list));
+    g_return_if_fail (g_variant_is_of_type (snapshot, G_VARIANT_TYPE ("(aa{sv}a(ss))")));
+
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    /* Only notify once we have loaded the user list */
+    gboolean had_users = priv->have_users;
+    stop_loading (user_list);
+
+    g_list_free_full (priv->sessions, g_object_unref);
+    priv->sessions = NULL;
+    g_autoptr(GVariant) sessions = g_variant_get_child_value (snapshot, 1);
+    GVariantIter iter;
+    g_variant_iter_init (&iter, sessions);
+    const gchar *id, *username;
+    while (g_variant_iter_next (&iter, "(&s&s)", &id, &username))
+    {
+        CommonSession *session = g_object_new (common_session_get_type (), NULL);
+        session->path = g_strdup (id);
+        session->username = g_strdup (username);
+        priv->sessions = g_list_append (priv->sessions, session);
+    }
+
+    GList *old_users = priv->users, *new_users = NULL, *changed_users = NULL;
+    priv->users = NULL;
+    g_autoptr(GVariant) users = g_variant_get_child_value (snapshot, 0);
+    g_variant_iter_init (&iter, users);
+    GVariant *properties;
+    while (g_variant_iter_loop (&iter, "@a{sv}", &properties))
+    {
+        if (!g_variant_lookup (properties, "Name", "&s", NULL))
+            continue;
+
+        CommonUser *user;
+        GList *link = find_fed_user (old_users, properties);
+        if (link)
+        {
+            user = link->data;
+            old_users = g_list_delete_link (old_users, link);
+            if (update_fed_user (user_list, user, properties))
+                changed_users = g_list_append (changed_users, user);
+        }
+        else
+        {
+            user = make_fed_user (user_list, properties);
+            if (had_users)
+                new_users = g_list_append (new_users, user);
+        }
+        priv->users = g_list_insert_sorted (priv->users, user, compare_user);
+    }
+
+    g_debug ("Loaded %d users and %d sessions from daemon", g_list_length (priv->users), g_list_length (priv->sessions));
+
+    for (GList *link = new_users; link; link = link->next)
+        g_signal_emit (user_list, list_signals[USER_ADDED], 0, link->data);
+    g_list_free (new_users);
+    for (GList *link = changed_users; link; link = link->next)
+        g_signal_emit (link->data, user_signals[CHANGED], 0);
+    g_list_free (changed_users);
+    for (GList *link = old_users; link; link = link->next)
+    {
+        CommonUser *user = link->data;
+        g_signal_emit (user_list, list_signals[USER_REMOVED], 0, user);
+        g_object_unref (user);
+    }
+    g_list_free (old_users);
+}
+
+/**
+ * common_user_list_update_user:
+ * @user_list: A #CommonUserList
+ * @properties: User properties made by common_user_serialize()
+ *
+ * Add a user fed from the daemon or update it if already known.
+ **/
+void
+common_user_list_update_user (CommonUserList *user_list, GVariant *properties)
+{
+    g_return_if_fail (COMMON_IS_USER_LIST (user_list));
+
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    const gchar *name;
+    if (!g_variant_lookup (properties, "Name", "&s", &name))
+        return;
+
+    GList *link = find_fed_user (priv->users, properties);
+    if (link)
+    {
+        CommonUser *user = link->data;
+        if (update_fed_user (user_list, user, properties))
+        {
+            g_debug ("User %s changed", name);
+            g_signal_emit (user, user_signals[CHANGED], 0);
+        }
+    }
+    else
+    {
+        g_debug ("User %s added", name);
+        CommonUser *user = make_fed_user (user_list, properties);
+        priv->users = g_list_insert_sorted (priv->users, user, compare_user);
+        g_signal_emit (user_list, list_signals[USER_ADDED], 0, user);
+    }
+}
+
+/**
+ * common_user_list_remove_user:
+ * @user_list: A #CommonUserList
+ * @username: Name of the user the daemon no longer has
+ *
+ * Remove a user fed from the daemon.
+ **/
+void
+common_user_list_remove_user (CommonUserList *user_list, const gchar *username)
+{
+    g_return_if_fail (COMMON_IS_USER_LIST (user_list));
+
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    CommonUser *user = get_user_by_name (user_list, username);
+    if (!user)
+        return;
+
+    g_debug ("User %s removed", username);
+    priv->users = g_list_remove (priv->users, user);
+    g_signal_emit (user_list, list_signals[USER_REMOVED], 0, user);
+    g_object_unref (user);
+}
+
+/**
+ * common_user_list_add_session:
+ * @user_list: A #CommonUserList
+ * @id: Daemon identifier for the session
+ * @username: User the session is running as
+ *
+ * Record a user session fed from the daemon.
+ **/
+void
+common_user_list_add_session (CommonUserList *user_list, const gchar *id, const gchar *username)
+{
+    g_return_if_fail (COMMON_IS_USER_LIST (user_list));
+
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    g_debug ("Session %s (%s) added", id, username);
+    CommonSession *session = g_object_new (common_session_get_type (), NULL);
+    session->path = g_strdup (id);
+    session->username = g_strdup (username);
+    priv->sessions = g_list_append (priv->sessions, session);
+
+    CommonUser *user = get_user_by_name (user_list, username);
+    if (user)
+        g_signal_emit (user, user_signals[CHANGED], 0);
+}
+
+/**
+ * common_user_list_remove_session:
+ * @user_list: A #CommonUserList
+ * @id: Daemon identifier for the session
+ *
+ * Remove a user session fed from the daemon.
+ **/
+void
+common_user_list_remove_session (CommonUserList *user_list, const gchar *id)
+{
+    g_return_if_fail (COMMON_IS_USER_LIST (user_list));
+    remove_session (user_list, id);
+}
+
 static void
 common_user_list_init (CommonUserList *user_list)
 {
@@ -1334,6 +1787,15 @@ common_user_set_language (CommonUser *user, const gchar *language)
     {
         call_method (user, "SetLanguage", g_variant_new ("(s)", language), "()", NULL);
         save_string_to_dmrc (user, "Desktop", "Language", language);
+
+        /* Accounts service notifies changes itself, for .dmrc users keep the loaded value current */
+        CommonUserPrivate *priv = GET_USER_PRIVATE (user);
+        if (!priv->path)
+        {
+            g_free (priv->language);
+            priv->language = g_strdup (language);
+            g_signal_emit (user, user_signals[CHANGED], 0);
+        }
     }
 }
 
@@ -1401,6 +1863,14 @@ common_user_set_session (CommonUser *user, const gchar *session)
     {
         call_method (user, "SetXSession", g_variant_new ("(s)", session), "()", NULL);
         save_string_to_dmrc (user, "Desktop", "Session", session);
+
+        CommonUserPrivate *priv = GET_USER_PRIVATE (user);
+        if (!priv->path)
+        {
+            g_free (priv->session);
+            priv->session = g_strdup (session);
+            g_signal_emit (user, user_signals[CHANGED], 0);
+        }
     }
 }
 
@@ -1478,6 +1948,54 @@ common_user_get_gid (CommonUser *user)
     return priv->gid;
 }
 
+static void
+add_string (GVariantBuilder *builder, const gchar *key, const gchar *value)
+{
+    if (value)
+        g_variant_builder_add (builder, "{sv}", key, g_variant_new_string (value));
+}
+
+/**
+ * common_user_serialize:
+ * @user: A #CommonUser
+ *
+ * Get the properties of a user in a form that can be fed to another process's
+ * user list with common_user_list_update_user().  Settings from .dmrc are not
+ * included, the receiving list loads them itself when they are needed.
+ *
+ * Return value: A floating a{sv} #GVariant
+ **/
+GVariant *
+common_user_serialize (CommonUser *user)
+{
+    g_return_val_if_fail (COMMON_IS_USER (user), NULL);
+
+    CommonUserPrivate *priv = GET_USER_PRIVATE (user);
+
+    GVariantBuilder builder;
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+    add_string (&builder, "Name", priv->name);
+    add_string (&builder, "RealName", priv->real_name);
+    add_string (&builder, "HomeDirectory", priv->home_directory);
+    add_string (&builder, "Shell", priv->shell);
+    add_string (&builder, "Image", priv->image);
+    add_string (&builder, "Background", priv->background);
+    /* Reading every user's .dmrc here would block the daemon */
+    if (priv->path)
+    {
+        add_string (&builder, "Language", priv->language);
+        add_string (&builder, "Session", priv->session);
+        g_variant_builder_add (&builder, "{sv}", "Layouts", g_variant_new_strv ((const gchar * const *) priv->layouts, -1));
+    }
+    g_variant_builder_add (&builder, "{sv}", "HasMessages", g_variant_new_boolean (priv->has_messages));
+    g_variant_builder_add (&builder, "{sv}", "Uid", g_variant_new_uint64 (priv->uid));
+    g_variant_builder_add (&builder, "{sv}", "Gid", g_variant_new_uint64 (common_user_get_gid (user)));
+    if (priv->path)
+        g_variant_builder_add (&builder, "{sv}", "Path", g_variant_new_object_path (priv->path));
+
+    return g_variant_builder_end (&builder);
+}
+
 static void
 common_user_init (CommonUser *user)
 {
@@ -1575,6 +2093,7 @@ common_user_finalize (GObject *object)
     g_clear_pointer (&priv->language, g_free);
     g_clear_pointer (&priv->layouts, g_strfreev);
     g_clear_pointer (&priv->session, g_free);
+    g_clear_pointer (&priv->properties, g_variant_unref);
 }
 
 static void
@@ -78,6 +78,16 @@ CommonUser *common_user_list_get_user_by_name (CommonUserList *user_list, const
 
 GList *common_user_list_get_users (CommonUserList *user_list);
 
+void common_user_list_set_snapshot (CommonUserList *user_list, GVariant *snapshot);
+
+void common_user_list_update_user (CommonUserList *user_list, GVariant *properties);
+
+void common_user_list_remove_user (CommonUserList *user_list, const gchar *username);
+
+void common_user_list_add_session (CommonUserList *user_list, const gchar *id, const gchar *username);
+
+void common_user_list_remove_session (CommonUserList *user_list, const gchar *id);
+
 const gchar *common_user_get_name (CommonUser *user);
 
 const gchar *common_user_get_real_name (CommonUser *user);
@@ -112,6 +122,8 @@ uid_t common_user_get_uid (CommonUser *user);
 
 gid_t common_user_get_gid (CommonUser *user);
 
+GVariant *common_user_serialize (CommonUser *user);
+
 G_END_DECLS
 
 #endif /* COMMON_USER_LIST_H_ */
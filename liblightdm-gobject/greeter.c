@@ -12,11 +12,13 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <gio/gio.h>
 #include <gio/gunixsocketaddress.h>
 #include <security/pam_appl.h>
 
 #include "lightdm/greeter.h"
+#include "user-list.h"
 
 /**
  * SECTION:greeter
@@ -172,7 +174,9 @@ G_DEFINE_TYPE (LightDMGreeter, lightdm_greeter, G_TYPE_OBJECT)
 
 #define HEADER_SIZE 8
 #define MAX_MESSAGE_LENGTH 1024
-#define API_VERSION 1
+/* The user list arrives in a single message so replies can be much longer than requests */
+#define MAX_RECEIVE_LENGTH (16 * 1024 * 1024)
+#define API_VERSION 2
 
 /* Messages from the greeter to the server */
 typedef enum
@@ -199,6 +203,11 @@ typedef enum
     SERVER_MESSAGE_IDLE,
     SERVER_MESSAGE_RESET,
     SERVER_MESSAGE_CONNECTED_V2,
+    SERVER_MESSAGE_USER_LIST,
+    SERVER_MESSAGE_USER_CHANGED,
+    SERVER_MESSAGE_USER_REMOVED,
+    SERVER_MESSAGE_SESSION_ADDED,
+    SERVER_MESSAGE_SESSION_REMOVED,
 } ServerMessage;
 
 /* Request sent to server */
@@ -237,6 +246,7 @@ lightdm_greeter_error_get_type (void)
             { LIGHTDM_GREETER_ERROR_SESSION_FAILED, "LIGHTDM_GREETER_ERROR_SESSION_FAILED", "session-failed" },
             { LIGHTDM_GREETER_ERROR_NO_AUTOLOGIN, "LIGHTDM_GREETER_ERROR_NO_AUTOLOGIN", "no-autologin" },
             { LIGHTDM_GREETER_ERROR_INVALID_USER, "LIGHTDM_GREETER_ERROR_INVALID_USER", "invalid-user" },
+            { LIGHTDM_GREETER_ERROR_TIMED_OUT, "LIGHTDM_GREETER_ERROR_TIMED_OUT", "timed-out" },
             { 0, NULL, NULL }
         };
         enum_type = g_enum_register_static (g_intern_static_string ("LightDMGreeterError"), values);
@@ -506,6 +516,9 @@ connect_to_daemon (LightDMGreeter *greeter, GError **error)
         !g_io_channel_set_encoding (priv->from_server_channel, NULL, error))
         return FALSE;
 
+    /* Read directly from the socket so polling it shows if there is more data to read */
+    g_io_channel_set_buffered (priv->from_server_channel, FALSE);
+
     return TRUE;
 }
 
@@ -788,6 +801,53 @@ handle_shared_dir_result (LightDMGreeter *greeter, guint8 *message, gsize messag
     }
 }
 
+/* Read a serialized variant that makes up the rest of the message */
+static GVariant *
+read_variant (guint8 *message, gsize message_length, gsize *offset, const GVariantType *type)
+{
+    g_autoptr(GBytes) data = g_bytes_new (message + *offset, message_length - *offset);
+    *offset = message_length;
+
+    /* Not trusted as it comes from another process, GVariant checks it as it is accessed */
+    return g_variant_ref_sink (g_variant_new_from_bytes (type, data, FALSE));
+}
+
+static void
+handle_user_list (LightDMGreeter *greeter, guint8 *message, gsize message_length, gsize *offset)
+{
+    g_autoptr(GVariant) snapshot = read_variant (message, message_length, offset, G_VARIANT_TYPE ("(aa{sv}a(ss))"));
+    common_user_list_set_snapshot (common_user_list_get_instance (), snapshot);
+}
+
+static void
+handle_user_changed (LightDMGreeter *greeter, guint8 *message, gsize message_length, gsize *offset)
+{
+    g_autoptr(GVariant) properties = read_variant (message, message_length, offset, G_VARIANT_TYPE ("a{sv}"));
+    common_user_list_update_user (common_user_list_get_instance (), properties);
+}
+
+static void
+handle_user_removed (LightDMGreeter *greeter, guint8 *message, gsize message_length, gsize *offset)
+{
+    g_autofree gchar *username = read_string (message, message_length, offset);
+    common_user_list_remove_user (common_user_list_get_instance (), username);
+}
+
+static void
+handle_session_added (LightDMGreeter *greeter, guint8 *message, gsize message_length, gsize *offset)
+{
+    g_autofree gchar *id = read_string (message, message_length, offset);
+    g_autofree gchar *username = read_string (message, message_length, offset);
+    common_user_list_add_session (common_user_list_get_instance (), id, username);
+}
+
+static void
+handle_session_removed (LightDMGreeter *greeter, guint8 *message, gsize message_length, gsize *offset)
+{
+    g_autofree gchar *id = read_string (message, message_length, offset);
+    common_user_list_remove_session (common_user_list_get_instance (), id);
+}
+
 static void
 handle_message (LightDMGreeter *greeter, guint8 *message, gsize message_length)
 {
@@ -820,40 +880,121 @@ handle_message (LightDMGreeter *greeter, guint8 *message, gsize message_length)
     case SERVER_MESSAGE_CONNECTED_V2:
         handle_connected (greeter, TRUE, message, message_length, &offset);
         break;
+    case SERVER_MESSAGE_USER_LIST:
+        handle_user_list (greeter, message, message_length, &offset);
+        break;
+    case SERVER_MESSAGE_USER_CHANGED:
+        handle_user_changed (greeter, message, message_length, &offset);
+        break;
+    case SERVER_MESSAGE_USER_REMOVED:
+        handle_user_removed (greeter, message, message_length, &offset);
+        break;
+    case SERVER_MESSAGE_SESSION_ADDED:
+        handle_session_added (greeter, message, message_length, &offset);
+        break;
+    case SERVER_MESSAGE_SESSION_REMOVED:
+        handle_session_removed (greeter, message, message_length, &offset);
+        break;
     default:
         g_warning ("Unknown message from server: %d", id);
         break;
     }
 }
 
+/* Wait until the daemon has sent data or @deadline (monotonic time, or -1 to wait forever) has passed */
+static gboolean
+wait_for_data (LightDMGreeter *greeter, gint64 deadline, GError **error)
+{
+    LightDMGreeterPrivate *priv = GET_PRIVATE (greeter);
+
+    GPollFD fd;
+    fd.fd = g_io_channel_unix_get_fd (priv->from_server_channel);
+    fd.events = G_IO_IN | G_IO_HUP | G_IO_ERR;
+
+    while (TRUE)
+    {
+        gint timeout = -1;
+        if (deadline >= 0)
+        {
+            gint64 now = g_get_monotonic_time ();
+            timeout = now < deadline ? (gint) ((deadline - now + 999) / 1000) : 0;
+        }
+
+        fd.revents = 0;
+        int n_fds = g_poll (&fd, 1, timeout);
+        if (n_fds > 0)
+            return TRUE;
+        if (n_fds == 0)
+        {
+            g_set_error_literal (error, LIGHTDM_GREETER_ERROR, LIGHTDM_GREETER_ERROR_TIMED_OUT,
+                                 "Timed out waiting for daemon");
+            return FALSE;
+        }
+        if (errno != EINTR)
+        {
+            g_set_error (error, LIGHTDM_GREETER_ERROR, LIGHTDM_GREETER_ERROR_COMMUNICATION_ERROR,
+                         "Failed to wait for daemon: %s", g_strerror (errno));
+            return FALSE;
+        }
+    }
+}
+
+/* Read a message from the daemon. If @block is FALSE only data that is already available is read and
+ * @message is set to NULL if a complete message has not arrived yet. If @block is TRUE this waits
+ * until @deadline (monotonic time, or -1 for no limit) for a complete message. */
 static gboolean
-recv_message (LightDMGreeter *greeter, gboolean block, guint8 **message, gsize *length, GError **error)
+recv_message (LightDMGreeter *greeter, gboolean block, gint64 deadline, guint8 **message, gsize *length, GError **error)
 {
     LightDMGreeterPrivate *priv = GET_PRIVATE (greeter);
 
+    if (message)
+        *message = NULL;
+    if (length)
+        *length = 0;
+
     if (!connect_to_daemon (greeter, error))
         return FALSE;
 
-    /* Read the header, or the whole message if we already have that */
-    gsize n_to_read = HEADER_SIZE;
-    if (priv->n_read >= HEADER_SIZE)
-        n_to_read += get_message_length (priv->read_buffer, priv->n_read);
-
-    do
+    while (TRUE)
     {
+        /* Read the header, then the rest of the message once we know how long it is */
+        gsize n_to_read = HEADER_SIZE;
+        if (priv->n_read >= HEADER_SIZE)
+            n_to_read += get_message_length (priv->read_buffer, priv->n_read);
+        if (n_to_read > MAX_RECEIVE_LENGTH)
+        {
+            g_set_error (error, LIGHTDM_GREETER_ERROR, LIGHTDM_GREETER_ERROR_COMMUNICATION_ERROR,
+                         "Failed to read from daemon: message of %zu octets is too long",
+                         n_to_read);
+            return FALSE;
+        }
+        if (priv->n_read == n_to_read)
+            break;
+
+        /* The channel is unbuffered, so if the socket is readable the read below returns without blocking */
+        GPollFD fd = { g_io_channel_unix_get_fd (priv->from_server_channel), G_IO_IN | G_IO_HUP | G_IO_ERR, 0 };
+        if (g_poll (&fd, 1, 0) <= 0)
+        {
+            if (!block)
+                return TRUE;
+            if (!wait_for_data (greeter, deadline, error))
+                return FALSE;
+        }
+
         gsize n_read;
         g_autoptr(GError) read_error = NULL;
         GIOStatus status = g_io_channel_read_chars (priv->from_server_channel,
-                                          (gchar *) priv->read_buffer + priv->n_read,
-                                          n_to_read - priv->n_read,
-                                          &n_read,
-                                          &read_error);
-        if (status == G_IO_STATUS_AGAIN)
+                                                    (gchar *) priv->read_buffer + priv->n_read,
+                                                    n_to_read - priv->n_read,
+                                                    &n_read,
+                                                    &read_error);
+        if (status == G_IO_STATUS_EOF)
         {
-            if (block)
-                continue;
+            g_set_error_literal (error, LIGHTDM_GREETER_ERROR, LIGHTDM_GREETER_ERROR_COMMUNICATION_ERROR,
+                                 "Failed to read from daemon: connection closed");
+            return FALSE;
         }
-        else if (status != G_IO_STATUS_NORMAL)
+        else if (status == G_IO_STATUS_ERROR)
         {
             g_set_error (error, LIGHTDM_GREETER_ERROR, LIGHTDM_GREETER_ERROR_COMMUNICATION_ERROR,
                          "Failed to read from daemon: %s",
@@ -864,26 +1005,13 @@ recv_message (LightDMGreeter *greeter, gboolean block, guint8 **message, gsize *
         g_debug ("Read %zi bytes from daemon", n_read);
 
         priv->n_read += n_read;
-    } while (priv->n_read < n_to_read && block);
 
-    /* Stop if haven't got all the data we want */
-    if (priv->n_read != n_to_read)
-    {
-        if (message)
-            *message = NULL;
-        if (length)
-            *length = 0;
-        return TRUE;
-    }
-
-    /* If have header, rerun for content */
-    if (priv->n_read == HEADER_SIZE)
-    {
-        n_to_read = get_message_length (priv->read_buffer, priv->n_read);
-        if (n_to_read > 0)
+        /* Make space for the rest of the message once the header is complete, overly long ones are rejected above */
+        if (priv->n_read == HEADER_SIZE)
         {
-            priv->read_buffer = g_realloc (priv->read_buffer, HEADER_SIZE + n_to_read);
-            return recv_message (greeter, block, message, length, error);
+            gsize message_length = HEADER_SIZE + get_message_length (priv->read_buffer, priv->n_read);
+            if (message_length <= MAX_RECEIVE_LENGTH)
+                priv->read_buffer = g_realloc (priv->read_buffer, message_length);
         }
     }
 
@@ -894,7 +1022,7 @@ recv_message (LightDMGreeter *greeter, gboolean block, guint8 **message, gsize *
     if (length)
         *length = priv->n_read;
 
-    priv->read_buffer = g_malloc (priv->n_read);
+    priv->read_buffer = g_malloc (HEADER_SIZE);
     priv->n_read = 0;
 
     return TRUE;
@@ -905,21 +1033,43 @@ from_server_cb (GIOChannel *source, GIOCondition condition, gpointer data)
 {
     LightDMGreeter *greeter = data;
 
-    /* Read one message and process it */
-    g_autofree guint8 *message = NULL;
-    gsize message_length;
-    g_autoptr(GError) error = NULL;
-    if (!recv_message (greeter, FALSE, &message, &message_length, &error))
+    /* A signal handler may drop the last reference to the greeter while we are still reading */
+    g_object_ref (greeter);
+
+    /* Process every complete message that has arrived */
+    gboolean result = G_SOURCE_CONTINUE;
+    while (TRUE)
     {
-        // FIXME: Should push this up to the client somehow
-        g_warning ("Failed to read from daemon: %s\n", error->message);
-        return G_SOURCE_REMOVE;
-    }
+        g_autofree guint8 *message = NULL;
+        gsize message_length;
+        g_autoptr(GError) error = NULL;
+        if (!recv_message (greeter, FALSE, -1, &message, &message_length, &error))
+        {
+            // FIXME: Should push this up to the client somehow
+            g_warning ("Failed to read from daemon: %s\n", error->message);
+            GET_PRIVATE (greeter)->from_server_watch = 0;
+            result = G_SOURCE_REMOVE;
+            break;
+        }
+
+        if (!message)
+            break;
 
-    if (message)
         handle_message (greeter, message, message_length);
+    }
+
+    g_object_unref (greeter);
+
+    return result;
+}
 
-    return G_SOURCE_CONTINUE;
+/* Get the deadline to use for a timeout in milliseconds, or -1 for no timeout */
+static gint64
+get_deadline (gint timeout)
+{
+    if (timeout < 0)
+        return -1;
+    return g_get_monotonic_time () + (gint64) timeout * 1000;
 }
 
 static gboolean
@@ -1026,11 +1176,33 @@ lightdm_greeter_connect_to_daemon_finish (LightDMGreeter *greeter, GAsyncResult
  **/
 gboolean
 lightdm_greeter_connect_to_daemon_sync (LightDMGreeter *greeter, GError **error)
+{
+    return lightdm_greeter_connect_to_daemon_sync_with_timeout (greeter, -1, error);
+}
+
+/**
+ * lightdm_greeter_connect_to_daemon_sync_with_timeout:
+ * @greeter: The greeter to connect
+ * @timeout: Maximum time to wait in milliseconds or -1 to wait forever
+ * @error: return location for a #GError, or %NULL
+ *
+ * Connects the greeter to the display manager.  Will block until connected or @timeout has passed,
+ * in which case %LIGHTDM_GREETER_ERROR_TIMED_OUT is returned.
+ *
+ * A timeout does not cancel the request.  The daemon still receives it and the greeter becomes
+ * connected when the reply is handled in the main loop, so don't send a new connect request.
+ *
+ * Return value: #TRUE if successfully connected
+ **/
+gboolean
+lightdm_greeter_connect_to_daemon_sync_with_timeout (LightDMGreeter *greeter, gint timeout, GError **error)
 {
     g_return_val_if_fail (LIGHTDM_IS_GREETER (greeter), FALSE);
 
     LightDMGreeterPrivate *priv = GET_PRIVATE (greeter);
 
+    gint64 deadline = get_deadline (timeout);
+
     /* Read until we are connected */
     if (!send_connect (greeter, priv->resettable, error))
         return FALSE;
@@ -1040,7 +1212,7 @@ lightdm_greeter_connect_to_daemon_sync (LightDMGreeter *greeter, GError **error)
     {
         g_autofree guint8 *message = NULL;
         gsize message_length;
-        if (!recv_message (greeter, TRUE, &message, &message_length, error))
+        if (!recv_message (greeter, TRUE, deadline, &message, &message_length, error))
             return FALSE;
         handle_message (greeter, message, message_length);
     } while (!request->complete);
@@ -1657,6 +1829,27 @@ lightdm_greeter_start_session_finish (LightDMGreeter *greeter, GAsyncResult *res
  **/
 gboolean
 lightdm_greeter_start_session_sync (LightDMGreeter *greeter, const gchar *session, GError **error)
+{
+    return lightdm_greeter_start_session_sync_with_timeout (greeter, session, -1, error);
+}
+
+/**
+ * lightdm_greeter_start_session_sync_with_timeout:
+ * @greeter: A #LightDMGreeter
+ * @session: (allow-none): The session to log into or #NULL to use the default.
+ * @timeout: Maximum time to wait in milliseconds or -1 to wait forever
+ * @error: return location for a #GError, or %NULL
+ *
+ * Start a session for the authenticated user.  Will block until the session is started or @timeout
+ * has passed, in which case %LIGHTDM_GREETER_ERROR_TIMED_OUT is returned.
+ *
+ * A timeout does not cancel the request.  It stays queued and the daemon still starts the session;
+ * the result is discarded when it arrives.
+ *
+ * Return value: TRUE if the session was started.
+ **/
+gboolean
+lightdm_greeter_start_session_sync_with_timeout (LightDMGreeter *greeter, const gchar *session, gint timeout, GError **error)
 {
     g_return_val_if_fail (LIGHTDM_IS_GREETER (greeter), FALSE);
 
@@ -1665,6 +1858,8 @@ lightdm_greeter_start_session_sync (LightDMGreeter *greeter, const gchar *sessio
     g_return_val_if_fail (priv->connected, FALSE);
     g_return_val_if_fail (priv->is_authenticated, FALSE);
 
+    gint64 deadline = get_deadline (timeout);
+
     /* Read until the session is started */
     if (!send_start_session (greeter, session, error))
         return FALSE;
@@ -1674,7 +1869,7 @@ lightdm_greeter_start_session_sync (LightDMGreeter *greeter, const gchar *sessio
     {
         g_autofree guint8 *message = NULL;
         gsize message_length;
-        if (!recv_message (greeter, TRUE, &message, &message_length, error))
+        if (!recv_message (greeter, TRUE, deadline, &message, &message_length, error))
             return FALSE;
         handle_message (greeter, message, message_length);
     } while (!request->complete);
@@ -1760,6 +1955,28 @@ lightdm_greeter_ensure_shared_data_dir_finish (LightDMGreeter *greeter, GAsyncRe
  **/
 gchar *
 lightdm_greeter_ensure_shared_data_dir_sync (LightDMGreeter *greeter, const gchar *username, GError **error)
+{
+    return lightdm_greeter_ensure_shared_data_dir_sync_with_timeout (greeter, username, -1, error);
+}
+
+/**
+ * lightdm_greeter_ensure_shared_data_dir_sync_with_timeout:
+ * @greeter: A #LightDMGreeter
+ * @username: A username
+ * @timeout: Maximum time to wait in milliseconds or -1 to wait forever
+ * @error: return location for a #GError, or %NULL
+ *
+ * Ensure that a shared data dir for the given user is available, see
+ * lightdm_greeter_ensure_shared_data_dir_sync().  Will block until the daemon responds or @timeout
+ * has passed, in which case %LIGHTDM_GREETER_ERROR_TIMED_OUT is returned.
+ *
+ * A timeout does not cancel the request.  It stays queued and the daemon still creates the
+ * directory; the path is discarded when it arrives.
+ *
+ * Return value: The path to the shared directory, free with g_free.
+ **/
+gchar *
+lightdm_greeter_ensure_shared_data_dir_sync_with_timeout (LightDMGreeter *greeter, const gchar *username, gint timeout, GError **error)
 {
     g_return_val_if_fail (LIGHTDM_IS_GREETER (greeter), NULL);
 
@@ -1767,6 +1984,8 @@ lightdm_greeter_ensure_shared_data_dir_sync (LightDMGreeter *greeter, const gcha
 
     g_return_val_if_fail (priv->connected, NULL);
 
+    gint64 deadline = get_deadline (timeout);
+
     /* Read until a response */
     if (!send_ensure_shared_data_dir (greeter, username, error))
         return NULL;
@@ -1776,7 +1995,7 @@ lightdm_greeter_ensure_shared_data_dir_sync (LightDMGreeter *greeter, const gcha
     {
         g_autofree guint8 *message = NULL;
         gsize message_length;
-        if (!recv_message (greeter, TRUE, &message, &message_length, error))
+        if (!recv_message (greeter, TRUE, deadline, &message, &message_length, error))
             return FALSE;
         handle_message (greeter, message, message_length);
     } while (!request->complete);
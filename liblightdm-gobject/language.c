@@ -8,6 +8,7 @@
  * See http://www.gnu.org/copyleft/lgpl.html the full text of the license.
  */
 
+#include <stdlib.h>
 #include <string.h>
 #include <locale.h>
 #include <langinfo.h>
@@ -54,15 +55,109 @@ G_DEFINE_TYPE (LightDMLanguage, lightdm_language, G_TYPE_OBJECT)
 
 #define GET_PRIVATE(obj) G_TYPE_INSTANCE_GET_PRIVATE ((obj), LIGHTDM_TYPE_LANGUAGE, LightDMLanguagePrivate)
 
+/* Where glibc keeps compiled locales, see locale/locarchive.h in glibc */
+#define LOCALE_DIR "/usr/lib/locale"
+#define LOCALE_ARCHIVE LOCALE_DIR "/locale-archive"
+#define LOCALE_ARCHIVE_MAGIC 0xde020109
+
+typedef struct
+{
+    guint32 magic;
+    guint32 serial;
+    guint32 namehash_offset;
+    guint32 namehash_used;
+    guint32 namehash_size;
+    guint32 string_offset;
+    guint32 string_used;
+    guint32 string_size;
+    guint32 locrectab_offset;
+    guint32 locrectab_used;
+    guint32 locrectab_size;
+    guint32 sumhash_offset;
+    guint32 sumhash_used;
+    guint32 sumhash_size;
+} LocaleArchiveHeader;
+
+typedef struct
+{
+    guint32 hashval;
+    guint32 name_offset;
+    guint32 locrec_offset;
+} LocaleArchiveNameEntry;
+
 static gboolean have_languages = FALSE;
 static GList *languages = NULL;
 
+/* Names of all compiled locales, sorted */
+static gchar **available_locales = NULL;
+
 static void
-update_languages (void)
+load_locale_archive (GHashTable *locales)
 {
-    if (have_languages)
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GMappedFile) file = g_mapped_file_new (LOCALE_ARCHIVE, FALSE, &error);
+    if (!file)
+    {
+        if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+            g_warning ("Failed to open locale archive: %s", error->message);
         return;
+    }
+
+    const gchar *data = g_mapped_file_get_contents (file);
+    gsize length = g_mapped_file_get_length (file);
+
+    LocaleArchiveHeader header;
+    if (length < sizeof (header))
+        return;
+    memcpy (&header, data, sizeof (header));
+    if (header.magic != LOCALE_ARCHIVE_MAGIC ||
+        header.namehash_offset > length ||
+        header.namehash_size > (length - header.namehash_offset) / sizeof (LocaleArchiveNameEntry))
+    {
+        g_warning ("Ignoring invalid locale archive %s", LOCALE_ARCHIVE);
+        return;
+    }
+
+    for (guint32 i = 0; i < header.namehash_size; i++)
+    {
+        LocaleArchiveNameEntry entry;
+        memcpy (&entry, data + header.namehash_offset + i * sizeof (entry), sizeof (entry));
+
+        /* Unused slot */
+        if (entry.locrec_offset == 0 || entry.name_offset >= length)
+            continue;
+
+        const gchar *name = data + entry.name_offset;
+        gsize name_length = strnlen (name, length - entry.name_offset);
+        if (name_length == 0 || name_length == length - entry.name_offset)
+            continue;
 
+        gchar *locale = g_strndup (name, name_length);
+        g_hash_table_add (locales, locale);
+    }
+}
+
+static void
+load_locale_dirs (GHashTable *locales)
+{
+    GDir *dir = g_dir_open (LOCALE_DIR, 0, NULL);
+    if (!dir)
+        return;
+
+    const gchar *name;
+    while ((name = g_dir_read_name (dir)))
+    {
+        g_autofree gchar *path = g_build_filename (LOCALE_DIR, name, "LC_IDENTIFICATION", NULL);
+        if (g_file_test (path, G_FILE_TEST_EXISTS))
+            g_hash_table_add (locales, g_strdup (name));
+    }
+
+    g_dir_close (dir);
+}
+
+static gchar **
+run_locale_command (void)
+{
     const gchar *command = "locale -a";
     g_autofree gchar *stdout_text = NULL;
     g_autofree gchar *stderr_text = NULL;
@@ -73,23 +168,65 @@ update_languages (void)
         g_warning ("Failed to run '%s': %s", command, error->message);
     else if (exit_status != 0)
         g_warning ("Failed to get languages, '%s' returned %d", command, exit_status);
-    else if (result)
+    if (!result || exit_status != 0)
+        return g_new0 (gchar *, 1);
+
+    return g_strsplit_set (g_strstrip (stdout_text), "\n\r", -1);
+}
+
+static gint
+compare_locale (gconstpointer a, gconstpointer b)
+{
+    return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+/* Get the compiled locales the same way 'locale -a' does without having to run it */
+static gchar **
+get_available_locales (void)
+{
+    if (available_locales)
+        return available_locales;
+
+    g_autoptr(GHashTable) locales = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    load_locale_archive (locales);
+    load_locale_dirs (locales);
+
+    /* Fall back to asking the C library if it keeps locales somewhere else */
+    if (g_hash_table_size (locales) == 0)
     {
-        g_auto(GStrv) tokens = g_strsplit_set (stdout_text, "\n\r", -1);
-        for (int i = 0; tokens[i]; i++)
-        {
-            const gchar *code = g_strchug (tokens[i]);
-            if (code[0] == '\0')
-                continue;
+        available_locales = run_locale_command ();
+        return available_locales;
+    }
 
-            /* Ignore the non-interesting languages */
-            if (strcmp (command, "locale -a") == 0 && !g_strrstr (code, ".utf8"))
-                continue;
+    guint length;
+    available_locales = (gchar **) g_hash_table_get_keys_as_array (locales, &length);
+    g_hash_table_steal_all (locales);
+    qsort (available_locales, length, sizeof (gchar *), compare_locale);
 
-            LightDMLanguage *language = g_object_new (LIGHTDM_TYPE_LANGUAGE, "code", code, NULL);
-            languages = g_list_append (languages, language);
-        }
+    return available_locales;
+}
+
+static void
+update_languages (void)
+{
+    if (have_languages)
+        return;
+
+    gchar **locales = get_available_locales ();
+    for (int i = 0; locales[i]; i++)
+    {
+        const gchar *code = g_strchug (locales[i]);
+        if (code[0] == '\0')
+            continue;
+
+        /* Ignore the non-interesting languages */
+        if (!g_strrstr (code, ".utf8"))
+            continue;
+
+        LightDMLanguage *language = g_object_new (LIGHTDM_TYPE_LANGUAGE, "code", code, NULL);
+        languages = g_list_prepend (languages, language);
     }
+    languages = g_list_reverse (languages);
 
     have_languages = TRUE;
 }
@@ -100,7 +237,7 @@ is_utf8 (const gchar *code)
     return g_strrstr (code, ".utf8") || g_strrstr (code, ".UTF-8");
 }
 
-/* Get a valid locale name that can be passed to setlocale(), so we always can use nl_langinfo() to get language and country names. */
+/* Get a valid locale name that can be passed to newlocale(), so we always can use nl_langinfo_l() to get language and country names. */
 static gchar *
 get_locale_name (const gchar *code)
 {
@@ -114,23 +251,10 @@ get_locale_name (const gchar *code)
     else
         language = g_strdup (code);
 
-    static gchar **avail_locales;
-    if (!avail_locales)
-    {
-        g_autofree gchar *locales = NULL;
-        g_autoptr(GError) error = NULL;
-        if (g_spawn_command_line_sync ("locale -a", &locales, NULL, NULL, &error))
-            avail_locales = g_strsplit (g_strchomp (locales), "\n", -1);
-        else
-            g_warning ("Failed to run 'locale -a': %s", error->message);
-    }
-
-    if (!avail_locales)
-        return NULL;
-
-    for (gint i = 0; avail_locales[i]; i++)
+    gchar **locales = get_available_locales ();
+    for (gint i = 0; locales[i]; i++)
     {
-        const gchar *loc = avail_locales[i];
+        const gchar *loc = locales[i];
         if (!g_strrstr (loc, ".utf8"))
             continue;
         if (g_str_has_prefix (loc, language))
@@ -140,6 +264,55 @@ get_locale_name (const gchar *code)
     return NULL;
 }
 
+/* Translate using the messages locale from the environment, without changing the global locale */
+static gchar *
+translate (const gchar *domain, const gchar *text)
+{
+    static locale_t messages_locale = (locale_t) 0;
+    static gboolean have_messages_locale = FALSE;
+    if (!have_messages_locale)
+    {
+        locale_t base = duplocale (LC_GLOBAL_LOCALE);
+        if (base != (locale_t) 0)
+        {
+            messages_locale = newlocale (LC_MESSAGES_MASK, "", base);
+            if (messages_locale == (locale_t) 0)
+                freelocale (base);
+        }
+        have_messages_locale = TRUE;
+    }
+
+    if (messages_locale == (locale_t) 0)
+        return g_strdup (dgettext (domain, text));
+
+    locale_t previous_locale = uselocale (messages_locale);
+    gchar *result = g_strdup (dgettext (domain, text));
+    uselocale (previous_locale);
+
+    return result;
+}
+
+static gchar *
+get_identification (const gchar *code, nl_item item, const gchar *domain)
+{
+    g_autofree gchar *locale = get_locale_name (code);
+    if (!locale)
+        return NULL;
+
+    locale_t identification = newlocale (LC_IDENTIFICATION_MASK, locale, (locale_t) 0);
+    if (identification == (locale_t) 0)
+        return NULL;
+
+    gchar *value = NULL;
+    const gchar *value_en = nl_langinfo_l (item, identification);
+    if (value_en && strlen (value_en) > 0 && g_strcmp0 (value_en, "ISO") != 0)
+        value = translate (domain, value_en);
+
+    freelocale (identification);
+
+    return value;
+}
+
 /**
  * lightdm_get_language:
  *
@@ -210,19 +383,7 @@ lightdm_language_get_name (LightDMLanguage *language)
 
     if (!priv->name)
     {
-        g_autofree gchar *locale = get_locale_name (priv->code);
-        if (locale)
-        {
-            const gchar *current = setlocale (LC_ALL, NULL);
-            setlocale (LC_IDENTIFICATION, locale);
-            setlocale (LC_MESSAGES, "");
-
-            const gchar *language_en = nl_langinfo (_NL_IDENTIFICATION_LANGUAGE);
-            if (language_en && strlen (language_en) > 0)
-                priv->name = g_strdup (dgettext ("iso_639_3", language_en));
-
-            setlocale (LC_ALL, current);
-        }
+        priv->name = get_identification (priv->code, _NL_IDENTIFICATION_LANGUAGE, "iso_639_3");
         if (!priv->name)
         {
             g_auto(GStrv) tokens = g_strsplit_set (priv->code, "_.@", 2);
@@ -250,19 +411,7 @@ lightdm_language_get_territory (LightDMLanguage *language)
 
     if (!priv->territory && strchr (priv->code, '_'))
     {
-        g_autofree gchar *locale = get_locale_name (priv->code);
-        if (locale)
-        {
-            gchar *current = setlocale (LC_ALL, NULL);
-            setlocale (LC_IDENTIFICATION, locale);
-            setlocale (LC_MESSAGES, "");
-
-            gchar *country_en = nl_langinfo (_NL_IDENTIFICATION_TERRITORY);
-            if (country_en && strlen (country_en) > 0 && g_strcmp0 (country_en, "ISO") != 0)
-                priv->territory = g_strdup (dgettext ("iso_3166", country_en));
-
-            setlocale (LC_ALL, current);
-        }
+        priv->territory = get_identification (priv->code, _NL_IDENTIFICATION_TERRITORY, "iso_3166");
         if (!priv->territory)
         {
             g_auto(GStrv) tokens = g_strsplit_set (priv->code, "_.@", 3);
@@ -9,6 +9,11 @@
  * See http://www.gnu.org/copyleft/lgpl.html the full text of the license.
  */
 
+#include <errno.h>
+#include <string.h>
+#include <locale.h>
+#include <glib/gstdio.h>
+#include <X11/Xatom.h>
 #include <libxklavier/xklavier.h>
 
 #include "lightdm/layout.h"
@@ -45,16 +50,38 @@ typedef struct
     gchar *name;
     gchar *short_description;
     gchar *description;
+
+    /* Position of this layout in the registry cache or -1 if not from the cache */
+    gint cache_index;
+
+    /* TRUE if the variants of this layout have been loaded */
+    gboolean have_variants;
+
+    /* Variants of this layout */
+    GList *variants;
 } LightDMLayoutPrivate;
 
 G_DEFINE_TYPE (LightDMLayout, lightdm_layout, G_TYPE_OBJECT)
 
 #define GET_PRIVATE(obj) G_TYPE_INSTANCE_GET_PRIVATE ((obj), LIGHTDM_TYPE_LAYOUT, LightDMLayoutPrivate)
 
+#ifndef XKB_RULES_DIR
+#define XKB_RULES_DIR "/usr/share/X11/xkb/rules"
+#endif
+
+/* The registry is cached as a serialized GVariant of base layouts and their
+ * variants, valid as long as the XKB rules file and locale are unchanged */
+#define CACHE_VERSION 1
+#define CACHE_TYPE "(ussxa(sssa(sss)))"
+
 static gboolean have_layouts = FALSE;
+static gboolean have_base_layouts = FALSE;
 static Display *display = NULL;
 static XklEngine *xkl_engine = NULL;
 static XklConfigRec *xkl_config = NULL;
+static XklConfigRegistry *xkl_registry = NULL;
+static GVariant *registry_cache = NULL;
+static GList *base_layouts = NULL;
 static GList *layouts = NULL;
 static LightDMLayout *default_layout = NULL;
 
@@ -87,14 +114,145 @@ parse_layout_string (const gchar *name, gchar **layout, gchar **variant)
     }
 }
 
+static gchar *
+get_cache_path (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "lightdm", "layouts.cache", NULL);
+}
+
+/* Get the XKB rules file the server is using, which is what the registry is loaded from */
+static gchar *
+get_rules_path (void)
+{
+    Atom rules_atom = XInternAtom (display, "_XKB_RULES_NAMES", True);
+    if (rules_atom == None)
+        return NULL;
+
+    Atom type;
+    int format;
+    unsigned long n_items, bytes_after;
+    unsigned char *data = NULL;
+    if (XGetWindowProperty (display, DefaultRootWindow (display), rules_atom, 0, 1024, False, XA_STRING,
+                            &type, &format, &n_items, &bytes_after, &data) != Success || !data)
+        return NULL;
+
+    gchar *path = NULL;
+    if (type == XA_STRING && format == 8 && n_items > 0 && data[0] != '\0')
+    {
+        g_autofree gchar *filename = g_strdup_printf ("%s.xml", (const gchar *) data);
+        path = g_build_filename (XKB_RULES_DIR, filename, NULL);
+    }
+    XFree (data);
+
+    return path;
+}
+
+static gint64
+get_rules_mtime (const gchar *rules_path)
+{
+    GStatBuf buf;
+    if (!rules_path || g_stat (rules_path, &buf) < 0)
+        return -1;
+    return (gint64) buf.st_mtim.tv_sec * G_USEC_PER_SEC + buf.st_mtim.tv_nsec / 1000;
+}
+
+static GVariant *
+load_registry_cache (void)
+{
+    g_autofree gchar *rules_path = get_rules_path ();
+    gint64 rules_mtime = get_rules_mtime (rules_path);
+    if (rules_mtime < 0)
+        return NULL;
+
+    g_autofree gchar *path = get_cache_path ();
+    g_autoptr(GMappedFile) file = g_mapped_file_new (path, FALSE, NULL);
+    if (!file)
+        return NULL;
+
+    g_autoptr(GBytes) data = g_mapped_file_get_bytes (file);
+    g_autoptr(GVariant) cache = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (CACHE_TYPE), data, FALSE));
+
+    guint32 version;
+    const gchar *locale, *cache_rules_path;
+    gint64 cache_rules_mtime;
+    g_variant_get (cache, "(u&s&sx@a(sssa(sss)))", &version, &locale, &cache_rules_path, &cache_rules_mtime, NULL);
+    if (version != CACHE_VERSION ||
+        g_strcmp0 (locale, setlocale (LC_MESSAGES, NULL)) != 0 ||
+        g_strcmp0 (cache_rules_path, rules_path) != 0 ||
+        cache_rules_mtime != rules_mtime)
+    {
+        g_debug ("Keyboard layout cache %s is out of date", path);
+        return NULL;
+    }
+
+    g_debug ("Loading keyboard layouts from cache %s", path);
+
+    return g_variant_get_child_value (cache, 4);
+}
+
 static void
-variant_cb (XklConfigRegistry *config,
-           const XklConfigItem *item,
-           gpointer data)
+cache_variant_cb (XklConfigRegistry *config,
+                  const XklConfigItem *item,
+                  gpointer data)
 {
-    g_autofree gchar *full_name = make_layout_string (data, item->name);
-    LightDMLayout *layout = g_object_new (LIGHTDM_TYPE_LAYOUT, "name", full_name, "short-description", item->short_description, "description", item->description, NULL);
-    layouts = g_list_append (layouts, layout);
+    GVariantBuilder *builder = data;
+    g_variant_builder_add (builder, "(sss)", item->name, item->short_description, item->description);
+}
+
+static void
+cache_layout_cb (XklConfigRegistry *config,
+                 const XklConfigItem *item,
+                 gpointer data)
+{
+    GVariantBuilder *builder = data;
+
+    g_variant_builder_open (builder, G_VARIANT_TYPE ("(sssa(sss))"));
+    g_variant_builder_add (builder, "s", item->name);
+    g_variant_builder_add (builder, "s", item->short_description);
+    g_variant_builder_add (builder, "s", item->description);
+    g_variant_builder_open (builder, G_VARIANT_TYPE ("a(sss)"));
+    xkl_config_registry_foreach_layout_variant (config, item->name, cache_variant_cb, builder);
+    g_variant_builder_close (builder);
+    g_variant_builder_close (builder);
+}
+
+/* Write the cache once the greeter is idle, as walking all the variants is the slow part */
+static gboolean
+write_registry_cache_cb (gpointer data)
+{
+    if (!xkl_registry)
+        return G_SOURCE_REMOVE;
+
+    g_autofree gchar *rules_path = get_rules_path ();
+    gint64 rules_mtime = get_rules_mtime (rules_path);
+    if (rules_mtime < 0)
+        return G_SOURCE_REMOVE;
+
+    GVariantBuilder builder;
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sssa(sss))"));
+    xkl_config_registry_foreach_layout (xkl_registry, cache_layout_cb, &builder);
+    g_autoptr(GVariant) cache = g_variant_ref_sink (g_variant_new ("(ussxa(sssa(sss)))",
+                                                                   CACHE_VERSION,
+                                                                   setlocale (LC_MESSAGES, NULL),
+                                                                   rules_path,
+                                                                   rules_mtime,
+                                                                   &builder));
+
+    g_autofree gchar *path = get_cache_path ();
+    g_autofree gchar *dir = g_path_get_dirname (path);
+    g_autoptr(GError) error = NULL;
+    if (g_mkdir_with_parents (dir, 0700) < 0 ||
+        !g_file_set_contents (path, g_variant_get_data (cache), g_variant_get_size (cache), &error))
+        g_debug ("Failed to write keyboard layout cache %s: %s", path, error ? error->message : g_strerror (errno));
+
+    return G_SOURCE_REMOVE;
+}
+
+static LightDMLayout *
+make_layout (const gchar *layout_name, const gchar *variant_name, const gchar *short_description, const gchar *description)
+{
+    g_autofree gchar *full_name = make_layout_string (layout_name, variant_name);
+    return g_object_new (LIGHTDM_TYPE_LAYOUT, "name", full_name, "short-description", short_description, "description", description, NULL);
 }
 
 static void
@@ -102,10 +260,85 @@ layout_cb (XklConfigRegistry *config,
            const XklConfigItem *item,
            gpointer data)
 {
-    LightDMLayout *layout = g_object_new (LIGHTDM_TYPE_LAYOUT, "name", item->name, "short-description", item->short_description, "description", item->description, NULL);
-    layouts = g_list_append (layouts, layout);
+    LightDMLayout *layout = make_layout (item->name, NULL, item->short_description, item->description);
+    base_layouts = g_list_prepend (base_layouts, layout);
+}
+
+static gboolean
+load_base_layouts (void)
+{
+    if (have_base_layouts)
+        return TRUE;
+
+    display = XOpenDisplay (NULL);
+    if (display == NULL)
+        return FALSE;
+
+    xkl_engine = xkl_engine_get_instance (display);
+    xkl_config = xkl_config_rec_new ();
+    if (!xkl_config_rec_get_from_server (xkl_config, xkl_engine))
+        g_warning ("Failed to get Xkl configuration from server");
+
+    registry_cache = load_registry_cache ();
+    if (registry_cache)
+    {
+        gsize n_layouts = g_variant_n_children (registry_cache);
+        for (gsize i = 0; i < n_layouts; i++)
+        {
+            const gchar *name, *short_description, *description;
+            g_variant_get_child (registry_cache, i, "(&s&s&s@a(sss))", &name, &short_description, &description, NULL);
+            LightDMLayout *layout = make_layout (name, NULL, short_description, description);
+            GET_PRIVATE (layout)->cache_index = i;
+            base_layouts = g_list_prepend (base_layouts, layout);
+        }
+    }
+    else
+    {
+        xkl_registry = xkl_config_registry_get_instance (xkl_engine);
+        xkl_config_registry_load (xkl_registry, FALSE);
+        xkl_config_registry_foreach_layout (xkl_registry, layout_cb, NULL);
+        g_idle_add_full (G_PRIORITY_LOW, write_registry_cache_cb, NULL, NULL);
+    }
+    base_layouts = g_list_reverse (base_layouts);
+
+    have_base_layouts = TRUE;
+
+    return TRUE;
+}
+
+static void
+variant_cb (XklConfigRegistry *config,
+            const XklConfigItem *item,
+            gpointer data)
+{
+    LightDMLayoutPrivate *priv = GET_PRIVATE (data);
+    LightDMLayout *layout = make_layout (priv->name, item->name, item->short_description, item->description);
+    priv->variants = g_list_prepend (priv->variants, layout);
+}
+
+static void
+load_variants (LightDMLayout *layout)
+{
+    LightDMLayoutPrivate *priv = GET_PRIVATE (layout);
 
-    xkl_config_registry_foreach_layout_variant (config, item->name, variant_cb, (gpointer) item->name);
+    if (priv->have_variants)
+        return;
+    priv->have_variants = TRUE;
+
+    if (priv->cache_index >= 0)
+    {
+        g_autoptr(GVariant) entry = g_variant_get_child_value (registry_cache, priv->cache_index);
+        g_autoptr(GVariantIter) iter = NULL;
+        g_variant_get (entry, "(&s&s&sa(sss))", NULL, NULL, NULL, &iter);
+
+        const gchar *name, *short_description, *description;
+        while (g_variant_iter_next (iter, "(&s&s&s)", &name, &short_description, &description))
+            priv->variants = g_list_prepend (priv->variants, make_layout (priv->name, name, short_description, description));
+    }
+    else if (xkl_registry)
+        xkl_config_registry_foreach_layout_variant (xkl_registry, priv->name, variant_cb, layout);
+
+    priv->variants = g_list_reverse (priv->variants);
 }
 
 /**
@@ -121,25 +354,93 @@ lightdm_get_layouts (void)
     if (have_layouts)
         return layouts;
 
-    display = XOpenDisplay (NULL);
-    if (display == NULL)
+    if (!load_base_layouts ())
         return NULL;
 
-    xkl_engine = xkl_engine_get_instance (display);
-    xkl_config = xkl_config_rec_new ();
-    if (!xkl_config_rec_get_from_server (xkl_config, xkl_engine))
-        g_warning ("Failed to get Xkl configuration from server");
+    for (GList *link = base_layouts; link; link = link->next)
+    {
+        LightDMLayout *layout = link->data;
 
-    XklConfigRegistry *registry = xkl_config_registry_get_instance (xkl_engine);
-    xkl_config_registry_load (registry, FALSE);
-    xkl_config_registry_foreach_layout (registry, layout_cb, NULL);
-    g_object_unref (registry);
+        layouts = g_list_prepend (layouts, g_object_ref (layout));
+        load_variants (layout);
+        for (GList *variant_link = GET_PRIVATE (layout)->variants; variant_link; variant_link = variant_link->next)
+            layouts = g_list_prepend (layouts, g_object_ref (variant_link->data));
+    }
+    layouts = g_list_reverse (layouts);
 
     have_layouts = TRUE;
 
     return layouts;
 }
 
+/**
+ * lightdm_get_base_layouts:
+ *
+ * Get a list of keyboard layouts without their variants. This is faster than
+ * lightdm_get_layouts() as variants are only loaded when requested with
+ * lightdm_layout_get_variants().
+ *
+ * Return value: (element-type LightDMLayout) (transfer none): A list of #LightDMLayout.
+ **/
+GList *
+lightdm_get_base_layouts (void)
+{
+    if (!load_base_layouts ())
+        return NULL;
+    return base_layouts;
+}
+
+static gboolean
+layout_has_prefix (LightDMLayout *layout, const gchar *folded_prefix)
+{
+    LightDMLayoutPrivate *priv = GET_PRIVATE (layout);
+
+    g_autofree gchar *name = g_utf8_casefold (priv->name, -1);
+    if (g_str_has_prefix (name, folded_prefix))
+        return TRUE;
+
+    if (!priv->description)
+        return FALSE;
+    g_autofree gchar *description = g_utf8_casefold (priv->description, -1);
+    return g_str_has_prefix (description, folded_prefix);
+}
+
+/**
+ * lightdm_search_layouts:
+ * @prefix: Text to search for
+ *
+ * Find the keyboard layouts and variants whose name or description starts
+ * with @prefix, ignoring case.
+ *
+ * Return value: (element-type LightDMLayout) (transfer container): A list of #LightDMLayout.
+ **/
+GList *
+lightdm_search_layouts (const gchar *prefix)
+{
+    g_return_val_if_fail (prefix != NULL, NULL);
+
+    if (!load_base_layouts ())
+        return NULL;
+
+    g_autofree gchar *folded_prefix = g_utf8_casefold (prefix, -1);
+    GList *matches = NULL;
+    for (GList *link = base_layouts; link; link = link->next)
+    {
+        LightDMLayout *layout = link->data;
+
+        if (layout_has_prefix (layout, folded_prefix))
+            matches = g_list_prepend (matches, layout);
+        load_variants (layout);
+        for (GList *variant_link = GET_PRIVATE (layout)->variants; variant_link; variant_link = variant_link->next)
+        {
+            if (layout_has_prefix (variant_link->data, folded_prefix))
+                matches = g_list_prepend (matches, variant_link->data);
+        }
+    }
+
+    return g_list_reverse (matches);
+}
+
 /**
  * lightdm_set_layout:
  * @layout: The layout to use
@@ -180,27 +481,62 @@ lightdm_set_layout (LightDMLayout *dmlayout)
 LightDMLayout *
 lightdm_get_layout (void)
 {
-    lightdm_get_layouts ();
+    if (!load_base_layouts ())
+        return NULL;
 
-    if (layouts && xkl_config && !default_layout)
+    if (xkl_config && !default_layout)
     {
-        g_autofree gchar *full_name = make_layout_string (xkl_config->layouts ? xkl_config->layouts[0] : NULL,
-                                                          xkl_config->variants ? xkl_config->variants[0] : NULL);
+        const gchar *layout_name = xkl_config->layouts ? xkl_config->layouts[0] : NULL;
+        const gchar *variant_name = xkl_config->variants ? xkl_config->variants[0] : NULL;
+        g_autofree gchar *full_name = make_layout_string (layout_name, variant_name);
 
-        for (GList *item = layouts; item; item = item->next)
+        for (GList *link = base_layouts; link; link = link->next)
         {
-            LightDMLayout *iter_layout = (LightDMLayout *) item->data;
-            if (g_strcmp0 (lightdm_layout_get_name (iter_layout), full_name) == 0)
+            LightDMLayout *layout = link->data;
+            if (g_strcmp0 (lightdm_layout_get_name (layout), layout_name) != 0)
+                continue;
+
+            if (g_strcmp0 (lightdm_layout_get_name (layout), full_name) == 0)
+                default_layout = layout;
+            else
             {
-                default_layout = iter_layout;
-                break;
+                /* Only load the variants of the active layout */
+                for (GList *variant_link = lightdm_layout_get_variants (layout); variant_link; variant_link = variant_link->next)
+                {
+                    if (g_strcmp0 (lightdm_layout_get_name (variant_link->data), full_name) == 0)
+                    {
+                        default_layout = variant_link->data;
+                        break;
+                    }
+                }
             }
+            break;
         }
     }
 
     return default_layout;
 }
 
+/**
+ * lightdm_layout_get_variants:
+ * @layout: A #LightDMLayout
+ *
+ * Get the variants of a layout. Variants are loaded the first time this is called.
+ *
+ * Return value: (element-type LightDMLayout) (transfer none): A list of #LightDMLayout or %NULL if this layout is a variant or has no variants.
+ **/
+GList *
+lightdm_layout_get_variants (LightDMLayout *layout)
+{
+    g_return_val_if_fail (LIGHTDM_IS_LAYOUT (layout), NULL);
+
+    if (strchr (GET_PRIVATE (layout)->name, '\t'))
+        return NULL;
+
+    load_variants (layout);
+    return GET_PRIVATE (layout)->variants;
+}
+
 /**
  * lightdm_layout_get_name:
  * @layout: A #LightDMLayout
@@ -249,6 +585,7 @@ lightdm_layout_get_description (LightDMLayout *layout)
 static void
 lightdm_layout_init (LightDMLayout *layout)
 {
+    GET_PRIVATE (layout)->cache_index = -1;
 }
 
 static void
@@ -312,6 +649,7 @@ lightdm_layout_finalize (GObject *object)
     g_free (priv->name);
     g_free (priv->short_description);
     g_free (priv->description);
+    g_list_free_full (priv->variants, g_object_unref);
 }
 
 static void
@@ -102,6 +102,7 @@ static inline void glib_autoptr_cleanup_LightDMGreeter (LightDMGreeter **_ptr)
  * @LIGHTDM_GREETER_ERROR_SESSION_FAILED: requested session failed to start.
  * @LIGHTDM_GREETER_ERROR_NO_AUTOLOGIN: autologin not configured.
  * @LIGHTDM_GREETER_ERROR_INVALID_USER: autologin not configured.
+ * @LIGHTDM_GREETER_ERROR_TIMED_OUT: timed out waiting for the daemon.
  *
  * Error codes returned by greeter operations.
  */
@@ -111,7 +112,8 @@ typedef enum
     LIGHTDM_GREETER_ERROR_CONNECTION_FAILED,
     LIGHTDM_GREETER_ERROR_SESSION_FAILED,
     LIGHTDM_GREETER_ERROR_NO_AUTOLOGIN,
-    LIGHTDM_GREETER_ERROR_INVALID_USER
+    LIGHTDM_GREETER_ERROR_INVALID_USER,
+    LIGHTDM_GREETER_ERROR_TIMED_OUT
 } LightDMGreeterError;
 
 GQuark lightdm_greeter_error_quark (void);
@@ -130,6 +132,8 @@ gboolean lightdm_greeter_connect_to_daemon_finish (LightDMGreeter *greeter, GAsy
 
 gboolean lightdm_greeter_connect_to_daemon_sync (LightDMGreeter *greeter, GError **error);
 
+gboolean lightdm_greeter_connect_to_daemon_sync_with_timeout (LightDMGreeter *greeter, gint timeout, GError **error);
+
 const gchar *lightdm_greeter_get_hint (LightDMGreeter *greeter, const gchar *name);
 
 const gchar *lightdm_greeter_get_default_session_hint (LightDMGreeter *greeter);
@@ -184,12 +188,16 @@ gboolean lightdm_greeter_start_session_finish (LightDMGreeter *greeter, GAsyncRe
 
 gboolean lightdm_greeter_start_session_sync (LightDMGreeter *greeter, const gchar *session, GError **error);
 
+gboolean lightdm_greeter_start_session_sync_with_timeout (LightDMGreeter *greeter, const gchar *session, gint timeout, GError **error);
+
 void lightdm_greeter_ensure_shared_data_dir (LightDMGreeter *greeter, const gchar *username, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
 
 gchar *lightdm_greeter_ensure_shared_data_dir_finish (LightDMGreeter *greeter, GAsyncResult *result, GError **error);
 
 gchar *lightdm_greeter_ensure_shared_data_dir_sync (LightDMGreeter *greeter, const gchar *username, GError **error);
 
+gchar *lightdm_greeter_ensure_shared_data_dir_sync_with_timeout (LightDMGreeter *greeter, const gchar *username, gint timeout, GError **error);
+
 #ifndef LIGHTDM_DISABLE_DEPRECATED
 gboolean lightdm_greeter_connect_sync (LightDMGreeter *greeter, GError **error);
 #endif
@@ -56,6 +56,10 @@ GType lightdm_layout_get_type (void);
 
 GList *lightdm_get_layouts (void);
 
+GList *lightdm_get_base_layouts (void);
+
+GList *lightdm_search_layouts (const gchar *prefix);
+
 void lightdm_set_layout (LightDMLayout *layout);
 
 LightDMLayout *lightdm_get_layout (void);
@@ -66,6 +70,8 @@ const gchar *lightdm_layout_get_short_description (LightDMLayout *layout);
 
 const gchar *lightdm_layout_get_description (LightDMLayout *layout);
 
+GList *lightdm_layout_get_variants (LightDMLayout *layout);
+
 G_END_DECLS
 
 #endif /* LIGHTDM_LAYOUT_H_ */
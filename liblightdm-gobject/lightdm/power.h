@@ -11,8 +11,51 @@
 #ifndef LIGHTDM_POWER_H_
 #define LIGHTDM_POWER_H_
 
+#include <glib-object.h>
+
 G_BEGIN_DECLS
 
+#define LIGHTDM_TYPE_POWER            (lightdm_power_get_type())
+#define LIGHTDM_POWER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), LIGHTDM_TYPE_POWER, LightDMPower));
+#define LIGHTDM_POWER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), LIGHTDM_TYPE_POWER, LightDMPowerClass))
+#define LIGHTDM_IS_POWER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), LIGHTDM_TYPE_POWER))
+#define LIGHTDM_IS_POWER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), LIGHTDM_TYPE_POWER))
+#define LIGHTDM_POWER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), LIGHTDM_TYPE_POWER, LightDMPowerClass))
+
+typedef struct _LightDMPower      LightDMPower;
+typedef struct _LightDMPowerClass LightDMPowerClass;
+
+struct _LightDMPower
+{
+    GObject parent_instance;
+};
+
+struct _LightDMPowerClass
+{
+    /*< private >*/
+    GObjectClass parent_class;
+
+    /* Reserved */
+    void (*reserved1) (void);
+    void (*reserved2) (void);
+    void (*reserved3) (void);
+    void (*reserved4) (void);
+    void (*reserved5) (void);
+    void (*reserved6) (void);
+};
+
+GType lightdm_power_get_type (void);
+
+LightDMPower *lightdm_power_get_instance (void);
+
+gboolean lightdm_power_get_can_suspend (LightDMPower *power);
+
+gboolean lightdm_power_get_can_hibernate (LightDMPower *power);
+
+gboolean lightdm_power_get_can_restart (LightDMPower *power);
+
+gboolean lightdm_power_get_can_shutdown (LightDMPower *power);
+
 gboolean lightdm_get_can_suspend (void);
 
 gboolean lightdm_suspend (GError **error);
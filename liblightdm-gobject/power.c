@@ -22,88 +22,249 @@
  * @include: lightdm.h
  *
  * Helper functions to perform power management operations.
+ *
+ * The lightdm_get_can_*() functions query the power management service each
+ * time they are called until #LightDMPower has been created.  After that they
+ * return its cached answer, which is refreshed when a power management service
+ * joins or leaves the bus.  Greeters that display power options for a long
+ * time should use #LightDMPower directly, which resolves all capabilities once
+ * in the background and emits #GObject::notify when they change.
+ */
+
+/**
+ * LightDMPower:
+ *
+ * #LightDMPower is an opaque data structure and can only be accessed
+ * using the provided functions.
  */
 
-static GDBusProxy *upower_proxy = NULL;
-static GDBusProxy *ck_proxy = NULL;
-static GDBusProxy *login1_proxy = NULL;
+/**
+ * LightDMPowerClass:
+ *
+ * Class structure for #LightDMPower.
+ */
+
+typedef enum
+{
+    BACKEND_LOGIN1,
+    BACKEND_CONSOLE_KIT,
+    BACKEND_UPOWER,
+    N_BACKENDS
+} PowerBackend;
+
+static const struct
+{
+    const gchar *label;
+    const gchar *name;
+    const gchar *path;
+    const gchar *interface;
+} backends[N_BACKENDS] =
+{
+    { "logind", "org.freedesktop.login1", "/org/freedesktop/login1", "org.freedesktop.login1.Manager" },
+    { "ConsoleKit", "org.freedesktop.ConsoleKit", "/org/freedesktop/ConsoleKit/Manager", "org.freedesktop.ConsoleKit.Manager" },
+    { "UPower", "org.freedesktop.UPower", "/org/freedesktop/UPower", "org.freedesktop.UPower" }
+};
+
+typedef enum
+{
+    CAPABILITY_SUSPEND,
+    CAPABILITY_HIBERNATE,
+    CAPABILITY_RESTART,
+    CAPABILITY_SHUTDOWN,
+    N_CAPABILITIES
+} PowerCapability;
+
+/* Methods used to query (and perform) each action, by backend.  Backends that
+ * can't perform an action have a NULL method.  The action methods take an
+ * 'interactive' argument where marked. */
+static const struct
+{
+    const gchar *property;
+    const gchar *verb;
+    const gchar *query[N_BACKENDS];
+    const gchar *action[N_BACKENDS];
+    gboolean action_interactive[N_BACKENDS];
+} capabilities[N_CAPABILITIES] =
+{
+    { "can-suspend", "suspend", { "CanSuspend", "CanSuspend", "SuspendAllowed" }, { "Suspend", "Suspend", "Suspend" }, { TRUE, TRUE, FALSE } },
+    { "can-hibernate", "hibernate", { "CanHibernate", "CanHibernate", "HibernateAllowed" }, { "Hibernate", "Hibernate", "Hibernate" }, { TRUE, TRUE, FALSE } },
+    { "can-restart", "restart", { "CanReboot", "CanRestart", NULL }, { "Reboot", "Restart", NULL }, { TRUE, FALSE, FALSE } },
+    { "can-shutdown", "shutdown", { "CanPowerOff", "CanStop", NULL }, { "PowerOff", "Stop", NULL }, { TRUE, FALSE, FALSE } }
+};
+
+enum
+{
+    PROP_CAN_SUSPEND = 1,
+    PROP_CAN_HIBERNATE,
+    PROP_CAN_RESTART,
+    PROP_CAN_SHUTDOWN,
+};
+
+typedef struct
+{
+    /* Connection used for background queries */
+    GDBusConnection *bus;
+
+    /* Cancellable for the queries currently in flight */
+    GCancellable *cancellable;
+
+    /* Cached capabilities */
+    gboolean known[N_CAPABILITIES];
+    gboolean allowed[N_CAPABILITIES];
+
+    /* TRUE while a capability is being resolved in the background */
+    gboolean querying[N_CAPABILITIES];
+
+    /* Watches on each backend's bus name and their last known state (-1 if unknown) */
+    guint watch_ids[N_BACKENDS];
+    gint has_owner[N_BACKENDS];
+} LightDMPowerPrivate;
+
+G_DEFINE_TYPE (LightDMPower, lightdm_power, G_TYPE_OBJECT)
+
+#define GET_PRIVATE(obj) G_TYPE_INSTANCE_GET_PRIVATE ((obj), LIGHTDM_TYPE_POWER, LightDMPowerPrivate)
+
+static LightDMPower *singleton = NULL;
+
+static GDBusProxy *proxies[N_BACKENDS] = { NULL };
+
+/* Time to skip a backend for after finding it is not on the bus */
+#define BACKEND_MISSING_TIMEOUT (30 * G_USEC_PER_SEC)
+
+/* Monotonic time each backend was found not to be on the bus or 0 if not missing */
+static gint64 backend_missing_time[N_BACKENDS] = { 0 };
+
+static gboolean
+backend_is_missing (PowerBackend backend)
+{
+    return backend_missing_time[backend] != 0 &&
+           g_get_monotonic_time () - backend_missing_time[backend] < BACKEND_MISSING_TIMEOUT;
+}
+
+static gboolean
+error_is_missing_service (GError *error)
+{
+    return g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_SERVICE_UNKNOWN) ||
+           g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_NAME_HAS_NO_OWNER);
+}
 
 static GVariant *
-upower_call_function (const gchar *function, GError **error)
+backend_call_function (PowerBackend backend, const gchar *function, GVariant *parameters, GError **error)
 {
-    if (!upower_proxy)
+    if (!proxies[backend])
     {
-        upower_proxy = g_dbus_proxy_new_for_bus_sync (G_BUS_TYPE_SYSTEM,
-                                                      G_DBUS_PROXY_FLAGS_NONE,
-                                                      NULL,
-                                                      "org.freedesktop.UPower",
-                                                      "/org/freedesktop/UPower",
-                                                      "org.freedesktop.UPower",
-                                                      NULL,
-                                                      error);
-        if (!upower_proxy)
+        proxies[backend] = g_dbus_proxy_new_for_bus_sync (G_BUS_TYPE_SYSTEM,
+                                                          G_DBUS_PROXY_FLAGS_NONE,
+                                                          NULL,
+                                                          backends[backend].name,
+                                                          backends[backend].path,
+                                                          backends[backend].interface,
+                                                          NULL,
+                                                          error);
+        if (!proxies[backend])
+        {
+            if (parameters)
+                g_variant_unref (g_variant_ref_sink (parameters));
             return NULL;
+        }
     }
 
-    return g_dbus_proxy_call_sync (upower_proxy,
-                                   function,
-                                   NULL,
-                                   G_DBUS_CALL_FLAGS_NONE,
-                                   -1,
-                                   NULL,
-                                   error);
+    g_autoptr(GError) call_error = NULL;
+    GVariant *result = g_dbus_proxy_call_sync (proxies[backend],
+                                               function,
+                                               parameters,
+                                               G_DBUS_CALL_FLAGS_NONE,
+                                               -1,
+                                               NULL,
+                                               &call_error);
+    if (result)
+        return result;
+
+    if (error_is_missing_service (call_error))
+        backend_missing_time[backend] = g_get_monotonic_time ();
+    g_propagate_error (error, g_steal_pointer (&call_error));
+
+    return NULL;
 }
 
-static GVariant *
-login1_call_function (const gchar *function, GVariant *parameters, GError **error)
+/* logind and newer ConsoleKit answer "yes"/"no"/"challenge", older services a boolean */
+static gboolean
+parse_capability (GVariant *result)
 {
-    if (!login1_proxy)
+    if (g_variant_is_of_type (result, G_VARIANT_TYPE ("(s)")))
     {
-        login1_proxy = g_dbus_proxy_new_for_bus_sync (G_BUS_TYPE_SYSTEM,
-                                                      G_DBUS_PROXY_FLAGS_NONE,
-                                                      NULL,
-                                                      "org.freedesktop.login1",
-                                                      "/org/freedesktop/login1",
-                                                      "org.freedesktop.login1.Manager",
-                                                      NULL,
-                                                      error);
-        if (!login1_proxy)
-            return NULL;
+        const gchar *value;
+        g_variant_get (result, "(&s)", &value);
+        return g_strcmp0 (value, "yes") == 0;
+    }
+    else if (g_variant_is_of_type (result, G_VARIANT_TYPE ("(b)")))
+    {
+        gboolean value;
+        g_variant_get (result, "(b)", &value);
+        return value;
     }
 
-    return g_dbus_proxy_call_sync (login1_proxy,
-                                   function,
-                                   parameters,
-                                   G_DBUS_CALL_FLAGS_NONE,
-                                   -1,
-                                   NULL,
-                                   error);
+    return FALSE;
 }
 
-static GVariant *
-ck_call_function (const gchar *function, GVariant *parameters, GError **error)
+static gboolean
+query_capability_sync (PowerCapability capability)
 {
-    if (!ck_proxy)
+    for (PowerBackend backend = 0; backend < N_BACKENDS; backend++)
+    {
+        const gchar *method = capabilities[capability].query[backend];
+        if (!method || backend_is_missing (backend))
+            continue;
+
+        g_autoptr(GVariant) result = backend_call_function (backend, method, NULL, NULL);
+        if (result)
+            return parse_capability (result);
+    }
+
+    return FALSE;
+}
+
+static gboolean
+get_capability (PowerCapability capability)
+{
+    if (singleton)
+    {
+        LightDMPowerPrivate *priv = GET_PRIVATE (singleton);
+        if (priv->known[capability])
+            return priv->allowed[capability];
+    }
+
+    return query_capability_sync (capability);
+}
+
+static gboolean
+perform_action (PowerCapability capability, GError **error)
+{
+    g_autoptr(GError) last_error = NULL;
+    PowerBackend failed_backend = N_BACKENDS;
+
+    for (PowerBackend backend = 0; backend < N_BACKENDS; backend++)
     {
-        ck_proxy = g_dbus_proxy_new_for_bus_sync (G_BUS_TYPE_SYSTEM,
-                                                  G_DBUS_PROXY_FLAGS_NONE,
-                                                  NULL,
-                                                  "org.freedesktop.ConsoleKit",
-                                                  "/org/freedesktop/ConsoleKit/Manager",
-                                                  "org.freedesktop.ConsoleKit.Manager",
-                                                  NULL,
-                                                  error);
-        if (!ck_proxy)
-            return FALSE;
+        const gchar *method = capabilities[capability].action[backend];
+        if (!method || backend_is_missing (backend))
+            continue;
+
+        if (last_error)
+            g_debug ("Can't %s using %s; falling back to %s: %s", capabilities[capability].verb, backends[failed_backend].label, backends[backend].label, last_error->message);
+        g_clear_error (&last_error);
+
+        GVariant *parameters = capabilities[capability].action_interactive[backend] ? g_variant_new ("(b)", FALSE) : NULL;
+        g_autoptr(GVariant) result = backend_call_function (backend, method, parameters, &last_error);
+        if (result)
+            return TRUE;
+        failed_backend = backend;
     }
 
-    return g_dbus_proxy_call_sync (ck_proxy,
-                                   function,
-                                   parameters,
-                                   G_DBUS_CALL_FLAGS_NONE,
-                                   -1,
-                                   NULL,
-                                   error);
+    if (!last_error)
+        g_set_error_literal (&last_error, G_DBUS_ERROR, G_DBUS_ERROR_SERVICE_UNKNOWN, "No power management service available");
+    g_propagate_error (error, g_steal_pointer (&last_error));
+
+    return FALSE;
 }
 
 /**
@@ -116,35 +277,7 @@ ck_call_function (const gchar *function, GVariant *parameters, GError **error)
 gboolean
 lightdm_get_can_suspend (void)
 {
-    g_autoptr(GVariant) r = login1_call_function ("CanSuspend", NULL, NULL);
-    gboolean can_suspend = FALSE;
-    if (r)
-    {
-        const gchar *result;
-        if (g_variant_is_of_type (r, G_VARIANT_TYPE ("(s)")))
-        {
-            g_variant_get (r, "(&s)", &result);
-            can_suspend = g_strcmp0 (result, "yes") == 0;
-        }
-    }
-    if (!r)
-    {
-        const gchar *result;
-        r = ck_call_function ("CanSuspend", NULL, NULL);
-        if (r && g_variant_is_of_type (r, G_VARIANT_TYPE ("(s)")))
-        {
-            g_variant_get (r, "(&s)", &result);
-            can_suspend = g_strcmp0 (result, "yes") == 0;
-        }
-    }
-    if (!r)
-    {
-        r = upower_call_function ("SuspendAllowed", NULL);
-        if (r && g_variant_is_of_type (r, G_VARIANT_TYPE ("(b)")))
-            g_variant_get (r, "(b)", &can_suspend);
-    }
-
-    return can_suspend;
+    return get_capability (CAPABILITY_SUSPEND);
 }
 
 /**
@@ -158,22 +291,7 @@ lightdm_get_can_suspend (void)
 gboolean
 lightdm_suspend (GError **error)
 {
-    g_autoptr(GError) login1_error = NULL;
-    g_autoptr(GVariant) login1_result = login1_call_function ("Suspend", g_variant_new("(b)", FALSE), &login1_error);
-    if (login1_result)
-        return TRUE;
-
-    g_debug ("Can't suspend using logind; falling back to ConsoleKit: %s", login1_error->message);
-
-    g_autoptr(GError) ck_error = NULL;
-    g_autoptr(GVariant) ck_result = ck_call_function ("Suspend", g_variant_new ("(b)", FALSE), &ck_error);
-    if (ck_result)
-        return TRUE;
-
-    g_debug ("Can't suspend using logind or ConsoleKit; falling back to UPower: %s", ck_error->message);
-
-    g_autoptr(GVariant) upower_result = upower_call_function ("Suspend", error);
-    return upower_result != NULL;
+    return perform_action (CAPABILITY_SUSPEND, error);
 }
 
 /**
@@ -186,35 +304,7 @@ lightdm_suspend (GError **error)
 gboolean
 lightdm_get_can_hibernate (void)
 {
-    g_autoptr(GVariant) r = login1_call_function ("CanHibernate", NULL, NULL);
-    gboolean can_hibernate = FALSE;
-    if (r)
-    {
-        const gchar *result;
-        if (g_variant_is_of_type (r, G_VARIANT_TYPE ("(s)")))
-        {
-            g_variant_get (r, "(&s)", &result);
-            can_hibernate = g_strcmp0 (result, "yes") == 0;
-        }
-    }
-    if (!r)
-    {
-        const gchar *result;
-        r = ck_call_function ("CanHibernate", NULL, NULL);
-        if (r && g_variant_is_of_type (r, G_VARIANT_TYPE ("(s)")))
-        {
-            g_variant_get (r, "(&s)", &result);
-            can_hibernate = g_strcmp0 (result, "yes") == 0;
-        }
-    }
-    if (!r)
-    {
-        r = upower_call_function ("HibernateAllowed", NULL);
-        if (r && g_variant_is_of_type (r, G_VARIANT_TYPE ("(b)")))
-            g_variant_get (r, "(b)", &can_hibernate);
-    }
-
-    return can_hibernate;
+    return get_capability (CAPABILITY_HIBERNATE);
 }
 
 /**
@@ -228,22 +318,7 @@ lightdm_get_can_hibernate (void)
 gboolean
 lightdm_hibernate (GError **error)
 {
-    g_autoptr(GError) login1_error = NULL;
-    g_autoptr(GVariant) login1_result = login1_call_function ("Hibernate", g_variant_new("(b)", FALSE), &login1_error);
-    if (login1_result)
-        return TRUE;
-
-    g_debug ("Can't hibernate using logind; falling back to ConsoleKit: %s", login1_error->message);
-
-    g_autoptr(GError) ck_error = NULL;
-    g_autoptr(GVariant) ck_result = ck_call_function ("Hibernate", g_variant_new ("(b)", FALSE), &ck_error);
-    if (ck_result)
-        return TRUE;
-
-    g_debug ("Can't hibernate using logind or ConsoleKit; falling back to UPower: %s", ck_error->message);
-
-    g_autoptr(GVariant) upower_result = upower_call_function ("Hibernate", error);
-    return upower_result != NULL;
+    return perform_action (CAPABILITY_HIBERNATE, error);
 }
 
 /**
@@ -256,25 +331,7 @@ lightdm_hibernate (GError **error)
 gboolean
 lightdm_get_can_restart (void)
 {
-    g_autoptr(GVariant) r = login1_call_function ("CanReboot", NULL, NULL);
-    gboolean can_restart = FALSE;
-    if (r)
-    {
-        const gchar *result;
-        if (g_variant_is_of_type (r, G_VARIANT_TYPE ("(s)")))
-        {
-            g_variant_get (r, "(&s)", &result);
-            can_restart = g_strcmp0 (result, "yes") == 0;
-        }
-    }
-    else
-    {
-        r = ck_call_function ("CanRestart", NULL, NULL);
-        if (r && g_variant_is_of_type (r, G_VARIANT_TYPE ("(b)")))
-            g_variant_get (r, "(b)", &can_restart);
-    }
-
-    return can_restart;
+    return get_capability (CAPABILITY_RESTART);
 }
 
 /**
@@ -288,13 +345,7 @@ lightdm_get_can_restart (void)
 gboolean
 lightdm_restart (GError **error)
 {
-    g_autoptr(GError) login1_error = NULL;
-    g_autoptr(GVariant) login1_result = login1_call_function ("Reboot", g_variant_new("(b)", FALSE), &login1_error);
-    if (login1_result)
-        return TRUE;
-
-    g_autoptr(GVariant) ck_result = ck_call_function ("Restart", NULL, error);
-    return ck_result != NULL;
+    return perform_action (CAPABILITY_RESTART, error);
 }
 
 /**
@@ -307,43 +358,401 @@ lightdm_restart (GError **error)
 gboolean
 lightdm_get_can_shutdown (void)
 {
-    g_autoptr(GVariant) r = login1_call_function ("CanPowerOff", NULL, NULL);
-    gboolean can_shutdown = FALSE;
+    return get_capability (CAPABILITY_SHUTDOWN);
+}
+
+/**
+ * lightdm_shutdown:
+ * @error: return location for a #GError, or %NULL
+ *
+ * Triggers a system shutdown.
+ *
+ * Return value: #TRUE if shutdown initiated.
+ **/
+gboolean
+lightdm_shutdown (GError **error)
+{
+    return perform_action (CAPABILITY_SHUTDOWN, error);
+}
+
+typedef struct
+{
+    LightDMPower *power;
+    GCancellable *cancellable;
+    PowerCapability capability;
+    PowerBackend backend;
+} CapabilityQuery;
+
+static void
+capability_query_free (CapabilityQuery *query)
+{
+    g_object_unref (query->power);
+    g_object_unref (query->cancellable);
+    g_free (query);
+}
+
+static void
+set_capability (LightDMPower *power, PowerCapability capability, gboolean allowed)
+{
+    LightDMPowerPrivate *priv = GET_PRIVATE (power);
+
+    /* Unresolved capabilities read as FALSE, so notify if the first answer differs */
+    gboolean changed = priv->allowed[capability] != allowed;
+
+    priv->known[capability] = TRUE;
+    priv->allowed[capability] = allowed;
+    priv->querying[capability] = FALSE;
+
+    if (changed)
+        g_object_notify (G_OBJECT (power), capabilities[capability].property);
+}
+
+static void run_query (CapabilityQuery *query);
+
+static void
+query_cb (GObject *object, GAsyncResult *result, gpointer data)
+{
+    CapabilityQuery *query = data;
+
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GVariant) r = g_dbus_connection_call_finish (G_DBUS_CONNECTION (object), result, &error);
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+        capability_query_free (query);
+        return;
+    }
+
     if (r)
     {
-        const gchar *result;
-        if (g_variant_is_of_type (r, G_VARIANT_TYPE ("(s)")))
-        {
-            g_variant_get (r, "(&s)", &result);
-            can_shutdown = g_strcmp0 (result, "yes") == 0;
-        }
+        set_capability (query->power, query->capability, parse_capability (r));
+        capability_query_free (query);
+        return;
     }
+
+    if (error_is_missing_service (error))
+        backend_missing_time[query->backend] = g_get_monotonic_time ();
     else
+        g_debug ("Failed to query %s from %s: %s", capabilities[query->capability].query[query->backend], backends[query->backend].label, error->message);
+
+    query->backend++;
+    run_query (query);
+}
+
+static void
+run_query (CapabilityQuery *query)
+{
+    LightDMPowerPrivate *priv = GET_PRIVATE (query->power);
+
+    for (; query->backend < N_BACKENDS; query->backend++)
+    {
+        const gchar *method = capabilities[query->capability].query[query->backend];
+        if (!method || backend_is_missing (query->backend))
+            continue;
+
+        g_dbus_connection_call (priv->bus,
+                                backends[query->backend].name,
+                                backends[query->backend].path,
+                                backends[query->backend].interface,
+                                method,
+                                NULL,
+                                NULL,
+                                G_DBUS_CALL_FLAGS_NONE,
+                                -1,
+                                query->cancellable,
+                                query_cb,
+                                query);
+        return;
+    }
+
+    /* No backend could answer */
+    set_capability (query->power, query->capability, FALSE);
+    capability_query_free (query);
+}
+
+static void
+refresh (LightDMPower *power)
+{
+    LightDMPowerPrivate *priv = GET_PRIVATE (power);
+
+    if (!priv->bus)
+        return;
+
+    if (priv->cancellable)
+        g_cancellable_cancel (priv->cancellable);
+    g_clear_object (&priv->cancellable);
+    priv->cancellable = g_cancellable_new ();
+
+    /* Query all capabilities in parallel, trying backends in the same order as the synchronous calls */
+    for (PowerCapability capability = 0; capability < N_CAPABILITIES; capability++)
     {
-        r = ck_call_function ("CanStop", NULL, NULL);
-        if (r && g_variant_is_of_type (r, G_VARIANT_TYPE ("(b)")))
-            g_variant_get (r, "(b)", &can_shutdown);
+        CapabilityQuery *query = g_malloc0 (sizeof (CapabilityQuery));
+        query->power = g_object_ref (power);
+        query->cancellable = g_object_ref (priv->cancellable);
+        query->capability = capability;
+        query->backend = BACKEND_LOGIN1;
+        priv->querying[capability] = TRUE;
+        run_query (query);
     }
+}
+
+static void
+backend_owner_changed (LightDMPower *power, const gchar *name, gboolean has_owner)
+{
+    LightDMPowerPrivate *priv = GET_PRIVATE (power);
 
-    return can_shutdown;
+    for (PowerBackend backend = 0; backend < N_BACKENDS; backend++)
+    {
+        if (strcmp (backends[backend].name, name) != 0)
+            continue;
+
+        /* The first callback only reports the initial state */
+        gint old_state = priv->has_owner[backend];
+        priv->has_owner[backend] = has_owner;
+        if (old_state < 0 || old_state == has_owner)
+            return;
+
+        if (has_owner)
+            backend_missing_time[backend] = 0;
+        g_debug ("%s %s the bus, refreshing power capabilities", backends[backend].label, has_owner ? "joined" : "left");
+        refresh (power);
+        return;
+    }
+}
+
+static void
+name_appeared_cb (GDBusConnection *connection, const gchar *name, const gchar *name_owner, gpointer data)
+{
+    backend_owner_changed (LIGHTDM_POWER (data), name, TRUE);
+}
+
+static void
+name_vanished_cb (GDBusConnection *connection, const gchar *name, gpointer data)
+{
+    backend_owner_changed (LIGHTDM_POWER (data), name, FALSE);
+}
+
+static void
+bus_cb (GObject *object, GAsyncResult *result, gpointer data)
+{
+    LightDMPower *power = data;
+    LightDMPowerPrivate *priv = GET_PRIVATE (power);
+
+    g_autoptr(GError) error = NULL;
+    GDBusConnection *bus = g_bus_get_finish (result, &error);
+    if (!bus)
+    {
+        if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            g_warning ("Failed to get system bus: %s", error->message);
+        for (PowerCapability capability = 0; capability < N_CAPABILITIES; capability++)
+            priv->querying[capability] = FALSE;
+        g_object_unref (power);
+        return;
+    }
+    priv->bus = bus;
+
+    for (PowerBackend backend = 0; backend < N_BACKENDS; backend++)
+        priv->watch_ids[backend] = g_bus_watch_name_on_connection (priv->bus,
+                                                                   backends[backend].name,
+                                                                   G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                                                   name_appeared_cb,
+                                                                   name_vanished_cb,
+                                                                   power,
+                                                                   NULL);
+
+    refresh (power);
+    g_object_unref (power);
 }
 
 /**
- * lightdm_shutdown:
- * @error: return location for a #GError, or %NULL
+ * lightdm_power_get_instance:
  *
- * Triggers a system shutdown.
+ * Get the power management service.  Capabilities are resolved in the
+ * background the first time this is called.  Until then they read as %FALSE
+ * and #GObject::notify is emitted for each one that turns out to be allowed.
  *
- * Return value: #TRUE if shutdown initiated.
+ * Return value: (transfer none): the #LightDMPower
+ **/
+LightDMPower *
+lightdm_power_get_instance (void)
+{
+    if (!singleton)
+        singleton = g_object_new (LIGHTDM_TYPE_POWER, NULL);
+    return singleton;
+}
+
+static gboolean
+power_get_capability (LightDMPower *power, PowerCapability capability)
+{
+    LightDMPowerPrivate *priv = GET_PRIVATE (power);
+
+    /* Not resolved yet, so ask now. If the background query hasn't answered
+     * yet report FALSE; #GObject::notify is emitted when it does. */
+    if (!priv->known[capability] && !priv->querying[capability])
+    {
+        priv->allowed[capability] = query_capability_sync (capability);
+        priv->known[capability] = TRUE;
+    }
+
+    return priv->allowed[capability];
+}
+
+/**
+ * lightdm_power_get_can_suspend:
+ * @power: A #LightDMPower
+ *
+ * Checks if authorized to do a system suspend.
+ *
+ * Return value: #TRUE if can suspend the system
  **/
 gboolean
-lightdm_shutdown (GError **error)
+lightdm_power_get_can_suspend (LightDMPower *power)
 {
-    g_autoptr(GError) login1_error = NULL;
-    g_autoptr(GVariant) login1_result = login1_call_function ("PowerOff", g_variant_new("(b)", FALSE), &login1_error);
-    if (login1_result)
-        return TRUE;
+    g_return_val_if_fail (LIGHTDM_IS_POWER (power), FALSE);
+    return power_get_capability (power, CAPABILITY_SUSPEND);
+}
 
-    g_autoptr(GVariant) ck_result = ck_call_function ("Stop", NULL, error);
-    return ck_result != NULL;
+/**
+ * lightdm_power_get_can_hibernate:
+ * @power: A #LightDMPower
+ *
+ * Checks if authorized to do a system hibernate.
+ *
+ * Return value: #TRUE if can hibernate the system
+ **/
+gboolean
+lightdm_power_get_can_hibernate (LightDMPower *power)
+{
+    g_return_val_if_fail (LIGHTDM_IS_POWER (power), FALSE);
+    return power_get_capability (power, CAPABILITY_HIBERNATE);
+}
+
+/**
+ * lightdm_power_get_can_restart:
+ * @power: A #LightDMPower
+ *
+ * Checks if authorized to do a system restart.
+ *
+ * Return value: #TRUE if can restart the system
+ **/
+gboolean
+lightdm_power_get_can_restart (LightDMPower *power)
+{
+    g_return_val_if_fail (LIGHTDM_IS_POWER (power), FALSE);
+    return power_get_capability (power, CAPABILITY_RESTART);
+}
+
+/**
+ * lightdm_power_get_can_shutdown:
+ * @power: A #LightDMPower
+ *
+ * Checks if authorized to do a system shutdown.
+ *
+ * Return value: #TRUE if can shutdown the system
+ **/
+gboolean
+lightdm_power_get_can_shutdown (LightDMPower *power)
+{
+    g_return_val_if_fail (LIGHTDM_IS_POWER (power), FALSE);
+    return power_get_capability (power, CAPABILITY_SHUTDOWN);
+}
+
+static void
+lightdm_power_init (LightDMPower *power)
+{
+    LightDMPowerPrivate *priv = GET_PRIVATE (power);
+
+    for (PowerBackend backend = 0; backend < N_BACKENDS; backend++)
+        priv->has_owner[backend] = -1;
+
+    /* Capabilities are resolved once the bus is connected */
+    for (PowerCapability capability = 0; capability < N_CAPABILITIES; capability++)
+        priv->querying[capability] = TRUE;
+
+    priv->cancellable = g_cancellable_new ();
+    g_bus_get (G_BUS_TYPE_SYSTEM, priv->cancellable, bus_cb, g_object_ref (power));
+}
+
+static void
+lightdm_power_get_property (GObject    *object,
+                            guint       prop_id,
+                            GValue     *value,
+                            GParamSpec *pspec)
+{
+    LightDMPower *self = LIGHTDM_POWER (object);
+
+    switch (prop_id)
+    {
+    case PROP_CAN_SUSPEND:
+        g_value_set_boolean (value, lightdm_power_get_can_suspend (self));
+        break;
+    case PROP_CAN_HIBERNATE:
+        g_value_set_boolean (value, lightdm_power_get_can_hibernate (self));
+        break;
+    case PROP_CAN_RESTART:
+        g_value_set_boolean (value, lightdm_power_get_can_restart (self));
+        break;
+    case PROP_CAN_SHUTDOWN:
+        g_value_set_boolean (value, lightdm_power_get_can_shutdown (self));
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+lightdm_power_finalize (GObject *object)
+{
+    LightDMPower *self = LIGHTDM_POWER (object);
+    LightDMPowerPrivate *priv = GET_PRIVATE (self);
+
+    for (PowerBackend backend = 0; backend < N_BACKENDS; backend++)
+        if (priv->watch_ids[backend])
+            g_bus_unwatch_name (priv->watch_ids[backend]);
+    if (priv->cancellable)
+        g_cancellable_cancel (priv->cancellable);
+    g_clear_object (&priv->cancellable);
+    g_clear_object (&priv->bus);
+
+    G_OBJECT_CLASS (lightdm_power_parent_class)->finalize (object);
+}
+
+static void
+lightdm_power_class_init (LightDMPowerClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    g_type_class_add_private (klass, sizeof (LightDMPowerPrivate));
+
+    object_class->get_property = lightdm_power_get_property;
+    object_class->finalize = lightdm_power_finalize;
+
+    g_object_class_install_property (object_class,
+                                     PROP_CAN_SUSPEND,
+                                     g_param_spec_boolean ("can-suspend",
+                                                           "can-suspend",
+                                                           "TRUE if authorized to suspend the system",
+                                                           FALSE,
+                                                           G_PARAM_READABLE));
+    g_object_class_install_property (object_class,
+                                     PROP_CAN_HIBERNATE,
+                                     g_param_spec_boolean ("can-hibernate",
+                                                           "can-hibernate",
+                                                           "TRUE if authorized to hibernate the system",
+                                                           FALSE,
+                                                           G_PARAM_READABLE));
+    g_object_class_install_property (object_class,
+                                     PROP_CAN_RESTART,
+                                     g_param_spec_boolean ("can-restart",
+                                                           "can-restart",
+                                                           "TRUE if authorized to restart the system",
+                                                           FALSE,
+                                                           G_PARAM_READABLE));
+    g_object_class_install_property (object_class,
+                                     PROP_CAN_SHUTDOWN,
+                                     g_param_spec_boolean ("can-shutdown",
+                                                           "can-shutdown",
+                                                           "TRUE if authorized to shutdown the system",
+                                                           FALSE,
+                                                           G_PARAM_READABLE));
 }
@@ -12,14 +12,36 @@
 #include <gio/gdesktopappinfo.h>
 
 #include "configuration.h"
+#include "session-list.h"
 #include "lightdm/session.h"
 
+/**
+ * SECTION:session-list
+ * @short_description: Get the sessions available on this system
+ * @include: lightdm.h
+ *
+ * An object that contains the sessions that can be chosen, updated as sessions are installed and removed.
+ */
+
 /**
  * SECTION:session
  * @short_description: Choose the session to use
  * @include: lightdm.h
  *
- * Object containing information about a session type. #LightDMSession objects are not created by the user, but provided by the #LightDMGreeter object.
+ * Object containing information about a session type. #LightDMSession objects are not created by the user, but provided by the #LightDMSessionList object.
+ */
+
+/**
+ * LightDMSessionList:
+ *
+ * #LightDMSessionList is an opaque data structure and can only be accessed
+ * using the provided functions.
+ */
+
+/**
+ * LightDMSessionListClass:
+ *
+ * Class structure for #LightDMSessionList.
  */
 
 /**
@@ -41,21 +63,45 @@ enum {
     PROP_COMMENT
 };
 
+enum
+{
+    SESSION_ADDED,
+    SESSION_REMOVED,
+    LAST_LIST_SIGNAL
+};
+static guint list_signals[LAST_LIST_SIGNAL] = { 0 };
+
 typedef struct
 {
+    /* TRUE if this list contains remote sessions */
+    gboolean remote;
+
+    /* Catalogue being wrapped */
+    CommonSessionList *common_list;
+
+    /* Sessions sorted by name, kept locally to preserve transfer-none promises */
+    GList *sessions;
+} LightDMSessionListPrivate;
+
+typedef struct
+{
+    /* Catalogue entry this session was loaded from */
+    CommonSessionEntry *entry;
+
     gchar *key;
     gchar *type;
     gchar *name;
     gchar *comment;
 } LightDMSessionPrivate;
 
+G_DEFINE_TYPE (LightDMSessionList, lightdm_session_list, G_TYPE_OBJECT)
 G_DEFINE_TYPE (LightDMSession, lightdm_session, G_TYPE_OBJECT)
 
+#define GET_LIST_PRIVATE(obj) G_TYPE_INSTANCE_GET_PRIVATE ((obj), LIGHTDM_TYPE_SESSION_LIST, LightDMSessionListPrivate)
 #define GET_PRIVATE(obj) G_TYPE_INSTANCE_GET_PRIVATE ((obj), LIGHTDM_TYPE_SESSION, LightDMSessionPrivate)
 
-static gboolean have_sessions = FALSE;
-static GList *local_sessions = NULL;
-static GList *remote_sessions = NULL;
+static LightDMSessionList *local_singleton = NULL;
+static LightDMSessionList *remote_singleton = NULL;
 
 static gint
 compare_session (gconstpointer a, gconstpointer b)
@@ -66,25 +112,19 @@ compare_session (gconstpointer a, gconstpointer b)
 }
 
 static LightDMSession *
-load_session (GKeyFile *key_file, const gchar *key, const gchar *default_type)
+wrap_session_entry (CommonSessionEntry *entry)
 {
-    if (g_key_file_get_boolean (key_file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_NO_DISPLAY, NULL) ||
-        g_key_file_get_boolean (key_file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_HIDDEN, NULL))
+    if (common_session_entry_get_hidden (entry))
         return NULL;
 
-#ifdef G_KEY_FILE_DESKTOP_KEY_GETTEXT_DOMAIN
-    g_autofree gchar *domain = g_key_file_get_string (key_file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_GETTEXT_DOMAIN, NULL);
-#else
-    g_autofree gchar *domain = g_key_file_get_string (key_file, G_KEY_FILE_DESKTOP_GROUP, "X-GNOME-Gettext-Domain", NULL);
-#endif
-    g_autofree gchar *name = g_key_file_get_locale_string (key_file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_NAME, domain, NULL);
+    const gchar *name = common_session_entry_get_name (entry);
     if (!name)
     {
         g_warning ("Ignoring session without name");
         return NULL;
     }
 
-    g_autofree gchar *try_exec = g_key_file_get_locale_string (key_file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_TRY_EXEC, domain, NULL);
+    const gchar *try_exec = common_session_entry_get_try_exec (entry);
     if (try_exec)
     {
         g_autofree gchar *full_path = g_find_program_in_path (try_exec);
@@ -92,124 +132,144 @@ load_session (GKeyFile *key_file, const gchar *key, const gchar *default_type)
             return NULL;
     }
 
-    g_autofree gchar *type = g_key_file_get_string (key_file, G_KEY_FILE_DESKTOP_GROUP, "X-LightDM-Session-Type", NULL);
-    if (!type)
-        type = strdup (default_type);
-
     LightDMSession *session = g_object_new (LIGHTDM_TYPE_SESSION, NULL);
     LightDMSessionPrivate *priv = GET_PRIVATE (session);
 
+    priv->entry = g_object_ref (entry);
+
     g_free (priv->key);
-    priv->key = g_strdup (key);
+    priv->key = g_strdup (common_session_entry_get_key (entry));
 
     g_free (priv->type);
-    priv->type = g_steal_pointer (&type);
+    priv->type = g_strdup (common_session_entry_get_session_type (entry));
 
     g_free (priv->name);
-    priv->name = g_steal_pointer (&name);
+    priv->name = g_strdup (name);
 
     g_free (priv->comment);
-    priv->comment = g_key_file_get_locale_string (key_file, G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_COMMENT, domain, NULL);
+    priv->comment = g_strdup (common_session_entry_get_comment (entry));
     if (!priv->comment)
         priv->comment = g_strdup ("");
 
     return session;
 }
 
-static GList *
-load_sessions_dir (GList *sessions, const gchar *sessions_dir, const gchar *default_type)
+static void
+session_added_cb (CommonSessionList *common_list, CommonSessionEntry *entry, LightDMSessionList *session_list)
 {
-    g_autoptr(GError) error = NULL;
-    GDir *directory = g_dir_open (sessions_dir, 0, &error);
-    if (error && !g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
-        g_warning ("Failed to open sessions directory: %s", error->message);
-    if (!directory)
-        return sessions;
-
-    while (TRUE)
-    {
-        const gchar *filename = g_dir_read_name (directory);
-        if (filename == NULL)
-            break;
+    LightDMSessionListPrivate *priv = GET_LIST_PRIVATE (session_list);
 
-        if (!g_str_has_suffix (filename, ".desktop"))
-            continue;
+    LightDMSession *session = wrap_session_entry (entry);
+    if (!session)
+        return;
 
-        g_autofree gchar *path = g_build_filename (sessions_dir, filename, NULL);
+    priv->sessions = g_list_insert_sorted (priv->sessions, session, compare_session);
+    g_signal_emit (session_list, list_signals[SESSION_ADDED], 0, session);
+}
 
-        g_autoptr(GKeyFile) key_file = g_key_file_new ();
-        g_autoptr(GError) e = NULL;
-        gboolean result = g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, &e);
-        if (e)
-            g_warning ("Failed to load session file %s: %s:", path, e->message);
+static void
+session_removed_cb (CommonSessionList *common_list, CommonSessionEntry *entry, LightDMSessionList *session_list)
+{
+    LightDMSessionListPrivate *priv = GET_LIST_PRIVATE (session_list);
 
-        if (result)
+    for (GList *link = priv->sessions; link; link = link->next)
+    {
+        LightDMSession *session = link->data;
+        if (GET_PRIVATE (session)->entry == entry)
         {
-            g_autofree gchar *key = g_strndup (filename, strlen (filename) - strlen (".desktop"));
-            LightDMSession *session = load_session (key_file, key, default_type);
-            if (session)
-            {
-                g_debug ("Loaded session %s (%s, %s)", path, GET_PRIVATE (session)->name, GET_PRIVATE (session)->comment);
-                sessions = g_list_insert_sorted (sessions, session, compare_session);
-            }
-            else
-                g_debug ("Ignoring session %s", path);
+            priv->sessions = g_list_delete_link (priv->sessions, link);
+            g_signal_emit (session_list, list_signals[SESSION_REMOVED], 0, session);
+            g_object_unref (session);
+            break;
         }
     }
-
-    g_dir_close (directory);
-
-    return sessions;
 }
 
-static GList *
-load_sessions (const gchar *sessions_dir)
+static LightDMSessionList *
+make_session_list (gboolean remote)
 {
-    g_auto(GStrv) dirs = g_strsplit (sessions_dir, ":", -1);
-    GList *sessions = NULL;
-    for (int i = 0; dirs[i]; i++)
-    {
-        const gchar *default_type = "x";
-
-        if (strcmp (dirs[i], WAYLAND_SESSIONS_DIR) == 0)
-            default_type = "wayland";
-
-        sessions = load_sessions_dir (sessions, dirs[i], default_type);
-    }
+    LightDMSessionList *session_list = g_object_new (LIGHTDM_TYPE_SESSION_LIST, NULL);
+    LightDMSessionListPrivate *priv = GET_LIST_PRIVATE (session_list);
 
-    return sessions;
-}
-
-static void
-update_sessions (void)
-{
-    if (have_sessions)
-        return;
-
-    g_autofree gchar *sessions_dir = g_strdup (SESSIONS_DIR);
-    g_autofree gchar *remote_sessions_dir = g_strdup (REMOTE_SESSIONS_DIR);
+    priv->remote = remote;
 
     /* Use session directory from configuration */
-    config_load_from_standard_locations (config_get_instance (), NULL, NULL);
-
-    gchar *value = config_get_string (config_get_instance (), "LightDM", "sessions-directory");
-    if (value)
+    static gboolean loaded_config = FALSE;
+    if (!loaded_config)
     {
-        g_free (sessions_dir);
-        sessions_dir = value;
+        config_load_from_standard_locations (config_get_instance (), NULL, NULL);
+        loaded_config = TRUE;
     }
 
-    value = config_get_string (config_get_instance (), "LightDM", "remote-sessions-directory");
-    if (value)
+    g_autofree gchar *sessions_dir = config_get_string (config_get_instance (), "LightDM", remote ? "remote-sessions-directory" : "sessions-directory");
+    if (!sessions_dir)
+        sessions_dir = g_strdup (remote ? REMOTE_SESSIONS_DIR : SESSIONS_DIR);
+    g_autofree gchar *cache_dir = config_get_string (config_get_instance (), "LightDM", "cache-directory");
+    if (!cache_dir)
+        cache_dir = g_strdup (CACHE_DIR);
+
+    priv->common_list = g_object_ref (common_session_list_get_instance (sessions_dir, cache_dir));
+    for (GList *link = common_session_list_get_entries (priv->common_list); link; link = link->next)
     {
-        g_free (remote_sessions_dir);
-        remote_sessions_dir = value;
+        LightDMSession *session = wrap_session_entry (link->data);
+        if (session)
+        {
+            g_debug ("Loaded session %s (%s, %s)", common_session_entry_get_path (link->data), GET_PRIVATE (session)->name, GET_PRIVATE (session)->comment);
+            priv->sessions = g_list_insert_sorted (priv->sessions, session, compare_session);
+        }
+        else
+            g_debug ("Ignoring session %s", common_session_entry_get_path (link->data));
     }
 
-    local_sessions = load_sessions (sessions_dir);
-    remote_sessions = load_sessions (remote_sessions_dir);
+    g_signal_connect (priv->common_list, SESSION_LIST_SIGNAL_SESSION_ADDED, G_CALLBACK (session_added_cb), session_list);
+    g_signal_connect (priv->common_list, SESSION_LIST_SIGNAL_SESSION_REMOVED, G_CALLBACK (session_removed_cb), session_list);
+
+    return session_list;
+}
+
+/**
+ * lightdm_session_list_get_instance:
+ *
+ * Get the list of local sessions.
+ *
+ * Return value: (transfer none): the #LightDMSessionList
+ **/
+LightDMSessionList *
+lightdm_session_list_get_instance (void)
+{
+    if (!local_singleton)
+        local_singleton = make_session_list (FALSE);
+    return local_singleton;
+}
+
+/**
+ * lightdm_session_list_get_remote_instance:
+ *
+ * Get the list of remote sessions.
+ *
+ * Return value: (transfer none): the #LightDMSessionList
+ **/
+LightDMSessionList *
+lightdm_session_list_get_remote_instance (void)
+{
+    if (!remote_singleton)
+        remote_singleton = make_session_list (TRUE);
+    return remote_singleton;
+}
 
-    have_sessions = TRUE;
+/**
+ * lightdm_session_list_get_sessions:
+ * @session_list: A #LightDMSessionList
+ *
+ * Get the sessions in this list, sorted by name.
+ *
+ * Return value: (element-type LightDMSession) (transfer none): A list of #LightDMSession
+ **/
+GList *
+lightdm_session_list_get_sessions (LightDMSessionList *session_list)
+{
+    g_return_val_if_fail (LIGHTDM_IS_SESSION_LIST (session_list), NULL);
+    return GET_LIST_PRIVATE (session_list)->sessions;
 }
 
 /**
@@ -222,8 +282,7 @@ update_sessions (void)
 GList *
 lightdm_get_sessions (void)
 {
-    update_sessions ();
-    return local_sessions;
+    return lightdm_session_list_get_sessions (lightdm_session_list_get_instance ());
 }
 
 /**
@@ -236,8 +295,68 @@ lightdm_get_sessions (void)
 GList *
 lightdm_get_remote_sessions (void)
 {
-    update_sessions ();
-    return remote_sessions;
+    return lightdm_session_list_get_sessions (lightdm_session_list_get_remote_instance ());
+}
+
+static void
+lightdm_session_list_init (LightDMSessionList *session_list)
+{
+}
+
+static void
+lightdm_session_list_finalize (GObject *object)
+{
+    LightDMSessionList *self = LIGHTDM_SESSION_LIST (object);
+    LightDMSessionListPrivate *priv = GET_LIST_PRIVATE (self);
+
+    if (priv->common_list)
+        g_signal_handlers_disconnect_matched (priv->common_list, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, self);
+    g_clear_object (&priv->common_list);
+    g_list_free_full (priv->sessions, g_object_unref);
+
+    G_OBJECT_CLASS (lightdm_session_list_parent_class)->finalize (object);
+}
+
+static void
+lightdm_session_list_class_init (LightDMSessionListClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    g_type_class_add_private (klass, sizeof (LightDMSessionListPrivate));
+
+    object_class->finalize = lightdm_session_list_finalize;
+
+    /**
+     * LightDMSessionList::session-added:
+     * @session_list: A #LightDMSessionList
+     * @session: The #LightDMSession that has been added.
+     *
+     * The ::session-added signal gets emitted when a session is installed or modified.
+     **/
+    list_signals[SESSION_ADDED] =
+        g_signal_new (LIGHTDM_SESSION_LIST_SIGNAL_SESSION_ADDED,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (LightDMSessionListClass, session_added),
+                      NULL, NULL,
+                      NULL,
+                      G_TYPE_NONE, 1, LIGHTDM_TYPE_SESSION);
+
+    /**
+     * LightDMSessionList::session-removed:
+     * @session_list: A #LightDMSessionList
+     * @session: The #LightDMSession that has been removed.
+     *
+     * The ::session-removed signal gets emitted when a session is removed or modified.
+     **/
+    list_signals[SESSION_REMOVED] =
+        g_signal_new (LIGHTDM_SESSION_LIST_SIGNAL_SESSION_REMOVED,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (LightDMSessionListClass, session_removed),
+                      NULL, NULL,
+                      NULL,
+                      G_TYPE_NONE, 1, LIGHTDM_TYPE_SESSION);
 }
 
 /**
@@ -344,6 +463,7 @@ lightdm_session_finalize (GObject *object)
     LightDMSession *self = LIGHTDM_SESSION (object);
     LightDMSessionPrivate *priv = GET_PRIVATE (self);
 
+    g_clear_object (&priv->entry);
     g_free (priv->key);
     g_free (priv->type);
     g_free (priv->name);
@@ -20,10 +20,10 @@ namespace QLightDM
     {
         Q_OBJECT
     public:
-        Q_PROPERTY(bool canSuspend READ canSuspend() CONSTANT)
-        Q_PROPERTY(bool canHibernate READ canHibernate() CONSTANT)
-        Q_PROPERTY(bool canShutdown READ canShutdown() CONSTANT)
-        Q_PROPERTY(bool canRestart READ canRestart() CONSTANT)
+        Q_PROPERTY(bool canSuspend READ canSuspend() NOTIFY canSuspendChanged)
+        Q_PROPERTY(bool canHibernate READ canHibernate() NOTIFY canHibernateChanged)
+        Q_PROPERTY(bool canShutdown READ canShutdown() NOTIFY canShutdownChanged)
+        Q_PROPERTY(bool canRestart READ canRestart() NOTIFY canRestartChanged)
 
         PowerInterface(QObject *parent=0);
         virtual ~PowerInterface();
@@ -39,6 +39,19 @@ namespace QLightDM
         bool shutdown();
         bool restart();
 
+    Q_SIGNALS:
+        void canSuspendChanged();
+        void canHibernateChanged();
+        void canShutdownChanged();
+        void canRestartChanged();
+
+    protected:
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+        void connectNotify(const QMetaMethod &signal);
+#else
+        void connectNotify(const char *signal);
+#endif
+
     private:
         class PowerInterfacePrivate;
         PowerInterfacePrivate * const d;
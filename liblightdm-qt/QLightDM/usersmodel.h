@@ -50,6 +50,7 @@ private:
     UsersModelPrivate * const d_ptr;
 
     Q_DECLARE_PRIVATE(UsersModel)
+    Q_PRIVATE_SLOT(d_func(), void _q_flushPending())
 
 };
 
@@ -12,6 +12,8 @@
 
 #include "QLightDM/power.h"
 
+#include <QtCore/QMetaMethod>
+
 #include <lightdm.h>
 
 using namespace QLightDM;
@@ -19,17 +21,59 @@ using namespace QLightDM;
 class PowerInterface::PowerInterfacePrivate
 {
 public:
-    PowerInterfacePrivate();
+    PowerInterfacePrivate(PowerInterface *parent);
+    ~PowerInterfacePrivate();
+
+    void watch();
+
+    PowerInterface * const q;
+
+    /* Set once something listens for changes; capabilities are then cached */
+    LightDMPower *power;
+
+    static void cb_notify(GObject *object, GParamSpec *pspec, gpointer data);
 };
 
-PowerInterface::PowerInterfacePrivate::PowerInterfacePrivate()
+PowerInterface::PowerInterfacePrivate::PowerInterfacePrivate(PowerInterface *parent) :
+    q(parent),
+    power(NULL)
+{
+}
+
+PowerInterface::PowerInterfacePrivate::~PowerInterfacePrivate()
 {
+    if (power)
+        g_signal_handlers_disconnect_by_data(power, this);
+}
+
+void PowerInterface::PowerInterfacePrivate::watch()
+{
+    if (power)
+        return;
+
+    power = lightdm_power_get_instance();
+    g_signal_connect(power, "notify", G_CALLBACK (cb_notify), this);
+}
+
+void PowerInterface::PowerInterfacePrivate::cb_notify(GObject *object, GParamSpec *pspec, gpointer data)
+{
+    Q_UNUSED(object)
+    PowerInterfacePrivate *that = static_cast<PowerInterfacePrivate*>(data);
+
+    if (g_strcmp0(pspec->name, "can-suspend") == 0)
+        Q_EMIT that->q->canSuspendChanged();
+    else if (g_strcmp0(pspec->name, "can-hibernate") == 0)
+        Q_EMIT that->q->canHibernateChanged();
+    else if (g_strcmp0(pspec->name, "can-shutdown") == 0)
+        Q_EMIT that->q->canShutdownChanged();
+    else if (g_strcmp0(pspec->name, "can-restart") == 0)
+        Q_EMIT that->q->canRestartChanged();
 }
 
 
 PowerInterface::PowerInterface(QObject *parent)
     : QObject(parent),
-      d(new PowerInterfacePrivate)
+      d(new PowerInterfacePrivate(this))
 {
 }
 
@@ -38,8 +82,24 @@ PowerInterface::~PowerInterface()
     delete d;
 }
 
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+void PowerInterface::connectNotify(const QMetaMethod &signal)
+{
+    if (signal.methodSignature().endsWith("Changed()"))
+        d->watch();
+}
+#else
+void PowerInterface::connectNotify(const char *signal)
+{
+    if (QByteArray(signal).endsWith("Changed()"))
+        d->watch();
+}
+#endif
+
 bool PowerInterface::canSuspend()
 {
+    if (d->power)
+        return lightdm_power_get_can_suspend (d->power);
     return lightdm_get_can_suspend ();
 }
 
@@ -50,6 +110,8 @@ bool PowerInterface::suspend()
 
 bool PowerInterface::canHibernate()
 {
+    if (d->power)
+        return lightdm_power_get_can_hibernate (d->power);
     return lightdm_get_can_hibernate ();
 }
 
@@ -60,6 +122,8 @@ bool PowerInterface::hibernate()
 
 bool PowerInterface::canShutdown()
 {
+    if (d->power)
+        return lightdm_power_get_can_shutdown (d->power);
     return lightdm_get_can_shutdown ();
 }
 
@@ -70,6 +134,8 @@ bool PowerInterface::shutdown()
 
 bool PowerInterface::canRestart()
 {
+    if (d->power)
+        return lightdm_power_get_can_restart (d->power);
     return lightdm_get_can_restart ();
 }
 
@@ -11,9 +11,15 @@
 #include "QLightDM/usersmodel.h"
 
 #include <QtCore/QString>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+#include <QtCore/QTimer>
+#include <QtCore/QVector>
 #include <QtCore/QDebug>
 #include <QtGui/QIcon>
 
+#include <algorithm>
+
 #include <lightdm.h>
 
 using namespace QLightDM;
@@ -21,6 +27,9 @@ using namespace QLightDM;
 class UserItem
 {
 public:
+    UserItem();
+    explicit UserItem(LightDMUser *ldmUser);
+
     QString name;
     QString realName;
     QString homeDirectory;
@@ -31,8 +40,32 @@ public:
     bool hasMessages;
     quint64 uid;
     QString displayName() const;
+
+    /* Display name as UTF-8, the order LightDMUserList keeps users in */
+    QByteArray sortKey;
 };
 
+UserItem::UserItem() :
+    isLoggedIn(false),
+    hasMessages(false),
+    uid(0)
+{
+}
+
+UserItem::UserItem(LightDMUser *ldmUser) :
+    name(QString::fromUtf8(lightdm_user_get_name(ldmUser))),
+    realName(QString::fromUtf8(lightdm_user_get_real_name(ldmUser))),
+    homeDirectory(QString::fromUtf8(lightdm_user_get_home_directory(ldmUser))),
+    image(QString::fromUtf8(lightdm_user_get_image(ldmUser))),
+    background(QString::fromUtf8(lightdm_user_get_background(ldmUser))),
+    session(QString::fromUtf8(lightdm_user_get_session(ldmUser))),
+    isLoggedIn(lightdm_user_get_logged_in(ldmUser)),
+    hasMessages(lightdm_user_get_has_messages(ldmUser)),
+    uid((quint64)lightdm_user_get_uid(ldmUser)),
+    sortKey(lightdm_user_get_display_name(ldmUser))
+{
+}
+
 QString UserItem::displayName() const {
     if (realName.isEmpty()){
         return name;
@@ -42,6 +75,11 @@ QString UserItem::displayName() const {
     }
 }
 
+static bool sortKeyLessThan(const UserItem &a, const UserItem &b)
+{
+    return qstrcmp(a.sortKey, b.sortKey) < 0;
+}
+
 namespace QLightDM {
 class UsersModelPrivate {
 public:
@@ -49,10 +87,24 @@ public:
     virtual ~UsersModelPrivate();
     QList<UserItem> users;
 
+    /* Row of each user in users, by user name */
+    QHash<QString, int> rows;
+
+    /* Changes waiting to be applied in one batch */
+    QList<UserItem> pendingAdded;
+    QSet<QString> pendingRemoved;
+    bool flushQueued;
+
+    void _q_flushPending();
+
     protected:
         UsersModel * const q_ptr;
 
         void loadUsers();
+        void reindex(int from);
+        void queueFlush();
+        void updateUser(int row, const UserItem &user);
+        int insertPosition(const UserItem &user) const;
 
         static void cb_userAdded(LightDMUserList *user_list, LightDMUser *user, gpointer data);
         static void cb_userChanged(LightDMUserList *user_list, LightDMUser *user, gpointer data);
@@ -63,6 +115,7 @@ public:
 }
 
 UsersModelPrivate::UsersModelPrivate(UsersModel* parent) :
+    flushQueued(false),
     q_ptr(parent)
 {
 #if !defined(GLIB_VERSION_2_36)
@@ -81,28 +134,17 @@ void UsersModelPrivate::loadUsers()
 
     int rowCount = lightdm_user_list_get_length(lightdm_user_list_get_instance());
 
-    if (rowCount == 0) {
-        return;
-    } else {
+    if (rowCount > 0) {
         q->beginInsertRows(QModelIndex(), 0, rowCount-1);
 
         const GList *items, *item;
         items = lightdm_user_list_get_users(lightdm_user_list_get_instance());
+        users.reserve(rowCount);
         for (item = items; item; item = item->next) {
             LightDMUser *ldmUser = static_cast<LightDMUser*>(item->data);
-
-            UserItem user;
-            user.name = QString::fromUtf8(lightdm_user_get_name(ldmUser));
-            user.homeDirectory = QString::fromUtf8(lightdm_user_get_home_directory(ldmUser));
-            user.realName = QString::fromUtf8(lightdm_user_get_real_name(ldmUser));
-            user.image = QString::fromUtf8(lightdm_user_get_image(ldmUser));
-            user.background = QString::fromUtf8(lightdm_user_get_background(ldmUser));
-            user.session = QString::fromUtf8(lightdm_user_get_session(ldmUser));
-            user.isLoggedIn = lightdm_user_get_logged_in(ldmUser);
-            user.hasMessages = lightdm_user_get_has_messages(ldmUser);
-            user.uid = (quint64)lightdm_user_get_uid(ldmUser);
-            users.append(user);
+            users.append(UserItem(ldmUser));
         }
+        reindex(0);
 
         q->endInsertRows();
     }
@@ -111,26 +153,189 @@ void UsersModelPrivate::loadUsers()
     g_signal_connect(lightdm_user_list_get_instance(), LIGHTDM_USER_LIST_SIGNAL_USER_REMOVED, G_CALLBACK (cb_userRemoved), this);
 }
 
+void UsersModelPrivate::reindex(int from)
+{
+    for (int i = from; i < users.size(); i++) {
+        rows.insert(users[i].name, i);
+    }
+}
+
+void UsersModelPrivate::queueFlush()
+{
+    Q_Q(UsersModel);
+
+    /* Users are added and removed in bursts when the user list is reloaded,
+     * so collect them and report each contiguous range once */
+    if (flushQueued) {
+        return;
+    }
+    flushQueued = true;
+    QTimer::singleShot(0, q, SLOT(_q_flushPending()));
+}
+
+int UsersModelPrivate::insertPosition(const UserItem &user) const
+{
+    return std::upper_bound(users.begin(), users.end(), user, sortKeyLessThan) - users.begin();
+}
+
+void UsersModelPrivate::updateUser(int row, const UserItem &user)
+{
+    Q_Q(UsersModel);
+
+    UserItem &item = users[row];
+    QVector<int> roles;
+
+    if (item.realName != user.realName) {
+        item.realName = user.realName;
+        roles << Qt::DisplayRole << UsersModel::RealNameRole;
+    }
+    if (item.homeDirectory != user.homeDirectory) {
+        item.homeDirectory = user.homeDirectory;
+    }
+    if (item.image != user.image) {
+        item.image = user.image;
+        roles << Qt::DecorationRole << UsersModel::ImagePathRole;
+    }
+    if (item.background != user.background) {
+        item.background = user.background;
+        roles << UsersModel::BackgroundRole << UsersModel::BackgroundPathRole;
+    }
+    if (item.session != user.session) {
+        item.session = user.session;
+        roles << UsersModel::SessionRole;
+    }
+    if (item.isLoggedIn != user.isLoggedIn) {
+        item.isLoggedIn = user.isLoggedIn;
+        roles << UsersModel::LoggedInRole;
+    }
+    if (item.hasMessages != user.hasMessages) {
+        item.hasMessages = user.hasMessages;
+        roles << UsersModel::HasMessagesRole;
+    }
+    if (item.uid != user.uid) {
+        item.uid = user.uid;
+        roles << UsersModel::UidRole;
+    }
+
+    /* Keep the rows sorted if the display name changed */
+    if (item.sortKey != user.sortKey) {
+        item.sortKey = user.sortKey;
+
+        UserItem moved = users.takeAt(row);
+        int to = insertPosition(moved);
+        users.insert(row, moved);
+        if (to != row) {
+            q->beginMoveRows(QModelIndex(), row, row, QModelIndex(), to > row ? to + 1 : to);
+            users.move(row, to);
+            reindex(qMin(row, to));
+            q->endMoveRows();
+            row = to;
+        }
+    }
+
+    if (roles.isEmpty()) {
+        return;
+    }
+
+    QModelIndex index = q->createIndex(row, 0);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
+    Q_EMIT q->dataChanged(index, index, roles);
+#else
+    Q_EMIT q->dataChanged(index, index);
+#endif
+}
+
+void UsersModelPrivate::_q_flushPending()
+{
+    Q_Q(UsersModel);
+
+    flushQueued = false;
+
+    if (!pendingRemoved.isEmpty()) {
+        QList<int> removedRows;
+        Q_FOREACH (const QString &name, pendingRemoved) {
+            QHash<QString, int>::const_iterator i = rows.constFind(name);
+            if (i != rows.constEnd()) {
+                removedRows.append(i.value());
+            }
+        }
+        pendingRemoved.clear();
+        std::sort(removedRows.begin(), removedRows.end());
+
+        /* Remove from the end so earlier row numbers stay valid */
+        int end = removedRows.size() - 1;
+        while (end >= 0) {
+            int start = end;
+            while (start > 0 && removedRows[start - 1] == removedRows[start] - 1) {
+                start--;
+            }
+
+            int first = removedRows[start], last = removedRows[end];
+            q->beginRemoveRows(QModelIndex(), first, last);
+            for (int row = last; row >= first; row--) {
+                rows.remove(users[row].name);
+                users.removeAt(row);
+            }
+            reindex(first);
+            q->endRemoveRows();
+
+            end = start - 1;
+        }
+    }
+
+    if (!pendingAdded.isEmpty()) {
+        QList<UserItem> added = pendingAdded;
+        pendingAdded.clear();
+        std::stable_sort(added.begin(), added.end(), sortKeyLessThan);
+
+        /* Insert from the end, grouping users that land on the same row */
+        int end = added.size() - 1;
+        while (end >= 0) {
+            int position = insertPosition(added[end]);
+            int start = end;
+            while (start > 0 && insertPosition(added[start - 1]) == position) {
+                start--;
+            }
+
+            q->beginInsertRows(QModelIndex(), position, position + end - start);
+            for (int i = end; i >= start; i--) {
+                users.insert(position, added[i]);
+            }
+            reindex(position);
+            q->endInsertRows();
+
+            end = start - 1;
+        }
+    }
+}
+
 void UsersModelPrivate::cb_userAdded(LightDMUserList *user_list, LightDMUser *ldmUser, gpointer data)
 {
     Q_UNUSED(user_list)
     UsersModelPrivate *that = static_cast<UsersModelPrivate*>(data);
 
-    that->q_func()->beginInsertRows(QModelIndex(), that->users.size(), that->users.size());
+    UserItem user(ldmUser);
 
-    UserItem user;
-    user.name = QString::fromUtf8(lightdm_user_get_name(ldmUser));
-    user.homeDirectory = QString::fromUtf8(lightdm_user_get_home_directory(ldmUser));
-    user.realName = QString::fromUtf8(lightdm_user_get_real_name(ldmUser));
-    user.image = QString::fromUtf8(lightdm_user_get_image(ldmUser));
-    user.background = QString::fromUtf8(lightdm_user_get_background(ldmUser));
-    user.isLoggedIn = lightdm_user_get_logged_in(ldmUser);
-    user.hasMessages = lightdm_user_get_has_messages(ldmUser);
-    user.uid = (quint64)lightdm_user_get_uid(ldmUser);
-    that->users.append(user);
+    /* Re-added before the removal was applied */
+    if (that->pendingRemoved.remove(user.name)) {
+        that->updateUser(that->rows.value(user.name), user);
+        return;
+    }
 
-    that->q_func()->endInsertRows();
+    QHash<QString, int>::const_iterator i = that->rows.constFind(user.name);
+    if (i != that->rows.constEnd()) {
+        that->updateUser(i.value(), user);
+        return;
+    }
 
+    for (int j = 0; j < that->pendingAdded.size(); j++) {
+        if (that->pendingAdded[j].name == user.name) {
+            that->pendingAdded[j] = user;
+            return;
+        }
+    }
+    that->pendingAdded.append(user);
+    that->queueFlush();
 }
 
 void UsersModelPrivate::cb_userChanged(LightDMUserList *user_list, LightDMUser *ldmUser, gpointer data)
@@ -140,20 +345,16 @@ void UsersModelPrivate::cb_userChanged(LightDMUserList *user_list, LightDMUser *
 
     QString userToChange = QString::fromUtf8(lightdm_user_get_name(ldmUser));
 
-    for (int i=0;i<that->users.size();i++) {
-        if (that->users[i].name == userToChange) {
-
-            that->users[i].homeDirectory = QString::fromUtf8(lightdm_user_get_home_directory(ldmUser));
-            that->users[i].realName = QString::fromUtf8(lightdm_user_get_real_name(ldmUser));
-            that->users[i].image = QString::fromUtf8(lightdm_user_get_image(ldmUser));
-            that->users[i].background = QString::fromUtf8(lightdm_user_get_background(ldmUser));
-            that->users[i].isLoggedIn = lightdm_user_get_logged_in(ldmUser);
-            that->users[i].hasMessages = lightdm_user_get_has_messages(ldmUser);
-            that->users[i].uid = (quint64)lightdm_user_get_uid(ldmUser);
+    QHash<QString, int>::const_iterator i = that->rows.constFind(userToChange);
+    if (i != that->rows.constEnd()) {
+        that->updateUser(i.value(), UserItem(ldmUser));
+        return;
+    }
 
-            QModelIndex index = that->q_ptr->createIndex(i, 0);
-            that->q_ptr->dataChanged(index, index);
-            break;
+    for (int j = 0; j < that->pendingAdded.size(); j++) {
+        if (that->pendingAdded[j].name == userToChange) {
+            that->pendingAdded[j] = UserItem(ldmUser);
+            return;
         }
     }
 }
@@ -166,14 +367,17 @@ void UsersModelPrivate::cb_userRemoved(LightDMUserList *user_list, LightDMUser *
     UsersModelPrivate *that = static_cast<UsersModelPrivate*>(data);
     QString userToRemove = QString::fromUtf8(lightdm_user_get_name(ldmUser));
 
-    for (int i=0;i<that->users.size();i++) {
-        if (that->users[i].name == userToRemove) {
-            that->q_ptr->beginRemoveRows(QModelIndex(), i, i);
-            that->users.removeAt(i);
-            that->q_ptr->endRemoveRows();
-            break;
+    for (int j = 0; j < that->pendingAdded.size(); j++) {
+        if (that->pendingAdded[j].name == userToRemove) {
+            that->pendingAdded.removeAt(j);
+            return;
         }
     }
+
+    if (that->rows.contains(userToRemove)) {
+        that->pendingRemoved.insert(userToRemove);
+        that->queueFlush();
+    }
 }
 
 UsersModel::UsersModel(QObject *parent) :
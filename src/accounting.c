@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2010-2011 Robert Ancell.
+ * Author: Robert Ancell <robert.ancell@canonical.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#include <config.h>
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utmp.h>
+
+#include "accounting.h"
+
+/* Time to collect records so a burst of logins/logouts is written in one go */
+#define FLUSH_DELAY_MS 100
+
+typedef struct
+{
+    AccountingEvent event;
+    struct utmpx ut;
+} AccountingRecord;
+
+/* Records waiting to be written */
+static GQueue records = G_QUEUE_INIT;
+static guint flush_timeout = 0;
+
+static void
+utmpx_to_utmp (const struct utmpx *ut, struct utmp *u)
+{
+    memset (u, 0, sizeof (*u));
+    u->ut_type = ut->ut_type;
+    u->ut_pid = ut->ut_pid;
+    strncpy (u->ut_line, ut->ut_line, sizeof (u->ut_line));
+    strncpy (u->ut_id, ut->ut_id, sizeof (u->ut_id));
+    strncpy (u->ut_user, ut->ut_user, sizeof (u->ut_user));
+    strncpy (u->ut_host, ut->ut_host, sizeof (u->ut_host));
+    u->ut_tv.tv_sec = ut->ut_tv.tv_sec;
+    u->ut_tv.tv_usec = ut->ut_tv.tv_usec;
+}
+
+/* Append the records for one file like updwtmp does, but taking the lock once for the whole batch */
+static void
+write_wtmp_records (const gchar *wtmp_file, GList *batch, gboolean login_failed)
+{
+    g_autoptr(GByteArray) data = g_byte_array_new ();
+    for (GList *link = batch; link; link = link->next)
+    {
+        AccountingRecord *record = link->data;
+        if ((record->event == ACCOUNTING_EVENT_LOGIN_FAILED) != login_failed)
+            continue;
+
+        struct utmp u;
+        utmpx_to_utmp (&record->ut, &u);
+        g_byte_array_append (data, (guint8 *) &u, sizeof (u));
+    }
+    if (data->len == 0)
+        return;
+
+    /* Like updwtmp, don't create the file if the system doesn't keep it */
+    int fd = open (wtmp_file, O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        if (errno != ENOENT)
+            g_warning ("Failed to open %s: %s", wtmp_file, strerror (errno));
+        return;
+    }
+
+    struct flock lock;
+    memset (&lock, 0, sizeof (lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    if (fcntl (fd, F_SETLKW, &lock) < 0)
+    {
+        g_warning ("Failed to lock %s: %s", wtmp_file, strerror (errno));
+        close (fd);
+        return;
+    }
+
+    /* Don't leave a partial record behind if the write fails */
+    off_t offset = lseek (fd, 0, SEEK_END);
+    ssize_t n_written = write (fd, data->data, data->len);
+    if (n_written != (ssize_t) data->len)
+    {
+        g_warning ("Failed to write %s: %s", wtmp_file, n_written < 0 ? strerror (errno) : "Short write");
+        if (offset >= 0 && n_written > 0 && ftruncate (fd, offset) < 0)
+            g_warning ("Failed to truncate %s: %s", wtmp_file, strerror (errno));
+    }
+
+    lock.l_type = F_UNLCK;
+    fcntl (fd, F_SETLK, &lock);
+    close (fd);
+}
+
+static gboolean
+flush_timeout_cb (gpointer data)
+{
+    flush_timeout = 0;
+    accounting_flush ();
+    return G_SOURCE_REMOVE;
+}
+
+void
+accounting_add_record (AccountingEvent event, const struct utmpx *ut)
+{
+    g_return_if_fail (ut != NULL);
+
+    AccountingRecord *record = g_malloc0 (sizeof (AccountingRecord));
+    record->event = event;
+    record->ut = *ut;
+    g_queue_push_tail (&records, record);
+
+    if (!flush_timeout)
+        flush_timeout = g_timeout_add (FLUSH_DELAY_MS, flush_timeout_cb, NULL);
+}
+
+void
+accounting_flush (void)
+{
+    if (flush_timeout)
+        g_source_remove (flush_timeout);
+    flush_timeout = 0;
+
+    if (g_queue_is_empty (&records))
+        return;
+
+    GList *batch = records.head;
+    g_queue_init (&records);
+
+    g_debug ("Writing %u accounting records", g_list_length (batch));
+
+    /* Session records share a single pass over the utmp database */
+    gboolean opened_utmp = FALSE;
+    for (GList *link = batch; link; link = link->next)
+    {
+        AccountingRecord *record = link->data;
+
+        if (record->event == ACCOUNTING_EVENT_LOGIN_FAILED)
+            continue;
+
+        if (!opened_utmp)
+            setutxent ();
+        opened_utmp = TRUE;
+        if (!pututxline (&record->ut))
+            g_warning ("Failed to write utmpx: %s", strerror (errno));
+    }
+    if (opened_utmp)
+        endutxent ();
+
+    /* Each file is locked once for the whole batch */
+    write_wtmp_records ("/var/log/wtmp", batch, FALSE);
+    write_wtmp_records ("/var/log/btmp", batch, TRUE);
+
+    g_list_free_full (batch, g_free);
+}
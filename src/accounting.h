@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2010-2011 Robert Ancell.
+ * Author: Robert Ancell <robert.ancell@canonical.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#ifndef ACCOUNTING_H_
+#define ACCOUNTING_H_
+
+#include <glib.h>
+#include <utmpx.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+    ACCOUNTING_EVENT_LOGIN_FAILED,
+    ACCOUNTING_EVENT_SESSION_OPENED,
+    ACCOUNTING_EVENT_SESSION_CLOSED
+} AccountingEvent;
+
+void accounting_add_record (AccountingEvent event, const struct utmpx *ut);
+
+void accounting_flush (void);
+
+G_END_DECLS
+
+#endif /* ACCOUNTING_H_ */
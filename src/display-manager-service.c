@@ -11,10 +11,13 @@
 #include <config.h>
 
 #include "display-manager-service.h"
+#include "main-loop-watchdog.h"
 
 enum {
     READY,
     ADD_XLOCAL_SEAT,
+    GET_XDMCP_SESSIONS_BY_STATE,
+    GET_VNC_STATISTICS,
     NAME_LOST,
     LAST_SIGNAL
 };
@@ -34,6 +37,9 @@ struct DisplayManagerServicePrivate
     /* Handle for display manager D-Bus object */
     guint reg_id;
 
+    /* Handle for object manager on the display manager D-Bus object */
+    guint object_manager_reg_id;
+
     /* D-Bus interface information */
     GDBusNodeInfo *seat_info;
     GDBusNodeInfo *session_info;
@@ -117,6 +123,40 @@ emit_object_value_changed (GDBusConnection *bus, const gchar *path, const gchar
         g_warning ("Failed to emit PropertiesChanged signal: %s", error->message);
 }
 
+static void
+emit_interfaces_added (GDBusConnection *bus, const gchar *object_path, const gchar *interface_name, GVariant *properties)
+{
+    GVariantBuilder builder;
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sa{sv}}"));
+    g_variant_builder_add (&builder, "{s@a{sv}}", interface_name, properties);
+
+    g_autoptr(GError) error = NULL;
+    if (!g_dbus_connection_emit_signal (bus,
+                                        NULL,
+                                        "/org/freedesktop/DisplayManager",
+                                        "org.freedesktop.DBus.ObjectManager",
+                                        "InterfacesAdded",
+                                        g_variant_new ("(oa{sa{sv}})", object_path, &builder),
+                                        &error))
+        g_warning ("Failed to emit InterfacesAdded signal for %s: %s", object_path, error->message);
+}
+
+static void
+emit_interfaces_removed (GDBusConnection *bus, const gchar *object_path, const gchar *interface_name)
+{
+    const gchar *interfaces[] = { interface_name, NULL };
+
+    g_autoptr(GError) error = NULL;
+    if (!g_dbus_connection_emit_signal (bus,
+                                        NULL,
+                                        "/org/freedesktop/DisplayManager",
+                                        "org.freedesktop.DBus.ObjectManager",
+                                        "InterfacesRemoved",
+                                        g_variant_new ("(o^as)", object_path, interfaces),
+                                        &error))
+        g_warning ("Failed to emit InterfacesRemoved signal for %s: %s", object_path, error->message);
+}
+
 static void
 emit_object_signal (GDBusConnection *bus, const gchar *path, const gchar *signal_name, const gchar *object_path)
 {
@@ -187,6 +227,64 @@ get_session_list (DisplayManagerService *service, const gchar *seat_path)
     return g_variant_builder_end (&builder);
 }
 
+static GVariant *
+get_seat_properties (SeatBusEntry *entry)
+{
+    GVariantBuilder builder;
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+    g_variant_builder_add (&builder, "{sv}", "CanSwitch", g_variant_new_boolean (seat_get_can_switch (entry->seat)));
+    g_variant_builder_add (&builder, "{sv}", "HasGuestAccount", g_variant_new_boolean (seat_get_allow_guest (entry->seat)));
+    g_variant_builder_add (&builder, "{sv}", "Sessions", get_session_list (entry->service, entry->path));
+
+    return g_variant_builder_end (&builder);
+}
+
+static GVariant *
+get_session_properties (SessionBusEntry *entry)
+{
+    GVariantBuilder builder;
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+    g_variant_builder_add (&builder, "{sv}", "Seat", g_variant_new_object_path (entry->seat_path));
+    g_variant_builder_add (&builder, "{sv}", "UserName", g_variant_new_string (session_get_username (entry->session)));
+
+    return g_variant_builder_end (&builder);
+}
+
+/* Get all seats and sessions with their properties, so clients can load the state in one call */
+static GVariant *
+get_managed_objects (DisplayManagerService *service)
+{
+    GVariantBuilder builder;
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{oa{sa{sv}}}"));
+
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init (&iter, service->priv->seat_bus_entries);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        SeatBusEntry *entry = value;
+        g_variant_builder_open (&builder, G_VARIANT_TYPE ("{oa{sa{sv}}}"));
+        g_variant_builder_add (&builder, "o", entry->path);
+        g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sa{sv}}"));
+        g_variant_builder_add (&builder, "{s@a{sv}}", "org.freedesktop.DisplayManager.Seat", get_seat_properties (entry));
+        g_variant_builder_close (&builder);
+        g_variant_builder_close (&builder);
+    }
+    g_hash_table_iter_init (&iter, service->priv->session_bus_entries);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        SessionBusEntry *entry = value;
+        g_variant_builder_open (&builder, G_VARIANT_TYPE ("{oa{sa{sv}}}"));
+        g_variant_builder_add (&builder, "o", entry->path);
+        g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sa{sv}}"));
+        g_variant_builder_add (&builder, "{s@a{sv}}", "org.freedesktop.DisplayManager.Session", get_session_properties (entry));
+        g_variant_builder_close (&builder);
+        g_variant_builder_close (&builder);
+    }
+
+    return g_variant_builder_end (&builder);
+}
+
 static GVariant *
 handle_display_manager_get_property (GDBusConnection       *connection,
                                      const gchar           *sender,
@@ -242,6 +340,78 @@ handle_display_manager_call (GDBusConnection       *connection,
         SeatBusEntry *entry = g_hash_table_lookup (service->priv->seat_bus_entries, seat);
         g_dbus_method_invocation_return_value (invocation, g_variant_new ("(o)", entry->path));
     }
+    else if (g_strcmp0 (method_name, "GetMainLoopStatistics") == 0)
+    {
+        if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("()")))
+        {
+            g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, "Invalid arguments");
+            return;
+        }
+
+        g_dbus_method_invocation_return_value (invocation, main_loop_watchdog_get_statistics ());
+    }
+    else if (g_strcmp0 (method_name, "GetXDMCPSessionsByState") == 0)
+    {
+        if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("()")))
+        {
+            g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, "Invalid arguments");
+            return;
+        }
+
+        g_autoptr(GVariant) sessions = NULL;
+        g_signal_emit (service, signals[GET_XDMCP_SESSIONS_BY_STATE], 0, &sessions);
+
+        if (!sessions)
+        {
+            g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_FAILED, "XDMCP server not running");
+            return;
+        }
+        g_dbus_method_invocation_return_value (invocation, g_variant_new ("(@a{st})", sessions));
+    }
+    else if (g_strcmp0 (method_name, "GetVNCStatistics") == 0)
+    {
+        if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("()")))
+        {
+            g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, "Invalid arguments");
+            return;
+        }
+
+        g_autoptr(GVariant) statistics = NULL;
+        g_signal_emit (service, signals[GET_VNC_STATISTICS], 0, &statistics);
+
+        if (!statistics)
+        {
+            g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_FAILED, "VNC server not running");
+            return;
+        }
+        g_dbus_method_invocation_return_value (invocation, g_variant_new ("(@a{st})", statistics));
+    }
+    else
+        g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD, "Unknown method");
+}
+
+static void
+handle_object_manager_call (GDBusConnection       *connection,
+                            const gchar           *sender,
+                            const gchar           *object_path,
+                            const gchar           *interface_name,
+                            const gchar           *method_name,
+                            GVariant              *parameters,
+                            GDBusMethodInvocation *invocation,
+                            gpointer               user_data)
+{
+    DisplayManagerService *service = user_data;
+
+    if (g_strcmp0 (method_name, "GetManagedObjects") == 0)
+    {
+        if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("()")))
+        {
+            g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, "Invalid arguments");
+            return;
+        }
+
+        g_dbus_method_invocation_return_value (invocation, g_variant_new ("(@a{oa{sa{sv}}})", get_managed_objects (service)));
+    }
     else
         g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD, "Unknown method");
 }
@@ -429,6 +599,8 @@ running_user_session_cb (Seat *seat, Session *session, DisplayManagerService *se
     if (session_entry->bus_id == 0)
         g_warning ("Failed to register user session: %s", error->message);
 
+    emit_interfaces_added (service->priv->bus, session_entry->path, "org.freedesktop.DisplayManager.Session", get_session_properties (session_entry));
+
     emit_object_value_changed (service->priv->bus, "/org/freedesktop/DisplayManager", "org.freedesktop.DisplayManager", "Sessions", get_session_list (service, NULL));
     emit_object_signal (service->priv->bus, "/org/freedesktop/DisplayManager", "SessionAdded", session_entry->path);
 
@@ -446,6 +618,7 @@ session_removed_cb (Seat *seat, Session *session, DisplayManagerService *service
     if (entry)
     {
         g_dbus_connection_unregister_object (service->priv->bus, entry->bus_id);
+        emit_interfaces_removed (service->priv->bus, entry->path, "org.freedesktop.DisplayManager.Session");
         emit_object_signal (service->priv->bus, "/org/freedesktop/DisplayManager", "SessionRemoved", entry->path);
         emit_object_signal (service->priv->bus, entry->seat_path, "SessionRemoved", entry->path);
         seat_path = g_strdup (entry->seat_path);
@@ -486,6 +659,8 @@ seat_added_cb (DisplayManager *display_manager, Seat *seat, DisplayManagerServic
     if (entry->bus_id == 0)
         g_warning ("Failed to register seat: %s", error->message);
 
+    emit_interfaces_added (service->priv->bus, entry->path, "org.freedesktop.DisplayManager.Seat", get_seat_properties (entry));
+
     emit_object_value_changed (service->priv->bus, "/org/freedesktop/DisplayManager", "org.freedesktop.DisplayManager", "Seats", get_seat_list (service));
     emit_object_signal (service->priv->bus, "/org/freedesktop/DisplayManager", "SeatAdded", entry->path);
 
@@ -500,6 +675,7 @@ seat_removed_cb (DisplayManager *display_manager, Seat *seat, DisplayManagerServ
     if (entry)
     {
         g_dbus_connection_unregister_object (service->priv->bus, entry->bus_id);
+        emit_interfaces_removed (service->priv->bus, entry->path, "org.freedesktop.DisplayManager.Seat");
         emit_object_signal (service->priv->bus, "/org/freedesktop/DisplayManager", "SeatRemoved", entry->path);
     }
 
@@ -533,6 +709,17 @@ bus_acquired_cb (GDBusConnection *connection,
         "      <arg name='display-number' direction='in' type='i'/>"
         "      <arg name='seat' direction='out' type='o'/>"
         "    </method>"
+        "    <method name='GetMainLoopStatistics'>"
+        "      <arg name='histogram' direction='out' type='a(ut)'/>"
+        "      <arg name='stalls' direction='out' type='t'/>"
+        "      <arg name='max-latency' direction='out' type='u'/>"
+        "    </method>"
+        "    <method name='GetXDMCPSessionsByState'>"
+        "      <arg name='sessions' direction='out' type='a{st}'/>"
+        "    </method>"
+        "    <method name='GetVNCStatistics'>"
+        "      <arg name='statistics' direction='out' type='a{st}'/>"
+        "    </method>"
         "    <signal name='SeatAdded'>"
         "      <arg name='seat' type='o'/>"
         "    </signal>"
@@ -546,6 +733,19 @@ bus_acquired_cb (GDBusConnection *connection,
         "      <arg name='session' type='o'/>"
         "    </signal>"
         "  </interface>"
+        "  <interface name='org.freedesktop.DBus.ObjectManager'>"
+        "    <method name='GetManagedObjects'>"
+        "      <arg name='objects' direction='out' type='a{oa{sa{sv}}}'/>"
+        "    </method>"
+        "    <signal name='InterfacesAdded'>"
+        "      <arg name='object' type='o'/>"
+        "      <arg name='interfaces' type='a{sa{sv}}'/>"
+        "    </signal>"
+        "    <signal name='InterfacesRemoved'>"
+        "      <arg name='object' type='o'/>"
+        "      <arg name='interfaces' type='as'/>"
+        "    </signal>"
+        "  </interface>"
         "</node>";
     GDBusNodeInfo *display_manager_info = g_dbus_node_info_new_for_xml (display_manager_interface, NULL);
     g_assert (display_manager_info != NULL);
@@ -601,6 +801,20 @@ bus_acquired_cb (GDBusConnection *connection,
                                                                &error);
     if (service->priv->reg_id == 0)
         g_warning ("Failed to register display manager: %s", error->message);
+    g_clear_error (&error);
+
+    static const GDBusInterfaceVTable object_manager_vtable =
+    {
+        handle_object_manager_call
+    };
+    service->priv->object_manager_reg_id = g_dbus_connection_register_object (connection,
+                                                                              "/org/freedesktop/DisplayManager",
+                                                                              display_manager_info->interfaces[1],
+                                                                              &object_manager_vtable,
+                                                                              service, NULL,
+                                                                              &error);
+    if (service->priv->object_manager_reg_id == 0)
+        g_warning ("Failed to register object manager: %s", error->message);
     g_dbus_node_info_unref (display_manager_info);
 
     /* Add objects for existing seats and listen to new ones */
@@ -657,6 +871,7 @@ display_manager_service_finalize (GObject *object)
     DisplayManagerService *self = DISPLAY_MANAGER_SERVICE (object);
 
     g_dbus_connection_unregister_object (self->priv->bus, self->priv->reg_id);
+    g_dbus_connection_unregister_object (self->priv->bus, self->priv->object_manager_reg_id);
     g_bus_unown_name (self->priv->bus_id);
     if (self->priv->seat_info)
         g_dbus_node_info_unref (self->priv->seat_info);
@@ -698,6 +913,26 @@ display_manager_service_class_init (DisplayManagerServiceClass *klass)
                       NULL,
                       SEAT_TYPE, 1, G_TYPE_INT);
 
+    signals[GET_XDMCP_SESSIONS_BY_STATE] =
+        g_signal_new (DISPLAY_MANAGER_SERVICE_SIGNAL_GET_XDMCP_SESSIONS_BY_STATE,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (DisplayManagerServiceClass, get_xdmcp_sessions_by_state),
+                      g_signal_accumulator_first_wins,
+                      NULL,
+                      NULL,
+                      G_TYPE_VARIANT, 0);
+
+    signals[GET_VNC_STATISTICS] =
+        g_signal_new (DISPLAY_MANAGER_SERVICE_SIGNAL_GET_VNC_STATISTICS,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (DisplayManagerServiceClass, get_vnc_statistics),
+                      g_signal_accumulator_first_wins,
+                      NULL,
+                      NULL,
+                      G_TYPE_VARIANT, 0);
+
     signals[NAME_LOST] =
         g_signal_new (DISPLAY_MANAGER_SERVICE_SIGNAL_NAME_LOST,
                       G_TYPE_FROM_CLASS (klass),
@@ -20,9 +20,11 @@ G_BEGIN_DECLS
 #define DISPLAY_MANAGER_SERVICE_TYPE (display_manager_service_get_type())
 #define DISPLAY_MANAGER_SERVICE(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), DISPLAY_MANAGER_SERVICE_TYPE, DisplayManagerService));
 
-#define DISPLAY_MANAGER_SERVICE_SIGNAL_READY           "ready"
-#define DISPLAY_MANAGER_SERVICE_SIGNAL_ADD_XLOCAL_SEAT "add-xlocal-seat"
-#define DISPLAY_MANAGER_SERVICE_SIGNAL_NAME_LOST       "name-lost"
+#define DISPLAY_MANAGER_SERVICE_SIGNAL_READY                       "ready"
+#define DISPLAY_MANAGER_SERVICE_SIGNAL_ADD_XLOCAL_SEAT             "add-xlocal-seat"
+#define DISPLAY_MANAGER_SERVICE_SIGNAL_GET_XDMCP_SESSIONS_BY_STATE "get-xdmcp-sessions-by-state"
+#define DISPLAY_MANAGER_SERVICE_SIGNAL_GET_VNC_STATISTICS          "get-vnc-statistics"
+#define DISPLAY_MANAGER_SERVICE_SIGNAL_NAME_LOST                   "name-lost"
 
 typedef struct DisplayManagerServicePrivate DisplayManagerServicePrivate;
 
@@ -36,9 +38,11 @@ typedef struct
 {
     GObjectClass parent_class;
 
-    void  (*ready)(DisplayManagerService *service);
-    Seat *(*add_xlocal_seat)(DisplayManagerService *service, gint display_number);
-    void  (*name_lost)(DisplayManagerService *service);
+    void      (*ready)(DisplayManagerService *service);
+    Seat     *(*add_xlocal_seat)(DisplayManagerService *service, gint display_number);
+    GVariant *(*get_xdmcp_sessions_by_state)(DisplayManagerService *service);
+    GVariant *(*get_vnc_statistics)(DisplayManagerService *service);
+    void      (*name_lost)(DisplayManagerService *service);
 } DisplayManagerServiceClass;
 
 GType display_manager_service_get_type (void);
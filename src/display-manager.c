@@ -17,6 +17,7 @@
 
 #include "display-manager.h"
 #include "configuration.h"
+#include "greeter.h"
 #include "seat-local.h"
 #include "seat-xremote.h"
 #include "seat-unity.h"
@@ -97,6 +98,26 @@ seat_stopped_cb (Seat *seat, DisplayManager *manager)
     check_stopped (manager);
 }
 
+gboolean
+display_manager_get_is_stopping (DisplayManager *manager)
+{
+    g_return_val_if_fail (manager != NULL, FALSE);
+    return manager->priv->stopping;
+}
+
+static void
+running_user_session_cb (Seat *seat, Session *session, DisplayManager *manager)
+{
+    /* Greeters are told about sessions so they can show who is logged in */
+    greeter_add_user_session (session);
+}
+
+static void
+session_removed_cb (Seat *seat, Session *session, DisplayManager *manager)
+{
+    greeter_remove_user_session (session);
+}
+
 gboolean
 display_manager_add_seat (DisplayManager *manager, Seat *seat)
 {
@@ -110,16 +131,16 @@ display_manager_add_seat (DisplayManager *manager, Seat *seat)
 
     manager->priv->seats = g_list_append (manager->priv->seats, g_object_ref (seat));
     g_signal_connect (seat, SEAT_SIGNAL_STOPPED, G_CALLBACK (seat_stopped_cb), manager);
+    g_signal_connect (seat, SEAT_SIGNAL_RUNNING_USER_SESSION, G_CALLBACK (running_user_session_cb), manager);
+    g_signal_connect (seat, SEAT_SIGNAL_SESSION_REMOVED, G_CALLBACK (session_removed_cb), manager);
     g_signal_emit (manager, signals[SEAT_ADDED], 0, seat);
 
     return TRUE;
 }
 
-void
-display_manager_start (DisplayManager *manager)
+static void
+plymouth_state_cb (gpointer data)
 {
-    g_return_if_fail (manager != NULL);
-
     /* Disable Plymouth if no X servers are replacing it */
     if (plymouth_get_is_active ())
     {
@@ -128,6 +149,14 @@ display_manager_start (DisplayManager *manager)
     }
 }
 
+void
+display_manager_start (DisplayManager *manager)
+{
+    g_return_if_fail (manager != NULL);
+
+    plymouth_wait_for_state (plymouth_state_cb, manager);
+}
+
 void
 display_manager_stop (DisplayManager *manager)
 {
@@ -97,6 +97,35 @@ get_seat_proxy (void)
     return seat_proxy;
 }
 
+/* Get the properties of an object, from the managed objects if we have them
+ * otherwise by asking the object directly */
+static GVariant *
+get_object_properties (GVariant *objects, const gchar *path, const gchar *interface)
+{
+    if (objects)
+    {
+        g_autoptr(GVariant) interfaces = g_variant_lookup_value (objects, path, G_VARIANT_TYPE ("a{sa{sv}}"));
+        if (!interfaces)
+            return NULL;
+        return g_variant_lookup_value (interfaces, interface, G_VARIANT_TYPE ("a{sv}"));
+    }
+
+    g_autoptr(GVariant) result = g_dbus_connection_call_sync (g_dbus_proxy_get_connection (dm_proxy),
+                                                              "org.freedesktop.DisplayManager",
+                                                              path,
+                                                              "org.freedesktop.DBus.Properties",
+                                                              "GetAll",
+                                                              g_variant_new ("(s)", interface),
+                                                              G_VARIANT_TYPE ("(a{sv})"),
+                                                              G_DBUS_CALL_FLAGS_NONE,
+                                                              -1,
+                                                              NULL,
+                                                              NULL);
+    if (!result)
+        return NULL;
+    return g_variant_get_child_value (result, 0);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -279,51 +308,60 @@ main (int argc, char **argv)
             g_printerr ("Unable to contact display manager\n");
             return EXIT_FAILURE;
         }
-        g_autoptr(GVariant) seats = g_dbus_proxy_get_cached_property (dm_proxy, "Seats");
 
-        g_autoptr(GVariantIter) seat_iter = NULL;
-        g_variant_get (seats, "ao", &seat_iter);
-        gchar *seat_path;
-        while (g_variant_iter_loop (seat_iter, "&o", &seat_path))
-        {
-            gchar *seat_name;
-            g_autoptr(GDBusProxy) proxy = NULL;
+        /* Get all seats and sessions in one call, falling back to asking each
+         * object if the daemon doesn't provide the object manager */
+        g_autoptr(GVariant) result = g_dbus_connection_call_sync (g_dbus_proxy_get_connection (dm_proxy),
+                                                                  "org.freedesktop.DisplayManager",
+                                                                  "/org/freedesktop/DisplayManager",
+                                                                  "org.freedesktop.DBus.ObjectManager",
+                                                                  "GetManagedObjects",
+                                                                  NULL,
+                                                                  G_VARIANT_TYPE ("(a{oa{sa{sv}}})"),
+                                                                  G_DBUS_CALL_FLAGS_NONE,
+                                                                  -1,
+                                                                  NULL,
+                                                                  NULL);
+        g_autoptr(GVariant) objects = result ? g_variant_get_child_value (result, 0) : NULL;
 
+        g_autoptr(GVariant) seats = g_dbus_proxy_get_cached_property (dm_proxy, "Seats");
+        GVariantIter seat_iter;
+        g_variant_iter_init (&seat_iter, seats);
+        const gchar *seat_path;
+        while (g_variant_iter_loop (&seat_iter, "&o", &seat_path))
+        {
+            const gchar *seat_name;
             if (g_str_has_prefix (seat_path, "/org/freedesktop/DisplayManager/"))
                 seat_name = seat_path + strlen ("/org/freedesktop/DisplayManager/");
             else
                 seat_name = seat_path;
 
-            proxy = g_dbus_proxy_new_sync (g_dbus_proxy_get_connection (dm_proxy),
-                                           G_DBUS_PROXY_FLAGS_NONE,
-                                           NULL,
-                                           "org.freedesktop.DisplayManager",
-                                           seat_path,
-                                           "org.freedesktop.DisplayManager.Seat",
-                                           NULL,
-                                           NULL);
-            if (!proxy || !g_dbus_proxy_get_name_owner (proxy))
+            g_autoptr(GVariant) seat_properties = get_object_properties (objects, seat_path, "org.freedesktop.DisplayManager.Seat");
+            if (!seat_properties)
                 continue;
 
             g_print ("%s\n", seat_name);
-            g_auto(GStrv) property_names = g_dbus_proxy_get_cached_property_names (proxy);
-            for (int i = 0; property_names[i]; i++)
+            GVariantIter property_iter;
+            g_variant_iter_init (&property_iter, seat_properties);
+            const gchar *name;
+            GVariant *value;
+            while (g_variant_iter_loop (&property_iter, "{&sv}", &name, &value))
             {
-                if (strcmp (property_names[i], "Sessions") == 0)
+                if (strcmp (name, "Sessions") == 0)
                     continue;
 
-                g_autoptr(GVariant) value = g_dbus_proxy_get_cached_property (proxy, property_names[i]);
-                g_print ("  %s=%s\n", property_names[i], g_variant_print (value, FALSE));
+                g_autofree gchar *text = g_variant_print (value, FALSE);
+                g_print ("  %s=%s\n", name, text);
             }
 
-            g_autoptr(GVariant) sessions = g_dbus_proxy_get_cached_property (proxy, "Sessions");
+            g_autoptr(GVariant) sessions = g_variant_lookup_value (seat_properties, "Sessions", G_VARIANT_TYPE ("ao"));
             if (!sessions)
                 continue;
 
-            g_autoptr(GVariantIter) session_iter = NULL;
-            g_variant_get (sessions, "ao", &session_iter);
+            GVariantIter session_iter;
+            g_variant_iter_init (&session_iter, sessions);
             const gchar *session_path;
-            while (g_variant_iter_loop (session_iter, "&o", &session_path))
+            while (g_variant_iter_loop (&session_iter, "&o", &session_path))
             {
                 const gchar *session_name;
                 if (g_str_has_prefix (session_path, "/org/freedesktop/DisplayManager/"))
@@ -331,31 +369,22 @@ main (int argc, char **argv)
                 else
                     session_name = session_path;
 
-                g_autoptr(GDBusProxy) session_proxy = g_dbus_proxy_new_sync (g_dbus_proxy_get_connection (dm_proxy),
-                                                                             G_DBUS_PROXY_FLAGS_NONE,
-                                                                             NULL,
-                                                                             "org.freedesktop.DisplayManager",
-                                                                             session_path,
-                                                                             "org.freedesktop.DisplayManager.Session",
-                                                                             NULL,
-                                                                             NULL);
-                if (!session_proxy || !g_dbus_proxy_get_name_owner (session_proxy))
+                g_autoptr(GVariant) session_properties = get_object_properties (objects, session_path, "org.freedesktop.DisplayManager.Session");
+                if (!session_properties)
                     continue;
 
                 g_print ("  %s\n", session_name);
-                g_auto(GStrv) property_names = g_dbus_proxy_get_cached_property_names (session_proxy);
-                for (int i = 0; property_names[i]; i++)
+                g_variant_iter_init (&property_iter, session_properties);
+                while (g_variant_iter_loop (&property_iter, "{&sv}", &name, &value))
                 {
-                    if (strcmp (property_names[i], "Seat") == 0)
+                    if (strcmp (name, "Seat") == 0)
                         continue;
 
-                    g_autoptr(GVariant) value = g_dbus_proxy_get_cached_property (session_proxy, property_names[i]);
-                    g_print ("    %s=%s\n", property_names[i], g_variant_print (value, FALSE));
+                    g_autofree gchar *text = g_variant_print (value, FALSE);
+                    g_print ("    %s=%s\n", name, text);
                 }
             }
-            g_variant_iter_free (session_iter);
         }
-        g_variant_iter_free (seat_iter);
 
         return EXIT_SUCCESS;
     }
@@ -16,7 +16,10 @@
 
 #include "greeter.h"
 #include "configuration.h"
+#include "message-channel.h"
+#include "session-list.h"
 #include "shared-data-manager.h"
+#include "user-list.h"
 
 enum {
     PROP_ACTIVE_USERNAME = 1,
@@ -78,14 +81,14 @@ struct GreeterPrivate
     /* Communication channels to communicate with */
     int to_greeter_input;
     int from_greeter_output;
-    GIOChannel *to_greeter_channel;
+    MessageChannel *to_greeter_channel;
     GIOChannel *from_greeter_channel;
     guint from_greeter_watch;
 };
 
 G_DEFINE_TYPE (Greeter, greeter, G_TYPE_OBJECT)
 
-#define API_VERSION 1
+#define API_VERSION 2
 
 /* Messages from the greeter to the server */
 typedef enum
@@ -112,8 +115,23 @@ typedef enum
     SERVER_MESSAGE_IDLE,
     SERVER_MESSAGE_RESET,
     SERVER_MESSAGE_CONNECTED_V2,
+    SERVER_MESSAGE_USER_LIST,
+    SERVER_MESSAGE_USER_CHANGED,
+    SERVER_MESSAGE_USER_REMOVED,
+    SERVER_MESSAGE_SESSION_ADDED,
+    SERVER_MESSAGE_SESSION_REMOVED,
 } ServerMessage;
 
+/* Greeters that are sent user and session changes */
+static GList *user_list_greeters = NULL;
+
+/* Running user sessions and the IDs greeters know them by */
+static GHashTable *user_sessions = NULL;
+static guint32 user_session_count = 0;
+
+/* Data to hold for a greeter that isn't reading, enough for a full size user list and the changes after it */
+#define MAX_QUEUED (32 * 1024 * 1024)
+
 static gboolean read_cb (GIOChannel *source, GIOCondition condition, gpointer data);
 
 Greeter *
@@ -122,6 +140,16 @@ greeter_new (void)
     return g_object_new (GREETER_TYPE, NULL);
 }
 
+static void
+to_greeter_closed_cb (MessageChannel *channel, Greeter *greeter)
+{
+    /* The greeter may have been part way through a message, close the pipe so it sees the end rather than waiting */
+    g_debug ("Closing connection to greeter");
+    user_list_greeters = g_list_remove (user_list_greeters, greeter);
+    close (greeter->priv->to_greeter_input);
+    greeter->priv->to_greeter_input = -1;
+}
+
 void
 greeter_set_file_descriptors (Greeter *greeter, int to_greeter_fd, int from_greeter_fd)
 {
@@ -129,12 +157,11 @@ greeter_set_file_descriptors (Greeter *greeter, int to_greeter_fd, int from_gree
     g_return_if_fail (greeter->priv->to_greeter_input < 0);
     g_return_if_fail (greeter->priv->from_greeter_output < 0);
 
+    /* Messages are queued when the greeter isn't reading so it can't block the daemon */
     greeter->priv->to_greeter_input = to_greeter_fd;
-    greeter->priv->to_greeter_channel = g_io_channel_unix_new (greeter->priv->to_greeter_input);
-    g_autoptr(GError) to_error = NULL;
-    g_io_channel_set_encoding (greeter->priv->to_greeter_channel, NULL, &to_error);
-    if (to_error)
-        g_warning ("Failed to set encoding on to greeter channel to binary: %s\n", to_error->message);
+    greeter->priv->to_greeter_channel = message_channel_new (greeter->priv->to_greeter_input, -1, MESSAGE_CHANNEL_HEADER_32);
+    message_channel_set_max_queued (greeter->priv->to_greeter_channel, MAX_QUEUED);
+    g_signal_connect (greeter->priv->to_greeter_channel, MESSAGE_CHANNEL_SIGNAL_CLOSED, G_CALLBACK (to_greeter_closed_cb), greeter);
 
     greeter->priv->from_greeter_output = from_greeter_fd;
     greeter->priv->from_greeter_channel = g_io_channel_unix_new (greeter->priv->from_greeter_output);
@@ -151,6 +178,7 @@ void
 greeter_stop (Greeter *greeter)
 {
     /* Stop any events occurring after we've stopped */
+    user_list_greeters = g_list_remove (user_list_greeters, greeter);
     if (greeter->priv->authentication_session)
         g_signal_handlers_disconnect_matched (greeter->priv->authentication_session, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, greeter);
 }
@@ -233,27 +261,8 @@ int_length (void)
 static void
 write_message (Greeter *greeter, guint8 *message, gsize message_length)
 {
-    gchar *data = (gchar *) message;
-    gsize data_length = message_length;
-    while (data_length > 0)
-    {
-        GIOStatus status;
-        gsize n_written;
-
-        g_autoptr(GError) error = NULL;
-        status = g_io_channel_write_chars (greeter->priv->to_greeter_channel, data, data_length, &n_written, &error);
-        if (error)
-            g_warning ("Error writing to greeter: %s", error->message);
-        if (status != G_IO_STATUS_NORMAL)
-            return;
-        data_length -= n_written;
-        data += n_written;
-    }
-
-    g_autoptr(GError) error = NULL;
-    g_io_channel_flush (greeter->priv->to_greeter_channel, &error);
-    if (error)
-        g_warning ("Failed to flush data to greeter: %s", error->message);
+    if (!message_channel_write (greeter->priv->to_greeter_channel, message, message_length))
+        g_warning ("Failed to send message to greeter");
 }
 
 static void
@@ -302,6 +311,144 @@ string_length (const gchar *value)
         return int_length () + strlen (value);
 }
 
+/* Make a message containing a serialized variant, as these can be larger than MAX_MESSAGE_LENGTH */
+static guint8 *
+make_variant_message (guint32 id, GVariant *value, gsize *message_length)
+{
+    g_autoptr(GVariant) v = g_variant_ref_sink (value);
+
+    gsize size = g_variant_get_size (v);
+    gsize buffer_length = HEADER_SIZE + size + 1; /* write_int () needs a byte spare */
+    guint8 *message = g_malloc (buffer_length);
+    gsize offset = 0;
+    write_header (message, buffer_length, id, size, &offset);
+    g_variant_store (v, message + offset);
+    *message_length = offset + size;
+
+    return message;
+}
+
+static void
+send_to_user_list_greeters (guint8 *message, gsize message_length)
+{
+    /* A greeter is removed from the list if its connection closes while writing */
+    g_autoptr(GList) greeters = g_list_copy (user_list_greeters);
+    for (GList *link = greeters; link; link = link->next)
+        write_message (link->data, message, message_length);
+}
+
+static void
+send_user_changed (CommonUser *user)
+{
+    gsize message_length;
+    g_autofree guint8 *message = make_variant_message (SERVER_MESSAGE_USER_CHANGED, common_user_serialize (user), &message_length);
+    send_to_user_list_greeters (message, message_length);
+}
+
+static void
+user_added_cb (CommonUserList *user_list, CommonUser *user)
+{
+    send_user_changed (user);
+}
+
+static void
+user_changed_cb (CommonUserList *user_list, CommonUser *user)
+{
+    send_user_changed (user);
+}
+
+static void
+user_removed_cb (CommonUserList *user_list, CommonUser *user)
+{
+    const gchar *username = common_user_get_name (user);
+
+    guint8 message[MAX_MESSAGE_LENGTH];
+    gsize offset = 0;
+    write_header (message, MAX_MESSAGE_LENGTH, SERVER_MESSAGE_USER_REMOVED, string_length (username), &offset);
+    write_string (message, MAX_MESSAGE_LENGTH, username, &offset);
+    send_to_user_list_greeters (message, offset);
+}
+
+void
+greeter_add_user_session (Session *session)
+{
+    if (!user_sessions)
+        user_sessions = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, g_free);
+
+    gchar *id = g_strdup_printf ("%u", user_session_count);
+    user_session_count++;
+    g_hash_table_insert (user_sessions, g_object_ref (session), id);
+
+    const gchar *username = session_get_username (session);
+    guint8 message[MAX_MESSAGE_LENGTH];
+    gsize offset = 0;
+    write_header (message, MAX_MESSAGE_LENGTH, SERVER_MESSAGE_SESSION_ADDED, string_length (id) + string_length (username), &offset);
+    write_string (message, MAX_MESSAGE_LENGTH, id, &offset);
+    write_string (message, MAX_MESSAGE_LENGTH, username, &offset);
+    send_to_user_list_greeters (message, offset);
+}
+
+void
+greeter_remove_user_session (Session *session)
+{
+    if (!user_sessions)
+        return;
+
+    const gchar *id = g_hash_table_lookup (user_sessions, session);
+    if (!id)
+        return;
+
+    guint8 message[MAX_MESSAGE_LENGTH];
+    gsize offset = 0;
+    write_header (message, MAX_MESSAGE_LENGTH, SERVER_MESSAGE_SESSION_REMOVED, string_length (id), &offset);
+    write_string (message, MAX_MESSAGE_LENGTH, id, &offset);
+    g_hash_table_remove (user_sessions, session);
+    send_to_user_list_greeters (message, offset);
+}
+
+/* Send all users and sessions to a greeter and keep it up to date from now on */
+static void
+start_user_list_feed (Greeter *greeter)
+{
+    static gboolean connected_user_list = FALSE;
+
+    if (g_list_find (user_list_greeters, greeter))
+        return;
+
+    CommonUserList *user_list = common_user_list_get_instance ();
+    if (!connected_user_list)
+    {
+        g_signal_connect (user_list, USER_LIST_SIGNAL_USER_ADDED, G_CALLBACK (user_added_cb), NULL);
+        g_signal_connect (user_list, USER_LIST_SIGNAL_USER_CHANGED, G_CALLBACK (user_changed_cb), NULL);
+        g_signal_connect (user_list, USER_LIST_SIGNAL_USER_REMOVED, G_CALLBACK (user_removed_cb), NULL);
+        connected_user_list = TRUE;
+    }
+
+    GVariantBuilder users;
+    g_variant_builder_init (&users, G_VARIANT_TYPE ("aa{sv}"));
+    for (GList *link = common_user_list_get_users (user_list); link; link = link->next)
+        g_variant_builder_add_value (&users, common_user_serialize (link->data));
+
+    GVariantBuilder sessions;
+    g_variant_builder_init (&sessions, G_VARIANT_TYPE ("a(ss)"));
+    if (user_sessions)
+    {
+        GHashTableIter iter;
+        g_hash_table_iter_init (&iter, user_sessions);
+        gpointer session, id;
+        while (g_hash_table_iter_next (&iter, &session, &id))
+            g_variant_builder_add (&sessions, "(ss)", id, session_get_username (SESSION (session)));
+    }
+
+    gsize message_length;
+    g_autofree guint8 *message = make_variant_message (SERVER_MESSAGE_USER_LIST,
+                                                       g_variant_new ("(@aa{sv}@a(ss))", g_variant_builder_end (&users), g_variant_builder_end (&sessions)),
+                                                       &message_length);
+    write_message (greeter, message, message_length);
+
+    user_list_greeters = g_list_append (user_list_greeters, greeter);
+}
+
 static void
 handle_connect (Greeter *greeter, const gchar *version, gboolean resettable, guint32 api_version)
 {
@@ -317,6 +464,11 @@ handle_connect (Greeter *greeter, const gchar *version, gboolean resettable, gui
     while (g_hash_table_iter_next (&iter, &key, &value))
         env_length += string_length (key) + string_length (value);
 
+    /* Send users before the greeter is told it is connected so they are ready to use.
+     * If users are hidden the greeter gets nothing and loads what it needs itself. */
+    if (api_version >= 2 && g_strcmp0 (g_hash_table_lookup (greeter->priv->hints, "hide-users"), "true") != 0)
+        start_user_list_feed (greeter);
+
     guint8 message[MAX_MESSAGE_LENGTH];
     gsize offset = 0;
     if (api_version == 0)
@@ -548,19 +700,17 @@ get_remote_session_service (const gchar *session_name)
             return NULL;
     }
 
-    /* Load the session file */
-    g_autoptr(GKeyFile) session_desktop_file = g_key_file_new ();
-    g_autofree gchar *filename = g_strdup_printf ("%s.desktop", session_name);
+    /* Look up the session file */
     g_autofree gchar *remote_sessions_dir = config_get_string (config_get_instance (), "LightDM", "remote-sessions-directory");
-    g_autofree gchar *path = g_build_filename (remote_sessions_dir, filename, NULL);
-    g_autoptr(GError) error = NULL;
-    gboolean result = g_key_file_load_from_file (session_desktop_file, path, G_KEY_FILE_NONE, &error);
-    if (error)
-        g_debug ("Failed to load session file %s: %s", path, error->message);
-    if (!result)
+    CommonSessionList *session_list = common_session_list_get_instance (remote_sessions_dir, NULL);
+    CommonSessionEntry *entry = common_session_list_get_entry (session_list, session_name);
+    if (!entry)
+    {
+        g_debug ("Failed to find remote session %s", session_name);
         return NULL;
+    }
 
-    return g_key_file_get_string (session_desktop_file, G_KEY_FILE_DESKTOP_GROUP, "X-LightDM-PAM-Service", NULL);
+    return g_strdup (common_session_entry_get_pam_service (entry));
 }
 
 static void
@@ -811,6 +961,7 @@ read_cb (GIOChannel *source, GIOCondition condition, gpointer data)
     {
         g_debug ("Greeter closed communication channel");
         greeter->priv->from_greeter_watch = 0;
+        user_list_greeters = g_list_remove (user_list_greeters, greeter);
         g_signal_emit (greeter, signals[DISCONNECTED], 0);
         return FALSE;
     }
@@ -853,6 +1004,12 @@ read_cb (GIOChannel *source, GIOCondition condition, gpointer data)
     if (greeter->priv->n_read == HEADER_SIZE)
     {
         n_to_read = get_message_length (greeter);
+        if (n_to_read > MAX_MESSAGE_LENGTH)
+        {
+            g_warning ("Greeter sent message of %zu octets, more than the maximum of %d", n_to_read, MAX_MESSAGE_LENGTH);
+            greeter->priv->from_greeter_watch = 0;
+            return FALSE;
+        }
         if (n_to_read > HEADER_SIZE)
         {
             greeter->priv->read_buffer = secure_realloc (greeter, greeter->priv->read_buffer, n_to_read);
@@ -902,7 +1059,8 @@ read_cb (GIOChannel *source, GIOCondition condition, gpointer data)
     case GREETER_MESSAGE_CONTINUE_AUTHENTICATION:
         {
             guint32 n_secrets = read_int (greeter, &offset);
-            guint32 max_secrets = (G_MAXUINT32 - 1) / sizeof (gchar *);
+            /* Each secret takes at least a length in the message */
+            guint32 max_secrets = offset < length ? (length - offset) / int_length () : 0;
             if (n_secrets > max_secrets)
             {
                 g_warning ("Array length of %u elements too long", n_secrets);
@@ -976,6 +1134,13 @@ greeter_get_resettable (Greeter *greeter)
     return greeter->priv->resettable;
 }
 
+gboolean
+greeter_get_is_authenticating (Greeter *greeter)
+{
+    g_return_val_if_fail (greeter != NULL, FALSE);
+    return greeter->priv->authentication_session != NULL;
+}
+
 gboolean
 greeter_get_start_session (Greeter *greeter)
 {
@@ -1018,6 +1183,7 @@ greeter_finalize (GObject *object)
 {
     Greeter *self = GREETER (object);
 
+    user_list_greeters = g_list_remove (user_list_greeters, self);
     g_clear_pointer (&self->priv->pam_service, g_free);
     g_clear_pointer (&self->priv->autologin_pam_service, g_free);
     secure_free (self, self->priv->read_buffer);
@@ -1029,10 +1195,9 @@ greeter_finalize (GObject *object)
         g_signal_handlers_disconnect_matched (self->priv->authentication_session, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, self);
         g_object_unref (self->priv->authentication_session);
     }
+    g_clear_object (&self->priv->to_greeter_channel);
     close (self->priv->to_greeter_input);
     close (self->priv->from_greeter_output);
-    if (self->priv->to_greeter_channel)
-        g_io_channel_unref (self->priv->to_greeter_channel);
     if (self->priv->from_greeter_channel)
         g_io_channel_unref (self->priv->from_greeter_channel);
     if (self->priv->from_greeter_watch)
@@ -67,6 +67,10 @@ void greeter_clear_hints (Greeter *greeter);
 
 void greeter_set_hint (Greeter *greeter, const gchar *name, const gchar *value);
 
+void greeter_add_user_session (Session *session);
+
+void greeter_remove_user_session (Session *session);
+
 void greeter_idle (Greeter *greeter);
 
 void greeter_reset (Greeter *greeter);
@@ -79,6 +83,8 @@ gboolean greeter_get_start_session (Greeter *greeter);
 
 gboolean greeter_get_resettable (Greeter *greeter);
 
+gboolean greeter_get_is_authenticating (Greeter *greeter);
+
 const gchar *greeter_get_active_username (Greeter *greeter);
 
 G_END_DECLS
@@ -11,10 +11,40 @@
 
 #include <string.h>
 #include <ctype.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
 
 #include "guest-account.h"
 #include "configuration.h"
 
+typedef struct
+{
+    /* Username of the account */
+    gchar *username;
+
+    /* Timeout to remove the account if it isn't used */
+    guint expire_timeout;
+} PooledAccount;
+
+/* Accounts created in advance and ready to be handed out */
+static GList *pool = NULL;
+
+/* Usernames to remove (NULL to add an account), run one at a time */
+static GQueue script_queue = G_QUEUE_INIT;
+static guint n_queued_adds = 0;
+
+/* Script currently running, its output is written to a temporary file so it
+ * can be waited for without running the main loop */
+static GSubprocess *script_process = NULL;
+static GCancellable *script_cancellable = NULL;
+static gchar *script_username = NULL;
+static gchar *script_output_path = NULL;
+
+/* TRUE once the daemon is shutting down and no more accounts should be pooled */
+static gboolean pool_closed = FALSE;
+
+static void run_next_script (void);
+
 static gchar *
 get_setup_script (void)
 {
@@ -54,20 +84,9 @@ run_script (const gchar *script, gchar **stdout_text, gint *exit_status, GError
     return result;
 }
 
-gchar *
-guest_account_setup (void)
+static gchar *
+get_username (const gchar *stdout_text, gint exit_status)
 {
-    g_autofree gchar *command = g_strdup_printf ("%s add", get_setup_script ());
-    g_debug ("Opening guest account with command '%s'", command);
-    g_autofree gchar *stdout_text = NULL;
-    gint exit_status;
-    g_autoptr(GError) error = NULL;
-    gboolean result = run_script (command, &stdout_text, &exit_status, &error);
-    if (error)
-        g_warning ("Error running guest account setup script '%s': %s", get_setup_script (), error->message);
-    if (!result)
-        return NULL;
-
     if (exit_status != 0)
     {
         g_debug ("Guest account setup script returns %d: %s", exit_status, stdout_text);
@@ -75,9 +94,10 @@ guest_account_setup (void)
     }
 
     /* Use the last line and trim whitespace */
-    g_auto(GStrv) lines = g_strsplit (g_strstrip (stdout_text), "\n", -1);
+    g_autofree gchar *text = g_strdup (stdout_text ? stdout_text : "");
+    g_auto(GStrv) lines = g_strsplit (g_strstrip (text), "\n", -1);
     g_autofree gchar *username = NULL;
-    if (lines)
+    if (lines && lines[0])
         username = g_strdup (g_strstrip (lines[g_strv_length (lines) - 1]));
     else
         username = g_strdup ("");
@@ -88,13 +108,11 @@ guest_account_setup (void)
         return NULL;
     }
 
-    g_debug ("Guest account %s setup", username);
-
     return g_steal_pointer (&username);
 }
 
-void
-guest_account_cleanup (const gchar *username)
+static void
+remove_account (const gchar *username)
 {
     g_autofree gchar *command = g_strdup_printf ("%s remove %s", get_setup_script (), username);
     g_debug ("Closing guest account %s with command '%s'", username, command);
@@ -109,3 +127,256 @@ guest_account_cleanup (const gchar *username)
     if (result && exit_status != 0)
         g_debug ("Guest account cleanup script returns %d", exit_status);
 }
+
+static gint
+get_pool_size (void)
+{
+    if (pool_closed || !guest_account_is_installed ())
+        return 0;
+
+    return config_get_integer (config_get_instance (), "LightDM", "guest-account-pool-size");
+}
+
+static void
+queue_script (const gchar *username)
+{
+    if (!username)
+        n_queued_adds++;
+    g_queue_push_tail (&script_queue, g_strdup (username));
+    run_next_script ();
+}
+
+static void
+free_pooled_account (PooledAccount *account)
+{
+    if (account->expire_timeout)
+        g_source_remove (account->expire_timeout);
+    g_free (account->username);
+    g_free (account);
+}
+
+static gboolean
+expire_timeout_cb (gpointer data)
+{
+    PooledAccount *account = data;
+
+    g_debug ("Pooled guest account %s expired", account->username);
+
+    account->expire_timeout = 0;
+    pool = g_list_remove (pool, account);
+    queue_script (account->username);
+    free_pooled_account (account);
+
+    /* Replace it with a fresh one */
+    guest_account_fill_pool ();
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+add_to_pool (const gchar *username)
+{
+    PooledAccount *account = g_malloc0 (sizeof (PooledAccount));
+    account->username = g_strdup (username);
+    gint ttl = config_get_integer (config_get_instance (), "LightDM", "guest-account-pool-ttl");
+    if (ttl > 0)
+        account->expire_timeout = g_timeout_add_seconds (ttl, expire_timeout_cb, account);
+    pool = g_list_append (pool, account);
+
+    g_debug ("Guest account %s added to pool", username);
+}
+
+static void
+finish_script (void)
+{
+    g_autoptr(GSubprocess) process = g_steal_pointer (&script_process);
+    g_autofree gchar *username = g_steal_pointer (&script_username);
+    g_autofree gchar *output_path = g_steal_pointer (&script_output_path);
+    g_clear_object (&script_cancellable);
+
+    g_autofree gchar *stdout_text = NULL;
+    g_autoptr(GError) error = NULL;
+    gboolean success = g_file_get_contents (output_path, &stdout_text, NULL, &error);
+    if (error)
+        g_warning ("Failed to read output of guest account script '%s': %s", get_setup_script (), error->message);
+    g_unlink (output_path);
+    gint exit_status = g_subprocess_get_if_exited (process) ? g_subprocess_get_exit_status (process) : -1;
+
+    if (username)
+    {
+        if (exit_status != 0)
+            g_debug ("Guest account cleanup script returns %d", exit_status);
+    }
+    else
+    {
+        g_autofree gchar *new_username = success ? get_username (stdout_text, exit_status) : NULL;
+        n_queued_adds--;
+        if (new_username && pool_closed)
+            remove_account (new_username);
+        else if (new_username)
+            add_to_pool (new_username);
+        else
+        {
+            /* Don't keep retrying a failing script, the next fill will try again */
+            g_queue_remove_all (&script_queue, NULL);
+            n_queued_adds = 0;
+        }
+    }
+}
+
+static void
+script_cb (GObject *object, GAsyncResult *result, gpointer data)
+{
+    g_autoptr(GError) error = NULL;
+    g_subprocess_wait_finish (G_SUBPROCESS (object), result, &error);
+
+    /* Already completed by wait_for_scripts () */
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        return;
+
+    finish_script ();
+    run_next_script ();
+}
+
+static void
+run_next_script (void)
+{
+    if (script_process || g_queue_is_empty (&script_queue))
+        return;
+
+    g_autofree gchar *username = g_queue_pop_head (&script_queue);
+    g_autofree gchar *command = NULL;
+    if (username)
+        command = g_strdup_printf ("%s remove %s", get_setup_script (), username);
+    else
+        command = g_strdup_printf ("%s add", get_setup_script ());
+    g_debug ("Running guest account command '%s'", command);
+
+    g_autoptr(GError) error = NULL;
+    g_auto(GStrv) argv = NULL;
+    g_autofree gchar *output_path = NULL;
+    g_autoptr(GSubprocess) process = NULL;
+    if (g_shell_parse_argv (command, NULL, &argv, &error))
+    {
+        int output_fd = g_file_open_tmp ("lightdm-guest-XXXXXX", &output_path, &error);
+        if (output_fd >= 0)
+        {
+            g_autoptr(GSubprocessLauncher) launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_NONE);
+            g_subprocess_launcher_take_stdout_fd (launcher, output_fd);
+            process = g_subprocess_launcher_spawnv (launcher, (const gchar * const *) argv, &error);
+            if (!process)
+                g_unlink (output_path);
+        }
+    }
+    if (!process)
+    {
+        g_warning ("Error running guest account script '%s': %s", get_setup_script (), error->message);
+        if (!username)
+            n_queued_adds--;
+        run_next_script ();
+        return;
+    }
+
+    script_process = g_steal_pointer (&process);
+    script_username = g_steal_pointer (&username);
+    script_output_path = g_steal_pointer (&output_path);
+    script_cancellable = g_cancellable_new ();
+    g_subprocess_wait_async (script_process, script_cancellable, script_cb, NULL);
+}
+
+/* Run queued scripts to completion without dispatching other main loop sources */
+static void
+wait_for_scripts (void)
+{
+    while (script_process)
+    {
+        g_cancellable_cancel (script_cancellable);
+        g_autoptr(GError) error = NULL;
+        if (!g_subprocess_wait (script_process, NULL, &error))
+            g_warning ("Failed to wait for guest account script '%s': %s", get_setup_script (), error->message);
+        finish_script ();
+        run_next_script ();
+    }
+}
+
+void
+guest_account_fill_pool (void)
+{
+    gint size = get_pool_size ();
+    while (g_list_length (pool) + n_queued_adds < (guint) MAX (size, 0))
+        queue_script (NULL);
+}
+
+gchar *
+guest_account_setup (void)
+{
+    /* Let scripts already queued finish first, so the add below doesn't race
+     * them and an account being added in the background can be handed out */
+    wait_for_scripts ();
+
+    /* Hand out an account that is already set up */
+    if (pool)
+    {
+        PooledAccount *account = pool->data;
+        pool = g_list_delete_link (pool, pool);
+        g_autofree gchar *username = g_steal_pointer (&account->username);
+        free_pooled_account (account);
+
+        g_debug ("Using pooled guest account %s", username);
+        guest_account_fill_pool ();
+
+        return g_steal_pointer (&username);
+    }
+
+    g_autofree gchar *command = g_strdup_printf ("%s add", get_setup_script ());
+    g_debug ("Opening guest account with command '%s'", command);
+    g_autofree gchar *stdout_text = NULL;
+    gint exit_status;
+    g_autoptr(GError) error = NULL;
+    gboolean result = run_script (command, &stdout_text, &exit_status, &error);
+    if (error)
+        g_warning ("Error running guest account setup script '%s': %s", get_setup_script (), error->message);
+    if (!result)
+        return NULL;
+
+    g_autofree gchar *username = get_username (stdout_text, exit_status);
+    if (!username)
+        return NULL;
+
+    g_debug ("Guest account %s setup", username);
+
+    /* Have the next one ready */
+    guest_account_fill_pool ();
+
+    return g_steal_pointer (&username);
+}
+
+void
+guest_account_cleanup (const gchar *username)
+{
+    if (!username)
+        return;
+
+    g_debug ("Closing guest account %s", username);
+    queue_script (username);
+
+    /* Replace the account if the pool is short */
+    guest_account_fill_pool ();
+}
+
+void
+guest_account_cleanup_pool (void)
+{
+    pool_closed = TRUE;
+
+    /* Let outstanding scripts complete, accounts still being added are removed when done */
+    wait_for_scripts ();
+
+    for (GList *link = pool; link; link = link->next)
+    {
+        PooledAccount *account = link->data;
+        remove_account (account->username);
+    }
+    g_list_free_full (pool, (GDestroyNotify) free_pooled_account);
+    pool = NULL;
+}
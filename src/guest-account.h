@@ -22,6 +22,10 @@ gchar *guest_account_setup (void);
 
 void guest_account_cleanup (const gchar *username);
 
+void guest_account_fill_pool (void);
+
+void guest_account_cleanup_pool (void);
+
 G_END_DECLS
 
 #endif /* GUEST_ACCOUNT_H_ */
@@ -21,6 +21,7 @@
 #include <sys/stat.h>
 #include <errno.h>
 
+#include "accounting.h"
 #include "configuration.h"
 #include "display-manager.h"
 #include "display-manager-service.h"
@@ -29,12 +30,18 @@
 #include "seat-xdmcp-session.h"
 #include "seat-xvnc.h"
 #include "x-server.h"
+#include "x-server-local.h"
+#include "x-server-capabilities.h"
 #include "process.h"
 #include "session-child.h"
 #include "shared-data-manager.h"
+#include "guest-account.h"
+#include "plymouth.h"
 #include "user-list.h"
+#include "session-list.h"
 #include "login1.h"
 #include "log-file.h"
+#include "main-loop-watchdog.h"
 
 static gchar *config_path = NULL;
 static GMainLoop *loop = NULL;
@@ -48,9 +55,13 @@ static XDMCPServer *xdmcp_server = NULL;
 static guint xdmcp_client_count = 0;
 static VNCServer *vnc_server = NULL;
 static guint vnc_client_count = 0;
+
+/* VNC seats started ahead of connections */
+static GList *vnc_pool = NULL;
 static gint exit_code = EXIT_SUCCESS;
 
 static gboolean update_login1_seat (Login1Seat *login1_seat);
+static void reload_config (void);
 
 static void
 log_cb (const gchar *log_domain, GLogLevelFlags log_level, const gchar *message, gpointer data)
@@ -116,12 +127,12 @@ log_init (void)
 }
 
 static GList*
-get_config_sections (const gchar *seat_name)
+get_config_sections (Configuration *config, const gchar *seat_name)
 {
     /* Load seat defaults first */
     GList *config_sections = g_list_append (NULL, g_strdup ("Seat:*"));
 
-    g_auto(GStrv) groups = config_get_groups (config_get_instance ());
+    g_auto(GStrv) groups = config_get_groups (config);
     for (gchar **i = groups; *i; i++)
     {
         if (g_str_has_prefix (*i, "Seat:") && strcmp (*i, "Seat:*") != 0)
@@ -135,10 +146,61 @@ get_config_sections (const gchar *seat_name)
     return config_sections;
 }
 
+/* Set default values for the configuration that can be reloaded */
+static void
+set_config_defaults (Configuration *config)
+{
+    if (!config_has_key (config, "Seat:*", "type"))
+        config_set_string (config, "Seat:*", "type", "local");
+    if (!config_has_key (config, "Seat:*", "pam-service"))
+        config_set_string (config, "Seat:*", "pam-service", "lightdm");
+    if (!config_has_key (config, "Seat:*", "pam-autologin-service"))
+        config_set_string (config, "Seat:*", "pam-autologin-service", "lightdm-autologin");
+    if (!config_has_key (config, "Seat:*", "pam-greeter-service"))
+        config_set_string (config, "Seat:*", "pam-greeter-service", "lightdm-greeter");
+    if (!config_has_key (config, "Seat:*", "xserver-command"))
+        config_set_string (config, "Seat:*", "xserver-command", "X");
+    if (!config_has_key (config, "Seat:*", "xmir-command"))
+        config_set_string (config, "Seat:*", "xmir-command", "Xmir");
+    if (!config_has_key (config, "Seat:*", "xserver-share"))
+        config_set_boolean (config, "Seat:*", "xserver-share", TRUE);
+    if (!config_has_key (config, "Seat:*", "unity-compositor-command"))
+        config_set_string (config, "Seat:*", "unity-compositor-command", "unity-system-compositor");
+    if (!config_has_key (config, "Seat:*", "unity-compositor-ping-interval"))
+        config_set_integer (config, "Seat:*", "unity-compositor-ping-interval", 30);
+    if (!config_has_key (config, "Seat:*", "start-session"))
+        config_set_boolean (config, "Seat:*", "start-session", TRUE);
+    if (!config_has_key (config, "Seat:*", "allow-user-switching"))
+        config_set_boolean (config, "Seat:*", "allow-user-switching", TRUE);
+    if (!config_has_key (config, "Seat:*", "allow-guest"))
+        config_set_boolean (config, "Seat:*", "allow-guest", TRUE);
+    if (!config_has_key (config, "Seat:*", "greeter-allow-guest"))
+        config_set_boolean (config, "Seat:*", "greeter-allow-guest", TRUE);
+    if (!config_has_key (config, "Seat:*", "greeter-show-remote-login"))
+        config_set_boolean (config, "Seat:*", "greeter-show-remote-login", TRUE);
+    if (!config_has_key (config, "Seat:*", "greeter-session"))
+        config_set_string (config, "Seat:*", "greeter-session", DEFAULT_GREETER_SESSION);
+    if (!config_has_key (config, "Seat:*", "user-session"))
+        config_set_string (config, "Seat:*", "user-session", DEFAULT_USER_SESSION);
+    if (!config_has_key (config, "Seat:*", "session-wrapper"))
+        config_set_string (config, "Seat:*", "session-wrapper", "lightdm-session");
+    if (!config_has_key (config, "XDMCPServer", "hostname"))
+        config_set_string (config, "XDMCPServer", "hostname", g_get_host_name ());
+    if (!config_has_key (config, "XDMCPServer", "keep-alive-timeout"))
+        config_set_integer (config, "XDMCPServer", "keep-alive-timeout", 180);
+    if (!config_has_key (config, "VNCServer", "max-starting"))
+        config_set_integer (config, "VNCServer", "max-starting", 8);
+    if (!config_has_key (config, "VNCServer", "max-queued"))
+        config_set_integer (config, "VNCServer", "max-queued", 64);
+}
+
 static void
 set_seat_properties (Seat *seat, const gchar *seat_name)
 {
-    GList *sections = get_config_sections (seat_name);
+    /* Remember which sections apply so the seat can be updated when the configuration is reloaded */
+    g_object_set_data_full (G_OBJECT (seat), "CONFIG_SEAT_NAME", g_strdup (seat_name), g_free);
+
+    GList *sections = get_config_sections (config_get_instance (), seat_name);
     for (GList *link = sections; link; link = link->next)
     {
         const gchar *section = link->data;
@@ -167,9 +229,12 @@ signal_cb (Process *process, int signum)
         display_manager_stop (display_manager);
         // FIXME: Stop XDMCP server
         break;
+    case SIGHUP:
+        g_debug ("Caught %s signal, reloading configuration", g_strsignal (signum));
+        reload_config ();
+        break;
     case SIGUSR1:
     case SIGUSR2:
-    case SIGHUP:
         break;
     }
 }
@@ -262,6 +327,14 @@ display_manager_seat_removed_cb (DisplayManager *display_manager, Seat *seat)
     }
 }
 
+static void
+xdmcp_seat_stopped_cb (SeatXDMCPSession *seat)
+{
+    /* Displays asking about this session are told it has ended */
+    if (xdmcp_server)
+        xdmcp_server_end_session (xdmcp_server, seat_xdmcp_session_get_session (seat));
+}
+
 static gboolean
 xdmcp_session_cb (XDMCPServer *server, XDMCPSession *session)
 {
@@ -270,22 +343,256 @@ xdmcp_session_cb (XDMCPServer *server, XDMCPSession *session)
     g_autofree gchar *name = g_strdup_printf ("xdmcp%d", xdmcp_client_count);
     xdmcp_client_count++;
 
+    g_signal_connect (seat, SEAT_SIGNAL_STOPPED, G_CALLBACK (xdmcp_seat_stopped_cb), NULL);
+
     seat_set_name (SEAT (seat), name);
     set_seat_properties (SEAT (seat), NULL);
     return display_manager_add_seat (display_manager, SEAT (seat));
 }
 
+static GVariant *
+service_get_xdmcp_sessions_by_state_cb (DisplayManagerService *service)
+{
+    return xdmcp_server ? xdmcp_server_get_sessions_by_state (xdmcp_server) : NULL;
+}
+
+static GVariant *
+service_get_vnc_statistics_cb (DisplayManagerService *service)
+{
+    return vnc_server ? vnc_server_get_statistics (vnc_server) : NULL;
+}
+
+static void fill_vnc_pool (void);
+
 static void
-vnc_connection_cb (VNCServer *server, GSocket *connection)
+vnc_seat_ready_cb (SeatXVNC *seat)
+{
+    if (!vnc_server)
+        return;
+
+    if (g_list_find (vnc_pool, seat))
+        vnc_server_pooled_seat_ready (vnc_server);
+    else
+        vnc_server_connection_ready (vnc_server, seat_xvnc_get_connection (seat));
+
+    /* A seat has finished starting, so the pool may have been waiting on it */
+    fill_vnc_pool ();
+}
+
+static void
+vnc_seat_stopped_cb (SeatXVNC *seat)
+{
+    if (vnc_server && seat_xvnc_get_connection (seat))
+    {
+        vnc_server_connection_closed (vnc_server, seat_xvnc_get_connection (seat));
+        fill_vnc_pool ();
+    }
+}
+
+/* Start a VNC seat, with no connection for a pooled seat */
+static SeatXVNC *
+add_vnc_seat (GSocket *connection)
 {
     g_autoptr(SeatXVNC) seat = seat_xvnc_new (connection);
 
     g_autofree gchar *name = g_strdup_printf ("vnc%d", vnc_client_count);
     vnc_client_count++;
 
+    /* Let the VNC server know when the connection stops using resources */
+    g_signal_connect (seat, SEAT_XVNC_SIGNAL_READY, G_CALLBACK (vnc_seat_ready_cb), NULL);
+    g_signal_connect (seat, SEAT_SIGNAL_STOPPED, G_CALLBACK (vnc_seat_stopped_cb), NULL);
+
     seat_set_name (SEAT (seat), name);
     set_seat_properties (SEAT (seat), NULL);
-    display_manager_add_seat (display_manager, SEAT (seat));
+    if (!display_manager_add_seat (display_manager, SEAT (seat)))
+        return NULL;
+
+    return g_steal_pointer (&seat);
+}
+
+static void
+vnc_pool_seat_stopped_cb (SeatXVNC *seat)
+{
+    g_debug ("Pooled VNC seat %s stopped", seat_get_name (SEAT (seat)));
+
+    vnc_pool = g_list_remove (vnc_pool, seat);
+    g_signal_handlers_disconnect_by_func (seat, vnc_pool_seat_stopped_cb, NULL);
+
+    /* Only replace seats that worked, so an X server that can't start isn't restarted forever */
+    gboolean was_ready = seat_xvnc_get_is_ready (seat);
+    g_object_unref (seat);
+    if (vnc_server)
+        vnc_server_pooled_seat_removed (vnc_server, was_ready);
+    if (was_ready)
+        fill_vnc_pool ();
+}
+
+/* Start seats until the pool is the configured size */
+static void
+fill_vnc_pool (void)
+{
+    if (!vnc_server || display_manager_get_is_stopping (display_manager))
+        return;
+
+    gint pool_size = config_get_integer (config_get_instance (), "VNCServer", "pool-size");
+    while ((gint) g_list_length (vnc_pool) < pool_size)
+    {
+        /* Pooled seats count against max-seats and max-starting, the rest are started when there's room */
+        if (!vnc_server_can_start_pooled_seat (vnc_server))
+            return;
+
+        SeatXVNC *seat = add_vnc_seat (NULL);
+        if (!seat)
+        {
+            g_warning ("Failed to start pooled VNC seat");
+            return;
+        }
+
+        g_debug ("Started pooled VNC seat %s", seat_get_name (SEAT (seat)));
+        g_signal_connect (seat, SEAT_SIGNAL_STOPPED, G_CALLBACK (vnc_pool_seat_stopped_cb), NULL);
+        vnc_pool = g_list_append (vnc_pool, seat);
+        vnc_server_pooled_seat_added (vnc_server);
+    }
+}
+
+static void
+empty_vnc_pool (void)
+{
+    /* Take the seats out of the pool first so they aren't counted against a later VNC server */
+    GList *seats = vnc_pool;
+    vnc_pool = NULL;
+    for (GList *link = seats; link; link = link->next)
+    {
+        g_signal_handlers_disconnect_by_func (link->data, vnc_pool_seat_stopped_cb, NULL);
+        seat_stop (SEAT (link->data));
+    }
+    g_list_free_full (seats, g_object_unref);
+}
+
+/* Give a connection to a pooled seat that is ready, returns FALSE if none are */
+static gboolean
+use_vnc_pool (VNCServer *server, GSocket *connection)
+{
+    GList *link;
+    for (link = vnc_pool; link && !seat_xvnc_get_is_ready (SEAT_XVNC (link->data)); link = link->next);
+    if (!link)
+        return FALSE;
+
+    g_autoptr(SeatXVNC) seat = link->data;
+    vnc_pool = g_list_delete_link (vnc_pool, link);
+    g_signal_handlers_disconnect_by_func (seat, vnc_pool_seat_stopped_cb, NULL);
+    vnc_server_pooled_seat_removed (server, TRUE);
+
+    gboolean result = seat_xvnc_attach_connection (seat, connection);
+    if (result)
+    {
+        g_debug ("Using pooled VNC seat %s", seat_get_name (SEAT (seat)));
+        vnc_server_connection_ready (server, connection);
+    }
+    else
+        seat_stop (SEAT (seat));
+
+    fill_vnc_pool ();
+
+    return result;
+}
+
+static void
+vnc_connection_cb (VNCServer *server, GSocket *connection)
+{
+    if (use_vnc_pool (server, connection))
+        return;
+
+    g_autoptr(SeatXVNC) seat = add_vnc_seat (connection);
+    if (!seat)
+        vnc_server_connection_closed (server, connection);
+}
+
+/* Apply the [XDMCPServer] configuration, returns FALSE if the configured key is not available */
+static gboolean
+configure_xdmcp_server (void)
+{
+    gint port = config_get_integer (config_get_instance (), "XDMCPServer", "port");
+    xdmcp_server_set_port (xdmcp_server, MAX (port, 0));
+    g_autofree gchar *listen_address = config_get_string (config_get_instance (), "XDMCPServer", "listen-address");
+    xdmcp_server_set_listen_address (xdmcp_server, listen_address);
+    g_autofree gchar *hostname = config_get_string (config_get_instance (), "XDMCPServer", "hostname");
+    xdmcp_server_set_hostname (xdmcp_server, hostname);
+    xdmcp_server_set_keep_alive_timeout (xdmcp_server, MAX (config_get_integer (config_get_instance (), "XDMCPServer", "keep-alive-timeout"), 0));
+
+    g_autofree gchar *key_name = config_get_string (config_get_instance (), "XDMCPServer", "key");
+    g_autofree gchar *key = NULL;
+    if (key_name)
+    {
+        g_autofree gchar *path = g_build_filename (config_get_directory (config_get_instance ()), "keys.conf", NULL);
+
+        g_autoptr(GKeyFile) keys = g_key_file_new ();
+        g_autoptr(GError) error = NULL;
+        gboolean result = g_key_file_load_from_file (keys, path, G_KEY_FILE_NONE, &error);
+        if (error)
+            g_warning ("Unable to load keys from %s: %s", path, error->message);
+
+        if (result)
+        {
+            if (g_key_file_has_key (keys, "keyring", key_name, NULL))
+                key = g_key_file_get_string (keys, "keyring", key_name, NULL);
+            else
+                g_warning ("Key %s not defined", key_name);
+        }
+    }
+    xdmcp_server_set_key (xdmcp_server, key);
+
+    return !key_name || key;
+}
+
+static gboolean
+start_xdmcp_server (void)
+{
+    xdmcp_server = xdmcp_server_new ();
+    g_signal_connect (xdmcp_server, XDMCP_SERVER_SIGNAL_NEW_SESSION, G_CALLBACK (xdmcp_session_cb), NULL);
+    if (!configure_xdmcp_server ())
+    {
+        g_clear_object (&xdmcp_server);
+        return FALSE;
+    }
+
+    g_debug ("Starting XDMCP server on UDP/IP port %d", xdmcp_server_get_port (xdmcp_server));
+    xdmcp_server_start (xdmcp_server);
+
+    return TRUE;
+}
+
+static void
+configure_vnc_server (void)
+{
+    gint port = config_get_integer (config_get_instance (), "VNCServer", "port");
+    vnc_server_set_port (vnc_server, MAX (port, 0));
+    g_autofree gchar *listen_address = config_get_string (config_get_instance (), "VNCServer", "listen-address");
+    vnc_server_set_listen_address (vnc_server, listen_address);
+    vnc_server_set_max_seats (vnc_server, MAX (config_get_integer (config_get_instance (), "VNCServer", "max-seats"), 0));
+    vnc_server_set_max_starting (vnc_server, MAX (config_get_integer (config_get_instance (), "VNCServer", "max-starting"), 0));
+    vnc_server_set_max_queued (vnc_server, MAX (config_get_integer (config_get_instance (), "VNCServer", "max-queued"), 0));
+    vnc_server_set_address_rate_limit (vnc_server, MAX (config_get_integer (config_get_instance (), "VNCServer", "address-rate-limit"), 0));
+}
+
+static void
+start_vnc_server (void)
+{
+    g_autofree gchar *path = g_find_program_in_path ("Xvnc");
+    if (!path)
+    {
+        g_warning ("Can't start VNC server, Xvnc is not in the path");
+        return;
+    }
+
+    vnc_server = vnc_server_new ();
+    configure_vnc_server ();
+    g_signal_connect (vnc_server, VNC_SERVER_SIGNAL_NEW_CONNECTION, G_CALLBACK (vnc_connection_cb), NULL);
+
+    g_debug ("Starting VNC server on TCP/IP port %d", vnc_server_get_port (vnc_server));
+    vnc_server_start (vnc_server);
+
+    fill_vnc_pool ();
 }
 
 static void
@@ -294,82 +601,238 @@ start_display_manager (void)
     display_manager_start (display_manager);
 
     /* Start the XDMCP server */
-    if (config_get_boolean (config_get_instance (), "XDMCPServer", "enabled"))
+    if (config_get_boolean (config_get_instance (), "XDMCPServer", "enabled") && !start_xdmcp_server ())
     {
-        xdmcp_server = xdmcp_server_new ();
-        if (config_has_key (config_get_instance (), "XDMCPServer", "port"))
+        exit_code = EXIT_FAILURE;
+        display_manager_stop (display_manager);
+        return;
+    }
+
+    /* Start the VNC server */
+    if (config_get_boolean (config_get_instance (), "VNCServer", "enabled"))
+        start_vnc_server ();
+}
+
+/* Check if a configuration section has the same keys and values in both configurations */
+static gboolean
+config_sections_equal (Configuration *a, Configuration *b, const gchar *section)
+{
+    g_auto(GStrv) a_keys = config_get_keys (a, section);
+    g_auto(GStrv) b_keys = config_get_keys (b, section);
+    if ((a_keys ? g_strv_length (a_keys) : 0) != (b_keys ? g_strv_length (b_keys) : 0))
+        return FALSE;
+
+    for (int i = 0; a_keys && a_keys[i]; i++)
+    {
+        g_autofree gchar *a_value = config_get_string (a, section, a_keys[i]);
+        g_autofree gchar *b_value = config_get_string (b, section, a_keys[i]);
+        if (g_strcmp0 (a_value, b_value) != 0)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Get the combined seat configuration as property name -> value */
+static GHashTable *
+get_seat_config (Configuration *config, const gchar *seat_name)
+{
+    GHashTable *values = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+    GList *sections = get_config_sections (config, seat_name);
+    for (GList *link = sections; link; link = link->next)
+    {
+        const gchar *section = link->data;
+        g_auto(GStrv) keys = config_get_keys (config, section);
+        for (gint i = 0; keys && keys[i]; i++)
+            g_hash_table_insert (values, g_strdup (keys[i]), config_get_string (config, section, keys[i]));
+    }
+    g_list_free_full (sections, g_free);
+
+    return values;
+}
+
+static void
+reload_seat (Seat *seat, Configuration *old_config)
+{
+    const gchar *seat_name = g_object_get_data (G_OBJECT (seat), "CONFIG_SEAT_NAME");
+    g_autoptr(GHashTable) old_values = get_seat_config (old_config, seat_name);
+    g_autoptr(GHashTable) new_values = get_seat_config (config_get_instance (), seat_name);
+
+    /* Properties no longer in the configuration become unset */
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init (&iter, old_values);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+        if (!g_hash_table_contains (new_values, key))
+            g_hash_table_insert (new_values, g_strdup (key), NULL);
+
+    g_autoptr(GPtrArray) changed = g_ptr_array_new ();
+    g_hash_table_iter_init (&iter, new_values);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        const gchar *name = key;
+
+        if (g_strcmp0 (value, g_hash_table_lookup (old_values, name)) == 0)
+            continue;
+
+        /* The seat implementation can't be swapped while it is running */
+        if (strcmp (name, "type") == 0)
         {
-            gint port;
-            port = config_get_integer (config_get_instance (), "XDMCPServer", "port");
-            if (port > 0)
-                xdmcp_server_set_port (xdmcp_server, port);
+            l_warning (seat, "Not changing seat type to %s, this requires a restart", (const gchar *) value);
+            continue;
         }
-        g_autofree gchar *listen_address = config_get_string (config_get_instance (), "XDMCPServer", "listen-address");
-        xdmcp_server_set_listen_address (xdmcp_server, listen_address);
-        g_autofree gchar *hostname = config_get_string (config_get_instance (), "XDMCPServer", "hostname");
-        xdmcp_server_set_hostname (xdmcp_server, hostname);
-        g_signal_connect (xdmcp_server, XDMCP_SERVER_SIGNAL_NEW_SESSION, G_CALLBACK (xdmcp_session_cb), NULL);
-
-        g_autofree gchar *key_name = config_get_string (config_get_instance (), "XDMCPServer", "key");
-        g_autofree gchar *key = NULL;
-        if (key_name)
-        {
-            g_autofree gchar *path = g_build_filename (config_get_directory (config_get_instance ()), "keys.conf", NULL);
 
-            g_autoptr(GKeyFile) keys = g_key_file_new ();
-            g_autoptr(GError) error = NULL;
-            gboolean result = g_key_file_load_from_file (keys, path, G_KEY_FILE_NONE, &error);
-            if (error)
-                g_warning ("Unable to load keys from %s: %s", path, error->message);
+        seat_set_property (seat, name, value);
+        g_ptr_array_add (changed, (gpointer) name);
+    }
 
-            if (result)
-            {
-                if (g_key_file_has_key (keys, "keyring", key_name, NULL))
-                    key = g_key_file_get_string (keys, "keyring", key_name, NULL);
-                else
-                    g_warning ("Key %s not defined", key_name);
-            }
-        }
-        if (key)
-            xdmcp_server_set_key (xdmcp_server, key);
+    if (changed->len == 0)
+        return;
+    g_ptr_array_add (changed, NULL);
+    seat_properties_changed (seat, (const gchar * const *) changed->pdata);
+}
 
-        if (key_name && !key)
+static void
+reload_xdmcp_server (Configuration *old_config)
+{
+    if (config_sections_equal (old_config, config_get_instance (), "XDMCPServer"))
+        return;
+
+    if (!config_get_boolean (config_get_instance (), "XDMCPServer", "enabled"))
+    {
+        if (xdmcp_server)
         {
-            exit_code = EXIT_FAILURE;
-            display_manager_stop (display_manager);
-            return;
+            g_debug ("Stopping XDMCP server");
+            xdmcp_server_stop (xdmcp_server);
+            g_clear_object (&xdmcp_server);
         }
-        else
+        return;
+    }
+
+    if (!xdmcp_server)
+    {
+        if (!start_xdmcp_server ())
+            g_warning ("Not starting XDMCP server, configured key is not available");
+        return;
+    }
+
+    /* Keep the same server so existing sessions continue, only move the sockets if required */
+    guint old_port = xdmcp_server_get_port (xdmcp_server);
+    g_autofree gchar *old_listen_address = g_strdup (xdmcp_server_get_listen_address (xdmcp_server));
+    if (!configure_xdmcp_server ())
+    {
+        g_warning ("Stopping XDMCP server, configured key is not available");
+        xdmcp_server_stop (xdmcp_server);
+        g_clear_object (&xdmcp_server);
+        return;
+    }
+    if (xdmcp_server_get_port (xdmcp_server) != old_port ||
+        g_strcmp0 (xdmcp_server_get_listen_address (xdmcp_server), old_listen_address) != 0)
+    {
+        g_debug ("Restarting XDMCP server on UDP/IP port %d", xdmcp_server_get_port (xdmcp_server));
+        xdmcp_server_stop (xdmcp_server);
+        xdmcp_server_start (xdmcp_server);
+    }
+}
+
+static void
+reload_vnc_server (Configuration *old_config)
+{
+    if (config_sections_equal (old_config, config_get_instance (), "VNCServer"))
+        return;
+
+    if (!config_get_boolean (config_get_instance (), "VNCServer", "enabled"))
+    {
+        if (vnc_server)
         {
-            g_debug ("Starting XDMCP server on UDP/IP port %d", xdmcp_server_get_port (xdmcp_server));
-            xdmcp_server_start (xdmcp_server);
+            g_debug ("Stopping VNC server");
+            vnc_server_stop (vnc_server);
+            g_clear_object (&vnc_server);
+            empty_vnc_pool ();
         }
+        return;
     }
 
-    /* Start the VNC server */
-    if (config_get_boolean (config_get_instance (), "VNCServer", "enabled"))
+    if (!vnc_server)
     {
-        g_autofree gchar *path = g_find_program_in_path ("Xvnc");
-        if (path)
-        {
-            vnc_server = vnc_server_new ();
-            if (config_has_key (config_get_instance (), "VNCServer", "port"))
-            {
-                gint port = config_get_integer (config_get_instance (), "VNCServer", "port");
-                if (port > 0)
-                    vnc_server_set_port (vnc_server, port);
-            }
-            g_autofree gchar *listen_address = config_get_string (config_get_instance (), "VNCServer", "listen-address");
-            vnc_server_set_listen_address (vnc_server, listen_address);
-            g_signal_connect (vnc_server, VNC_SERVER_SIGNAL_NEW_CONNECTION, G_CALLBACK (vnc_connection_cb), NULL);
+        start_vnc_server ();
+        return;
+    }
 
-            g_debug ("Starting VNC server on TCP/IP port %d", vnc_server_get_port (vnc_server));
-            vnc_server_start (vnc_server);
-        }
-        else
-            g_warning ("Can't start VNC server, Xvnc is not in the path");
+    /* Other settings are read for each new connection, only the listening sockets need updating */
+    guint old_port = vnc_server_get_port (vnc_server);
+    g_autofree gchar *old_listen_address = g_strdup (vnc_server_get_listen_address (vnc_server));
+    configure_vnc_server ();
+    if (vnc_server_get_port (vnc_server) != old_port ||
+        g_strcmp0 (vnc_server_get_listen_address (vnc_server), old_listen_address) != 0)
+    {
+        g_debug ("Restarting VNC server on TCP/IP port %d", vnc_server_get_port (vnc_server));
+        vnc_server_stop (vnc_server);
+        vnc_server_start (vnc_server);
+    }
+    fill_vnc_pool ();
+}
+
+/* Keep the values a section had in the previous configuration */
+static void
+keep_config_section (Configuration *config, Configuration *old_config, const gchar *section)
+{
+    /* The old configuration also contains the defaults and command line overrides, so only warn about values that were set */
+    gboolean changed = FALSE;
+    g_auto(GStrv) keys = config_get_keys (config, section);
+    for (int i = 0; keys && keys[i]; i++)
+    {
+        g_autofree gchar *value = config_get_string (config, section, keys[i]);
+        g_autofree gchar *old_value = config_get_string (old_config, section, keys[i]);
+        if (g_strcmp0 (value, old_value) != 0)
+            changed = TRUE;
+        config_remove_key (config, section, keys[i]);
+    }
+    if (changed)
+        g_warning ("Ignoring changes to [%s], these require a restart", section);
+
+    g_auto(GStrv) old_keys = config_get_keys (old_config, section);
+    for (int i = 0; old_keys && old_keys[i]; i++)
+    {
+        g_autofree gchar *value = config_get_string (old_config, section, old_keys[i]);
+        config_set_string (config, section, old_keys[i], value);
     }
 }
+
+static void
+reload_config (void)
+{
+    Configuration *config = g_object_new (CONFIGURATION_TYPE, NULL);
+    GList *messages = NULL;
+    gboolean result = config_load_from_standard_locations (config, config_path, &messages);
+    for (GList *link = messages; link; link = link->next)
+        g_debug ("%s", (gchar *) link->data);
+    g_list_free_full (messages, g_free);
+    if (!result)
+    {
+        g_warning ("Failed to reload configuration, keeping existing configuration");
+        g_object_unref (config);
+        return;
+    }
+    set_config_defaults (config);
+
+    /* Daemon settings are only used at startup */
+    Configuration *old_config = g_object_ref (config_get_instance ());
+    keep_config_section (config, old_config, "LightDM");
+
+    config_set_instance (config);
+    g_object_unref (config);
+
+    /* Seats and servers pick up the changes, running sessions are left alone */
+    for (GList *link = display_manager_get_seats (display_manager); link; link = link->next)
+        reload_seat (SEAT (link->data), old_config);
+    reload_xdmcp_server (old_config);
+    reload_vnc_server (old_config);
+
+    g_object_unref (old_config);
+}
+
 static void
 service_ready_cb (DisplayManagerService *service)
 {
@@ -389,7 +852,7 @@ add_login1_seat (Login1Seat *login1_seat)
     g_debug ("New seat added from logind: %s", seat_name);
     gboolean is_seat0 = strcmp (seat_name, "seat0") == 0;
 
-    GList *config_sections = get_config_sections (seat_name);
+    GList *config_sections = get_config_sections (config_get_instance (), seat_name);
     g_auto(GStrv) types = NULL;
     for (GList *link = g_list_last (config_sections); link; link = link->prev)
     {
@@ -536,13 +999,73 @@ login1_service_seat_removed_cb (Login1Service *service, Login1Seat *login1_seat)
     remove_login1_seat (login1_seat);
 }
 
+static void
+start_seats (gpointer data)
+{
+    /* Connect to logind */
+    if (login1_service_connect (login1_service_get_instance ()))
+    {
+        /* Load dynamic seats from logind */
+        g_debug ("Monitoring logind for seats");
+
+        if (config_get_boolean (config_get_instance (), "LightDM", "start-default-seat"))
+        {
+            g_signal_connect (login1_service_get_instance (), LOGIN1_SERVICE_SIGNAL_SEAT_ADDED, G_CALLBACK (login1_service_seat_added_cb), NULL);
+            g_signal_connect (login1_service_get_instance (), LOGIN1_SERVICE_SIGNAL_SEAT_REMOVED, G_CALLBACK (login1_service_seat_removed_cb), NULL);
+
+            for (GList *link = login1_service_get_seats (login1_service_get_instance ()); link; link = link->next)
+            {
+                Login1Seat *login1_seat = link->data;
+                if (!login1_add_seat (login1_seat))
+                {
+                    exit_code = EXIT_FAILURE;
+                    display_manager_stop (display_manager);
+                    return;
+                }
+            }
+        }
+    }
+    else
+    {
+        if (config_get_boolean (config_get_instance (), "LightDM", "start-default-seat"))
+        {
+            g_debug ("Adding default seat");
+
+            g_auto(GStrv) types = config_get_string_list (config_get_instance (), "Seat:*", "type");
+            g_autoptr(Seat) seat = NULL;
+            for (gchar **type = types; type && *type; type++)
+            {
+                seat = create_seat (*type, "seat0");
+                if (seat)
+                    break;
+            }
+            if (seat)
+            {
+                set_seat_properties (seat, NULL);
+                seat_set_property (seat, "exit-on-failure", "true");
+                if (!display_manager_add_seat (display_manager, seat))
+                {
+                    exit_code = EXIT_FAILURE;
+                    display_manager_stop (display_manager);
+                }
+            }
+            else
+            {
+                g_warning ("Failed to create default seat");
+                exit_code = EXIT_FAILURE;
+                display_manager_stop (display_manager);
+            }
+        }
+    }
+}
+
 int
 main (int argc, char **argv)
 {
     /* Disable the SIGPIPE handler - this is a stupid Unix hangover behaviour.
      * We will handle pipes / sockets being closed instead of having the whole daemon be killed...
      * http://stackoverflow.com/questions/8369506/why-does-sigpipe-exist
-     * Similar case for SIGHUP.
+     * Similar case for SIGHUP, until the daemon sets it up to reload the configuration.
      */
     struct sigaction action;
     action.sa_handler = SIG_IGN;
@@ -741,9 +1264,9 @@ main (int argc, char **argv)
     /* Load config file(s) */
     if (!config_load_from_standard_locations (config_get_instance (), config_path, &messages))
         exit (EXIT_FAILURE);
-    g_free (config_path);
 
     /* Set default values */
+    set_config_defaults (config_get_instance ());
     if (!config_has_key (config_get_instance (), "LightDM", "start-default-seat"))
         config_set_boolean (config_get_instance (), "LightDM", "start-default-seat", TRUE);
     if (!config_has_key (config_get_instance (), "LightDM", "minimum-vt"))
@@ -758,38 +1281,8 @@ main (int argc, char **argv)
         config_set_boolean (config_get_instance (), "LightDM", "backup-logs", TRUE);
     if (!config_has_key (config_get_instance (), "LightDM", "dbus-service"))
         config_set_boolean (config_get_instance (), "LightDM", "dbus-service", TRUE);
-    if (!config_has_key (config_get_instance (), "Seat:*", "type"))
-        config_set_string (config_get_instance (), "Seat:*", "type", "local");
-    if (!config_has_key (config_get_instance (), "Seat:*", "pam-service"))
-        config_set_string (config_get_instance (), "Seat:*", "pam-service", "lightdm");
-    if (!config_has_key (config_get_instance (), "Seat:*", "pam-autologin-service"))
-        config_set_string (config_get_instance (), "Seat:*", "pam-autologin-service", "lightdm-autologin");
-    if (!config_has_key (config_get_instance (), "Seat:*", "pam-greeter-service"))
-        config_set_string (config_get_instance (), "Seat:*", "pam-greeter-service", "lightdm-greeter");
-    if (!config_has_key (config_get_instance (), "Seat:*", "xserver-command"))
-        config_set_string (config_get_instance (), "Seat:*", "xserver-command", "X");
-    if (!config_has_key (config_get_instance (), "Seat:*", "xmir-command"))
-        config_set_string (config_get_instance (), "Seat:*", "xmir-command", "Xmir");
-    if (!config_has_key (config_get_instance (), "Seat:*", "xserver-share"))
-        config_set_boolean (config_get_instance (), "Seat:*", "xserver-share", TRUE);
-    if (!config_has_key (config_get_instance (), "Seat:*", "unity-compositor-command"))
-        config_set_string (config_get_instance (), "Seat:*", "unity-compositor-command", "unity-system-compositor");
-    if (!config_has_key (config_get_instance (), "Seat:*", "start-session"))
-        config_set_boolean (config_get_instance (), "Seat:*", "start-session", TRUE);
-    if (!config_has_key (config_get_instance (), "Seat:*", "allow-user-switching"))
-        config_set_boolean (config_get_instance (), "Seat:*", "allow-user-switching", TRUE);
-    if (!config_has_key (config_get_instance (), "Seat:*", "allow-guest"))
-        config_set_boolean (config_get_instance (), "Seat:*", "allow-guest", TRUE);
-    if (!config_has_key (config_get_instance (), "Seat:*", "greeter-allow-guest"))
-        config_set_boolean (config_get_instance (), "Seat:*", "greeter-allow-guest", TRUE);
-    if (!config_has_key (config_get_instance (), "Seat:*", "greeter-show-remote-login"))
-        config_set_boolean (config_get_instance (), "Seat:*", "greeter-show-remote-login", TRUE);
-    if (!config_has_key (config_get_instance (), "Seat:*", "greeter-session"))
-        config_set_string (config_get_instance (), "Seat:*", "greeter-session", DEFAULT_GREETER_SESSION);
-    if (!config_has_key (config_get_instance (), "Seat:*", "user-session"))
-        config_set_string (config_get_instance (), "Seat:*", "user-session", DEFAULT_USER_SESSION);
-    if (!config_has_key (config_get_instance (), "Seat:*", "session-wrapper"))
-        config_set_string (config_get_instance (), "Seat:*", "session-wrapper", "lightdm-session");
+    if (!config_has_key (config_get_instance (), "LightDM", "watchdog-threshold"))
+        config_set_integer (config_get_instance (), "LightDM", "watchdog-threshold", 500);
     if (!config_has_key (config_get_instance (), "LightDM", "log-directory"))
         config_set_string (config_get_instance (), "LightDM", "log-directory", default_log_dir);
     if (!config_has_key (config_get_instance (), "LightDM", "run-directory"))
@@ -812,8 +1305,6 @@ main (int argc, char **argv)
         g_autofree gchar *value = g_strjoinv (":", (gchar **) dirs->pdata);
         config_set_string (config_get_instance (), "LightDM", "greeters-directory", value);
     }
-    if (!config_has_key (config_get_instance (), "XDMCPServer", "hostname"))
-        config_set_string (config_get_instance (), "XDMCPServer", "hostname", g_get_host_name ());
 
     /* Override defaults */
     if (log_dir)
@@ -839,6 +1330,9 @@ main (int argc, char **argv)
 
     log_init ();
 
+    /* Report anything that blocks the main loop */
+    main_loop_watchdog_start (MAX (config_get_integer (config_get_instance (), "LightDM", "watchdog-threshold"), 0));
+
     /* Show queued messages once logging is complete */
     for (GList *link = messages; link; link = link->next)
         g_debug ("%s", (gchar *)link->data);
@@ -849,6 +1343,9 @@ main (int argc, char **argv)
     if (getenv ("DISPLAY"))
         g_debug ("Using Xephyr for X servers");
 
+    /* Find out if Plymouth is running while the rest of the daemon starts */
+    plymouth_connect ();
+
     display_manager = display_manager_new ();
     g_signal_connect (display_manager, DISPLAY_MANAGER_SIGNAL_STOPPED, G_CALLBACK (display_manager_stopped_cb), NULL);
     g_signal_connect (display_manager, DISPLAY_MANAGER_SIGNAL_SEAT_REMOVED, G_CALLBACK (display_manager_seat_removed_cb), NULL);
@@ -857,6 +1354,8 @@ main (int argc, char **argv)
     {
         display_manager_service = display_manager_service_new (display_manager);
         g_signal_connect (display_manager_service, DISPLAY_MANAGER_SERVICE_SIGNAL_ADD_XLOCAL_SEAT, G_CALLBACK (service_add_xlocal_seat_cb), NULL);
+        g_signal_connect (display_manager_service, DISPLAY_MANAGER_SERVICE_SIGNAL_GET_XDMCP_SESSIONS_BY_STATE, G_CALLBACK (service_get_xdmcp_sessions_by_state_cb), NULL);
+        g_signal_connect (display_manager_service, DISPLAY_MANAGER_SERVICE_SIGNAL_GET_VNC_STATISTICS, G_CALLBACK (service_get_vnc_statistics_cb), NULL);
         g_signal_connect (display_manager_service, DISPLAY_MANAGER_SERVICE_SIGNAL_READY, G_CALLBACK (service_ready_cb), NULL);
         g_signal_connect (display_manager_service, DISPLAY_MANAGER_SERVICE_SIGNAL_NAME_LOST, G_CALLBACK (service_name_lost_cb), NULL);
         display_manager_service_start (display_manager_service);
@@ -866,61 +1365,42 @@ main (int argc, char **argv)
 
     shared_data_manager_start (shared_data_manager_get_instance ());
 
-    /* Connect to logind */
-    if (login1_service_connect (login1_service_get_instance ()))
+    /* Find out what the configured X servers support before they are started */
+    g_auto(GStrv) groups = config_get_groups (config_get_instance ());
+    for (gchar **group = groups; group && *group; group++)
     {
-        /* Load dynamic seats from logind */
-        g_debug ("Monitoring logind for seats");
-
-        if (config_get_boolean (config_get_instance (), "LightDM", "start-default-seat"))
-        {
-            g_signal_connect (login1_service_get_instance (), LOGIN1_SERVICE_SIGNAL_SEAT_ADDED, G_CALLBACK (login1_service_seat_added_cb), NULL);
-            g_signal_connect (login1_service_get_instance (), LOGIN1_SERVICE_SIGNAL_SEAT_REMOVED, G_CALLBACK (login1_service_seat_removed_cb), NULL);
-
-            for (GList *link = login1_service_get_seats (login1_service_get_instance ()); link; link = link->next)
-            {
-                Login1Seat *login1_seat = link->data;
-                if (!login1_add_seat (login1_seat))
-                    return EXIT_FAILURE;
-            }
-        }
+        if (!g_str_has_prefix (*group, "Seat:") || !config_has_key (config_get_instance (), *group, "xserver-command"))
+            continue;
+        g_autofree gchar *xserver_command = config_get_string (config_get_instance (), *group, "xserver-command");
+        x_server_local_probe_command (xserver_command);
     }
-    else
-    {
-        if (config_get_boolean (config_get_instance (), "LightDM", "start-default-seat"))
-        {
-            g_debug ("Adding default seat");
 
-            g_auto(GStrv) types = config_get_string_list (config_get_instance (), "Seat:*", "type");
-            g_autoptr(Seat) seat = NULL;
-            for (gchar **type = types; type && *type; type++)
-            {
-                seat = create_seat (*type, "seat0");
-                if (seat)
-                    break;
-            }
-            if (seat)
-            {
-                set_seat_properties (seat, NULL);
-                seat_set_property (seat, "exit-on-failure", "true");
-                if (!display_manager_add_seat (display_manager, seat))
-                    return EXIT_FAILURE;
-            }
-            else
-            {
-                g_warning ("Failed to create default seat");
-                return EXIT_FAILURE;
-            }
-        }
-    }
+    /* Seats are started once it is known if they need to take over from Plymouth */
+    plymouth_wait_for_state (start_seats, NULL);
 
     g_main_loop_run (loop);
 
+    /* Stop measuring the main loop */
+    main_loop_watchdog_stop ();
+
     /* Clean up shared data manager */
     shared_data_manager_cleanup ();
 
-    /* Clean up user list */
+    /* Clean up X server capabilities */
+    x_server_capabilities_cleanup ();
+
+    /* Remove guest accounts that were never used */
+    guest_account_cleanup_pool ();
+
+    /* Write out any login records still waiting */
+    accounting_flush ();
+
+    /* Close connection to Plymouth */
+    plymouth_cleanup ();
+
+    /* Clean up user and session lists */
     common_user_list_cleanup ();
+    common_session_list_cleanup ();
 
     /* Remove D-Bus interface */
     g_clear_object (&display_manager_service);
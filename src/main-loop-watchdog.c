@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2010-2011 Robert Ancell.
+ * Author: Robert Ancell <robert.ancell@canonical.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#if HAVE_EXECINFO_H
+#include <execinfo.h>
+#endif
+
+#include "main-loop-watchdog.h"
+
+/* Older C libraries only provide the union member */
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+/* Dispatch times are counted in power of two buckets, from under 64us to over 8s */
+#define FIRST_BUCKET_SHIFT 6
+#define N_BUCKETS 18
+
+/* Maximum number of stack frames to report */
+#define MAX_FRAMES 32
+
+/* TRUE if measuring the main loop */
+static gboolean running = FALSE;
+
+/* Milliseconds a dispatch can take before it is reported, or 0 to not report */
+static guint threshold_ms = 0;
+
+/* Time the current dispatch started or 0 if waiting in poll */
+static volatile gint64 dispatch_start_time = 0;
+
+/* Collected statistics */
+static guint64 histogram[N_BUCKETS];
+static guint64 n_stalls = 0;
+static gint64 longest_dispatch = 0;
+
+/* State captured by the timer signal while the main loop is blocked */
+static volatile sig_atomic_t stall_captured = FALSE;
+static void *stall_frames[MAX_FRAMES];
+static int n_stall_frames = 0;
+static gchar stall_source_name[128];
+static guint stall_source_id = 0;
+static const GSourceFuncs *stall_source_funcs = NULL;
+
+static struct sigaction old_alarm_action;
+
+/* Timer that signals the main loop thread when a dispatch passes the threshold */
+static timer_t stall_timer;
+
+static void
+set_timer (guint ms)
+{
+    struct itimerspec timer = { { 0, 0 }, { ms / 1000, (ms % 1000) * 1000000 } };
+    timer_settime (stall_timer, 0, &timer, NULL);
+}
+
+static void
+alarm_cb (int signum)
+{
+    /* Only async-signal-safe work here, the report is logged when the dispatch completes */
+    if (dispatch_start_time == 0 || stall_captured)
+        return;
+
+#if HAVE_EXECINFO_H
+    n_stall_frames = backtrace (stall_frames, MAX_FRAMES);
+#endif
+
+    /* Read the source fields directly, the accessors take the context lock */
+    GSource *source = g_main_current_source ();
+    stall_source_id = source ? source->source_id : 0;
+    stall_source_funcs = source ? source->source_funcs : NULL;
+    gsize i = 0;
+    if (source && source->name)
+        for (; source->name[i] != '\0' && i < sizeof (stall_source_name) - 1; i++)
+            stall_source_name[i] = source->name[i];
+    stall_source_name[i] = '\0';
+
+    stall_captured = TRUE;
+}
+
+static const gchar *
+get_source_type (const GSourceFuncs *funcs)
+{
+    if (funcs == &g_timeout_funcs)
+        return "timeout";
+    if (funcs == &g_idle_funcs)
+        return "idle";
+    if (funcs == &g_io_watch_funcs)
+        return "I/O watch";
+    if (funcs == &g_child_watch_funcs)
+        return "child watch";
+    return "custom";
+}
+
+static void
+report_stall (gint64 duration)
+{
+    g_autoptr(GString) report = g_string_new ("");
+    g_string_append_printf (report, "Main loop blocked for %" G_GINT64_FORMAT "ms", duration / 1000);
+
+    /* The timer may not have fired if the dispatch only just passed the threshold */
+    if (!stall_captured)
+    {
+        g_warning ("%s", report->str);
+        return;
+    }
+
+    if (stall_source_funcs)
+    {
+        g_string_append_printf (report, " dispatching %s source %u", get_source_type (stall_source_funcs), stall_source_id);
+        if (stall_source_name[0] != '\0')
+            g_string_append_printf (report, " (%s)", stall_source_name);
+    }
+    else
+        g_string_append (report, " outside of a source dispatch");
+
+#if HAVE_EXECINFO_H
+    /* Skip the signal handler and the signal trampoline */
+    char **symbols = backtrace_symbols (stall_frames, n_stall_frames);
+    for (int i = 2; symbols && i < n_stall_frames; i++)
+        g_string_append_printf (report, "\n  #%d %s", i - 2, symbols[i]);
+    free (symbols);
+#endif
+
+    g_warning ("%s", report->str);
+}
+
+static guint
+get_bucket (gint64 duration)
+{
+    guint bucket = 0;
+    while (bucket < N_BUCKETS - 1 && duration >= (G_GINT64_CONSTANT (1) << (FIRST_BUCKET_SHIFT + bucket)))
+        bucket++;
+    return bucket;
+}
+
+static void
+dispatch_complete (void)
+{
+    if (dispatch_start_time == 0)
+        return;
+
+    if (threshold_ms > 0)
+        set_timer (0);
+    gint64 duration = g_get_monotonic_time () - dispatch_start_time;
+    dispatch_start_time = 0;
+
+    histogram[get_bucket (duration)]++;
+    if (duration > longest_dispatch)
+        longest_dispatch = duration;
+
+    if (threshold_ms > 0 && duration >= (gint64) threshold_ms * 1000)
+    {
+        n_stalls++;
+        report_stall (duration);
+    }
+    stall_captured = FALSE;
+}
+
+/* Everything between two polls is the time spent dispatching sources */
+static gint
+watchdog_poll (GPollFD *fds, guint nfds, gint timeout)
+{
+    dispatch_complete ();
+
+    gint result = g_poll (fds, nfds, timeout);
+
+    dispatch_start_time = g_get_monotonic_time ();
+    if (threshold_ms > 0)
+        set_timer (threshold_ms);
+
+    return result;
+}
+
+void
+main_loop_watchdog_start (guint threshold)
+{
+    g_return_if_fail (!running);
+
+    running = TRUE;
+    threshold_ms = threshold;
+
+    if (threshold_ms > 0)
+    {
+#if HAVE_EXECINFO_H
+        /* The first backtrace () loads the unwinder, which isn't safe to do from a signal handler */
+        void *frames[1];
+        backtrace (frames, 1);
+#endif
+
+        struct sigaction action;
+        action.sa_handler = alarm_cb;
+        sigemptyset (&action.sa_mask);
+        action.sa_flags = SA_RESTART;
+        sigaction (SIGALRM, &action, &old_alarm_action);
+
+        /* A process-wide timer signal can be handled by any thread, and the handler
+         * needs to run on this one to see the main loop's stack and current source */
+        struct sigevent event;
+        memset (&event, 0, sizeof (event));
+        event.sigev_notify = SIGEV_THREAD_ID;
+        event.sigev_signo = SIGALRM;
+        event.sigev_notify_thread_id = syscall (SYS_gettid);
+        if (timer_create (CLOCK_MONOTONIC, &event, &stall_timer) < 0)
+        {
+            g_warning ("Failed to create main loop watchdog timer: %s", strerror (errno));
+            sigaction (SIGALRM, &old_alarm_action, NULL);
+            threshold_ms = 0;
+        }
+    }
+
+    g_main_context_set_poll_func (NULL, watchdog_poll);
+}
+
+GVariant *
+main_loop_watchdog_get_statistics (void)
+{
+    GVariantBuilder builder;
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ut)"));
+    for (guint i = 0; i < N_BUCKETS; i++)
+    {
+        /* Each bucket is labelled with its upper bound in microseconds */
+        guint32 limit = i < N_BUCKETS - 1 ? 1u << (FIRST_BUCKET_SHIFT + i) : G_MAXUINT32;
+        g_variant_builder_add (&builder, "(ut)", limit, histogram[i]);
+    }
+
+    return g_variant_new ("(a(ut)tu)", &builder, n_stalls, (guint32) MIN (longest_dispatch, G_MAXUINT32));
+}
+
+void
+main_loop_watchdog_stop (void)
+{
+    if (!running)
+        return;
+
+    g_main_context_set_poll_func (NULL, NULL);
+    if (threshold_ms > 0)
+    {
+        timer_delete (stall_timer);
+        sigaction (SIGALRM, &old_alarm_action, NULL);
+    }
+    dispatch_start_time = 0;
+    running = FALSE;
+}
@@ -0,0 +1,27 @@
+/*
+ * Copyright (C) 2010-2011 Robert Ancell.
+ * Author: Robert Ancell <robert.ancell@canonical.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#ifndef MAIN_LOOP_WATCHDOG_H_
+#define MAIN_LOOP_WATCHDOG_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+void main_loop_watchdog_start (guint threshold);
+
+GVariant *main_loop_watchdog_get_statistics (void);
+
+void main_loop_watchdog_stop (void);
+
+G_END_DECLS
+
+#endif /* MAIN_LOOP_WATCHDOG_H_ */
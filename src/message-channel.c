@@ -0,0 +1,382 @@
+/*
+ * Copyright (C) 2010-2011 Robert Ancell.
+ * Author: Robert Ancell <robert.ancell@canonical.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "message-channel.h"
+
+enum {
+    MESSAGE,
+    CLOSED,
+    LAST_SIGNAL
+};
+static guint signals[LAST_SIGNAL] = { 0 };
+
+/* Amount to read from the file descriptor at a time, and most to read before letting other sources run */
+#define READ_CHUNK_SIZE 4096
+#define MAX_READ_CHUNKS 64
+
+/* Default amount of data to hold for a peer that isn't reading */
+#define DEFAULT_MAX_QUEUED (1024 * 1024)
+
+struct MessageChannelPrivate
+{
+    /* Header before each message */
+    MessageChannelHeader header;
+    gsize header_size;
+
+    /* Largest message accepted, including the header */
+    gsize max_message_length;
+
+    /* Most data to hold waiting to be written */
+    gsize max_queued;
+
+    /* File descriptor to write to and its watch when data is waiting */
+    int to_fd;
+    GIOChannel *to_channel;
+    guint to_watch;
+    GByteArray *write_buffer;
+
+    /* File descriptor to read from and the data not yet handled */
+    int from_fd;
+    GIOChannel *from_channel;
+    guint from_watch;
+    GByteArray *read_buffer;
+
+    /* TRUE when the other end has gone away */
+    gboolean closed;
+};
+
+G_DEFINE_TYPE (MessageChannel, message_channel, G_TYPE_OBJECT)
+
+static gboolean read_cb (GIOChannel *source, GIOCondition condition, gpointer data);
+
+static void
+set_non_blocking (int fd)
+{
+    int flags = fcntl (fd, F_GETFL);
+    if (flags >= 0)
+        fcntl (fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+MessageChannel *
+message_channel_new (int to_fd, int from_fd, MessageChannelHeader header)
+{
+    MessageChannel *channel = g_object_new (MESSAGE_CHANNEL_TYPE, NULL);
+
+    channel->priv->header = header;
+    channel->priv->header_size = header == MESSAGE_CHANNEL_HEADER_16 ? 4 : 8;
+    channel->priv->max_message_length = header == MESSAGE_CHANNEL_HEADER_16 ? 4 + G_MAXUINT16 : 16 * 1024 * 1024;
+
+    channel->priv->to_fd = to_fd;
+    if (to_fd >= 0)
+    {
+        set_non_blocking (to_fd);
+        channel->priv->to_channel = g_io_channel_unix_new (to_fd);
+    }
+
+    channel->priv->from_fd = from_fd;
+    if (from_fd >= 0)
+    {
+        set_non_blocking (from_fd);
+        channel->priv->from_channel = g_io_channel_unix_new (from_fd);
+        channel->priv->from_watch = g_io_add_watch (channel->priv->from_channel, G_IO_IN | G_IO_HUP, read_cb, channel);
+    }
+
+    return channel;
+}
+
+void
+message_channel_set_max_message_length (MessageChannel *channel, gsize max_message_length)
+{
+    g_return_if_fail (channel != NULL);
+    channel->priv->max_message_length = max_message_length;
+}
+
+void
+message_channel_set_max_queued (MessageChannel *channel, gsize max_queued)
+{
+    g_return_if_fail (channel != NULL);
+    channel->priv->max_queued = max_queued;
+}
+
+static void
+close_channel (MessageChannel *channel)
+{
+    if (channel->priv->closed)
+        return;
+
+    channel->priv->closed = TRUE;
+    if (channel->priv->to_watch)
+        g_source_remove (channel->priv->to_watch);
+    channel->priv->to_watch = 0;
+    if (channel->priv->from_watch)
+        g_source_remove (channel->priv->from_watch);
+    channel->priv->from_watch = 0;
+
+    g_signal_emit (channel, signals[CLOSED], 0);
+}
+
+/* Write as much as possible without blocking, returns FALSE on error */
+static gboolean
+write_data (MessageChannel *channel, const guint8 *data, gsize data_length, gsize *n_written)
+{
+    *n_written = 0;
+    while (*n_written < data_length)
+    {
+        ssize_t n = write (channel->priv->to_fd, data + *n_written, data_length - *n_written);
+        if (n >= 0)
+            *n_written += n;
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return TRUE;
+        else if (errno != EINTR)
+        {
+            g_warning ("Failed to write message: %s", strerror (errno));
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static gboolean
+write_cb (GIOChannel *source, GIOCondition condition, gpointer data)
+{
+    MessageChannel *channel = data;
+
+    gsize n_written;
+    gboolean result = write_data (channel, channel->priv->write_buffer->data, channel->priv->write_buffer->len, &n_written);
+    g_byte_array_remove_range (channel->priv->write_buffer, 0, n_written);
+    if (result && channel->priv->write_buffer->len > 0)
+        return G_SOURCE_CONTINUE;
+
+    channel->priv->to_watch = 0;
+    if (!result)
+        close_channel (channel);
+
+    return G_SOURCE_REMOVE;
+}
+
+gboolean
+message_channel_write (MessageChannel *channel, const guint8 *message, gsize message_length)
+{
+    g_return_val_if_fail (channel != NULL, FALSE);
+    g_return_val_if_fail (channel->priv->to_fd >= 0, FALSE);
+
+    if (channel->priv->closed)
+        return FALSE;
+
+    /* Stop once the other end stops reading, rather than growing forever. A missing message would
+     * leave the other end out of step, so close the channel instead of dropping it */
+    if (channel->priv->write_buffer->len > 0 && channel->priv->write_buffer->len + message_length > channel->priv->max_queued)
+    {
+        g_warning ("Closing channel, %u octets waiting to be written and %zu more to send", channel->priv->write_buffer->len, message_length);
+        close_channel (channel);
+        return FALSE;
+    }
+
+    /* Messages go straight out unless earlier ones are still waiting */
+    gsize n_written = 0;
+    if (channel->priv->write_buffer->len == 0 && !write_data (channel, message, message_length, &n_written))
+    {
+        close_channel (channel);
+        return FALSE;
+    }
+
+    if (n_written < message_length)
+    {
+        g_byte_array_append (channel->priv->write_buffer, message + n_written, message_length - n_written);
+        if (channel->priv->to_watch == 0)
+            channel->priv->to_watch = g_io_add_watch (channel->priv->to_channel, G_IO_OUT, write_cb, channel);
+    }
+
+    return TRUE;
+}
+
+static void
+write_field (MessageChannel *channel, guint8 *buffer, guint32 value)
+{
+    if (channel->priv->header == MESSAGE_CHANNEL_HEADER_16)
+    {
+        buffer[0] = value >> 8;
+        buffer[1] = value & 0xFF;
+    }
+    else
+    {
+        buffer[0] = value >> 24;
+        buffer[1] = (value >> 16) & 0xFF;
+        buffer[2] = (value >> 8) & 0xFF;
+        buffer[3] = value & 0xFF;
+    }
+}
+
+static guint32
+read_field (MessageChannel *channel, const guint8 *buffer)
+{
+    if (channel->priv->header == MESSAGE_CHANNEL_HEADER_16)
+        return buffer[0] << 8 | buffer[1];
+    else
+        return (guint32) buffer[0] << 24 | buffer[1] << 16 | buffer[2] << 8 | buffer[3];
+}
+
+gboolean
+message_channel_send (MessageChannel *channel, guint32 id, const guint8 *payload, gsize payload_length)
+{
+    g_return_val_if_fail (channel != NULL, FALSE);
+    g_return_val_if_fail (channel->priv->header_size + payload_length <= channel->priv->max_message_length, FALSE);
+
+    gsize field_size = channel->priv->header_size / 2;
+    gsize message_length = channel->priv->header_size + payload_length;
+    g_autofree guint8 *message = g_malloc (message_length);
+    write_field (channel, message, id);
+    write_field (channel, message + field_size, payload_length);
+    if (payload_length > 0)
+        memcpy (message + channel->priv->header_size, payload, payload_length);
+
+    return message_channel_write (channel, message, message_length);
+}
+
+gsize
+message_channel_get_queued (MessageChannel *channel)
+{
+    g_return_val_if_fail (channel != NULL, 0);
+    return channel->priv->write_buffer->len;
+}
+
+/* Handle every complete message that has been read, returns FALSE if the data is invalid */
+static gboolean
+dispatch_messages (MessageChannel *channel)
+{
+    GByteArray *buffer = channel->priv->read_buffer;
+    gsize field_size = channel->priv->header_size / 2;
+    gsize offset = 0;
+    gboolean result = TRUE;
+    while (!channel->priv->closed && buffer->len - offset >= channel->priv->header_size)
+    {
+        const guint8 *header = buffer->data + offset;
+        guint32 id = read_field (channel, header);
+        guint32 payload_length = read_field (channel, header + field_size);
+        if (payload_length > channel->priv->max_message_length - channel->priv->header_size)
+        {
+            g_warning ("Got message of %u octets, more than the maximum of %zu", payload_length, channel->priv->max_message_length);
+            result = FALSE;
+            break;
+        }
+        if (buffer->len - offset < channel->priv->header_size + payload_length)
+            break;
+
+        g_signal_emit (channel, signals[MESSAGE], 0, id, header + channel->priv->header_size, payload_length);
+        offset += channel->priv->header_size + payload_length;
+    }
+    g_byte_array_remove_range (buffer, 0, offset);
+
+    return result;
+}
+
+static gboolean
+read_cb (GIOChannel *source, GIOCondition condition, gpointer data)
+{
+    MessageChannel *channel = data;
+
+    /* Read everything available so queued messages are handled in one wakeup */
+    gboolean eof = FALSE;
+    GByteArray *buffer = channel->priv->read_buffer;
+    for (int i = 0; i < MAX_READ_CHUNKS; i++)
+    {
+        gsize n_used = buffer->len;
+        g_byte_array_set_size (buffer, n_used + READ_CHUNK_SIZE);
+        ssize_t n_read = read (channel->priv->from_fd, buffer->data + n_used, READ_CHUNK_SIZE);
+        g_byte_array_set_size (buffer, n_used + MAX (n_read, 0));
+
+        if (n_read > 0)
+            continue;
+        if (n_read == 0)
+            eof = TRUE;
+        else if (errno == EINTR)
+            continue;
+        else if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            g_warning ("Failed to read message: %s", strerror (errno));
+            eof = TRUE;
+        }
+        break;
+    }
+
+    /* Handlers may drop the last reference */
+    g_autoptr(MessageChannel) ref = g_object_ref (channel);
+    if (!dispatch_messages (channel) || eof)
+    {
+        channel->priv->from_watch = 0;
+        close_channel (channel);
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+message_channel_init (MessageChannel *channel)
+{
+    channel->priv = G_TYPE_INSTANCE_GET_PRIVATE (channel, MESSAGE_CHANNEL_TYPE, MessageChannelPrivate);
+    channel->priv->max_queued = DEFAULT_MAX_QUEUED;
+    channel->priv->to_fd = -1;
+    channel->priv->from_fd = -1;
+    channel->priv->write_buffer = g_byte_array_new ();
+    channel->priv->read_buffer = g_byte_array_new ();
+}
+
+static void
+message_channel_finalize (GObject *object)
+{
+    MessageChannel *self = MESSAGE_CHANNEL (object);
+
+    if (self->priv->to_watch)
+        g_source_remove (self->priv->to_watch);
+    if (self->priv->from_watch)
+        g_source_remove (self->priv->from_watch);
+    g_clear_pointer (&self->priv->to_channel, g_io_channel_unref);
+    g_clear_pointer (&self->priv->from_channel, g_io_channel_unref);
+    g_byte_array_unref (self->priv->write_buffer);
+    g_byte_array_unref (self->priv->read_buffer);
+
+    G_OBJECT_CLASS (message_channel_parent_class)->finalize (object);
+}
+
+static void
+message_channel_class_init (MessageChannelClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->finalize = message_channel_finalize;
+
+    g_type_class_add_private (klass, sizeof (MessageChannelPrivate));
+
+    signals[MESSAGE] =
+        g_signal_new (MESSAGE_CHANNEL_SIGNAL_MESSAGE,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (MessageChannelClass, message),
+                      NULL, NULL,
+                      NULL,
+                      G_TYPE_NONE, 3, G_TYPE_UINT, G_TYPE_POINTER, G_TYPE_UINT);
+
+    signals[CLOSED] =
+        g_signal_new (MESSAGE_CHANNEL_SIGNAL_CLOSED,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (MessageChannelClass, closed),
+                      NULL, NULL,
+                      NULL,
+                      G_TYPE_NONE, 0);
+}
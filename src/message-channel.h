@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2010-2011 Robert Ancell.
+ * Author: Robert Ancell <robert.ancell@canonical.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#ifndef MESSAGE_CHANNEL_H_
+#define MESSAGE_CHANNEL_H_
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define MESSAGE_CHANNEL_TYPE (message_channel_get_type())
+#define MESSAGE_CHANNEL(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), MESSAGE_CHANNEL_TYPE, MessageChannel))
+
+#define MESSAGE_CHANNEL_SIGNAL_MESSAGE "message"
+#define MESSAGE_CHANNEL_SIGNAL_CLOSED  "closed"
+
+/* Layout of the header before each message, both are an ID then a payload length in network byte order */
+typedef enum
+{
+    /* 16 bit fields, used by Unity System Compositor */
+    MESSAGE_CHANNEL_HEADER_16,
+    /* 32 bit fields, used by the greeter protocol */
+    MESSAGE_CHANNEL_HEADER_32
+} MessageChannelHeader;
+
+typedef struct MessageChannelPrivate MessageChannelPrivate;
+
+typedef struct
+{
+    GObject                parent_instance;
+    MessageChannelPrivate *priv;
+} MessageChannel;
+
+typedef struct
+{
+    GObjectClass parent_class;
+    void (*message)(MessageChannel *channel, guint id, const guint8 *payload, guint payload_length);
+    void (*closed)(MessageChannel *channel);
+} MessageChannelClass;
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (MessageChannel, g_object_unref)
+
+GType message_channel_get_type (void);
+
+MessageChannel *message_channel_new (int to_fd, int from_fd, MessageChannelHeader header);
+
+void message_channel_set_max_message_length (MessageChannel *channel, gsize max_message_length);
+
+void message_channel_set_max_queued (MessageChannel *channel, gsize max_queued);
+
+gboolean message_channel_write (MessageChannel *channel, const guint8 *message, gsize message_length);
+
+gboolean message_channel_send (MessageChannel *channel, guint32 id, const guint8 *payload, gsize payload_length);
+
+gsize message_channel_get_queued (MessageChannel *channel);
+
+G_END_DECLS
+
+#endif /* MESSAGE_CHANNEL_H_ */
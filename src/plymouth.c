@@ -9,50 +9,304 @@
  * license.
  */
 
-#include <stdlib.h>
-#include <sys/wait.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include "plymouth.h"
 
-static gboolean have_pinged = FALSE;
-static gboolean have_checked_active_vt = FALSE;
+/* Abstract socket the Plymouth daemon listens on */
+#define PLYMOUTH_SOCKET_PATH "/org/freedesktop/plymouthd"
+
+/* Protocol values from ply-boot-protocol.h */
+#define PLYMOUTH_REQUEST_PING          'P'
+#define PLYMOUTH_REQUEST_HAS_ACTIVE_VT 'V'
+#define PLYMOUTH_REQUEST_DEACTIVATE    'D'
+#define PLYMOUTH_REQUEST_QUIT          'Q'
+#define PLYMOUTH_ARGUMENT              '\002'
+#define PLYMOUTH_RESPONSE_ACK          '\006'
+
+/* Seconds to wait for Plymouth to answer before giving up on it */
+#define PLYMOUTH_RESPONSE_TIMEOUT 5
+
+typedef struct
+{
+    PlymouthCallback callback;
+    gpointer data;
+} StateWaiter;
+
+typedef struct
+{
+    gchar request;
+    PlymouthCallback callback;
+    gpointer data;
+} PendingRequest;
+
+/* Connection to the Plymouth daemon */
+static int plymouth_fd = -1;
+static GIOChannel *plymouth_channel = NULL;
+static guint plymouth_watch = 0;
+
+/* Requests sent that are waiting on a response, in order */
+static GQueue pending_requests = G_QUEUE_INIT;
+static guint response_timeout = 0;
+
+/* Number of state queries still to be answered */
+static guint n_state_queries = 0;
+
+/* TRUE once we know if Plymouth is running */
+static gboolean have_state = FALSE;
+static GList *state_waiters = NULL;
 
 static gboolean is_running = FALSE;
 static gboolean is_active = FALSE;
 static gboolean has_active_vt = FALSE;
 
+static void
+disconnect (void)
+{
+    if (response_timeout)
+        g_source_remove (response_timeout);
+    response_timeout = 0;
+    if (plymouth_watch)
+        g_source_remove (plymouth_watch);
+    plymouth_watch = 0;
+    g_clear_pointer (&plymouth_channel, g_io_channel_unref);
+    if (plymouth_fd >= 0)
+        close (plymouth_fd);
+    plymouth_fd = -1;
+}
+
+static void
+set_have_state (void)
+{
+    if (have_state)
+        return;
+    have_state = TRUE;
+
+    g_debug ("Plymouth is %s%s", is_running ? "running" : "not running", is_running && has_active_vt ? " on an active VT" : "");
+
+    GList *waiters = state_waiters;
+    state_waiters = NULL;
+    for (GList *link = waiters; link; link = link->next)
+    {
+        StateWaiter *waiter = link->data;
+        waiter->callback (waiter->data);
+    }
+    g_list_free_full (waiters, g_free);
+}
+
+static void
+handle_response (gchar request, gboolean success, PlymouthCallback callback, gpointer data)
+{
+    if (callback)
+        callback (data);
+
+    switch (request)
+    {
+    case PLYMOUTH_REQUEST_PING:
+        is_running = is_active = success;
+        n_state_queries--;
+        break;
+    case PLYMOUTH_REQUEST_HAS_ACTIVE_VT:
+        has_active_vt = success;
+        n_state_queries--;
+        break;
+    default:
+        if (!success)
+            g_debug ("Plymouth failed request '%c'", request);
+        return;
+    }
+
+    if (n_state_queries == 0)
+        set_have_state ();
+}
+
+static void
+complete_request (gboolean success)
+{
+    g_autofree PendingRequest *request = g_queue_pop_head (&pending_requests);
+    handle_response (request->request, success, request->callback, request->data);
+}
+
+static void
+fail_pending_requests (void)
+{
+    while (!g_queue_is_empty (&pending_requests))
+        complete_request (FALSE);
+}
+
+static gboolean
+response_timeout_cb (gpointer data)
+{
+    response_timeout = 0;
+
+    /* A Plymouth that doesn't answer can't be waited on, carry on as if it wasn't there */
+    g_debug ("Plymouth didn't respond in %d seconds, disconnecting", PLYMOUTH_RESPONSE_TIMEOUT);
+    disconnect ();
+    fail_pending_requests ();
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Give Plymouth a fresh timeout to answer the oldest request */
+static void
+reset_response_timeout (void)
+{
+    if (response_timeout)
+        g_source_remove (response_timeout);
+    response_timeout = 0;
+
+    if (!g_queue_is_empty (&pending_requests))
+        response_timeout = g_timeout_add_seconds (PLYMOUTH_RESPONSE_TIMEOUT, response_timeout_cb, NULL);
+}
+
 static gboolean
-plymouth_run_command (const gchar *command, gint *exit_status)
+read_cb (GIOChannel *source, GIOCondition condition, gpointer data)
+{
+    gchar buffer[64];
+    ssize_t n_read = read (plymouth_fd, buffer, sizeof (buffer));
+    if (n_read < 0 && (errno == EAGAIN || errno == EINTR))
+        return G_SOURCE_CONTINUE;
+
+    /* Each request is answered with a single byte */
+    for (ssize_t i = 0; i < n_read && !g_queue_is_empty (&pending_requests); i++)
+        complete_request (buffer[i] == PLYMOUTH_RESPONSE_ACK);
+
+    if (n_read > 0)
+    {
+        reset_response_timeout ();
+        return G_SOURCE_CONTINUE;
+    }
+
+    if (n_read < 0)
+        g_debug ("Error reading from Plymouth: %s", g_strerror (errno));
+    else
+        g_debug ("Plymouth closed connection");
+    plymouth_watch = 0;
+    disconnect ();
+    fail_pending_requests ();
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+send_request (gchar request, const gchar *argument, PlymouthCallback callback, gpointer data)
 {
-    g_autofree gchar *command_line = g_strdup_printf ("plymouth %s", command);
-    g_autoptr(GError) error = NULL;
-    gboolean result = g_spawn_command_line_sync (command_line, NULL, NULL, exit_status, &error);
+    if (plymouth_fd < 0)
+    {
+        handle_response (request, FALSE, callback, data);
+        return;
+    }
 
-    if (error)
-        g_debug ("Could not run %s: %s", command_line, error->message);
+    /* Requests are the command followed by an optional length-prefixed argument */
+    g_autoptr(GByteArray) data = g_byte_array_new ();
+    guint8 header[2] = { request, argument ? PLYMOUTH_ARGUMENT : '\0' };
+    g_byte_array_append (data, header, 2);
+    if (argument)
+    {
+        guint8 length = strlen (argument) + 1;
+        g_byte_array_append (data, &length, 1);
+        g_byte_array_append (data, (const guint8 *) argument, length);
+    }
+
+    if (write (plymouth_fd, data->data, data->len) != (ssize_t) data->len)
+    {
+        g_debug ("Failed to write to Plymouth: %s", g_strerror (errno));
+        handle_response (request, FALSE, callback, data);
+        return;
+    }
 
-    return result;
+    PendingRequest *pending = g_malloc0 (sizeof (PendingRequest));
+    pending->request = request;
+    pending->callback = callback;
+    pending->data = data;
+    g_queue_push_tail (&pending_requests, pending);
+    if (!response_timeout)
+        reset_response_timeout ();
 }
 
 static gboolean
-plymouth_command_returns_true (gchar *command)
+connect_to_daemon (void)
 {
-    gint exit_status;
-    if (!plymouth_run_command (command, &exit_status))
+    int fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        g_debug ("Could not create Plymouth socket: %s", g_strerror (errno));
         return FALSE;
-    return WIFEXITED (exit_status) && WEXITSTATUS (exit_status) == 0;
+    }
+
+    struct sockaddr_un address;
+    memset (&address, 0, sizeof (address));
+    address.sun_family = AF_UNIX;
+    strncpy (address.sun_path + 1, PLYMOUTH_SOCKET_PATH, sizeof (address.sun_path) - 2);
+
+    /* Newer versions listen on the trimmed abstract name, older on the zero padded one */
+    socklen_t trimmed_length = offsetof (struct sockaddr_un, sun_path) + 1 + strlen (PLYMOUTH_SOCKET_PATH);
+    if (connect (fd, (struct sockaddr *) &address, trimmed_length) < 0 &&
+        connect (fd, (struct sockaddr *) &address, sizeof (address)) < 0)
+    {
+        g_debug ("Could not connect to Plymouth: %s", g_strerror (errno));
+        close (fd);
+        return FALSE;
+    }
+
+    fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+
+    plymouth_fd = fd;
+    plymouth_channel = g_io_channel_unix_new (plymouth_fd);
+    plymouth_watch = g_io_add_watch (plymouth_channel, G_IO_IN | G_IO_HUP | G_IO_ERR, read_cb, NULL);
+
+    return TRUE;
 }
 
-gboolean
-plymouth_get_is_running (void)
+void
+plymouth_connect (void)
 {
-    if (!have_pinged)
+    if (have_state || plymouth_fd >= 0)
+        return;
+
+    if (!connect_to_daemon ())
     {
-        have_pinged = TRUE;
-        is_running = plymouth_command_returns_true ("--ping");
-        is_active = is_running;
+        set_have_state ();
+        return;
     }
 
+    /* Ask everything we need up front so it only costs one round trip */
+    n_state_queries = 2;
+    send_request (PLYMOUTH_REQUEST_PING, NULL, NULL, NULL);
+    send_request (PLYMOUTH_REQUEST_HAS_ACTIVE_VT, NULL, NULL, NULL);
+}
+
+static gboolean
+state_known_cb (gpointer data)
+{
+    StateWaiter *waiter = data;
+    waiter->callback (waiter->data);
+    return G_SOURCE_REMOVE;
+}
+
+void
+plymouth_wait_for_state (PlymouthCallback callback, gpointer data)
+{
+    StateWaiter *waiter = g_malloc0 (sizeof (StateWaiter));
+    waiter->callback = callback;
+    waiter->data = data;
+
+    /* Always call back from the main loop, even if already known */
+    if (have_state)
+        g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, state_known_cb, waiter, g_free);
+    else
+        state_waiters = g_list_append (state_waiters, waiter);
+}
+
+gboolean
+plymouth_get_is_running (void)
+{
     return is_running;
 }
 
@@ -65,21 +319,15 @@ plymouth_get_is_active (void)
 gboolean
 plymouth_has_active_vt (void)
 {
-    if (!have_checked_active_vt)
-    {
-        have_checked_active_vt = TRUE;
-        has_active_vt = plymouth_command_returns_true ("--has-active-vt");
-    }
-
     return has_active_vt;
 }
 
 void
-plymouth_deactivate (void)
+plymouth_deactivate (PlymouthCallback callback, gpointer data)
 {
     g_debug ("Deactivating Plymouth");
     is_active = FALSE;
-    plymouth_run_command ("deactivate", NULL);
+    send_request (PLYMOUTH_REQUEST_DEACTIVATE, NULL, callback, data);
 }
 
 void
@@ -90,10 +338,16 @@ plymouth_quit (gboolean retain_splash)
     else
         g_debug ("Quitting Plymouth");
 
-    have_pinged = TRUE;
     is_running = FALSE;
-    if (retain_splash)
-        plymouth_run_command ("quit --retain-splash", NULL);
-    else
-        plymouth_run_command ("quit", NULL);
+    send_request (PLYMOUTH_REQUEST_QUIT, retain_splash ? "\001" : "", NULL, NULL);
+}
+
+void
+plymouth_cleanup (void)
+{
+    disconnect ();
+    while (!g_queue_is_empty (&pending_requests))
+        g_free (g_queue_pop_head (&pending_requests));
+    g_list_free_full (state_waiters, g_free);
+    state_waiters = NULL;
 }
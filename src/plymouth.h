@@ -16,16 +16,24 @@
 
 G_BEGIN_DECLS
 
+typedef void (*PlymouthCallback)(gpointer data);
+
+void plymouth_connect (void);
+
+void plymouth_wait_for_state (PlymouthCallback callback, gpointer data);
+
 gboolean plymouth_get_is_running (void);
 
 gboolean plymouth_get_is_active (void);
 
 gboolean plymouth_has_active_vt (void);
 
-void plymouth_deactivate (void);
+void plymouth_deactivate (PlymouthCallback callback, gpointer data);
 
 void plymouth_quit (gboolean retain_splash);
 
+void plymouth_cleanup (void);
+
 G_END_DECLS
 
 #endif /* PLYMOUTH_H_ */
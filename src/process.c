@@ -235,6 +235,9 @@ process_start (Process *process, gboolean block)
         /* Reset SIGPIPE handler so the child has default behaviour (we disabled it at LightDM start) */
         signal (SIGPIPE, SIG_DFL);
 
+        /* SIGHUP reloads the daemon configuration, children keep ignoring it as set at LightDM start */
+        signal (SIGHUP, SIG_IGN);
+
         execvp (argv[0], argv);
         _exit (EXIT_FAILURE);
     }
@@ -454,4 +457,5 @@ process_class_init (ProcessClass *klass)
     sigaction (SIGINT, &action, NULL);
     sigaction (SIGUSR1, &action, NULL);
     sigaction (SIGUSR2, &action, NULL);
+    sigaction (SIGHUP, &action, NULL);
 }
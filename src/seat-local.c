@@ -131,6 +131,15 @@ display_server_ready_cb (DisplayServer *display_server, Seat *seat)
     plymouth_quit (TRUE);
 }
 
+static void
+plymouth_deactivated_cb (gpointer data)
+{
+    g_autoptr(XServerLocal) x_server = data;
+
+    /* Plymouth has let go of the VT so the X server can take it */
+    x_server_local_release_launch (x_server);
+}
+
 static void
 display_server_transition_plymouth_cb (DisplayServer *display_server, Seat *seat)
 {
@@ -157,7 +166,13 @@ get_vt (SeatLocal *seat, DisplayServer *display_server)
             vt = active_vt;
             g_signal_connect (display_server, DISPLAY_SERVER_SIGNAL_READY, G_CALLBACK (display_server_ready_cb), seat);
             g_signal_connect (display_server, DISPLAY_SERVER_SIGNAL_STOPPED, G_CALLBACK (display_server_transition_plymouth_cb), seat);
-            plymouth_deactivate ();
+            if (IS_X_SERVER_LOCAL (display_server))
+            {
+                x_server_local_hold_launch (X_SERVER_LOCAL (display_server));
+                plymouth_deactivate (plymouth_deactivated_cb, g_object_ref (display_server));
+            }
+            else
+                plymouth_deactivate (NULL, NULL);
         }
         else
             l_debug (seat, "Plymouth is running on VT %d, but this is less than the configured minimum of %d so not replacing it", active_vt, vt_get_min ());
@@ -186,6 +201,7 @@ get_unity_system_compositor (SeatLocal *seat)
     if (timeout <= 0)
         timeout = 60;
     unity_system_compositor_set_timeout (seat->priv->compositor, timeout);
+    unity_system_compositor_set_ping_interval (seat->priv->compositor, seat_get_integer_property (SEAT (seat), "unity-compositor-ping-interval"));
 
     gint vt = get_vt (seat, DISPLAY_SERVER (seat->priv->compositor));
     if (vt >= 0)
@@ -291,6 +307,36 @@ seat_local_create_display_server (Seat *s, Session *session)
     }
 }
 
+static void
+idle_display_server_ready_cb (DisplayServer *display_server, SeatLocal *seat)
+{
+    g_signal_handlers_disconnect_matched (display_server, G_SIGNAL_MATCH_FUNC, 0, 0, NULL, idle_display_server_ready_cb, NULL);
+
+    /* X switches to its VT when it starts, so switch back unless the user has changed VT since.
+     * The VT is activated again when the display server is used. */
+    gint return_vt = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (display_server), "IDLE_RETURN_VT"));
+    gint vt = display_server_get_vt (display_server);
+    if (return_vt > 0 && vt > 0 && return_vt != vt && vt_get_active () == vt)
+    {
+        l_debug (seat, "Returning to VT %d from idle display server", return_vt);
+        vt_set_active (return_vt);
+    }
+}
+
+static DisplayServer *
+seat_local_create_idle_display_server (Seat *seat)
+{
+    /* Only X servers running on their own VT are started in advance */
+    if (g_strcmp0 (seat_get_string_property (seat, "xserver-backend"), "mir") == 0)
+        return NULL;
+
+    XServerLocal *x_server = create_x_server (SEAT_LOCAL (seat));
+    g_object_set_data (G_OBJECT (x_server), "IDLE_RETURN_VT", GINT_TO_POINTER (vt_get_active ()));
+    g_signal_connect (x_server, DISPLAY_SERVER_SIGNAL_READY, G_CALLBACK (idle_display_server_ready_cb), seat);
+
+    return DISPLAY_SERVER (x_server);
+}
+
 static gboolean
 seat_local_display_server_is_used (Seat *seat, DisplayServer *display_server)
 {
@@ -454,6 +500,7 @@ seat_local_class_init (SeatLocalClass *klass)
     seat_class->setup = seat_local_setup;
     seat_class->start = seat_local_start;
     seat_class->create_display_server = seat_local_create_display_server;
+    seat_class->create_idle_display_server = seat_local_create_idle_display_server;
     seat_class->display_server_is_used = seat_local_display_server_is_used;
     seat_class->create_greeter_session = seat_local_create_greeter_session;
     seat_class->create_session = seat_local_create_session;
@@ -166,6 +166,7 @@ seat_unity_start (Seat *seat)
     unity_system_compositor_set_command (SEAT_UNITY (seat)->priv->compositor, seat_get_string_property (SEAT (seat), "unity-compositor-command"));
     unity_system_compositor_set_vt (SEAT_UNITY (seat)->priv->compositor, vt);
     unity_system_compositor_set_timeout (SEAT_UNITY (seat)->priv->compositor, timeout);
+    unity_system_compositor_set_ping_interval (SEAT_UNITY (seat)->priv->compositor, seat_get_integer_property (SEAT (seat), "unity-compositor-ping-interval"));
 
     return display_server_start (DISPLAY_SERVER (SEAT_UNITY (seat)->priv->compositor));
 }
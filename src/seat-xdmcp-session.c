@@ -25,15 +25,45 @@ struct SeatXDMCPSessionPrivate
 
 G_DEFINE_TYPE (SeatXDMCPSession, seat_xdmcp_session, SEAT_TYPE)
 
+static gboolean
+session_check_alive_cb (XDMCPSession *session, SeatXDMCPSession *seat)
+{
+    if (!seat->priv->x_server)
+        return TRUE;
+    return x_server_check_connection (X_SERVER (seat->priv->x_server));
+}
+
+static void
+x_server_ready_cb (XServerRemote *x_server, SeatXDMCPSession *seat)
+{
+    xdmcp_session_set_connected (seat->priv->session);
+}
+
+static void
+session_ended_cb (XDMCPSession *session, SeatXDMCPSession *seat)
+{
+    l_debug (seat, "XDMCP display has gone away");
+    seat_stop (SEAT (seat));
+}
+
 SeatXDMCPSession *
 seat_xdmcp_session_new (XDMCPSession *session)
 {
     SeatXDMCPSession *seat = g_object_new (SEAT_XDMCP_SESSION_TYPE, NULL);
     seat->priv->session = g_object_ref (session);
+    g_signal_connect (session, XDMCP_SESSION_SIGNAL_CHECK_ALIVE, G_CALLBACK (session_check_alive_cb), seat);
+    g_signal_connect (session, XDMCP_SESSION_SIGNAL_ENDED, G_CALLBACK (session_ended_cb), seat);
 
     return seat;
 }
 
+XDMCPSession *
+seat_xdmcp_session_get_session (SeatXDMCPSession *seat)
+{
+    g_return_val_if_fail (seat != NULL, NULL);
+    return seat->priv->session;
+}
+
 static DisplayServer *
 seat_xdmcp_session_create_display_server (Seat *seat, Session *session)
 {
@@ -48,6 +78,7 @@ seat_xdmcp_session_create_display_server (Seat *seat, Session *session)
     g_autofree gchar *host = g_inet_address_to_string (xdmcp_session_get_address (SEAT_XDMCP_SESSION (seat)->priv->session));
 
     SEAT_XDMCP_SESSION (seat)->priv->x_server = x_server_remote_new (host, xdmcp_session_get_display_number (SEAT_XDMCP_SESSION (seat)->priv->session), authority);
+    g_signal_connect (SEAT_XDMCP_SESSION (seat)->priv->x_server, DISPLAY_SERVER_SIGNAL_READY, G_CALLBACK (x_server_ready_cb), seat);
 
     return g_object_ref (DISPLAY_SERVER (SEAT_XDMCP_SESSION (seat)->priv->x_server));
 }
@@ -63,7 +94,10 @@ seat_xdmcp_session_finalize (GObject *object)
 {
     SeatXDMCPSession *self = SEAT_XDMCP_SESSION (object);
 
+    g_signal_handlers_disconnect_matched (self->priv->session, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, self);
     g_clear_object (&self->priv->session);
+    if (self->priv->x_server)
+        g_signal_handlers_disconnect_matched (self->priv->x_server, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, self);
     g_clear_object (&self->priv->x_server);
 
     G_OBJECT_CLASS (seat_xdmcp_session_parent_class)->finalize (object);
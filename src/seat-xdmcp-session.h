@@ -39,6 +39,8 @@ GType seat_xdmcp_session_get_type (void);
 
 SeatXDMCPSession *seat_xdmcp_session_new (XDMCPSession *session);
 
+XDMCPSession *seat_xdmcp_session_get_session (SeatXDMCPSession *seat);
+
 G_END_DECLS
 
 #endif /* SEAT_XDMCP_SESSION_H_ */
@@ -10,11 +10,21 @@
  */
 
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <gio/gio.h>
 
 #include "seat-xvnc.h"
 #include "x-server-xvnc.h"
 #include "configuration.h"
 
+enum {
+    READY,
+    LAST_SIGNAL
+};
+static guint signals[LAST_SIGNAL] = { 0 };
+
 G_DEFINE_TYPE (SeatXVNC, seat_xvnc, SEAT_TYPE)
 
 struct SeatXVNCPrivate
@@ -22,18 +32,84 @@ struct SeatXVNCPrivate
     /* VNC connection */
     GSocket *connection;
 
+    /* Address of the VNC client */
+    gchar *remote_host;
+
+    /* Sockets connecting the daemon to a pooled X server, the X server uses the second and
+     * the daemon closes it once the X server is running */
+    GSocket *pool_sockets[2];
+
+    /* Copies data between the VNC connection and a pooled X server */
+    GCancellable *splice_cancellable;
+
     /* X server using VNC connection */
     XServerXVNC *x_server;
+
+    /* TRUE when the X server is ready */
+    gboolean ready;
 };
 
+static void
+set_connection (SeatXVNC *seat, GSocket *connection)
+{
+    seat->priv->connection = g_object_ref (connection);
+
+    g_autoptr(GSocketAddress) address = g_socket_get_remote_address (connection, NULL);
+    if (address && G_IS_INET_SOCKET_ADDRESS (address))
+        seat->priv->remote_host = g_inet_address_to_string (g_inet_socket_address_get_address (G_INET_SOCKET_ADDRESS (address)));
+}
+
 SeatXVNC *seat_xvnc_new (GSocket *connection)
 {
     SeatXVNC *seat = g_object_new (SEAT_XVNC_TYPE, NULL);
-    seat->priv->connection = g_object_ref (connection);
+    if (connection)
+        set_connection (seat, connection);
 
     return seat;
 }
 
+static void
+splice_cb (GObject *object, GAsyncResult *result, gpointer data)
+{
+    g_autoptr(GError) error = NULL;
+    if (g_io_stream_splice_finish (result, &error) || g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        return;
+
+    SeatXVNC *seat = data;
+    l_debug (seat, "VNC connection failed: %s", error->message);
+}
+
+gboolean
+seat_xvnc_attach_connection (SeatXVNC *seat, GSocket *connection)
+{
+    g_return_val_if_fail (seat != NULL, FALSE);
+    g_return_val_if_fail (connection != NULL, FALSE);
+
+    if (seat->priv->connection || !seat->priv->pool_sockets[0] || !seat->priv->ready || seat_get_is_stopping (SEAT (seat)))
+        return FALSE;
+
+    set_connection (seat, connection);
+
+    /* The X server was started before the connection arrived and can't be given a new socket, so copy the data to the socket it has */
+    g_autoptr(GSocketConnection) client_stream = g_socket_connection_factory_create_connection (connection);
+    g_autoptr(GSocketConnection) server_stream = g_socket_connection_factory_create_connection (seat->priv->pool_sockets[0]);
+    seat->priv->splice_cancellable = g_cancellable_new ();
+    g_io_stream_splice_async (G_IO_STREAM (client_stream), G_IO_STREAM (server_stream),
+                              G_IO_STREAM_SPLICE_CLOSE_STREAM1 | G_IO_STREAM_SPLICE_CLOSE_STREAM2,
+                              G_PRIORITY_DEFAULT, seat->priv->splice_cancellable, splice_cb, seat);
+
+    l_debug (seat, "Attached VNC connection from %s", seat->priv->remote_host);
+
+    return TRUE;
+}
+
+GSocket *
+seat_xvnc_get_connection (SeatXVNC *seat)
+{
+    g_return_val_if_fail (seat != NULL, NULL);
+    return seat->priv->connection;
+}
+
 static void
 seat_xvnc_setup (Seat *seat)
 {
@@ -41,6 +117,23 @@ seat_xvnc_setup (Seat *seat)
     SEAT_CLASS (seat_xvnc_parent_class)->setup (seat);
 }
 
+gboolean
+seat_xvnc_get_is_ready (SeatXVNC *seat)
+{
+    g_return_val_if_fail (seat != NULL, FALSE);
+    return seat->priv->ready;
+}
+
+static void
+x_server_ready_cb (DisplayServer *display_server, SeatXVNC *seat)
+{
+    /* Xvnc has its own copy of its end of the socket, close ours so the connection ends when Xvnc exits */
+    g_clear_object (&seat->priv->pool_sockets[1]);
+
+    seat->priv->ready = TRUE;
+    g_signal_emit (seat, signals[READY], 0);
+}
+
 static DisplayServer *
 seat_xvnc_create_display_server (Seat *seat, Session *session)
 {
@@ -51,12 +144,38 @@ seat_xvnc_create_display_server (Seat *seat, Session *session)
     if (SEAT_XVNC (seat)->priv->x_server)
         return NULL;
 
+    /* Pooled servers are started before there is a connection so talk to the daemon until one arrives */
+    GSocket *socket = SEAT_XVNC (seat)->priv->connection;
+    if (!socket)
+    {
+        int fds[2];
+        if (socketpair (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0)
+        {
+            l_warning (seat, "Failed to create socket for pooled X server: %s", g_strerror (errno));
+            return NULL;
+        }
+        for (int i = 0; i < 2; i++)
+        {
+            g_autoptr(GError) error = NULL;
+            SEAT_XVNC (seat)->priv->pool_sockets[i] = g_socket_new_from_fd (fds[i], &error);
+            if (!SEAT_XVNC (seat)->priv->pool_sockets[i])
+            {
+                l_warning (seat, "Failed to create socket for pooled X server: %s", error->message);
+                close (fds[i]);
+            }
+        }
+        if (!SEAT_XVNC (seat)->priv->pool_sockets[0] || !SEAT_XVNC (seat)->priv->pool_sockets[1])
+            return NULL;
+        socket = SEAT_XVNC (seat)->priv->pool_sockets[1];
+    }
+
     g_autoptr(XServerXVNC) x_server = x_server_xvnc_new ();
     SEAT_XVNC (seat)->priv->x_server = g_object_ref (x_server);
     g_autofree gchar *number = g_strdup_printf ("%d", x_server_get_display_number (X_SERVER (x_server)));
     g_autoptr(XAuthority) cookie = x_authority_new_local_cookie (number);
     x_server_set_authority (X_SERVER (x_server), cookie);
-    x_server_xvnc_set_socket (x_server, g_socket_get_fd (SEAT_XVNC (seat)->priv->connection));
+    x_server_xvnc_set_socket (x_server, g_socket_get_fd (socket));
+    g_signal_connect (x_server, DISPLAY_SERVER_SIGNAL_READY, G_CALLBACK (x_server_ready_cb), seat);
 
     const gchar *command = config_get_string (config_get_instance (), "VNCServer", "command");
     if (command)
@@ -87,11 +206,11 @@ seat_xvnc_run_script (Seat *seat, DisplayServer *display_server, Process *script
 {
     XServerXVNC *x_server = X_SERVER_XVNC (display_server);
 
-    GInetSocketAddress *address = G_INET_SOCKET_ADDRESS (g_socket_get_remote_address (SEAT_XVNC (seat)->priv->connection, NULL));
-    g_autofree gchar *hostname = g_inet_address_to_string (g_inet_socket_address_get_address (address));
     const gchar *path = x_server_local_get_authority_file_path (X_SERVER_LOCAL (x_server));
 
-    process_set_env (script, "REMOTE_HOST", hostname);
+    /* Pooled servers run the display setup script before a client connects */
+    if (SEAT_XVNC (seat)->priv->remote_host)
+        process_set_env (script, "REMOTE_HOST", SEAT_XVNC (seat)->priv->remote_host);
     process_set_env (script, "DISPLAY", x_server_get_address (X_SERVER (x_server)));
     process_set_env (script, "XAUTHORITY", path);
 
@@ -109,7 +228,15 @@ seat_xvnc_session_finalize (GObject *object)
 {
     SeatXVNC *self = SEAT_XVNC (object);
 
+    if (self->priv->splice_cancellable)
+        g_cancellable_cancel (self->priv->splice_cancellable);
+    g_clear_object (&self->priv->splice_cancellable);
     g_clear_object (&self->priv->connection);
+    g_clear_pointer (&self->priv->remote_host, g_free);
+    g_clear_object (&self->priv->pool_sockets[0]);
+    g_clear_object (&self->priv->pool_sockets[1]);
+    if (self->priv->x_server)
+        g_signal_handlers_disconnect_matched (self->priv->x_server, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, self);
     g_clear_object (&self->priv->x_server);
 
     G_OBJECT_CLASS (seat_xvnc_parent_class)->finalize (object);
@@ -127,4 +254,13 @@ seat_xvnc_class_init (SeatXVNCClass *klass)
     object_class->finalize = seat_xvnc_session_finalize;
 
     g_type_class_add_private (klass, sizeof (SeatXVNCPrivate));
+
+    signals[READY] =
+        g_signal_new (SEAT_XVNC_SIGNAL_READY,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (SeatXVNCClass, ready),
+                      NULL, NULL,
+                      NULL,
+                      G_TYPE_NONE, 0);
 }
@@ -20,6 +20,8 @@ G_BEGIN_DECLS
 #define SEAT_XVNC_TYPE (seat_xvnc_get_type())
 #define SEAT_XVNC(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), SEAT_XVNC_TYPE, SeatXVNC))
 
+#define SEAT_XVNC_SIGNAL_READY "ready"
+
 typedef struct SeatXVNCPrivate SeatXVNCPrivate;
 
 typedef struct
@@ -31,6 +33,7 @@ typedef struct
 typedef struct
 {
     SeatClass parent_class;
+    void (*ready)(SeatXVNC *seat);
 } SeatXVNCClass;
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (SeatXVNC, g_object_unref)
@@ -39,6 +42,12 @@ GType seat_xvnc_get_type (void);
 
 SeatXVNC *seat_xvnc_new (GSocket *connection);
 
+GSocket *seat_xvnc_get_connection (SeatXVNC *seat);
+
+gboolean seat_xvnc_get_is_ready (SeatXVNC *seat);
+
+gboolean seat_xvnc_attach_connection (SeatXVNC *seat, GSocket *connection);
+
 G_END_DECLS
 
 #endif /* SEAT_XVNC_H_ */
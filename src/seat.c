@@ -45,6 +45,12 @@ struct SeatPrivate
     /* The display servers on this seat */
     GList *display_servers;
 
+    /* Idle display servers started in advance for fast switching */
+    GList *display_server_pool;
+
+    /* Timeout to stop unused display servers in the pool */
+    guint display_server_pool_timeout;
+
     /* The sessions on this seat */
     GList *sessions;
 
@@ -88,6 +94,8 @@ static DisplayServer *create_display_server (Seat *seat, Session *session);
 static gboolean start_display_server (Seat *seat, DisplayServer *display_server);
 static GreeterSession *create_greeter_session (Seat *seat);
 static void start_session (Seat *seat, Session *session);
+static void start_standby_greeter (Seat *seat);
+static void fill_display_server_pool (Seat *seat);
 
 static void
 free_seat_module (gpointer data)
@@ -435,6 +443,8 @@ display_server_stopped_cb (DisplayServer *display_server, Seat *seat)
 
     g_signal_handlers_disconnect_matched (display_server, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, seat);
     seat->priv->display_servers = g_list_remove (seat->priv->display_servers, display_server);
+    gboolean pooled = g_list_find (seat->priv->display_server_pool, display_server) != NULL;
+    seat->priv->display_server_pool = g_list_remove (seat->priv->display_server_pool, display_server);
 
     if (seat->priv->stopping || !seat->priv->started)
     {
@@ -443,6 +453,18 @@ display_server_stopped_cb (DisplayServer *display_server, Seat *seat)
         return;
     }
 
+    /* Idle display servers have no sessions to clean up, replace them if they
+     * quit on their own after starting successfully */
+    if (pooled)
+    {
+        l_debug (seat, "Idle display server stopped");
+        gboolean replace = !display_server_get_is_stopping (display_server) && display_server_get_is_ready (display_server);
+        g_object_unref (display_server);
+        if (replace)
+            fill_display_server_pool (seat);
+        return;
+    }
+
     /* Stop all sessions on this display server */
     GList *list = g_list_copy (seat->priv->sessions);
     for (GList *link = list; link; link = link->next)
@@ -521,9 +543,8 @@ find_resettable_greeter (Seat *seat)
 }
 
 static void
-set_greeter_hints (Seat *seat, Greeter *greeter)
+update_greeter_hints (Seat *seat, Greeter *greeter)
 {
-    greeter_clear_hints (greeter);
     greeter_set_hint (greeter, "default-session", seat_get_string_property (seat, "user-session"));
     greeter_set_hint (greeter, "hide-users", seat_get_boolean_property (seat, "greeter-hide-users") ? "true" : "false");
     greeter_set_hint (greeter, "show-manual-login", seat_get_boolean_property (seat, "greeter-show-manual-login") ? "true" : "false");
@@ -531,6 +552,13 @@ set_greeter_hints (Seat *seat, Greeter *greeter)
     greeter_set_hint (greeter, "has-guest-account", seat_get_allow_guest (seat) && seat_get_boolean_property (seat, "greeter-allow-guest") ? "true" : "false");
 }
 
+static void
+set_greeter_hints (Seat *seat, Greeter *greeter)
+{
+    greeter_clear_hints (greeter);
+    update_greeter_hints (seat, greeter);
+}
+
 static void
 switch_to_greeter_from_failed_session (Seat *seat, Session *session)
 {
@@ -652,6 +680,17 @@ run_session (Seat *seat, Session *session)
            There's no harm to do this in seats that enforce separate VTs. */
         session_activate (seat->priv->active_session);
     }
+
+    /* Have a greeter waiting for when this session ends */
+    if (!IS_GREETER_SESSION (session))
+        start_standby_greeter (seat);
+
+    /* Have display servers ready for the next switch */
+    fill_display_server_pool (seat);
+
+    /* Set up guest accounts while the seat waits at the greeter */
+    if (IS_GREETER_SESSION (session) && seat_get_allow_guest (seat))
+        guest_account_fill_pool ();
 }
 
 static Session *
@@ -909,20 +948,11 @@ find_session_config (Seat *seat, const gchar *sessions_dir, const gchar *session
     g_return_val_if_fail (sessions_dir != NULL, NULL);
     g_return_val_if_fail (session_name != NULL, NULL);
 
-    g_auto(GStrv) dirs = g_strsplit (sessions_dir, ":", -1);
-    for (int i = 0; dirs[i]; i++)
-    {
-        const gchar *default_session_type = "x";
-        if (strcmp (dirs[i], WAYLAND_SESSIONS_DIR) == 0)
-            default_session_type = "wayland";
-
-        g_autofree gchar *filename = g_strdup_printf ("%s.desktop", session_name);
-        g_autofree gchar *path = g_build_filename (dirs[i], filename, NULL);
-        g_autoptr(GError) error = NULL;
-        SessionConfig *session_config = session_config_new_from_file (path, default_session_type, &error);
-        if (session_config)
-            return session_config;
-    }
+    /* Greeters can write to the cache directory so always parse the session files */
+    CommonSessionList *session_list = common_session_list_get_instance (sessions_dir, NULL);
+    CommonSessionEntry *entry = common_session_list_get_entry (session_list, session_name);
+    if (entry)
+        return session_config_new_from_session_entry (entry);
 
     l_debug (seat, "Failed to find session configuration %s", session_name);
 
@@ -1275,6 +1305,13 @@ find_session_for_display_server (Seat *seat, DisplayServer *display_server)
 static void
 display_server_ready_cb (DisplayServer *display_server, Seat *seat)
 {
+    /* Idle display servers are set up when they are handed out */
+    if (g_list_find (seat->priv->display_server_pool, display_server))
+    {
+        l_debug (seat, "Idle display server ready");
+        return;
+    }
+
     /* Run setup script */
     const gchar *script = seat_get_string_property (seat, "display-setup-script");
     if (script && !run_script (seat, display_server, script, NULL))
@@ -1308,22 +1345,130 @@ display_server_ready_cb (DisplayServer *display_server, Seat *seat)
     }
 }
 
+static void
+add_display_server (Seat *seat, DisplayServer *display_server)
+{
+    if (g_list_find (seat->priv->display_servers, display_server))
+        return;
+
+    seat->priv->display_servers = g_list_append (seat->priv->display_servers, display_server);
+    g_signal_connect (display_server, DISPLAY_SERVER_SIGNAL_READY, G_CALLBACK (display_server_ready_cb), seat);
+    g_signal_connect (display_server, DISPLAY_SERVER_SIGNAL_STOPPED, G_CALLBACK (display_server_stopped_cb), seat);
+}
+
+static void
+stop_display_server_pool (Seat *seat)
+{
+    /* Copy the list as it is modified when each display server stops */
+    GList *list = g_list_copy (seat->priv->display_server_pool);
+    for (GList *link = list; link; link = link->next)
+    {
+        DisplayServer *display_server = link->data;
+        if (!display_server_get_is_stopping (display_server))
+            display_server_stop (display_server);
+    }
+    g_list_free (list);
+}
+
+static gboolean
+display_server_pool_timeout_cb (gpointer data)
+{
+    Seat *seat = data;
+
+    seat->priv->display_server_pool_timeout = 0;
+
+    l_debug (seat, "Stopping unused idle display servers");
+    stop_display_server_pool (seat);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+reset_display_server_pool_timeout (Seat *seat)
+{
+    if (seat->priv->display_server_pool_timeout)
+        g_source_remove (seat->priv->display_server_pool_timeout);
+    seat->priv->display_server_pool_timeout = 0;
+
+    gint timeout = seat_get_integer_property (seat, "display-server-pool-idle-timeout");
+    if (timeout > 0 && seat->priv->display_server_pool)
+        seat->priv->display_server_pool_timeout = g_timeout_add_seconds (timeout, display_server_pool_timeout_cb, seat);
+}
+
+static void
+fill_display_server_pool (Seat *seat)
+{
+    if (seat->priv->stopping || !seat_get_can_switch (seat))
+        return;
+
+    gint pool_size = seat_get_integer_property (seat, "display-server-pool-size");
+    gboolean added = FALSE;
+    while ((gint) g_list_length (seat->priv->display_server_pool) < pool_size)
+    {
+        DisplayServer *display_server = SEAT_GET_CLASS (seat)->create_idle_display_server (seat);
+        if (!display_server)
+            break;
+
+        l_debug (seat, "Starting idle display server");
+        add_display_server (seat, display_server);
+        seat->priv->display_server_pool = g_list_append (seat->priv->display_server_pool, display_server);
+        if (!display_server_start (display_server))
+        {
+            l_debug (seat, "Failed to start idle display server");
+            g_signal_handlers_disconnect_matched (display_server, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, seat);
+            seat->priv->display_servers = g_list_remove (seat->priv->display_servers, display_server);
+            seat->priv->display_server_pool = g_list_remove (seat->priv->display_server_pool, display_server);
+            g_object_unref (display_server);
+            break;
+        }
+        added = TRUE;
+    }
+
+    if (added)
+        reset_display_server_pool_timeout (seat);
+}
+
+static DisplayServer *
+take_idle_display_server (Seat *seat, Session *session)
+{
+    for (GList *link = seat->priv->display_server_pool; link; link = link->next)
+    {
+        DisplayServer *display_server = link->data;
+
+        if (!display_server_get_is_ready (display_server) ||
+            display_server_get_is_stopping (display_server) ||
+            strcmp (display_server_get_session_type (display_server), session_get_session_type (session)) != 0)
+            continue;
+
+        seat->priv->display_server_pool = g_list_delete_link (seat->priv->display_server_pool, link);
+        if (!seat->priv->display_server_pool)
+            reset_display_server_pool_timeout (seat);
+
+        return display_server;
+    }
+
+    return NULL;
+}
+
 static DisplayServer *
 create_display_server (Seat *seat, Session *session)
 {
+    /* Use an idle display server if one is ready */
+    DisplayServer *display_server = take_idle_display_server (seat, session);
+    if (display_server)
+    {
+        l_debug (seat, "Using idle display server of type %s", session_get_session_type (session));
+        return display_server;
+    }
+
     l_debug (seat, "Creating display server of type %s", session_get_session_type (session));
 
-    DisplayServer *display_server = SEAT_GET_CLASS (seat)->create_display_server (seat, session);
+    display_server = SEAT_GET_CLASS (seat)->create_display_server (seat, session);
     if (!display_server)
         return NULL;
 
     /* Remember this display server */
-    if (!g_list_find (seat->priv->display_servers, display_server))
-    {
-        seat->priv->display_servers = g_list_append (seat->priv->display_servers, display_server);
-        g_signal_connect (display_server, DISPLAY_SERVER_SIGNAL_READY, G_CALLBACK (display_server_ready_cb), seat);
-        g_signal_connect (display_server, DISPLAY_SERVER_SIGNAL_STOPPED, G_CALLBACK (display_server_stopped_cb), seat);
-    }
+    add_display_server (seat, display_server);
 
     return display_server;
 }
@@ -1352,6 +1497,23 @@ seat_switch_to_greeter (Seat *seat)
     GreeterSession *greeter_session = find_greeter_session (seat);
     if (greeter_session)
     {
+        /* Return a standby greeter to its initial state */
+        Greeter *greeter = greeter_session_get_greeter (greeter_session);
+        if (seat_get_boolean_property (seat, "greeter-standby") && greeter_get_resettable (greeter))
+        {
+            set_greeter_hints (seat, greeter);
+            greeter_reset (greeter);
+        }
+
+        /* Activate once it is running if still starting */
+        if (!session_get_is_run (SESSION (greeter_session)))
+        {
+            l_debug (seat, "Switching to existing greeter when it starts");
+            g_clear_object (&seat->priv->session_to_activate);
+            seat->priv->session_to_activate = g_object_ref (SESSION (greeter_session));
+            return TRUE;
+        }
+
         l_debug (seat, "Switching to existing greeter");
         seat_set_active_session (seat, SESSION (greeter_session));
         return TRUE;
@@ -1374,6 +1536,41 @@ seat_switch_to_greeter (Seat *seat)
     return start_display_server (seat, display_server);
 }
 
+static void
+start_standby_greeter (Seat *seat)
+{
+    if (seat->priv->stopping ||
+        !seat_get_boolean_property (seat, "greeter-standby") ||
+        !seat_get_can_switch (seat) ||
+        find_greeter_session (seat))
+        return;
+
+    l_debug (seat, "Starting standby greeter");
+
+    GreeterSession *greeter_session = create_greeter_session (seat);
+    if (!greeter_session)
+        return;
+
+    /* Start X servers the same way as idle ones so they don't take the VT from the user session */
+    DisplayServer *display_server = take_idle_display_server (seat, SESSION (greeter_session));
+    if (!display_server && strcmp (session_get_session_type (SESSION (greeter_session)), "x") == 0)
+    {
+        display_server = SEAT_GET_CLASS (seat)->create_idle_display_server (seat);
+        if (display_server)
+            add_display_server (seat, display_server);
+    }
+    if (!display_server)
+        display_server = create_display_server (seat, SESSION (greeter_session));
+    session_set_display_server (SESSION (greeter_session), display_server);
+    if (!display_server || !start_display_server (seat, display_server))
+    {
+        l_debug (seat, "Failed to start display server for standby greeter");
+        session_stop (SESSION (greeter_session));
+        if (display_server)
+            display_server_stop (display_server);
+    }
+}
+
 static void
 switch_authentication_complete_cb (Session *session, Seat *seat)
 {
@@ -1582,6 +1779,62 @@ seat_lock (Seat *seat, const gchar *username)
     }
 }
 
+static gboolean
+is_display_server_property (const gchar *name)
+{
+    return g_str_has_prefix (name, "xserver-") ||
+           g_str_has_prefix (name, "xmir-") ||
+           g_str_has_prefix (name, "unity-compositor-") ||
+           strcmp (name, "display-server-pool-size") == 0;
+}
+
+void
+seat_properties_changed (Seat *seat, const gchar * const *names)
+{
+    g_return_if_fail (seat != NULL);
+
+    if (seat->priv->stopping)
+        return;
+
+    gboolean display_server_changed = FALSE, pool_timeout_changed = FALSE;
+    for (int i = 0; names[i]; i++)
+    {
+        l_debug (seat, "Property %s changed", names[i]);
+        if (is_display_server_property (names[i]))
+            display_server_changed = TRUE;
+        else if (strcmp (names[i], "display-server-pool-idle-timeout") == 0)
+            pool_timeout_changed = TRUE;
+    }
+
+    /* Idle display servers were started with the old settings, they are replaced when the pool is next filled */
+    if (display_server_changed && seat->priv->display_server_pool)
+    {
+        l_debug (seat, "Stopping idle display servers with old configuration");
+        stop_display_server_pool (seat);
+    }
+    else if (pool_timeout_changed)
+        reset_display_server_pool_timeout (seat);
+
+    /* Show the new settings on the greeter if no one is using it, otherwise they are used when it is next reset or started.
+     * Running sessions are never changed, they use the new settings once they are restarted */
+    GreeterSession *greeter_session = find_resettable_greeter (seat);
+    if (!greeter_session ||
+        SESSION (greeter_session) != seat_get_active_session (seat) ||
+        !session_get_is_run (SESSION (greeter_session)))
+        return;
+    Greeter *greeter = greeter_session_get_greeter (greeter_session);
+    if (greeter_get_is_authenticating (greeter))
+        return;
+
+    l_debug (seat, "Resetting idle greeter with new configuration");
+    greeter_set_pam_services (greeter,
+                              seat_get_string_property (seat, "pam-service"),
+                              seat_get_string_property (seat, "pam-autologin-service"));
+    greeter_set_allow_guest (greeter, seat_get_allow_guest (seat));
+    update_greeter_hints (seat, greeter);
+    greeter_reset (greeter);
+}
+
 void
 seat_stop (Seat *seat)
 {
@@ -1706,6 +1959,12 @@ seat_real_create_display_server (Seat *seat, Session *session)
     return NULL;
 }
 
+static DisplayServer *
+seat_real_create_idle_display_server (Seat *seat)
+{
+    return NULL;
+}
+
 static gboolean
 seat_real_display_server_is_used (Seat *seat, DisplayServer *display_server)
 {
@@ -1782,6 +2041,10 @@ seat_real_get_active_session (Seat *seat)
 static void
 seat_real_stop (Seat *seat)
 {
+    if (seat->priv->display_server_pool_timeout)
+        g_source_remove (seat->priv->display_server_pool_timeout);
+    seat->priv->display_server_pool_timeout = 0;
+
     check_stopped (seat);
     if (seat->priv->stopped)
         return;
@@ -1837,6 +2100,9 @@ seat_finalize (GObject *object)
         g_signal_handlers_disconnect_matched (display_server, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, self);
     }
     g_list_free_full (self->priv->display_servers, g_object_unref);
+    g_list_free (self->priv->display_server_pool);
+    if (self->priv->display_server_pool_timeout)
+        g_source_remove (self->priv->display_server_pool_timeout);
     for (GList *link = self->priv->sessions; link; link = link->next)
     {
         Session *session = link->data;
@@ -1859,6 +2125,7 @@ seat_class_init (SeatClass *klass)
     klass->setup = seat_real_setup;
     klass->start = seat_real_start;
     klass->create_display_server = seat_real_create_display_server;
+    klass->create_idle_display_server = seat_real_create_idle_display_server;
     klass->display_server_is_used = seat_real_display_server_is_used;
     klass->create_greeter_session = seat_real_create_greeter_session;
     klass->create_session = seat_real_create_session;
@@ -46,6 +46,7 @@ typedef struct
     void (*setup)(Seat *seat);
     gboolean (*start)(Seat *seat);
     DisplayServer *(*create_display_server) (Seat *seat, Session *session);
+    DisplayServer *(*create_idle_display_server) (Seat *seat);
     gboolean (*display_server_is_used) (Seat *seat, DisplayServer *display_server);
     GreeterSession *(*create_greeter_session) (Seat *seat);
     Session *(*create_session) (Seat *seat);
@@ -73,6 +74,8 @@ void seat_set_name (Seat *seat, const gchar *name);
 
 void seat_set_property (Seat *seat, const gchar *name, const gchar *value);
 
+void seat_properties_changed (Seat *seat, const gchar * const *names);
+
 const gchar *seat_get_string_property (Seat *seat, const gchar *name);
 
 gchar **seat_get_string_list_property (Seat *seat, const gchar *name);
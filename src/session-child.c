@@ -13,14 +13,17 @@
 #include <grp.h>
 #include <glib.h>
 #include <security/pam_appl.h>
-#include <utmp.h>
 #include <utmpx.h>
 #include <sys/mman.h>
+#if HAVE_MALLOC_TRIM
+#include <malloc.h>
+#endif
 
 #if HAVE_LIBAUDIT
 #include <libaudit.h>
 #endif
 
+#include "accounting.h"
 #include "configuration.h"
 #include "session-child.h"
 #include "session.h"
@@ -30,6 +33,7 @@
 #include "privileges.h"
 #include "x-authority.h"
 #include "configuration.h"
+#include "user-list.h"
 
 /* Child process being run */
 static GPid child_pid = 0;
@@ -192,26 +196,12 @@ read_xauth (void)
     return x_authority_new (x_authority_family, x_authority_address, x_authority_address_length, x_authority_number, x_authority_name, x_authority_data, x_authority_data_length);
 }
 
-/* GNU provides this but we can't rely on that so let's make our own version */
+/* Pass a login record to the daemon, which writes them to the system databases in batches */
 static void
-updwtmpx (const gchar *wtmp_file, struct utmpx *ut)
+write_accounting_record (AccountingEvent event, struct utmpx *ut)
 {
-    struct utmp u;
-    memset (&u, 0, sizeof (u));
-    u.ut_type = ut->ut_type;
-    u.ut_pid = ut->ut_pid;
-    if (ut->ut_line)
-        strncpy (u.ut_line, ut->ut_line, sizeof (u.ut_line));
-    if (ut->ut_id)
-        strncpy (u.ut_id, ut->ut_id, sizeof (u.ut_id));
-    if (ut->ut_user)
-        strncpy (u.ut_user, ut->ut_user, sizeof (u.ut_user));
-    if (ut->ut_host)
-        strncpy (u.ut_host, ut->ut_host, sizeof (u.ut_host));
-    u.ut_tv.tv_sec = ut->ut_tv.tv_sec;
-    u.ut_tv.tv_usec = ut->ut_tv.tv_usec;
-
-    updwtmp (wtmp_file, &u);
+    write_data (&event, sizeof (event));
+    write_data (ut, sizeof (*ut));
 }
 
 #if HAVE_LIBAUDIT
@@ -238,6 +228,26 @@ audit_event (int type, const gchar *username, uid_t uid, const gchar *remote_hos
 }
 #endif
 
+/* Drop everything not needed while waiting for the session to end */
+static void
+enter_slim_supervisor (void)
+{
+    /* The authentication tokens are not needed once the session is open */
+    pam_set_item (pam_handle, PAM_AUTHTOK, NULL);
+    pam_set_item (pam_handle, PAM_OLDAUTHTOK, NULL);
+
+    common_user_list_cleanup ();
+    config_cleanup ();
+
+#if HAVE_MALLOC_TRIM
+    /* Give the freed heap back to the system */
+    malloc_trim (0);
+#endif
+
+    /* Nothing left needs protecting from being paged to disk */
+    munlockall ();
+}
+
 int
 session_child_run (int argc, char **argv)
 {
@@ -326,6 +336,8 @@ session_child_run (int argc, char **argv)
 
     /* Authenticate */
     int authentication_result = PAM_SUCCESS;
+    gboolean login_failed = FALSE;
+    struct utmpx failed_login_ut;
     if (do_authenticate)
     {
         const gchar *new_username;
@@ -341,29 +353,28 @@ session_child_run (int argc, char **argv)
         g_free (username);
         username = g_strdup (new_username);
 
-        /* Write record to btmp database */
+        /* Keep record for btmp database, it is sent once the daemon knows the result */
         if (authentication_result == PAM_AUTH_ERR)
         {
-            struct utmpx ut;
+            struct utmpx *ut = &failed_login_ut;
             struct timeval tv;
 
-            memset (&ut, 0, sizeof (ut));
-            ut.ut_type = USER_PROCESS;
-            ut.ut_pid = getpid ();
+            login_failed = TRUE;
+            memset (ut, 0, sizeof (*ut));
+            ut->ut_type = USER_PROCESS;
+            ut->ut_pid = getpid ();
             if (xdisplay)
-                strncpy (ut.ut_id, xdisplay, sizeof (ut.ut_id));
+                strncpy (ut->ut_id, xdisplay, sizeof (ut->ut_id));
             if (tty && g_str_has_prefix (tty, "/dev/"))
-                strncpy (ut.ut_line, tty + strlen ("/dev/"), sizeof (ut.ut_line));
-            strncpy (ut.ut_user, username, sizeof (ut.ut_user));
+                strncpy (ut->ut_line, tty + strlen ("/dev/"), sizeof (ut->ut_line));
+            strncpy (ut->ut_user, username, sizeof (ut->ut_user));
             if (xdisplay)
-                strncpy (ut.ut_host, xdisplay, sizeof (ut.ut_host));
+                strncpy (ut->ut_host, xdisplay, sizeof (ut->ut_host));
             else if (remote_host_name)
-                strncpy (ut.ut_host, remote_host_name, sizeof (ut.ut_host));
+                strncpy (ut->ut_host, remote_host_name, sizeof (ut->ut_host));
             gettimeofday (&tv, NULL);
-            ut.ut_tv.tv_sec = tv.tv_sec;
-            ut.ut_tv.tv_usec = tv.tv_usec;
-
-            updwtmpx ("/var/log/btmp", &ut);
+            ut->ut_tv.tv_sec = tv.tv_sec;
+            ut->ut_tv.tv_usec = tv.tv_usec;
 
 #if HAVE_LIBAUDIT
             audit_event (AUDIT_USER_LOGIN, username, -1, remote_host_name, tty, FALSE);
@@ -438,6 +449,9 @@ session_child_run (int argc, char **argv)
     write_data (&authentication_result, sizeof (authentication_result));
     write_string (authentication_result_string);
 
+    if (login_failed)
+        write_accounting_record (ACCOUNTING_EVENT_LOGIN_FAILED, &failed_login_ut);
+
     /* Check we got a valid user */
     if (!username)
     {
@@ -482,6 +496,9 @@ session_child_run (int argc, char **argv)
     for (i = 0; i < command_argc; i++)
         command_argv[i] = read_string ();
     command_argv[i] = NULL;
+    gboolean slim_supervisor = FALSE;
+    if (version >= 4)
+        read_data (&slim_supervisor, sizeof (slim_supervisor));
 
     /* If nothing to run just refresh credentials because we successfully authenticated */
     if (command_argc == 0)
@@ -636,6 +653,10 @@ session_child_run (int argc, char **argv)
         if (setsid () < 0)
             _exit (errno);
 
+        /* The session must not be able to write to the daemon */
+        close (from_daemon_output);
+        close (to_daemon_input);
+
         /* Change to this user */
         if (getuid () == 0)
         {
@@ -703,18 +724,34 @@ session_child_run (int argc, char **argv)
             ut.ut_tv.tv_sec = tv.tv_sec;
             ut.ut_tv.tv_usec = tv.tv_usec;
 
-            /* Write records to utmp/wtmp databases */
-            setutxent ();
-            if (!pututxline (&ut))
-                g_printerr ("Failed to write utmpx: %s\n", strerror (errno));
-            endutxent ();
-            updwtmpx ("/var/log/wtmp", &ut);
+            /* Have the daemon write records to utmp/wtmp databases */
+            write_accounting_record (ACCOUNTING_EVENT_SESSION_OPENED, &ut);
 
 #if HAVE_LIBAUDIT
             audit_event (AUDIT_USER_LOGIN, username, uid, remote_host_name, tty, TRUE);
 #endif
         }
 
+        /* Only the values needed to close the session are kept from here */
+        if (slim_supervisor)
+        {
+            g_clear_pointer (&service, g_free);
+            g_clear_pointer (&unused_class, g_free);
+            g_clear_pointer (&authentication_result_string, g_free);
+            g_clear_pointer (&log_filename, g_free);
+            g_clear_pointer (&command_argv, g_strfreev);
+            g_clear_object (&user);
+
+            /* ConsoleKit closes the session if we drop the bus connection */
+            if (!console_kit_cookie)
+            {
+                g_dbus_connection_close_sync (bus, NULL, NULL);
+                g_clear_object (&bus);
+            }
+
+            enter_slim_supervisor ();
+        }
+
         int child_status;
         waitpid (child_pid, &child_status, 0);
         child_pid = 0;
@@ -744,12 +781,8 @@ session_child_run (int argc, char **argv)
             ut.ut_tv.tv_sec = tv.tv_sec;
             ut.ut_tv.tv_usec = tv.tv_usec;
 
-            /* Write records to utmp/wtmp databases */
-            setutxent ();
-            if (!pututxline (&ut))
-                g_printerr ("Failed to write utmpx: %s\n", strerror (errno));
-            endutxent ();
-            updwtmpx ("/var/log/wtmp", &ut);
+            /* Have the daemon write records to utmp/wtmp databases */
+            write_accounting_record (ACCOUNTING_EVENT_SESSION_CLOSED, &ut);
 
 #if HAVE_LIBAUDIT
             audit_event (AUDIT_USER_LOGOUT, username, uid, remote_host_name, tty, TRUE);
@@ -762,7 +795,7 @@ session_child_run (int argc, char **argv)
     {
         gboolean drop_privileges = geteuid () == 0;
         if (drop_privileges)
-            privileges_drop (user_get_uid (user), user_get_gid (user));
+            privileges_drop (uid, gid);
 
         g_autoptr(GError) error = NULL;
         gboolean result = x_authority_write (x_authority, XAUTH_WRITE_MODE_REMOVE, x_authority_filename, &error);
@@ -68,6 +68,21 @@ session_config_new_from_file (const gchar *filename, const gchar *default_sessio
     return g_steal_pointer (&config);
 }
 
+SessionConfig *
+session_config_new_from_session_entry (CommonSessionEntry *entry)
+{
+    g_return_val_if_fail (entry != NULL, NULL);
+    g_return_val_if_fail (common_session_entry_get_command (entry) != NULL, NULL);
+
+    SessionConfig *config = g_object_new (SESSION_CONFIG_TYPE, NULL);
+    config->priv->command = g_strdup (common_session_entry_get_command (entry));
+    config->priv->session_type = g_strdup (common_session_entry_get_session_type (entry));
+    config->priv->desktop_names = g_strdupv (common_session_entry_get_desktop_names (entry));
+    config->priv->allow_greeter = common_session_entry_get_allow_greeter (entry);
+
+    return config;
+}
+
 const gchar *
 session_config_get_command (SessionConfig *config)
 {
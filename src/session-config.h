@@ -14,6 +14,8 @@
 
 #include <glib-object.h>
 
+#include "session-list.h"
+
 G_BEGIN_DECLS
 
 #define SESSION_CONFIG_TYPE           (session_config_get_type())
@@ -40,6 +42,8 @@ GType session_config_get_type (void);
 
 SessionConfig *session_config_new_from_file (const gchar *filename, const gchar *default_session_type, GError **error);
 
+SessionConfig *session_config_new_from_session_entry (CommonSessionEntry *entry);
+
 const gchar *session_config_get_command (SessionConfig *config);
 
 const gchar *session_config_get_session_type (SessionConfig *config);
@@ -17,11 +17,13 @@
 #include <unistd.h>
 #include <sys/wait.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <glib/gstdio.h>
 #include <grp.h>
 #include <pwd.h>
 
 #include "session.h"
+#include "accounting.h"
 #include "configuration.h"
 #include "console-kit.h"
 #include "login1.h"
@@ -413,6 +415,78 @@ read_string_from_child (Session *session)
     return value;
 }
 
+static gboolean
+read_accounting_record (Session *session)
+{
+    AccountingEvent event;
+    if (read_from_child (session, &event, sizeof (event)) <= 0)
+        return FALSE;
+    struct utmpx ut;
+    if (read_from_child (session, &ut, sizeof (ut)) != sizeof (ut))
+        return FALSE;
+
+    accounting_add_record (event, &ut);
+
+    return TRUE;
+}
+
+static gboolean
+accounting_cb (GIOChannel *source, GIOCondition condition, gpointer data)
+{
+    Session *session = data;
+
+    if (condition == G_IO_HUP || !read_accounting_record (session))
+    {
+        session->priv->from_child_watch = 0;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+child_has_data (Session *session)
+{
+    struct pollfd fds = { session->priv->from_child_output, POLLIN, 0 };
+    return poll (&fds, 1, 0) > 0 && (fds.revents & POLLIN);
+}
+
+/* Read login records the child has already written, without waiting for more */
+static gboolean
+read_pending_accounting_records (Session *session)
+{
+    gboolean have_records = FALSE;
+    while (child_has_data (session) && read_accounting_record (session))
+        have_records = TRUE;
+
+    return have_records;
+}
+
+static gboolean from_child_cb (GIOChannel *source, GIOCondition condition, gpointer data);
+
+/* Handle everything the child wrote before exiting, it is lost once the pipe is closed */
+static void
+read_remaining_from_child (Session *session)
+{
+    if (session->priv->from_child_output < 0)
+        return;
+
+    /* Read directly, the main loop won't get another chance */
+    if (session->priv->from_child_watch)
+        g_source_remove (session->priv->from_child_watch);
+    session->priv->from_child_watch = 0;
+
+    /* The authentication result comes before any login records */
+    while (!session->priv->authentication_complete && child_has_data (session))
+    {
+        if (!from_child_cb (session->priv->from_child_channel, G_IO_IN, session))
+            break;
+    }
+
+    if (session->priv->authentication_complete)
+        read_pending_accounting_records (session);
+}
+
 static void
 session_watch_cb (GPid pid, gint status, gpointer data)
 {
@@ -428,6 +502,8 @@ session_watch_cb (GPid pid, gint status, gpointer data)
     /* do this as late as possible for log messages prefix */
     session->priv->pid = 0;
 
+    read_remaining_from_child (session);
+
     /* If failed during authentication then report this as an authentication failure */
     if (session->priv->authentication_started && !session->priv->authentication_complete)
     {
@@ -606,7 +682,7 @@ session_real_start (Session *session)
     close (from_child_input);
 
     /* Indicate what version of the protocol we are using */
-    int version = 3;
+    int version = 4;
     write_data (session, &version, sizeof (version));
 
     /* Send configuration */
@@ -810,9 +886,15 @@ session_real_run (Session *session)
     write_data (session, &argc, sizeof (argc));
     for (gsize i = 0; i < argc; i++)
         write_string (session, session->priv->argv[i]);
+    gboolean slim_supervisor = config_get_boolean (config_get_instance (), "LightDM", "slim-session-supervisor");
+    write_data (session, &slim_supervisor, sizeof (slim_supervisor));
 
     session->priv->login1_session_id = read_string_from_child (session);
     session->priv->console_kit_cookie = read_string_from_child (session);
+
+    /* Login records follow while the session runs */
+    if (!session->priv->from_child_watch)
+        session->priv->from_child_watch = g_io_add_watch (session->priv->from_child_channel, G_IO_IN | G_IO_HUP, accounting_cb, session);
 }
 
 void
@@ -929,6 +1011,9 @@ session_finalize (GObject *object)
     g_clear_object (&self->priv->display_server);
     if (self->priv->pid)
         kill (self->priv->pid, SIGKILL);
+    /* Write out login records the child sent, nothing else will once the pipe is closed */
+    if (self->priv->authentication_complete && self->priv->from_child_output >= 0 && read_pending_accounting_records (self))
+        accounting_flush ();
     close (self->priv->to_child_input);
     close (self->priv->from_child_output);
     g_clear_pointer (&self->priv->from_child_channel, g_io_channel_unref);
@@ -13,7 +13,12 @@
 #include <gio/gio.h>
 #include <pwd.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <string.h>
 
 #include "configuration.h"
 #include "shared-data-manager.h"
@@ -21,11 +26,20 @@
 
 #define NUM_ENUMERATION_FILES 100
 
+/* Maximum number of directories being deleted at once */
+#define MAX_DELETE_THREADS 2
+
 struct SharedDataManagerPrivate
 {
     gchar *greeter_user;
     guint32 greeter_gid;
     GHashTable *starting_dirs;
+
+    /* Users whose directories have been created and chowned this run */
+    GHashTable *ensured_dirs;
+
+    /* Threads deleting unused directories */
+    GThreadPool *delete_pool;
 };
 
 struct OwnerInfo
@@ -52,33 +66,198 @@ shared_data_manager_cleanup (void)
     g_clear_object (&singleton);
 }
 
+/* Directory being deleted, and the parent we expect to get back to through ".." */
+typedef struct
+{
+    gchar *name;
+    dev_t parent_dev;
+    ino_t parent_ino;
+} DeleteLevel;
+
+static void
+clear_delete_level (gpointer data)
+{
+    DeleteLevel *level = data;
+    g_free (level->name);
+}
+
+/* Remove everything in the directory open at fd up to the first directory, which is returned in subdir */
+static gboolean
+delete_files_at (int fd, gchar **subdir)
+{
+    /* Open a new descriptor so each scan starts from the beginning */
+    int dir_fd = openat (fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0)
+        return FALSE;
+    DIR *dir = fdopendir (dir_fd);
+    if (!dir)
+    {
+        int error = errno;
+        close (dir_fd);
+        errno = error;
+        return FALSE;
+    }
+
+    gboolean result = TRUE;
+    struct dirent *entry;
+    while ((entry = readdir (dir)))
+    {
+        if (strcmp (entry->d_name, ".") == 0 || strcmp (entry->d_name, "..") == 0)
+            continue;
+
+        /* Files and symbolic links are removed directly, links are never followed */
+        if (unlinkat (fd, entry->d_name, 0) == 0 || errno == ENOENT)
+            continue;
+
+        if (errno == EISDIR || errno == EPERM)
+            *subdir = g_strdup (entry->d_name);
+        else
+            result = FALSE;
+        break;
+    }
+    int error = errno;
+    closedir (dir);
+    errno = error;
+
+    return result;
+}
+
+static gboolean
+delete_at (int parent_fd, const gchar *name)
+{
+    if (unlinkat (parent_fd, name, 0) == 0 || errno == ENOENT)
+        return TRUE;
+    if (errno != EISDIR && errno != EPERM)
+        return FALSE;
+
+    /* Walk the tree holding only the current directory open so the depth isn't limited by
+     * the number of file descriptors. Stop on the first error, otherwise we'd keep coming
+     * back to whatever can't be removed. */
+    g_autoptr(GArray) levels = g_array_new (FALSE, FALSE, sizeof (DeleteLevel));
+    g_array_set_clear_func (levels, clear_delete_level);
+
+    struct stat info;
+    if (fstat (parent_fd, &info) < 0)
+        return FALSE;
+    int fd = openat (parent_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0)
+        return FALSE;
+    DeleteLevel top = { g_strdup (name), info.st_dev, info.st_ino };
+    g_array_append_val (levels, top);
+
+    gboolean result = TRUE;
+    while (levels->len > 0)
+    {
+        g_autofree gchar *subdir = NULL;
+        if (!delete_files_at (fd, &subdir))
+        {
+            result = FALSE;
+            break;
+        }
+
+        /* Descend into the next directory */
+        if (subdir)
+        {
+            if (fstat (fd, &info) < 0)
+            {
+                result = FALSE;
+                break;
+            }
+            int child_fd = openat (fd, subdir, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (child_fd < 0)
+            {
+                result = FALSE;
+                break;
+            }
+            close (fd);
+            fd = child_fd;
+            DeleteLevel level = { g_steal_pointer (&subdir), info.st_dev, info.st_ino };
+            g_array_append_val (levels, level);
+            continue;
+        }
+
+        /* This directory is now empty, go back up and remove it. Check we got back to
+         * where we came from in case the tree was moved while we were in it. */
+        DeleteLevel *level = &g_array_index (levels, DeleteLevel, levels->len - 1);
+        int up_fd = levels->len > 1 ? openat (fd, "..", O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC) : dup (parent_fd);
+        if (up_fd < 0)
+        {
+            result = FALSE;
+            break;
+        }
+        close (fd);
+        fd = up_fd;
+        if (fstat (fd, &info) < 0 || info.st_dev != level->parent_dev || info.st_ino != level->parent_ino)
+        {
+            errno = EXDEV;
+            result = FALSE;
+            break;
+        }
+        if (unlinkat (fd, level->name, AT_REMOVEDIR) < 0 && errno != ENOENT)
+        {
+            result = FALSE;
+            break;
+        }
+        g_array_set_size (levels, levels->len - 1);
+    }
+    int error = errno;
+    close (fd);
+    errno = error;
+
+    return result;
+}
+
+static void
+delete_user_dir_cb (gpointer data, gpointer user_data)
+{
+    g_autofree gchar *user = data;
+
+    int users_fd = open (USERS_DIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (users_fd < 0)
+    {
+        g_warning ("Could not open user data directory %s: %s", USERS_DIR, g_strerror (errno));
+        return;
+    }
+
+    g_debug ("Deleting unused user data directory %s/%s", USERS_DIR, user);
+    if (!delete_at (users_fd, user))
+    {
+        int error = errno;
+        g_warning ("Could not delete unused user data directory %s/%s: %s", USERS_DIR, user, g_strerror (error));
+    }
+
+    close (users_fd);
+}
+
 static void
 delete_unused_user (gpointer key, gpointer value, gpointer user_data)
 {
     const gchar *user = (const gchar *)key;
+    SharedDataManager *manager = SHARED_DATA_MANAGER (user_data);
 
-    /* For this operation, we just need a fire and forget rm -rf.  Since
-       recursively deleting in GIO is a huge pain in the butt, we'll just drop
-       to shell for this. */
+    /* Only ever delete direct children of the users directory */
+    if (strchr (user, '/') || strcmp (user, ".") == 0 || strcmp (user, "..") == 0)
+        return;
 
-    g_autofree gchar *path = g_build_filename (USERS_DIR, user, NULL);
-    g_autofree gchar *quoted_path = g_shell_quote (path);
-    g_autofree gchar *cmd = g_strdup_printf ("/bin/rm -rf %s", quoted_path);
+    g_hash_table_remove (manager->priv->ensured_dirs, user);
 
-    g_autoptr(GError) error = NULL;
-    g_spawn_command_line_async (cmd, &error);
-    if (error)
-        g_warning ("Could not delete unused user data directory %s: %s", path, error->message);
+    /* Deleted in the background so a large number of users doesn't stall the daemon */
+    g_thread_pool_push (manager->priv->delete_pool, g_strdup (user), NULL);
 }
 
 gchar *
 shared_data_manager_ensure_user_dir (SharedDataManager *manager, const gchar *user)
 {
+    g_autofree gchar *path = g_build_filename (USERS_DIR, user, NULL);
+
+    /* Already set up this run */
+    if (g_hash_table_contains (manager->priv->ensured_dirs, user))
+        return g_steal_pointer (&path);
+
     struct passwd *entry = getpwnam (user);
     if (!entry)
         return NULL;
 
-    g_autofree gchar *path = g_build_filename (USERS_DIR, user, NULL);
     g_autoptr(GFile) file = g_file_new_for_path (path);
 
     g_debug ("Creating shared data directory %s", path);
@@ -114,6 +293,8 @@ shared_data_manager_ensure_user_dir (SharedDataManager *manager, const gchar *us
     if (!result)
         return NULL;
 
+    g_hash_table_add (manager->priv->ensured_dirs, g_strdup (user));
+
     return g_steal_pointer (&path);
 }
 
@@ -205,6 +386,8 @@ static void
 shared_data_manager_init (SharedDataManager *manager)
 {
     manager->priv = G_TYPE_INSTANCE_GET_PRIVATE (manager, SHARED_DATA_MANAGER_TYPE, SharedDataManagerPrivate);
+    manager->priv->ensured_dirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    manager->priv->delete_pool = g_thread_pool_new (delete_user_dir_cb, NULL, MAX_DELETE_THREADS, FALSE, NULL);
 
     /* Grab current greeter-user gid */
     manager->priv->greeter_user = config_get_string (config_get_instance (), "LightDM", "greeter-user");
@@ -224,6 +407,12 @@ shared_data_manager_finalize (GObject *object)
 
     if (self->priv->starting_dirs)
         g_hash_table_destroy (self->priv->starting_dirs);
+    g_clear_pointer (&self->priv->ensured_dirs, g_hash_table_unref);
+
+    /* Finish deletions in progress, any not started are picked up on the next run */
+    if (self->priv->delete_pool)
+        g_thread_pool_free (self->priv->delete_pool, TRUE, TRUE);
+    self->priv->delete_pool = NULL;
 
     g_clear_pointer (&self->priv->greeter_user, g_free);
 
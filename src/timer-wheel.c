@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2010-2011 Robert Ancell.
+ * Author: Robert Ancell <robert.ancell@canonical.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#include "timer-wheel.h"
+
+/* Timers are kept in three levels of 64 slots. The first level has a slot
+ * for each of the next 64 seconds, each slot in the next level covers 64
+ * slots of the level below. A timer moves down a level each time the level
+ * below wraps around, so adding, removing and expiring a timer doesn't
+ * depend on how many other timers there are. */
+#define SLOT_BITS 6
+#define N_SLOTS (1 << SLOT_BITS)
+#define SLOT_MASK (N_SLOTS - 1)
+#define N_LEVELS 3
+
+/* Longest timeout that can be set, about three days */
+#define MAX_TICKS ((G_GUINT64_CONSTANT (1) << (SLOT_BITS * N_LEVELS)) - 1)
+
+struct TimerWheelTimer
+{
+    /* Tick this timer expires on */
+    guint64 expiry;
+
+    TimerWheelFunc func;
+    gpointer user_data;
+
+    /* Slot this timer is in and its position in it */
+    GQueue *slot;
+    GList *link;
+};
+
+struct TimerWheel
+{
+    GQueue slots[N_LEVELS][N_SLOTS];
+
+    /* Time the wheel was created, ticks are counted from here */
+    gint64 start_time;
+
+    /* Last tick processed */
+    guint64 current;
+
+    guint n_timers;
+
+    /* Timeout advancing the wheel, only running while there are timers */
+    guint tick_source;
+};
+
+TimerWheel *
+timer_wheel_new (void)
+{
+    TimerWheel *wheel = g_new0 (TimerWheel, 1);
+
+    for (int level = 0; level < N_LEVELS; level++)
+        for (int i = 0; i < N_SLOTS; i++)
+            g_queue_init (&wheel->slots[level][i]);
+    wheel->start_time = g_get_monotonic_time ();
+
+    return wheel;
+}
+
+static guint64
+get_now (TimerWheel *wheel)
+{
+    return (g_get_monotonic_time () - wheel->start_time) / G_USEC_PER_SEC;
+}
+
+static void
+insert_timer (TimerWheel *wheel, TimerWheelTimer *timer)
+{
+    guint64 delta = timer->expiry - wheel->current;
+
+    int level = 0;
+    while (level < N_LEVELS - 1 && delta >= (G_GUINT64_CONSTANT (1) << (SLOT_BITS * (level + 1))))
+        level++;
+
+    timer->slot = &wheel->slots[level][(timer->expiry >> (SLOT_BITS * level)) & SLOT_MASK];
+    g_queue_push_tail (timer->slot, timer);
+    timer->link = timer->slot->tail;
+}
+
+/* Move the timers in a slot down to the levels below */
+static void
+cascade (TimerWheel *wheel, int level)
+{
+    GQueue *slot = &wheel->slots[level][(wheel->current >> (SLOT_BITS * level)) & SLOT_MASK];
+    GQueue timers = *slot;
+    g_queue_init (slot);
+
+    TimerWheelTimer *timer;
+    while ((timer = g_queue_pop_head (&timers)))
+        insert_timer (wheel, timer);
+}
+
+static void
+advance (TimerWheel *wheel)
+{
+    wheel->current++;
+
+    /* When a level wraps around, bring down the timers that now fit in it */
+    for (int level = N_LEVELS - 1; level > 0; level--)
+        if ((wheel->current & ((G_GUINT64_CONSTANT (1) << (SLOT_BITS * level)) - 1)) == 0)
+            cascade (wheel, level);
+
+    /* Run timers one at a time, as callbacks may add and remove timers in this slot */
+    GQueue *slot = &wheel->slots[0][wheel->current & SLOT_MASK];
+    TimerWheelTimer *timer;
+    while ((timer = g_queue_pop_head (slot)))
+    {
+        TimerWheelFunc func = timer->func;
+        gpointer user_data = timer->user_data;
+
+        wheel->n_timers--;
+        g_free (timer);
+
+        func (user_data);
+    }
+}
+
+static gboolean
+tick_cb (gpointer data)
+{
+    TimerWheel *wheel = data;
+
+    /* Catch up if the main loop was blocked for more than one tick */
+    guint64 now = get_now (wheel);
+    while (wheel->current < now && wheel->n_timers > 0)
+        advance (wheel);
+
+    if (wheel->n_timers > 0)
+        return G_SOURCE_CONTINUE;
+
+    wheel->tick_source = 0;
+    return G_SOURCE_REMOVE;
+}
+
+TimerWheelTimer *
+timer_wheel_add (TimerWheel *wheel, guint timeout_seconds, TimerWheelFunc func, gpointer user_data)
+{
+    g_return_val_if_fail (wheel != NULL, NULL);
+    g_return_val_if_fail (func != NULL, NULL);
+
+    /* Nothing is in the wheel while it is stopped so it can jump straight to the current time */
+    if (wheel->tick_source == 0)
+    {
+        wheel->current = get_now (wheel);
+        wheel->tick_source = g_timeout_add_seconds (1, tick_cb, wheel);
+    }
+
+    TimerWheelTimer *timer = g_new0 (TimerWheelTimer, 1);
+    timer->expiry = wheel->current + CLAMP (timeout_seconds, 1, MAX_TICKS);
+    timer->func = func;
+    timer->user_data = user_data;
+    insert_timer (wheel, timer);
+    wheel->n_timers++;
+
+    return timer;
+}
+
+void
+timer_wheel_remove (TimerWheel *wheel, TimerWheelTimer *timer)
+{
+    g_return_if_fail (wheel != NULL);
+    g_return_if_fail (timer != NULL);
+
+    g_queue_delete_link (timer->slot, timer->link);
+    wheel->n_timers--;
+    g_free (timer);
+}
+
+guint
+timer_wheel_get_n_timers (TimerWheel *wheel)
+{
+    g_return_val_if_fail (wheel != NULL, 0);
+    return wheel->n_timers;
+}
+
+void
+timer_wheel_free (TimerWheel *wheel)
+{
+    if (!wheel)
+        return;
+
+    for (int level = 0; level < N_LEVELS; level++)
+        for (int i = 0; i < N_SLOTS; i++)
+        {
+            g_queue_foreach (&wheel->slots[level][i], (GFunc) g_free, NULL);
+            g_queue_clear (&wheel->slots[level][i]);
+        }
+    if (wheel->tick_source)
+        g_source_remove (wheel->tick_source);
+    g_free (wheel);
+}
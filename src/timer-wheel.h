@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2010-2011 Robert Ancell.
+ * Author: Robert Ancell <robert.ancell@canonical.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#ifndef TIMER_WHEEL_H_
+#define TIMER_WHEEL_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* A set of one-shot timers run from a single main loop source with a resolution of one second */
+typedef struct TimerWheel TimerWheel;
+
+typedef struct TimerWheelTimer TimerWheelTimer;
+
+/* Called when a timer expires, the timer has already been freed */
+typedef void (*TimerWheelFunc)(gpointer user_data);
+
+TimerWheel *timer_wheel_new (void);
+
+TimerWheelTimer *timer_wheel_add (TimerWheel *wheel, guint timeout_seconds, TimerWheelFunc func, gpointer user_data);
+
+void timer_wheel_remove (TimerWheel *wheel, TimerWheelTimer *timer);
+
+guint timer_wheel_get_n_timers (TimerWheel *wheel);
+
+void timer_wheel_free (TimerWheel *wheel);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (TimerWheel, timer_wheel_free)
+
+G_END_DECLS
+
+#endif /* TIMER_WHEEL_H_ */
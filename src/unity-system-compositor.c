@@ -20,6 +20,7 @@
 
 #include "unity-system-compositor.h"
 #include "configuration.h"
+#include "message-channel.h"
 #include "process.h"
 #include "greeter-session.h"
 #include "vt.h"
@@ -43,14 +44,15 @@ struct UnitySystemCompositorPrivate
     int to_compositor_pipe[2];
     int from_compositor_pipe[2];
 
-    /* IO channel listening on for messages from the compositor */
-    GIOChannel *from_compositor_channel;
-    guint from_compositor_watch;
+    /* Channel to exchange messages with the compositor */
+    MessageChannel *channel;
 
-    /* Buffer reading from channel */
-    guint8 *read_buffer;
-    gsize read_buffer_length;
-    gsize read_buffer_n_used;
+    /* Seconds between checking the compositor is responding */
+    gint ping_interval;
+    guint ping_source;
+
+    /* Time the unanswered ping was sent or 0 if not waiting for a reply */
+    gint64 ping_time;
 
     /* Timeout when waiting for compositor to start */
     gint timeout;
@@ -133,21 +135,25 @@ unity_system_compositor_set_timeout (UnitySystemCompositor *compositor, gint tim
     compositor->priv->timeout = timeout;
 }
 
+void
+unity_system_compositor_set_ping_interval (UnitySystemCompositor *compositor, gint ping_interval)
+{
+    g_return_if_fail (compositor != NULL);
+    compositor->priv->ping_interval = ping_interval;
+}
+
 static void
 write_message (UnitySystemCompositor *compositor, guint16 id, const guint8 *payload, guint16 payload_length)
 {
-    gsize data_length = 4 + payload_length;
-    g_autofree guint8 *data = g_malloc (data_length);
-    data[0] = id >> 8;
-    data[1] = id & 0xFF;
-    data[2] = payload_length >> 8;
-    data[3] = payload_length & 0xFF;
-    if (payload)
-        memcpy (data + 4, payload, payload_length);
-
-    errno = 0;
-    if (write (compositor->priv->to_compositor_pipe[1], data, data_length) != data_length)
-        l_warning (compositor, "Failed to write to compositor: %s", strerror (errno));
+    if (!compositor->priv->channel)
+    {
+        l_warning (compositor, "Not sending message %d, compositor not running", id);
+        return;
+    }
+
+    /* Messages are queued if the compositor isn't reading, so a busy compositor doesn't block the daemon */
+    if (!message_channel_send (compositor->priv->channel, id, payload, payload_length))
+        l_warning (compositor, "Failed to send message %d to compositor", id);
 }
 
 void
@@ -232,59 +238,26 @@ get_absolute_command (const gchar *command)
 }
 
 static gboolean
-read_cb (GIOChannel *source, GIOCondition condition, gpointer data)
+ping_cb (gpointer data)
 {
     UnitySystemCompositor *compositor = data;
 
-    if (condition == G_IO_HUP)
-    {
-        l_debug (compositor, "Compositor closed communication channel");
-        compositor->priv->from_compositor_watch = 0;
-        return FALSE;
-    }
-
-    /* Work out how much required for a message */
-    gsize n_to_read = 0;
-    if (compositor->priv->read_buffer_n_used < 4)
-        n_to_read = 4 - compositor->priv->read_buffer_n_used;
-    else
+    if (compositor->priv->ping_time != 0)
     {
-        guint16 payload_length = compositor->priv->read_buffer[2] << 8 | compositor->priv->read_buffer[3];
-        n_to_read = 4 + payload_length - compositor->priv->read_buffer_n_used;
+        l_warning (compositor, "Compositor has not answered ping sent %" G_GINT64_FORMAT "s ago",
+                   (g_get_monotonic_time () - compositor->priv->ping_time) / G_USEC_PER_SEC);
+        return G_SOURCE_CONTINUE;
     }
 
-    /* Read from compositor */
-    if (n_to_read > 0)
-    {
-        gsize n_total = compositor->priv->read_buffer_n_used + n_to_read;
-        if (compositor->priv->read_buffer_length < n_total)
-            compositor->priv->read_buffer = g_realloc (compositor->priv->read_buffer, n_total);
-
-        g_autoptr(GError) error = NULL;
-        gsize n_read = 0;
-        GIOStatus status = g_io_channel_read_chars (source,
-                                                    (gchar *)compositor->priv->read_buffer + compositor->priv->read_buffer_n_used,
-                                                    n_to_read,
-                                                    &n_read,
-                                                    &error);
-        if (error)
-            l_warning (compositor, "Failed to read from compositor: %s", error->message);
-        if (status != G_IO_STATUS_NORMAL)
-            return TRUE;
-        compositor->priv->read_buffer_n_used += n_read;
-    }
+    compositor->priv->ping_time = g_get_monotonic_time ();
+    write_message (compositor, USC_MESSAGE_PING, NULL, 0);
 
-    /* Read header */
-    if (compositor->priv->read_buffer_n_used < 4)
-         return TRUE;
-    guint16 id = compositor->priv->read_buffer[0] << 8 | compositor->priv->read_buffer[1];
-    guint16 payload_length = compositor->priv->read_buffer[2] << 8 | compositor->priv->read_buffer[3];
-
-    /* Read payload */
-    if (compositor->priv->read_buffer_n_used < 4 + payload_length)
-        return TRUE;
-    /*guint8 *payload = compositor->priv->read_buffer + 4;*/
+    return G_SOURCE_CONTINUE;
+}
 
+static void
+message_cb (MessageChannel *channel, guint id, const guint8 *payload, guint payload_length, UnitySystemCompositor *compositor)
+{
     switch (id)
     {
     case USC_MESSAGE_PING:
@@ -293,6 +266,12 @@ read_cb (GIOChannel *source, GIOCondition condition, gpointer data)
         break;
     case USC_MESSAGE_PONG:
         l_debug (compositor, "PONG!");
+        if (compositor->priv->ping_time != 0)
+        {
+            gint64 latency = g_get_monotonic_time () - compositor->priv->ping_time;
+            compositor->priv->ping_time = 0;
+            l_debug (compositor, "Compositor answered ping in %" G_GINT64_FORMAT "us", latency);
+        }
         break;
     case USC_MESSAGE_READY:
         l_debug (compositor, "READY");
@@ -302,6 +281,8 @@ read_cb (GIOChannel *source, GIOCondition condition, gpointer data)
             l_debug (compositor, "Compositor ready");
             g_source_remove (compositor->priv->timeout_source);
             compositor->priv->timeout_source = 0;
+            if (compositor->priv->ping_interval > 0)
+                compositor->priv->ping_source = g_timeout_add_seconds (compositor->priv->ping_interval, ping_cb, compositor);
             DISPLAY_SERVER_CLASS (unity_system_compositor_parent_class)->start (DISPLAY_SERVER (compositor));
         }
         break;
@@ -312,11 +293,12 @@ read_cb (GIOChannel *source, GIOCondition condition, gpointer data)
         l_warning (compositor, "Ignoring unknown message %d with %d octets from system compositor", id, payload_length);
         break;
     }
+}
 
-    /* Clear buffer */
-    compositor->priv->read_buffer_n_used = 0;
-
-    return TRUE;
+static void
+closed_cb (MessageChannel *channel, UnitySystemCompositor *compositor)
+{
+    l_debug (compositor, "Compositor closed communication channel");
 }
 
 static void
@@ -349,6 +331,10 @@ stopped_cb (Process *process, UnitySystemCompositor *compositor)
     if (compositor->priv->timeout_source != 0)
         g_source_remove (compositor->priv->timeout_source);
     compositor->priv->timeout_source = 0;
+    if (compositor->priv->ping_source != 0)
+        g_source_remove (compositor->priv->ping_source);
+    compositor->priv->ping_source = 0;
+    compositor->priv->ping_time = 0;
 
     /* Release VT and display number for re-use */
     if (compositor->priv->have_vt_ref)
@@ -383,8 +369,9 @@ unity_system_compositor_start (DisplayServer *server)
     fcntl (compositor->priv->from_compositor_pipe[0], F_SETFD, FD_CLOEXEC);
 
     /* Listen for messages from the compositor */
-    compositor->priv->from_compositor_channel = g_io_channel_unix_new (compositor->priv->from_compositor_pipe[0]);
-    compositor->priv->from_compositor_watch = g_io_add_watch (compositor->priv->from_compositor_channel, G_IO_IN | G_IO_HUP, read_cb, compositor);
+    compositor->priv->channel = message_channel_new (compositor->priv->to_compositor_pipe[1], compositor->priv->from_compositor_pipe[0], MESSAGE_CHANNEL_HEADER_16);
+    g_signal_connect (compositor->priv->channel, MESSAGE_CHANNEL_SIGNAL_MESSAGE, G_CALLBACK (message_cb), compositor);
+    g_signal_connect (compositor->priv->channel, MESSAGE_CHANNEL_SIGNAL_CLOSED, G_CALLBACK (closed_cb), compositor);
 
     /* Setup logging */
     g_autofree gchar *dir = config_get_string (config_get_instance (), "LightDM", "log-directory");
@@ -476,16 +463,17 @@ unity_system_compositor_finalize (GObject *object)
     g_clear_pointer (&self->priv->socket, g_free);
     if (self->priv->have_vt_ref)
         vt_unref (self->priv->vt);
+    if (self->priv->channel)
+        g_signal_handlers_disconnect_matched (self->priv->channel, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, self);
+    g_clear_object (&self->priv->channel);
     close (self->priv->to_compositor_pipe[0]);
     close (self->priv->to_compositor_pipe[1]);
     close (self->priv->from_compositor_pipe[0]);
     close (self->priv->from_compositor_pipe[1]);
-    g_clear_pointer (&self->priv->from_compositor_channel, g_io_channel_unref);
-    if (self->priv->from_compositor_watch)
-        g_source_remove (self->priv->from_compositor_watch);
-    g_clear_pointer (&self->priv->read_buffer, g_free);
     if (self->priv->timeout_source)
         g_source_remove (self->priv->timeout_source);
+    if (self->priv->ping_source)
+        g_source_remove (self->priv->ping_source);
 
     G_OBJECT_CLASS (unity_system_compositor_parent_class)->finalize (object);
 }
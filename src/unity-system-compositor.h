@@ -48,6 +48,8 @@ void unity_system_compositor_set_vt (UnitySystemCompositor *compositor, gint vt)
 
 void unity_system_compositor_set_timeout (UnitySystemCompositor *compositor, gint timeout);
 
+void unity_system_compositor_set_ping_interval (UnitySystemCompositor *compositor, gint ping_interval);
+
 void unity_system_compositor_set_active_session (UnitySystemCompositor *compositor, const gchar *id);
 
 void unity_system_compositor_set_next_session (UnitySystemCompositor *compositor, const gchar *id);
@@ -29,10 +29,56 @@ struct VNCServerPrivate
 
     /* Listening sockets */
     GSocket *socket, *socket6;
+
+    /* Sources watching the listening sockets */
+    GSource *source, *source6;
+
+    /* Limits on connections, 0 for no limit */
+    guint max_seats;
+    guint max_starting;
+    guint max_queued;
+    guint address_rate_limit;
+
+    /* Connections passed on, mapped to TRUE once their X server is ready */
+    GHashTable *connections;
+    guint n_starting;
+
+    /* Seats started ahead of connections, and how many of them are ready */
+    guint n_pooled;
+    guint n_pooled_ready;
+
+    /* Connections waiting for a free slot */
+    GQueue *queue;
+    guint queue_source;
+
+    /* Connections from each address in the current minute */
+    GHashTable *address_rates;
+
+    /* Counters reported in the statistics */
+    guint64 n_accepted;
+    guint64 n_rate_limited;
+    guint64 n_rejected;
 };
 
+typedef struct
+{
+    gint64 window_start;
+    guint count;
+} AddressRate;
+
 G_DEFINE_TYPE (VNCServer, vnc_server, G_TYPE_OBJECT)
 
+#define DEFAULT_PORT 5900
+
+/* Most connections to accept in one wakeup so other sources still get to run */
+#define MAX_ACCEPTS 64
+
+/* Period the address rate limit applies over */
+#define RATE_WINDOW (60 * G_USEC_PER_SEC)
+
+/* Number of addresses to remember before removing expired ones */
+#define MAX_ADDRESS_RATES 1024
+
 VNCServer *
 vnc_server_new (void)
 {
@@ -43,7 +89,7 @@ void
 vnc_server_set_port (VNCServer *server, guint port)
 {
     g_return_if_fail (server != NULL);
-    server->priv->port = port;
+    server->priv->port = port > 0 ? port : DEFAULT_PORT;
 }
 
 guint
@@ -69,21 +115,179 @@ vnc_server_get_listen_address (VNCServer *server)
     return server->priv->listen_address;
 }
 
+void
+vnc_server_set_max_seats (VNCServer *server, guint max_seats)
+{
+    g_return_if_fail (server != NULL);
+    server->priv->max_seats = max_seats;
+}
+
+void
+vnc_server_set_max_starting (VNCServer *server, guint max_starting)
+{
+    g_return_if_fail (server != NULL);
+    server->priv->max_starting = max_starting;
+}
+
+void
+vnc_server_set_max_queued (VNCServer *server, guint max_queued)
+{
+    g_return_if_fail (server != NULL);
+    server->priv->max_queued = max_queued;
+}
+
+void
+vnc_server_set_address_rate_limit (VNCServer *server, guint connections_per_minute)
+{
+    g_return_if_fail (server != NULL);
+    server->priv->address_rate_limit = connections_per_minute;
+}
+
 static gboolean
-read_cb (GSocket *socket, GIOCondition condition, VNCServer *server)
+rate_expired_cb (gpointer key, gpointer value, gpointer data)
+{
+    AddressRate *rate = value;
+    gint64 *now = data;
+    return *now - rate->window_start >= RATE_WINDOW;
+}
+
+/* Returns FALSE if this address has connected too often recently */
+static gboolean
+check_address_rate (VNCServer *server, const gchar *hostname)
+{
+    if (server->priv->address_rate_limit == 0)
+        return TRUE;
+
+    gint64 now = g_get_monotonic_time ();
+    if (g_hash_table_size (server->priv->address_rates) >= MAX_ADDRESS_RATES)
+        g_hash_table_foreach_remove (server->priv->address_rates, rate_expired_cb, &now);
+
+    AddressRate *rate = g_hash_table_lookup (server->priv->address_rates, hostname);
+    if (!rate)
+    {
+        rate = g_new0 (AddressRate, 1);
+        g_hash_table_insert (server->priv->address_rates, g_strdup (hostname), rate);
+    }
+    if (now - rate->window_start >= RATE_WINDOW)
+    {
+        rate->window_start = now;
+        rate->count = 0;
+    }
+
+    if (rate->count >= server->priv->address_rate_limit)
+        return FALSE;
+    rate->count++;
+
+    return TRUE;
+}
+
+/* Pooled seats count against the limits the same as seats for connections */
+static gboolean
+can_start_seat (VNCServer *server)
+{
+    guint n_seats = g_hash_table_size (server->priv->connections) + server->priv->n_pooled;
+    guint n_starting = server->priv->n_starting + server->priv->n_pooled - server->priv->n_pooled_ready;
+
+    if (server->priv->max_seats > 0 && n_seats >= server->priv->max_seats)
+        return FALSE;
+    if (server->priv->max_starting > 0 && n_starting >= server->priv->max_starting)
+        return FALSE;
+    return TRUE;
+}
+
+static gboolean
+can_start_connection (VNCServer *server)
+{
+    /* A ready pooled seat takes the connection without starting another X server */
+    return server->priv->n_pooled_ready > 0 || can_start_seat (server);
+}
+
+static void
+start_connection (VNCServer *server, GSocket *connection)
+{
+    g_hash_table_insert (server->priv->connections, g_object_ref (connection), GINT_TO_POINTER (FALSE));
+    server->priv->n_starting++;
+    server->priv->n_accepted++;
+
+    g_signal_emit (server, signals[NEW_CONNECTION], 0, connection);
+}
+
+static gboolean
+queue_cb (gpointer data)
+{
+    VNCServer *server = data;
+
+    server->priv->queue_source = 0;
+    while (!g_queue_is_empty (server->priv->queue) && can_start_connection (server))
+    {
+        g_autoptr(GSocket) connection = g_queue_pop_head (server->priv->queue);
+
+        /* VNC clients wait for the server to speak first, so anything to read means the client has gone */
+        if (g_socket_condition_check (connection, G_IO_IN | G_IO_HUP | G_IO_ERR) != 0)
+        {
+            g_debug ("Dropping queued VNC connection that has closed");
+            continue;
+        }
+
+        g_debug ("Starting queued VNC connection, %u still waiting", g_queue_get_length (server->priv->queue));
+        start_connection (server, connection);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Queued connections are started from an idle callback so seats aren't added while others are being removed */
+static void
+schedule_queue (VNCServer *server)
+{
+    if (!g_queue_is_empty (server->priv->queue) && server->priv->queue_source == 0)
+        server->priv->queue_source = g_idle_add (queue_cb, server);
+}
+
+static void
+handle_connection (VNCServer *server, GSocket *connection)
 {
-    g_autoptr(GError) error = NULL;
-    g_autoptr(GSocket) client_socket = g_socket_accept (socket, NULL, &error);
-    if (error)
-        g_warning ("Failed to get connection from from VNC socket: %s", error->message);
+    GInetSocketAddress *address = G_INET_SOCKET_ADDRESS (g_socket_get_remote_address (connection, NULL));
+    g_autofree gchar *hostname = g_inet_address_to_string (g_inet_socket_address_get_address (address));
+    g_debug ("Got VNC connection from %s:%d", hostname, g_inet_socket_address_get_port (address));
+
+    if (!check_address_rate (server, hostname))
+    {
+        g_debug ("Rejecting VNC connection, more than %u connections from %s in the last minute", server->priv->address_rate_limit, hostname);
+        server->priv->n_rate_limited++;
+        return;
+    }
 
-    if (client_socket)
+    if (g_queue_is_empty (server->priv->queue) && can_start_connection (server))
+        start_connection (server, connection);
+    else if (server->priv->max_queued == 0 || g_queue_get_length (server->priv->queue) < server->priv->max_queued)
     {
-        GInetSocketAddress *address = G_INET_SOCKET_ADDRESS (g_socket_get_remote_address (client_socket, NULL));
-        g_autofree gchar *hostname = g_inet_address_to_string (g_inet_socket_address_get_address (address));
-        g_debug ("Got VNC connection from %s:%d", hostname, g_inet_socket_address_get_port (address));
+        g_queue_push_tail (server->priv->queue, g_object_ref (connection));
+        g_debug ("Queueing VNC connection from %s, %u waiting", hostname, g_queue_get_length (server->priv->queue));
+    }
+    else
+    {
+        g_debug ("Rejecting VNC connection from %s, queue is full", hostname);
+        server->priv->n_rejected++;
+    }
+}
 
-        g_signal_emit (server, signals[NEW_CONNECTION], 0, client_socket);
+static gboolean
+read_cb (GSocket *socket, GIOCondition condition, VNCServer *server)
+{
+    /* Take every waiting connection so a burst doesn't need a wakeup for each one */
+    for (int i = 0; i < MAX_ACCEPTS; i++)
+    {
+        g_autoptr(GError) error = NULL;
+        g_autoptr(GSocket) client_socket = g_socket_accept (socket, NULL, &error);
+        if (!client_socket)
+        {
+            if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
+                g_warning ("Failed to get connection from from VNC socket: %s", error->message);
+            break;
+        }
+
+        handle_connection (server, client_socket);
     }
 
     return TRUE;
@@ -110,6 +314,7 @@ open_tcp_socket (GSocketFamily family, guint port, const gchar *listen_address,
     if (!g_socket_bind (socket, address, TRUE, error) ||
         !g_socket_listen (socket, error))
         return NULL;
+    g_socket_set_blocking (socket, FALSE);
 
     return g_steal_pointer (&socket);
 }
@@ -126,9 +331,9 @@ vnc_server_start (VNCServer *server)
 
     if (server->priv->socket)
     {
-        GSource *source = g_socket_create_source (server->priv->socket, G_IO_IN, NULL);
-        g_source_set_callback (source, (GSourceFunc) read_cb, server, NULL);
-        g_source_attach (source, NULL);
+        server->priv->source = g_socket_create_source (server->priv->socket, G_IO_IN, NULL);
+        g_source_set_callback (server->priv->source, (GSourceFunc) read_cb, server, NULL);
+        g_source_attach (server->priv->source, NULL);
     }
 
     g_autoptr(GError) ipv6_error = NULL;
@@ -138,9 +343,9 @@ vnc_server_start (VNCServer *server)
 
     if (server->priv->socket6)
     {
-        GSource *source = g_socket_create_source (server->priv->socket6, G_IO_IN, NULL);
-        g_source_set_callback (source, (GSourceFunc) read_cb, server, NULL);
-        g_source_attach (source, NULL);
+        server->priv->source6 = g_socket_create_source (server->priv->socket6, G_IO_IN, NULL);
+        g_source_set_callback (server->priv->source6, (GSourceFunc) read_cb, server, NULL);
+        g_source_attach (server->priv->source6, NULL);
     }
 
     if (!server->priv->socket && !server->priv->socket6)
@@ -149,11 +354,113 @@ vnc_server_start (VNCServer *server)
     return TRUE;
 }
 
+void
+vnc_server_connection_ready (VNCServer *server, GSocket *connection)
+{
+    g_return_if_fail (server != NULL);
+
+    gpointer value;
+    if (!g_hash_table_lookup_extended (server->priv->connections, connection, NULL, &value) || GPOINTER_TO_INT (value))
+        return;
+
+    g_hash_table_insert (server->priv->connections, g_object_ref (connection), GINT_TO_POINTER (TRUE));
+    server->priv->n_starting--;
+    schedule_queue (server);
+}
+
+void
+vnc_server_connection_closed (VNCServer *server, GSocket *connection)
+{
+    g_return_if_fail (server != NULL);
+
+    gpointer value;
+    if (!g_hash_table_lookup_extended (server->priv->connections, connection, NULL, &value))
+        return;
+
+    if (!GPOINTER_TO_INT (value))
+        server->priv->n_starting--;
+    g_hash_table_remove (server->priv->connections, connection);
+    schedule_queue (server);
+}
+
+gboolean
+vnc_server_can_start_pooled_seat (VNCServer *server)
+{
+    g_return_val_if_fail (server != NULL, FALSE);
+
+    /* Waiting connections get any free slots first */
+    return g_queue_is_empty (server->priv->queue) && can_start_seat (server);
+}
+
+void
+vnc_server_pooled_seat_added (VNCServer *server)
+{
+    g_return_if_fail (server != NULL);
+    server->priv->n_pooled++;
+}
+
+void
+vnc_server_pooled_seat_ready (VNCServer *server)
+{
+    g_return_if_fail (server != NULL);
+    g_return_if_fail (server->priv->n_pooled_ready < server->priv->n_pooled);
+
+    server->priv->n_pooled_ready++;
+    schedule_queue (server);
+}
+
+void
+vnc_server_pooled_seat_removed (VNCServer *server, gboolean was_ready)
+{
+    g_return_if_fail (server != NULL);
+    g_return_if_fail (server->priv->n_pooled > 0);
+
+    server->priv->n_pooled--;
+    if (was_ready)
+        server->priv->n_pooled_ready--;
+    schedule_queue (server);
+}
+
+GVariant *
+vnc_server_get_statistics (VNCServer *server)
+{
+    g_return_val_if_fail (server != NULL, NULL);
+
+    GVariantBuilder builder;
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{st}"));
+    g_variant_builder_add (&builder, "{st}", "active", (guint64) g_hash_table_size (server->priv->connections));
+    g_variant_builder_add (&builder, "{st}", "starting", (guint64) server->priv->n_starting);
+    g_variant_builder_add (&builder, "{st}", "queued", (guint64) g_queue_get_length (server->priv->queue));
+    g_variant_builder_add (&builder, "{st}", "accepted", server->priv->n_accepted);
+    g_variant_builder_add (&builder, "{st}", "rate-limited", server->priv->n_rate_limited);
+    g_variant_builder_add (&builder, "{st}", "rejected", server->priv->n_rejected);
+
+    return g_variant_builder_end (&builder);
+}
+
+void
+vnc_server_stop (VNCServer *server)
+{
+    g_return_if_fail (server != NULL);
+
+    if (server->priv->source)
+        g_source_destroy (server->priv->source);
+    g_clear_pointer (&server->priv->source, g_source_unref);
+    if (server->priv->source6)
+        g_source_destroy (server->priv->source6);
+    g_clear_pointer (&server->priv->source6, g_source_unref);
+    g_clear_object (&server->priv->socket);
+    g_clear_object (&server->priv->socket6);
+}
+
 static void
 vnc_server_init (VNCServer *server)
 {
     server->priv = G_TYPE_INSTANCE_GET_PRIVATE (server, VNC_SERVER_TYPE, VNCServerPrivate);
-    server->priv->port = 5900;
+    server->priv->port = DEFAULT_PORT;
+    server->priv->connections = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, NULL);
+    server->priv->queue = g_queue_new ();
+    server->priv->address_rates = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 }
 
 static void
@@ -161,9 +468,13 @@ vnc_server_finalize (GObject *object)
 {
     VNCServer *self = VNC_SERVER (object);
 
+    vnc_server_stop (self);
     g_clear_pointer (&self->priv->listen_address, g_free);
-    g_clear_object (&self->priv->socket);
-    g_clear_object (&self->priv->socket6);
+    g_hash_table_unref (self->priv->connections);
+    g_queue_free_full (self->priv->queue, g_object_unref);
+    if (self->priv->queue_source)
+        g_source_remove (self->priv->queue_source);
+    g_hash_table_unref (self->priv->address_rates);
 
     G_OBJECT_CLASS (vnc_server_parent_class)->finalize (object);
 }
@@ -48,8 +48,32 @@ void vnc_server_set_listen_address (VNCServer *server, const gchar *listen_addre
 
 const gchar *vnc_server_get_listen_address (VNCServer *server);
 
+void vnc_server_set_max_seats (VNCServer *server, guint max_seats);
+
+void vnc_server_set_max_starting (VNCServer *server, guint max_starting);
+
+void vnc_server_set_max_queued (VNCServer *server, guint max_queued);
+
+void vnc_server_set_address_rate_limit (VNCServer *server, guint connections_per_minute);
+
 gboolean vnc_server_start (VNCServer *server);
 
+void vnc_server_stop (VNCServer *server);
+
+void vnc_server_connection_ready (VNCServer *server, GSocket *connection);
+
+void vnc_server_connection_closed (VNCServer *server, GSocket *connection);
+
+gboolean vnc_server_can_start_pooled_seat (VNCServer *server);
+
+void vnc_server_pooled_seat_added (VNCServer *server);
+
+void vnc_server_pooled_seat_ready (VNCServer *server);
+
+void vnc_server_pooled_seat_removed (VNCServer *server, gboolean was_ready);
+
+GVariant *vnc_server_get_statistics (VNCServer *server);
+
 G_END_DECLS
 
 #endif /* VNC_SERVER_H_ */
@@ -0,0 +1,409 @@
+/*
+ * Copyright (C) 2010-2011 Robert Ancell.
+ * Author: Robert Ancell <robert.ancell@canonical.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "x-server-capabilities.h"
+#include "configuration.h"
+
+struct XServerCapabilities
+{
+    /* Path to the X server binary */
+    gchar *path;
+
+    /* Size and modification time of the binary */
+    goffset size;
+    gint64 mtime;
+
+    /* TRUE when the values below are valid for this binary */
+    gboolean known;
+
+    /* Version reported by the server */
+    gchar *version;
+    guint version_major, version_minor;
+
+    /* Command line options the server supports */
+    guint options;
+
+    /* TRUE while running the binary to find the values */
+    gboolean probing;
+
+    /* Callbacks waiting for probing to complete */
+    GList *waiters;
+};
+
+typedef struct
+{
+    XServerCapabilitiesCallback callback;
+    gpointer user_data;
+} Waiter;
+
+static const struct
+{
+    const gchar *name;
+    XServerOptions option;
+} option_names[] =
+{
+    { "-listen",    X_SERVER_OPTION_LISTEN },
+    { "-displayfd", X_SERVER_OPTION_DISPLAYFD },
+    { "-seat",      X_SERVER_OPTION_SEAT }
+};
+
+#define XORG_VERSION_PREFIX "X.Org X Server "
+
+/* Capabilities for each binary, keyed by path */
+static GHashTable *capabilities_table = NULL;
+
+/* Capabilities stored in the cache directory */
+static GKeyFile *cache = NULL;
+
+/* Cancellable for probes in progress */
+static GCancellable *cancellable = NULL;
+
+static void start_probe (XServerCapabilities *capabilities);
+
+static void
+free_capabilities (gpointer data)
+{
+    XServerCapabilities *capabilities = data;
+
+    g_free (capabilities->path);
+    g_free (capabilities->version);
+    g_list_free_full (capabilities->waiters, g_free);
+    g_free (capabilities);
+}
+
+static gchar *
+get_cache_path (void)
+{
+    g_autofree gchar *cache_dir = config_get_string (config_get_instance (), "LightDM", "cache-directory");
+    return g_build_filename (cache_dir, "xserver-capabilities", NULL);
+}
+
+static GKeyFile *
+get_cache (void)
+{
+    if (cache)
+        return cache;
+
+    cache = g_key_file_new ();
+    g_autofree gchar *path = get_cache_path ();
+    g_autoptr(GError) error = NULL;
+    if (!g_key_file_load_from_file (cache, path, G_KEY_FILE_NONE, &error) &&
+        !g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        g_warning ("Failed to load X server capabilities from %s: %s", path, error->message);
+
+    return cache;
+}
+
+static void
+set_version (XServerCapabilities *capabilities, const gchar *version)
+{
+    g_free (capabilities->version);
+    capabilities->version = g_strdup (version);
+    capabilities->version_major = 0;
+    capabilities->version_minor = 0;
+    if (!version)
+        return;
+
+    g_auto(GStrv) tokens = g_strsplit (version, ".", 3);
+    guint n_tokens = g_strv_length (tokens);
+    capabilities->version_major = n_tokens > 0 ? atoi (tokens[0]) : 0;
+    capabilities->version_minor = n_tokens > 1 ? atoi (tokens[1]) : 0;
+}
+
+static guint
+find_option (const gchar *name)
+{
+    for (gsize i = 0; i < G_N_ELEMENTS (option_names); i++)
+        if (strcmp (option_names[i].name, name) == 0)
+            return option_names[i].option;
+
+    return 0;
+}
+
+static void
+load_from_cache (XServerCapabilities *capabilities)
+{
+    GKeyFile *key_file = get_cache ();
+    const gchar *group = capabilities->path;
+
+    if (capabilities->size < 0 || !g_key_file_has_group (key_file, group))
+        return;
+
+    /* Ignore if the binary has been replaced since it was probed */
+    if (g_key_file_get_int64 (key_file, group, "size", NULL) != capabilities->size ||
+        g_key_file_get_int64 (key_file, group, "mtime", NULL) != capabilities->mtime)
+        return;
+
+    g_autofree gchar *version = g_key_file_get_string (key_file, group, "version", NULL);
+    set_version (capabilities, version);
+    capabilities->options = 0;
+    g_auto(GStrv) options = g_key_file_get_string_list (key_file, group, "options", NULL, NULL);
+    for (gchar **option = options; option && *option; option++)
+        capabilities->options |= find_option (*option);
+    capabilities->known = TRUE;
+
+    g_debug ("Using cached capabilities for X server %s", capabilities->path);
+}
+
+static void
+save_to_cache (XServerCapabilities *capabilities)
+{
+    GKeyFile *key_file = get_cache ();
+    const gchar *group = capabilities->path;
+
+    g_key_file_remove_group (key_file, group, NULL);
+    g_key_file_set_int64 (key_file, group, "size", capabilities->size);
+    g_key_file_set_int64 (key_file, group, "mtime", capabilities->mtime);
+    if (capabilities->version)
+        g_key_file_set_string (key_file, group, "version", capabilities->version);
+    g_autoptr(GPtrArray) options = g_ptr_array_new ();
+    for (gsize i = 0; i < G_N_ELEMENTS (option_names); i++)
+        if (capabilities->options & option_names[i].option)
+            g_ptr_array_add (options, (gpointer) option_names[i].name);
+    g_key_file_set_string_list (key_file, group, "options", (const gchar * const *) options->pdata, options->len);
+
+    g_autofree gchar *path = get_cache_path ();
+    g_autoptr(GError) error = NULL;
+    if (!g_key_file_save_to_file (key_file, path, &error))
+        g_warning ("Failed to write X server capabilities to %s: %s", path, error->message);
+}
+
+static XServerCapabilities *
+get_capabilities (const gchar *path)
+{
+    if (!capabilities_table)
+        capabilities_table = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, free_capabilities);
+
+    XServerCapabilities *capabilities = g_hash_table_lookup (capabilities_table, path);
+    if (!capabilities)
+    {
+        capabilities = g_malloc0 (sizeof (XServerCapabilities));
+        capabilities->path = g_strdup (path);
+        capabilities->size = -1;
+        g_hash_table_insert (capabilities_table, capabilities->path, capabilities);
+    }
+
+    if (capabilities->probing)
+        return capabilities;
+
+    /* Forget what we know if the binary has changed */
+    GStatBuf info;
+    goffset size = -1;
+    gint64 mtime = 0;
+    if (g_stat (path, &info) == 0)
+    {
+        size = info.st_size;
+        mtime = info.st_mtime;
+    }
+    if (size != capabilities->size || mtime != capabilities->mtime)
+    {
+        capabilities->known = FALSE;
+        capabilities->size = size;
+        capabilities->mtime = mtime;
+    }
+
+    if (!capabilities->known)
+        load_from_cache (capabilities);
+
+    return capabilities;
+}
+
+static void
+probe_complete (XServerCapabilities *capabilities, gboolean success)
+{
+    capabilities->probing = FALSE;
+    capabilities->known = TRUE;
+
+    g_debug ("X server %s has version %s", capabilities->path, capabilities->version ? capabilities->version : "(unknown)");
+
+    /* Don't remember failures, they might be temporary */
+    if (success && capabilities->size >= 0)
+        save_to_cache (capabilities);
+
+    GList *waiters = capabilities->waiters;
+    capabilities->waiters = NULL;
+    for (GList *link = waiters; link; link = link->next)
+    {
+        Waiter *waiter = link->data;
+        waiter->callback (capabilities, waiter->user_data);
+    }
+    g_list_free_full (waiters, g_free);
+}
+
+static gboolean
+run_probe (XServerCapabilities *capabilities, const gchar *arg, GAsyncReadyCallback callback)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GSubprocess) probe = g_subprocess_new (G_SUBPROCESS_FLAGS_STDOUT_SILENCE | G_SUBPROCESS_FLAGS_STDERR_PIPE, &error,
+                                                     capabilities->path, arg, NULL);
+    if (!probe)
+    {
+        g_warning ("Failed to run %s %s: %s", capabilities->path, arg, error->message);
+        return FALSE;
+    }
+
+    g_subprocess_communicate_utf8_async (probe, NULL, cancellable, callback, capabilities);
+
+    return TRUE;
+}
+
+static void
+help_probe_cb (GObject *object, GAsyncResult *result, gpointer data)
+{
+    g_autofree gchar *stderr_text = NULL;
+    g_autoptr(GError) error = NULL;
+    if (!g_subprocess_communicate_utf8_finish (G_SUBPROCESS (object), result, NULL, &stderr_text, &error))
+    {
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            return;
+        g_warning ("Failed to get X server options: %s", error->message);
+    }
+
+    XServerCapabilities *capabilities = data;
+
+    /* Usage lists one option per line, the exit status varies between servers */
+    capabilities->options = 0;
+    g_auto(GStrv) lines = g_strsplit (stderr_text ? stderr_text : "", "\n", -1);
+    for (int i = 0; lines[i]; i++)
+    {
+        g_strstrip (lines[i]);
+        gchar *end = strchr (lines[i], ' ');
+        if (end)
+            *end = '\0';
+        capabilities->options |= find_option (lines[i]);
+    }
+
+    probe_complete (capabilities, error == NULL);
+}
+
+static void
+version_probe_cb (GObject *object, GAsyncResult *result, gpointer data)
+{
+    g_autofree gchar *stderr_text = NULL;
+    g_autoptr(GError) error = NULL;
+    if (!g_subprocess_communicate_utf8_finish (G_SUBPROCESS (object), result, NULL, &stderr_text, &error))
+    {
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            return;
+        g_warning ("Failed to get X server version: %s", error->message);
+    }
+
+    XServerCapabilities *capabilities = data;
+
+    set_version (capabilities, NULL);
+    if (stderr_text && g_subprocess_get_successful (G_SUBPROCESS (object)))
+    {
+        g_auto(GStrv) lines = g_strsplit (stderr_text, "\n", -1);
+        for (int i = 0; lines[i] && !capabilities->version; i++)
+            if (g_str_has_prefix (lines[i], XORG_VERSION_PREFIX))
+                set_version (capabilities, lines[i] + strlen (XORG_VERSION_PREFIX));
+    }
+
+    if (error || !run_probe (capabilities, "-help", help_probe_cb))
+        probe_complete (capabilities, FALSE);
+}
+
+static void
+start_probe (XServerCapabilities *capabilities)
+{
+    if (!cancellable)
+        cancellable = g_cancellable_new ();
+
+    g_debug ("Probing capabilities of X server %s", capabilities->path);
+
+    capabilities->probing = TRUE;
+    if (!run_probe (capabilities, "-version", version_probe_cb))
+        probe_complete (capabilities, FALSE);
+}
+
+void
+x_server_capabilities_probe (const gchar *path)
+{
+    g_return_if_fail (path != NULL);
+
+    XServerCapabilities *capabilities = get_capabilities (path);
+    if (!capabilities->known && !capabilities->probing)
+        start_probe (capabilities);
+}
+
+XServerCapabilities *
+x_server_capabilities_lookup (const gchar *path)
+{
+    g_return_val_if_fail (path != NULL, NULL);
+
+    XServerCapabilities *capabilities = get_capabilities (path);
+    if (!capabilities->known && !capabilities->probing)
+        start_probe (capabilities);
+
+    return capabilities->known ? capabilities : NULL;
+}
+
+void
+x_server_capabilities_wait (const gchar *path, XServerCapabilitiesCallback callback, gpointer user_data)
+{
+    g_return_if_fail (path != NULL);
+    g_return_if_fail (callback != NULL);
+
+    XServerCapabilities *capabilities = get_capabilities (path);
+    if (capabilities->known)
+    {
+        callback (capabilities, user_data);
+        return;
+    }
+
+    Waiter *waiter = g_malloc0 (sizeof (Waiter));
+    waiter->callback = callback;
+    waiter->user_data = user_data;
+    capabilities->waiters = g_list_append (capabilities->waiters, waiter);
+
+    if (!capabilities->probing)
+        start_probe (capabilities);
+}
+
+const gchar *
+x_server_capabilities_get_version (XServerCapabilities *capabilities)
+{
+    g_return_val_if_fail (capabilities != NULL, NULL);
+    return capabilities->version;
+}
+
+gint
+x_server_capabilities_version_compare (XServerCapabilities *capabilities, guint major, guint minor)
+{
+    g_return_val_if_fail (capabilities != NULL, 0);
+
+    if (major == capabilities->version_major)
+        return capabilities->version_minor - minor;
+    else
+        return capabilities->version_major - major;
+}
+
+gboolean
+x_server_capabilities_has_option (XServerCapabilities *capabilities, XServerOptions option)
+{
+    g_return_val_if_fail (capabilities != NULL, FALSE);
+    return (capabilities->options & option) != 0;
+}
+
+void
+x_server_capabilities_cleanup (void)
+{
+    if (cancellable)
+        g_cancellable_cancel (cancellable);
+    g_clear_object (&cancellable);
+    g_clear_pointer (&capabilities_table, g_hash_table_unref);
+    g_clear_pointer (&cache, g_key_file_unref);
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2010-2011 Robert Ancell.
+ * Author: Robert Ancell <robert.ancell@canonical.com>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#ifndef X_SERVER_CAPABILITIES_H_
+#define X_SERVER_CAPABILITIES_H_
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+    X_SERVER_OPTION_LISTEN    = 1 << 0,
+    X_SERVER_OPTION_DISPLAYFD = 1 << 1,
+    X_SERVER_OPTION_SEAT      = 1 << 2,
+} XServerOptions;
+
+typedef struct XServerCapabilities XServerCapabilities;
+
+typedef void (*XServerCapabilitiesCallback)(XServerCapabilities *capabilities, gpointer user_data);
+
+void x_server_capabilities_probe (const gchar *path);
+
+XServerCapabilities *x_server_capabilities_lookup (const gchar *path);
+
+void x_server_capabilities_wait (const gchar *path, XServerCapabilitiesCallback callback, gpointer user_data);
+
+const gchar *x_server_capabilities_get_version (XServerCapabilities *capabilities);
+
+gint x_server_capabilities_version_compare (XServerCapabilities *capabilities, guint major, guint minor);
+
+gboolean x_server_capabilities_has_option (XServerCapabilities *capabilities, XServerOptions option);
+
+void x_server_capabilities_cleanup (void);
+
+G_END_DECLS
+
+#endif /* X_SERVER_CAPABILITIES_H_ */
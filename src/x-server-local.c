@@ -16,8 +16,10 @@
 #include <errno.h>
 #include <glib/gstdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "x-server-local.h"
+#include "x-server-capabilities.h"
 #include "configuration.h"
 #include "process.h"
 #include "vt.h"
@@ -60,6 +62,21 @@ struct XServerLocalPrivate
     /* TRUE when received ready signal */
     gboolean got_signal;
 
+    /* Pipe the X server writes its display number to when ready (-displayfd) */
+    GIOChannel *display_fd_channel;
+    guint display_fd_watch;
+
+    /* TRUE if the X server is choosing its own display number */
+    gboolean choosing_display_number;
+
+    /* Command to launch once the capabilities of the binary are known */
+    gchar *absolute_command;
+    gboolean waiting_for_capabilities;
+
+    /* TRUE if something else still has the VT and the server must not launch yet */
+    gboolean launch_held;
+    gboolean waiting_for_release;
+
     /* VT to run on */
     gint vt;
     gboolean have_vt_ref;
@@ -73,55 +90,10 @@ static void x_server_local_logger_iface_init (LoggerInterface *iface);
 G_DEFINE_TYPE_WITH_CODE (XServerLocal, x_server_local, X_SERVER_TYPE,
                          G_IMPLEMENT_INTERFACE (LOGGER_TYPE, x_server_local_logger_iface_init))
 
-static gchar *version = NULL;
-static guint version_major = 0, version_minor = 0;
 static GList *display_numbers = NULL;
 
-#define XORG_VERSION_PREFIX "X.Org X Server "
-
-static gchar *
-find_version (const gchar *line)
-{
-    if (!g_str_has_prefix (line, XORG_VERSION_PREFIX))
-        return NULL;
-
-    return g_strdup (line + strlen (XORG_VERSION_PREFIX));
-}
-
-const gchar *
-x_server_local_get_version (void)
-{
-    if (version)
-        return version;
-
-    g_autofree gchar *stderr_text = NULL;
-    gint exit_status;
-    if (!g_spawn_command_line_sync ("X -version", NULL, &stderr_text, &exit_status, NULL))
-        return NULL;
-    if (exit_status == EXIT_SUCCESS)
-    {
-        g_auto(GStrv) lines = g_strsplit (stderr_text, "\n", -1);
-        for (int i = 0; lines[i] && !version; i++)
-            version = find_version (lines[i]);
-    }
-
-    g_auto(GStrv) tokens = g_strsplit (version, ".", 3);
-    guint n_tokens = g_strv_length (tokens);
-    version_major = n_tokens > 0 ? atoi (tokens[0]) : 0;
-    version_minor = n_tokens > 1 ? atoi (tokens[1]) : 0;
-
-    return version;
-}
-
-gint
-x_server_local_version_compare (guint major, guint minor)
-{
-    x_server_local_get_version ();
-    if (major == version_major)
-        return version_minor - minor;
-    else
-        return version_major - major;
-}
+/* Number of authority files named without a display number */
+static guint authority_file_count = 0;
 
 static gboolean
 display_number_in_use (guint display_number)
@@ -207,6 +179,28 @@ x_server_local_set_vt (XServerLocal *server, gint vt)
     }
 }
 
+void
+x_server_local_hold_launch (XServerLocal *server)
+{
+    g_return_if_fail (server != NULL);
+    server->priv->launch_held = TRUE;
+}
+
+static gboolean launch_when_capable (XServerLocal *server);
+
+void
+x_server_local_release_launch (XServerLocal *server)
+{
+    g_return_if_fail (server != NULL);
+
+    server->priv->launch_held = FALSE;
+    if (!server->priv->waiting_for_release)
+        return;
+    server->priv->waiting_for_release = FALSE;
+
+    launch_when_capable (server);
+}
+
 void
 x_server_local_set_config (XServerLocal *server, const gchar *path)
 {
@@ -303,6 +297,23 @@ x_server_local_get_authority_file_path (XServerLocal *server)
     return server->priv->authority_file;
 }
 
+static gchar *
+get_absolute_binary (const gchar *command)
+{
+    g_auto(GStrv) tokens = g_strsplit (command, " ", 2);
+    return g_find_program_in_path (tokens[0]);
+}
+
+void
+x_server_local_probe_command (const gchar *command)
+{
+    g_return_if_fail (command != NULL);
+
+    g_autofree gchar *absolute_binary = get_absolute_binary (command);
+    if (absolute_binary)
+        x_server_capabilities_probe (absolute_binary);
+}
+
 static gchar *
 get_absolute_command (const gchar *command)
 {
@@ -344,17 +355,107 @@ x_server_local_get_log_stdout (XServerLocal *server)
     return TRUE;
 }
 
+static void
+x_server_local_ready (XServerLocal *server)
+{
+    server->priv->got_signal = TRUE;
+
+    /* Stop the X server if we can't connect to it, it's no use to anyone */
+    if (!DISPLAY_SERVER_CLASS (x_server_local_parent_class)->start (DISPLAY_SERVER (server)))
+    {
+        l_warning (server, "Failed to connect to X server :%d, stopping it", server->priv->display_number);
+        process_stop (server->priv->x_server_process);
+    }
+}
+
 static void
 got_signal_cb (Process *process, int signum, XServerLocal *server)
 {
-    if (signum == SIGUSR1 && !server->priv->got_signal)
+    /* Wait for the display number if the X server is choosing it */
+    if (signum == SIGUSR1 && !server->priv->got_signal && !server->priv->choosing_display_number)
     {
-        server->priv->got_signal = TRUE;
         l_debug (server, "Got signal from X server :%d", server->priv->display_number);
+        x_server_local_ready (server);
+    }
+}
+
+static void
+close_display_fd (XServerLocal *server)
+{
+    if (server->priv->display_fd_watch)
+        g_source_remove (server->priv->display_fd_watch);
+    server->priv->display_fd_watch = 0;
+    if (server->priv->display_fd_channel)
+        g_io_channel_shutdown (server->priv->display_fd_channel, FALSE, NULL);
+    g_clear_pointer (&server->priv->display_fd_channel, g_io_channel_unref);
+}
 
-        // FIXME: Check return value
-        DISPLAY_SERVER_CLASS (x_server_local_parent_class)->start (DISPLAY_SERVER (server));
+static gboolean
+display_fd_cb (GIOChannel *source, GIOCondition condition, gpointer data)
+{
+    XServerLocal *server = data;
+
+    g_autofree gchar *line = NULL;
+    if (condition & G_IO_IN)
+    {
+        g_autoptr(GError) error = NULL;
+        g_io_channel_read_line (source, &line, NULL, NULL, &error);
+        if (error)
+            l_warning (server, "Failed to read display number from X server: %s", error->message);
     }
+
+    /* Server closed the pipe without reporting, it will have to signal or stop */
+    if (!line)
+    {
+        server->priv->display_fd_watch = 0;
+        close_display_fd (server);
+
+        /* Without a display number there's nothing to connect to */
+        if (server->priv->choosing_display_number)
+        {
+            l_warning (server, "X server didn't report its display number, stopping it");
+            process_stop (server->priv->x_server_process);
+        }
+
+        return FALSE;
+    }
+
+    guint display_number = atoi (line);
+    server->priv->display_fd_watch = 0;
+    close_display_fd (server);
+
+    if (server->priv->choosing_display_number)
+    {
+        server->priv->choosing_display_number = FALSE;
+
+        /* Swap our reservation for the number the server took */
+        if (display_number != server->priv->display_number)
+        {
+            l_debug (server, "X server chose display :%d", display_number);
+
+            x_server_local_release_display_number (server->priv->display_number);
+            display_numbers = g_list_append (display_numbers, GUINT_TO_POINTER (display_number));
+            server->priv->display_number = display_number;
+            x_server_reset_address (X_SERVER (server));
+
+            XAuthority *authority = x_server_get_authority (X_SERVER (server));
+            if (authority)
+            {
+                g_autofree gchar *number = g_strdup_printf ("%d", display_number);
+                x_authority_set_number (authority, number);
+            }
+        }
+    }
+    else if (display_number != server->priv->display_number)
+        l_warning (server, "X server reported display :%d, expected :%d", display_number, server->priv->display_number);
+
+    if (!server->priv->got_signal)
+    {
+        l_debug (server, "Got display number from X server :%d", server->priv->display_number);
+        x_server_local_ready (server);
+    }
+
+    return FALSE;
 }
 
 static void
@@ -362,6 +463,8 @@ stopped_cb (Process *process, XServerLocal *server)
 {
     l_debug (server, "X server stopped");
 
+    close_display_fd (server);
+
     /* Release VT and display number for re-use */
     if (server->priv->have_vt_ref)
     {
@@ -401,7 +504,15 @@ write_authority_file (XServerLocal *server)
         if (g_mkdir_with_parents (dir, S_IRWXU) < 0)
             l_warning (server, "Failed to make authority directory %s: %s", dir, strerror (errno));
 
-        server->priv->authority_file = g_build_filename (dir, x_server_get_address (X_SERVER (server)), NULL);
+        /* The display number isn't known yet if the server is choosing it, so use a name that won't be reused.
+         * The server reads this file again on each reset, so it must keep this name while running */
+        if (server->priv->choosing_display_number)
+        {
+            g_autofree gchar *name = g_strdup_printf ("auto-%u", authority_file_count++);
+            server->priv->authority_file = g_build_filename (dir, name, NULL);
+        }
+        else
+            server->priv->authority_file = g_build_filename (dir, x_server_get_address (X_SERVER (server)), NULL);
     }
 
     l_debug (server, "Writing X server authority to %s", server->priv->authority_file);
@@ -412,6 +523,37 @@ write_authority_file (XServerLocal *server)
         l_warning (server, "Failed to write authority: %s", error->message);
 }
 
+static gboolean launch_x_server (XServerLocal *server, XServerCapabilities *capabilities);
+
+static void
+capabilities_cb (XServerCapabilities *capabilities, gpointer data)
+{
+    g_autoptr(XServerLocal) server = data;
+
+    /* Ignore if stopped while waiting */
+    if (!server->priv->waiting_for_capabilities)
+        return;
+    server->priv->waiting_for_capabilities = FALSE;
+
+    launch_x_server (server, capabilities);
+}
+
+static gboolean
+launch_when_capable (XServerLocal *server)
+{
+    /* Launch now if we know what the server supports, otherwise wait for the probe */
+    g_autofree gchar *absolute_binary = get_absolute_binary (server->priv->command);
+    XServerCapabilities *capabilities = x_server_capabilities_lookup (absolute_binary);
+    if (capabilities)
+        return launch_x_server (server, capabilities);
+
+    l_debug (server, "Waiting for capabilities of %s", absolute_binary);
+    server->priv->waiting_for_capabilities = TRUE;
+    x_server_capabilities_wait (absolute_binary, capabilities_cb, g_object_ref (server));
+
+    return TRUE;
+}
+
 static gboolean
 x_server_local_start (DisplayServer *display_server)
 {
@@ -420,6 +562,7 @@ x_server_local_start (DisplayServer *display_server)
     g_return_val_if_fail (server->priv->x_server_process == NULL, FALSE);
 
     server->priv->got_signal = FALSE;
+    server->priv->choosing_display_number = FALSE;
 
     g_return_val_if_fail (server->priv->command != NULL, FALSE);
 
@@ -437,16 +580,62 @@ x_server_local_start (DisplayServer *display_server)
     process_set_log_file (server->priv->x_server_process, log_file, X_SERVER_LOCAL_GET_CLASS (server)->get_log_stdout (server), backup_logs ? LOG_MODE_BACKUP_AND_TRUNCATE : LOG_MODE_APPEND);
     l_debug (display_server, "Logging to %s", log_file);
 
-    g_autofree gchar *absolute_command = get_absolute_command (server->priv->command);
-    if (!absolute_command)
+    g_free (server->priv->absolute_command);
+    server->priv->absolute_command = get_absolute_command (server->priv->command);
+    if (!server->priv->absolute_command)
     {
         l_debug (display_server, "Can't launch X server %s, not found in path", server->priv->command);
         stopped_cb (server->priv->x_server_process, X_SERVER_LOCAL (server));
         return FALSE;
     }
-    g_autoptr(GString) command = g_string_new (absolute_command);
 
-    g_string_append_printf (command, " :%d", server->priv->display_number);
+    if (server->priv->launch_held)
+    {
+        l_debug (display_server, "Waiting for VT %d to be released", server->priv->vt);
+        server->priv->waiting_for_release = TRUE;
+        return TRUE;
+    }
+
+    return launch_when_capable (server);
+}
+
+static gboolean
+launch_x_server (XServerLocal *server, XServerCapabilities *capabilities)
+{
+    DisplayServer *display_server = DISPLAY_SERVER (server);
+
+    g_autoptr(GString) command = g_string_new (server->priv->absolute_command);
+
+    /* Let the X server pick a free display number and report it over a pipe if it can.
+     * It searches upwards from :0, so a configured minimum means we have to choose. */
+    int display_fd_pipe[2] = { -1, -1 };
+    if (x_server_capabilities_has_option (capabilities, X_SERVER_OPTION_DISPLAYFD))
+    {
+        if (pipe (display_fd_pipe) < 0)
+        {
+            l_warning (server, "Failed to create display number pipe: %s", g_strerror (errno));
+            display_fd_pipe[0] = display_fd_pipe[1] = -1;
+        }
+        else
+        {
+            /* Don't allow the daemon end of the pipe to be accessed in the X server */
+            fcntl (display_fd_pipe[0], F_SETFD, FD_CLOEXEC);
+
+            server->priv->display_fd_channel = g_io_channel_unix_new (display_fd_pipe[0]);
+            server->priv->display_fd_watch = g_io_add_watch (server->priv->display_fd_channel, G_IO_IN | G_IO_HUP, display_fd_cb, server);
+
+            server->priv->choosing_display_number = config_get_integer (config_get_instance (), "LightDM", "minimum-display-number") <= 0;
+        }
+    }
+
+    if (server->priv->choosing_display_number)
+        g_string_append_printf (command, " -displayfd %d", display_fd_pipe[1]);
+    else
+    {
+        g_string_append_printf (command, " :%d", server->priv->display_number);
+        if (display_fd_pipe[1] >= 0)
+            g_string_append_printf (command, " -displayfd %d", display_fd_pipe[1]);
+    }
 
     if (server->priv->config_file)
         g_string_append_printf (command, " -config %s", server->priv->config_file);
@@ -455,7 +644,12 @@ x_server_local_start (DisplayServer *display_server)
         g_string_append_printf (command, " -layout %s", server->priv->layout);
 
     if (server->priv->xdg_seat)
-        g_string_append_printf (command, " -seat %s", server->priv->xdg_seat);
+    {
+        if (x_server_capabilities_has_option (capabilities, X_SERVER_OPTION_SEAT))
+            g_string_append_printf (command, " -seat %s", server->priv->xdg_seat);
+        else
+            l_warning (server, "X server does not support -seat, not passing seat %s", server->priv->xdg_seat);
+    }
 
     write_authority_file (server);
     if (server->priv->authority_file)
@@ -472,7 +666,7 @@ x_server_local_start (DisplayServer *display_server)
     }
     else if (server->priv->allow_tcp)
     {
-        if (x_server_local_version_compare (1, 17) >= 0)
+        if (x_server_capabilities_has_option (capabilities, X_SERVER_OPTION_LISTEN))
             g_string_append (command, " -listen tcp");
     }
     else
@@ -518,7 +712,14 @@ x_server_local_start (DisplayServer *display_server)
         process_set_env (server->priv->x_server_process, "LIGHTDM_TEST_ROOT", g_getenv ("LIGHTDM_TEST_ROOT"));
 
     gboolean result = process_start (server->priv->x_server_process, FALSE);
-    if (result)
+
+    /* Only the X server holds the write end now */
+    if (display_fd_pipe[1] >= 0)
+        close (display_fd_pipe[1]);
+
+    if (result && server->priv->choosing_display_number)
+        l_debug (display_server, "Waiting for X server to report its display number");
+    else if (result)
         l_debug (display_server, "Waiting for ready signal from X server :%d", server->priv->display_number);
     else
         stopped_cb (server->priv->x_server_process, X_SERVER_LOCAL (server));
@@ -527,9 +728,20 @@ x_server_local_start (DisplayServer *display_server)
 }
 
 static void
-x_server_local_stop (DisplayServer *server)
+x_server_local_stop (DisplayServer *display_server)
 {
-    process_stop (X_SERVER_LOCAL (server)->priv->x_server_process);
+    XServerLocal *server = X_SERVER_LOCAL (display_server);
+
+    /* Not launched yet, so stop straight away */
+    if (server->priv->waiting_for_capabilities || server->priv->waiting_for_release)
+    {
+        server->priv->waiting_for_capabilities = FALSE;
+        server->priv->waiting_for_release = FALSE;
+        stopped_cb (server->priv->x_server_process, server);
+        return;
+    }
+
+    process_stop (server->priv->x_server_process);
 }
 
 static void
@@ -549,7 +761,9 @@ x_server_local_finalize (GObject *object)
     if (self->priv->x_server_process)
         g_signal_handlers_disconnect_matched (self->priv->x_server_process, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, self);
     g_clear_object (&self->priv->x_server_process);
+    close_display_fd (self);
     g_clear_pointer (&self->priv->command, g_free);
+    g_clear_pointer (&self->priv->absolute_command, g_free);
     g_clear_pointer (&self->priv->config_file, g_free);
     g_clear_pointer (&self->priv->layout, g_free);
     g_clear_pointer (&self->priv->xdg_seat, g_free);
@@ -42,9 +42,7 @@ typedef struct
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (XServerLocal, g_object_unref)
 
-const gchar *x_server_local_get_version (void);
-
-gint x_server_local_version_compare (guint major, guint minor);
+void x_server_local_probe_command (const gchar *command);
 
 guint x_server_local_get_unused_display_number (void);
 
@@ -58,6 +56,10 @@ void x_server_local_set_command (XServerLocal *server, const gchar *command);
 
 void x_server_local_set_vt (XServerLocal *server, gint vt);
 
+void x_server_local_hold_launch (XServerLocal *server);
+
+void x_server_local_release_launch (XServerLocal *server);
+
 void x_server_local_set_config (XServerLocal *server, const gchar *path);
 
 void x_server_local_set_layout (XServerLocal *server, const gchar *layout);
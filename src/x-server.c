@@ -10,8 +10,10 @@
  */
 
 #include <config.h>
+#include <stdlib.h>
 #include <string.h>
 #include <xcb/xcb.h>
+#include <xcb/xcbext.h>
 
 #include "x-server.h"
 #include "configuration.h"
@@ -29,6 +31,10 @@ struct XServerPrivate
 
     /* Connection to this X server */
     xcb_connection_t *connection;
+
+    /* Request sent by the last connection check that needs a reply by the next check */
+    gboolean probe_pending;
+    unsigned int probe_sequence;
 };
 
 G_DEFINE_TYPE (XServer, x_server, DISPLAY_SERVER_TYPE)
@@ -73,6 +79,14 @@ x_server_get_address (XServer *server)
     return server->priv->address;
 }
 
+void
+x_server_reset_address (XServer *server)
+{
+    g_return_if_fail (server != NULL);
+    g_free (server->priv->address);
+    server->priv->address = NULL;
+}
+
 void
 x_server_set_authority (XServer *server, XAuthority *authority)
 {
@@ -90,6 +104,44 @@ x_server_get_authority (XServer *server)
     return server->priv->authority;
 }
 
+gboolean
+x_server_check_connection (XServer *server)
+{
+    g_return_val_if_fail (server != NULL, FALSE);
+
+    if (!server->priv->connection)
+        return TRUE;
+
+    /* No events are selected, so this just reads any replies and notices if the server has closed the connection */
+    xcb_generic_event_t *event;
+    while ((event = xcb_poll_for_event (server->priv->connection)))
+        free (event);
+    if (xcb_connection_has_error (server->priv->connection))
+        return FALSE;
+
+    /* A server that has been powered off or unplugged never closes the connection, so it has to answer a request */
+    if (server->priv->probe_pending)
+    {
+        void *reply = NULL;
+        xcb_generic_error_t *error = NULL;
+        if (!xcb_poll_for_reply (server->priv->connection, server->priv->probe_sequence, &reply, &error))
+        {
+            l_debug (server, "No reply from XServer %s since last check", x_server_get_address (server));
+            return FALSE;
+        }
+        free (reply);
+        free (error);
+        server->priv->probe_pending = FALSE;
+    }
+
+    xcb_get_input_focus_cookie_t cookie = xcb_get_input_focus (server->priv->connection);
+    server->priv->probe_sequence = cookie.sequence;
+    server->priv->probe_pending = TRUE;
+    xcb_flush (server->priv->connection);
+
+    return !xcb_connection_has_error (server->priv->connection);
+}
+
 static const gchar *
 x_server_get_session_type (DisplayServer *server)
 {
@@ -50,6 +50,8 @@ guint x_server_get_display_number (XServer *server);
 
 const gchar *x_server_get_address (XServer *server);
 
+void x_server_reset_address (XServer *server);
+
 const gchar *x_server_get_authentication_name (XServer *server);
 
 const guint8 *x_server_get_authentication_data (XServer *server);
@@ -60,6 +62,8 @@ void x_server_set_authority (XServer *server, XAuthority *authority);
 
 XAuthority *x_server_get_authority (XServer *server);
 
+gboolean x_server_check_connection (XServer *server);
+
 G_END_DECLS
 
 #endif /* X_SERVER_H_ */
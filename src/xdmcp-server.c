@@ -38,6 +38,9 @@ struct XDMCPServerPrivate
     /* Listening sockets */
     GSocket *socket, *socket6;
 
+    /* Sources watching the listening sockets */
+    GSource *source, *source6;
+
     /* Hostname to report to client */
     gchar *hostname;
 
@@ -47,14 +50,30 @@ struct XDMCPServerPrivate
     /* XDM-AUTHENTICATION-1 key */
     gchar *key;
 
+    /* Seconds without a KeepAlive before checking the display is still there, 0 to not check */
+    guint keep_alive_timeout;
+
     /* Active XDMCP sessions */
     GHashTable *sessions;
+
+    /* Managed sessions keyed by display address */
+    GHashTable *displays;
+
+    /* Timers for all sessions */
+    TimerWheel *timers;
+
+    /* Number of sessions in each state */
+    guint n_sessions[XDMCP_SESSION_N_STATES];
+
+    /* Sessions removed because they were never managed or their display went away */
+    guint64 n_expired;
+    guint64 n_reaped;
 };
 
 G_DEFINE_TYPE (XDMCPServer, xdmcp_server, G_TYPE_OBJECT)
 
-/* Maximum number of milliseconds client will resend manage requests before giving up */
-#define MANAGE_TIMEOUT 126000
+/* Maximum number of seconds client will resend manage requests before giving up */
+#define MANAGE_TIMEOUT 126
 
 /* Address sort support structure */
 typedef struct
@@ -73,7 +92,7 @@ void
 xdmcp_server_set_port (XDMCPServer *server, guint port)
 {
     g_return_if_fail (server != NULL);
-    server->priv->port = port;
+    server->priv->port = port > 0 ? port : XDM_UDP_PORT;
 }
 
 guint
@@ -139,14 +158,128 @@ xdmcp_server_set_key (XDMCPServer *server, const gchar *key)
     server->priv->key = g_strdup (key);
 }
 
-static gboolean
-session_timeout_cb (XDMCPSession *session)
+void
+xdmcp_server_set_keep_alive_timeout (XDMCPServer *server, guint timeout)
 {
-    session->priv->inactive_timeout = 0;
+    g_return_if_fail (server != NULL);
+    server->priv->keep_alive_timeout = timeout;
+}
 
-    g_debug ("Timing out unmanaged session %d", session->priv->id);
-    g_hash_table_remove (session->priv->server->priv->sessions, GINT_TO_POINTER ((gint) session->priv->id));
-    return FALSE;
+static gchar *
+get_display_key (XDMCPSession *session)
+{
+    g_autofree gchar *address = g_inet_address_to_string (session->priv->address);
+    return g_strdup_printf ("%s:%d", address, session->priv->display_number);
+}
+
+static void
+set_state (XDMCPSession *session, XDMCPSessionState state)
+{
+    XDMCPServer *server = session->priv->server;
+
+    server->priv->n_sessions[session->priv->state]--;
+    session->priv->state = state;
+    server->priv->n_sessions[state]++;
+}
+
+static void session_timeout_cb (gpointer data);
+
+/* Replace the timer for this session, or clear it if timeout is zero */
+static void
+set_timer (XDMCPSession *session, guint timeout)
+{
+    XDMCPServer *server = session->priv->server;
+
+    if (session->priv->timer)
+        timer_wheel_remove (server->priv->timers, session->priv->timer);
+    session->priv->timer = timeout > 0 ? timer_wheel_add (server->priv->timers, timeout, session_timeout_cb, session) : NULL;
+}
+
+static void
+remove_session (XDMCPServer *server, XDMCPSession *session)
+{
+    set_timer (session, 0);
+    server->priv->n_sessions[session->priv->state]--;
+
+    g_autofree gchar *key = get_display_key (session);
+    if (g_hash_table_lookup (server->priv->displays, key) == session)
+        g_hash_table_remove (server->priv->displays, key);
+
+    g_hash_table_remove (server->priv->sessions, GINT_TO_POINTER ((gint) session->priv->id));
+}
+
+/* Remove a session whose display has gone away and tell its seat */
+static void
+reap_session (XDMCPServer *server, XDMCPSession *session)
+{
+    g_object_ref (session);
+    remove_session (server, session);
+    server->priv->n_reaped++;
+    xdmcp_session_end (session);
+    g_object_unref (session);
+}
+
+static void
+session_timeout_cb (gpointer data)
+{
+    XDMCPSession *session = data;
+    XDMCPServer *server = session->priv->server;
+
+    session->priv->timer = NULL;
+
+    if (session->priv->state == XDMCP_SESSION_STATE_PENDING)
+    {
+        g_debug ("Timing out unmanaged session %d", session->priv->id);
+        server->priv->n_expired++;
+        remove_session (server, session);
+        return;
+    }
+
+    /* Displays only send KeepAlive when idle, so check the display is still there before giving up on it */
+    if (!xdmcp_session_check_alive (session))
+    {
+        g_debug ("Display for session %d has gone away", session->priv->id);
+        reap_session (server, session);
+        return;
+    }
+
+    set_state (session, XDMCP_SESSION_STATE_IDLE);
+    set_timer (session, server->priv->keep_alive_timeout);
+}
+
+static XDMCPSession *
+get_session (XDMCPServer *server, guint16 id)
+{
+    return g_hash_table_lookup (server->priv->sessions, GINT_TO_POINTER ((gint) id));
+}
+
+static void
+session_connected_cb (XDMCPSession *session, XDMCPServer *server)
+{
+    /* The seat may have already stopped and ended the session */
+    if (get_session (server, session->priv->id) != session)
+        return;
+
+    g_autofree gchar *key = get_display_key (session);
+    XDMCPSession *old_session = g_hash_table_lookup (server->priv->displays, key);
+    if (old_session == session)
+        return;
+
+    /* A display that starts a new session has given up on its old one, e.g. the terminal was restarted.
+     * Only believe this once the new session is known to work and it was the display that asked for it */
+    if (old_session)
+    {
+        if (!session->priv->manage_from_display)
+        {
+            g_debug ("Not ending session %d for display %s, Manage for session %d was not sent from the display", old_session->priv->id, key, session->priv->id);
+            return;
+        }
+
+        g_debug ("Display %s has connected session %d, ending session %d", key, session->priv->id, old_session->priv->id);
+        reap_session (server, old_session);
+    }
+
+    g_hash_table_insert (server->priv->displays, g_steal_pointer (&key), session);
 }
 
 static XDMCPSession *
@@ -161,17 +294,14 @@ add_session (XDMCPServer *server)
     XDMCPSession *session = xdmcp_session_new (id);
     session->priv->server = server;
     g_hash_table_insert (server->priv->sessions, GINT_TO_POINTER ((gint) id), g_object_ref (session));
-    session->priv->inactive_timeout = g_timeout_add (MANAGE_TIMEOUT, (GSourceFunc) session_timeout_cb, session);
+    g_signal_connect (session, XDMCP_SESSION_SIGNAL_CONNECTED, G_CALLBACK (session_connected_cb), server);
+    session->priv->state = XDMCP_SESSION_STATE_PENDING;
+    server->priv->n_sessions[XDMCP_SESSION_STATE_PENDING]++;
+    set_timer (session, MANAGE_TIMEOUT);
 
     return session;
 }
 
-static XDMCPSession *
-get_session (XDMCPServer *server, guint16 id)
-{
-    return g_hash_table_lookup (server->priv->sessions, GINT_TO_POINTER ((gint) id));
-}
-
 static gchar *
 socket_address_to_string (GSocketAddress *address)
 {
@@ -622,15 +752,22 @@ handle_manage (XDMCPServer *server, GSocket *socket, GSocketAddress *address, XD
 
     session->priv->display_class = g_strdup (packet->Manage.display_class);
 
+    /* Any old session for this display is ended when the new one connects, but only if the display sent this */
+    if (G_IS_INET_SOCKET_ADDRESS (address))
+        session->priv->manage_from_display = g_inet_address_equal (g_inet_socket_address_get_address (G_INET_SOCKET_ADDRESS (address)), session->priv->address);
+
     gboolean result = FALSE;
     g_signal_emit (server, signals[NEW_SESSION], 0, session, &result);
+
     if (result)
     {
-        /* Cancel the inactive timer */
-        if (session->priv->inactive_timeout)
-            g_source_remove (session->priv->inactive_timeout);
+        /* The seat may have already stopped and ended the session */
+        if (get_session (server, packet->Manage.session_id) != session)
+            return;
 
         session->priv->started = TRUE;
+        set_state (session, XDMCP_SESSION_STATE_RUNNING);
+        set_timer (session, server->priv->keep_alive_timeout);
     }
     else
     {
@@ -652,8 +789,12 @@ handle_keep_alive (XDMCPServer *server, GSocket *socket, GSocketAddress *address
     gboolean alive = FALSE;
 
     session = get_session (server, packet->KeepAlive.session_id);
-    if (session)
-        alive = TRUE; // FIXME: xdmcp_session_get_alive (session);
+    if (session && session->priv->started)
+    {
+        alive = TRUE;
+        set_state (session, XDMCP_SESSION_STATE_RUNNING);
+        set_timer (session, server->priv->keep_alive_timeout);
+    }
 
     response = xdmcp_packet_alloc (XDMCP_Alive);
     response->Alive.session_running = alive;
@@ -761,9 +902,9 @@ xdmcp_server_start (XDMCPServer *server)
 
     if (server->priv->socket)
     {
-        GSource *source = g_socket_create_source (server->priv->socket, G_IO_IN, NULL);
-        g_source_set_callback (source, (GSourceFunc) read_cb, server, NULL);
-        g_source_attach (source, NULL);
+        server->priv->source = g_socket_create_source (server->priv->socket, G_IO_IN, NULL);
+        g_source_set_callback (server->priv->source, (GSourceFunc) read_cb, server, NULL);
+        g_source_attach (server->priv->source, NULL);
     }
 
     g_autoptr(GError) ipv6_error = NULL;
@@ -773,9 +914,9 @@ xdmcp_server_start (XDMCPServer *server)
 
     if (server->priv->socket6)
     {
-        GSource *source = g_socket_create_source (server->priv->socket6, G_IO_IN, NULL);
-        g_source_set_callback (source, (GSourceFunc) read_cb, server, NULL);
-        g_source_attach (source, NULL);
+        server->priv->source6 = g_socket_create_source (server->priv->socket6, G_IO_IN, NULL);
+        g_source_set_callback (server->priv->source6, (GSourceFunc) read_cb, server, NULL);
+        g_source_attach (server->priv->source6, NULL);
     }
 
     if (!server->priv->socket && !server->priv->socket6)
@@ -784,6 +925,50 @@ xdmcp_server_start (XDMCPServer *server)
     return TRUE;
 }
 
+void
+xdmcp_server_end_session (XDMCPServer *server, XDMCPSession *session)
+{
+    g_return_if_fail (server != NULL);
+    g_return_if_fail (session != NULL);
+
+    if (get_session (server, session->priv->id) != session)
+        return;
+
+    g_debug ("Ending XDMCP session %d", session->priv->id);
+    remove_session (server, session);
+}
+
+GVariant *
+xdmcp_server_get_sessions_by_state (XDMCPServer *server)
+{
+    g_return_val_if_fail (server != NULL, NULL);
+
+    GVariantBuilder builder;
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{st}"));
+    g_variant_builder_add (&builder, "{st}", "pending", (guint64) server->priv->n_sessions[XDMCP_SESSION_STATE_PENDING]);
+    g_variant_builder_add (&builder, "{st}", "running", (guint64) server->priv->n_sessions[XDMCP_SESSION_STATE_RUNNING]);
+    g_variant_builder_add (&builder, "{st}", "idle", (guint64) server->priv->n_sessions[XDMCP_SESSION_STATE_IDLE]);
+    g_variant_builder_add (&builder, "{st}", "expired", server->priv->n_expired);
+    g_variant_builder_add (&builder, "{st}", "reaped", server->priv->n_reaped);
+
+    return g_variant_builder_end (&builder);
+}
+
+void
+xdmcp_server_stop (XDMCPServer *server)
+{
+    g_return_if_fail (server != NULL);
+
+    if (server->priv->source)
+        g_source_destroy (server->priv->source);
+    g_clear_pointer (&server->priv->source, g_source_unref);
+    if (server->priv->source6)
+        g_source_destroy (server->priv->source6);
+    g_clear_pointer (&server->priv->source6, g_source_unref);
+    g_clear_object (&server->priv->socket);
+    g_clear_object (&server->priv->socket6);
+}
+
 static void
 xdmcp_server_init (XDMCPServer *server)
 {
@@ -793,6 +978,8 @@ xdmcp_server_init (XDMCPServer *server)
     server->priv->hostname = g_strdup ("");
     server->priv->status = g_strdup ("");
     server->priv->sessions = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_object_unref);
+    server->priv->displays = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    server->priv->timers = timer_wheel_new ();
 }
 
 static void
@@ -800,13 +987,23 @@ xdmcp_server_finalize (GObject *object)
 {
     XDMCPServer *self = XDMCP_SERVER (object);
 
-    g_clear_object (&self->priv->socket);
-    g_clear_object (&self->priv->socket6);
+    xdmcp_server_stop (self);
     g_clear_pointer (&self->priv->listen_address, g_free);
     g_clear_pointer (&self->priv->hostname, g_free);
     g_clear_pointer (&self->priv->status, g_free);
     g_clear_pointer (&self->priv->key, g_free);
+    /* Sessions may outlive the server, their timers go with the wheel */
+    GHashTableIter iter;
+    XDMCPSession *session;
+    g_hash_table_iter_init (&iter, self->priv->sessions);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &session))
+    {
+        g_signal_handlers_disconnect_matched (session, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, self);
+        session->priv->timer = NULL;
+    }
     g_clear_pointer (&self->priv->sessions, g_hash_table_unref);
+    g_clear_pointer (&self->priv->displays, g_hash_table_unref);
+    g_clear_pointer (&self->priv->timers, timer_wheel_free);
 
     G_OBJECT_CLASS (xdmcp_server_parent_class)->finalize (object);
 }
@@ -60,8 +60,16 @@ const gchar *xdmcp_server_get_status (XDMCPServer *server);
 
 void xdmcp_server_set_key (XDMCPServer *server, const gchar *key);
 
+void xdmcp_server_set_keep_alive_timeout (XDMCPServer *server, guint timeout);
+
 gboolean xdmcp_server_start (XDMCPServer *server);
 
+void xdmcp_server_end_session (XDMCPServer *server, XDMCPSession *session);
+
+GVariant *xdmcp_server_get_sessions_by_state (XDMCPServer *server);
+
+void xdmcp_server_stop (XDMCPServer *server);
+
 G_END_DECLS
 
 #endif /* XDMCP_SERVER_H_ */
@@ -14,6 +14,18 @@
 
 #include "xdmcp-server.h"
 #include "x-authority.h"
+#include "timer-wheel.h"
+
+typedef enum
+{
+    /* Waiting for the display to send Manage */
+    XDMCP_SESSION_STATE_PENDING,
+    /* Display is being managed and has been heard from recently */
+    XDMCP_SESSION_STATE_RUNNING,
+    /* Display is being managed but hasn't sent a KeepAlive recently */
+    XDMCP_SESSION_STATE_IDLE,
+    XDMCP_SESSION_N_STATES
+} XDMCPSessionState;
 
 struct XDMCPSessionPrivate
 {
@@ -25,15 +37,25 @@ struct XDMCPSessionPrivate
 
     GInetAddress *address;
 
-    guint inactive_timeout;
+    XDMCPSessionState state;
+
+    /* Timer for the current state */
+    TimerWheelTimer *timer;
 
     XAuthority *authority;
 
     gboolean started;
 
+    /* TRUE if Manage was sent from the address the display is on */
+    gboolean manage_from_display;
+
     guint16 display_number;
 
     gchar *display_class;
 };
 
+gboolean xdmcp_session_check_alive (XDMCPSession *session);
+
+void xdmcp_session_end (XDMCPSession *session);
+
 #endif /* XDMCP_SESSION_PRIVATE_H_ */
@@ -12,6 +12,14 @@
 #include "xdmcp-session.h"
 #include "xdmcp-session-private.h"
 
+enum {
+    CHECK_ALIVE,
+    CONNECTED,
+    ENDED,
+    LAST_SIGNAL
+};
+static guint signals[LAST_SIGNAL] = { 0 };
+
 G_DEFINE_TYPE (XDMCPSession, xdmcp_session, G_TYPE_OBJECT)
 
 XDMCPSession *
@@ -66,6 +74,33 @@ xdmcp_session_get_display_class (XDMCPSession *session)
     return session->priv->display_class;
 }
 
+void
+xdmcp_session_set_connected (XDMCPSession *session)
+{
+    g_return_if_fail (session != NULL);
+    g_signal_emit (session, signals[CONNECTED], 0);
+}
+
+gboolean
+xdmcp_session_check_alive (XDMCPSession *session)
+{
+    gboolean result = TRUE;
+    g_signal_emit (session, signals[CHECK_ALIVE], 0, &result);
+    return result;
+}
+
+void
+xdmcp_session_end (XDMCPSession *session)
+{
+    g_signal_emit (session, signals[ENDED], 0);
+}
+
+static gboolean
+xdmcp_session_real_check_alive (XDMCPSession *session)
+{
+    return TRUE;
+}
+
 static void
 xdmcp_session_init (XDMCPSession *session)
 {
@@ -92,7 +127,36 @@ xdmcp_session_class_init (XDMCPSessionClass *klass)
 {
     GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
+    klass->check_alive = xdmcp_session_real_check_alive;
     object_class->finalize = xdmcp_session_finalize;
 
     g_type_class_add_private (klass, sizeof (XDMCPSessionPrivate));
+
+    signals[CHECK_ALIVE] =
+        g_signal_new (XDMCP_SESSION_SIGNAL_CHECK_ALIVE,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (XDMCPSessionClass, check_alive),
+                      g_signal_accumulator_first_wins,
+                      NULL,
+                      NULL,
+                      G_TYPE_BOOLEAN, 0);
+
+    signals[CONNECTED] =
+        g_signal_new (XDMCP_SESSION_SIGNAL_CONNECTED,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (XDMCPSessionClass, connected),
+                      NULL, NULL,
+                      NULL,
+                      G_TYPE_NONE, 0);
+
+    signals[ENDED] =
+        g_signal_new (XDMCP_SESSION_SIGNAL_ENDED,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (XDMCPSessionClass, ended),
+                      NULL, NULL,
+                      NULL,
+                      G_TYPE_NONE, 0);
 }
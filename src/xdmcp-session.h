@@ -22,6 +22,10 @@ G_BEGIN_DECLS
 #define XDMCP_SESSION_TYPE (xdmcp_session_get_type())
 #define XDMCP_SESSION(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), XDMCP_SESSION_TYPE, XDMCPSession));
 
+#define XDMCP_SESSION_SIGNAL_CHECK_ALIVE "check-alive"
+#define XDMCP_SESSION_SIGNAL_CONNECTED   "connected"
+#define XDMCP_SESSION_SIGNAL_ENDED       "ended"
+
 typedef struct XDMCPSessionPrivate XDMCPSessionPrivate;
 
 typedef struct
@@ -33,6 +37,10 @@ typedef struct
 typedef struct
 {
     GObjectClass parent_class;
+
+    gboolean (*check_alive)(XDMCPSession *session);
+    void     (*connected)(XDMCPSession *session);
+    void     (*ended)(XDMCPSession *session);
 } XDMCPSessionClass;
 
 GType xdmcp_session_get_type (void);
@@ -51,6 +59,8 @@ guint16 xdmcp_session_get_display_number (XDMCPSession *session);
 
 const gchar *xdmcp_session_get_display_class (XDMCPSession *session);
 
+void xdmcp_session_set_connected (XDMCPSession *session);
+
 G_END_DECLS
 
 #endif /* XDMCP_SESSION_H_ */
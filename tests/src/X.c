@@ -6,7 +6,11 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/ioctl.h>
 #include <glib-unix.h>
+#ifdef __linux__
+#include <linux/vt.h>
+#endif
 
 #include "status.h"
 #include "x-server.h"
@@ -49,6 +53,9 @@ static int display_number = 0;
 /* VT being run on */
 static int vt_number = -1;
 
+/* File descriptor to write display number to when ready */
+static int display_fd = -1;
+
 /* X server */
 static XServer *xserver = NULL;
 
@@ -203,6 +210,33 @@ get_nibble (char c)
         return 0;
 }
 
+static void
+indicate_ready (void)
+{
+    void *handler = signal (SIGUSR1, SIG_IGN);
+    if (display_fd >= 0 || handler == SIG_IGN)
+        status_notify ("%s INDICATE-READY", id);
+
+    if (display_fd >= 0)
+    {
+        g_autofree gchar *text = g_strdup_printf ("%d\n", display_number);
+        if (write (display_fd, text, strlen (text)) < 0)
+            g_printerr ("Failed to write display number: %s\n", strerror (errno));
+        close (display_fd);
+        display_fd = -1;
+    }
+    if (handler == SIG_IGN)
+        kill (getppid (), SIGUSR1);
+    signal (SIGUSR1, handler);
+}
+
+static gboolean
+ready_timeout_cb (gpointer data)
+{
+    indicate_ready ();
+    return G_SOURCE_REMOVE;
+}
+
 static void
 request_cb (const gchar *name, GHashTable *params)
 {
@@ -218,16 +252,12 @@ request_cb (const gchar *name, GHashTable *params)
         kill (getpid (), SIGSEGV);
     }
 
+    /* Stop replying but keep connections open, like a display that has been powered off */
+    else if (strcmp (name, "HANG") == 0)
+        x_server_set_responding (xserver, FALSE);
+
     else if (strcmp (name, "INDICATE-READY") == 0)
-    {
-        void *handler = signal (SIGUSR1, SIG_IGN);
-        if (handler == SIG_IGN)
-        {
-            status_notify ("%s INDICATE-READY", id);
-            kill (getppid (), SIGUSR1);
-        }
-        signal (SIGUSR1, handler);
-    }
+        indicate_ready ();
 
     else if (strcmp (name, "SEND-QUERY") == 0)
     {
@@ -373,6 +403,7 @@ main (int argc, char **argv)
     const gchar *xdmcp_host = NULL;
     const gchar *seat = NULL;
     const gchar *mir_id = NULL;
+    gboolean have_display_number = FALSE;
     for (int i = 1; i < argc; i++)
     {
         char *arg = argv[i];
@@ -380,6 +411,7 @@ main (int argc, char **argv)
         if (arg[0] == ':')
         {
             display_number = atoi (arg + 1);
+            have_display_number = TRUE;
         }
         else if (strcmp (arg, "-config") == 0)
         {
@@ -452,6 +484,11 @@ main (int argc, char **argv)
             seat = argv[i+1];
             i++;
         }
+        else if (strcmp (arg, "-displayfd") == 0)
+        {
+            display_fd = atoi (argv[i+1]);
+            i++;
+        }
         else if (strcmp (arg, "-terminate") == 0)
         {
             terminate_on_reset = TRUE;
@@ -479,22 +516,40 @@ main (int argc, char **argv)
                         "-layout name           Specify the ServerLayout section name\n"
                         "-auth file             Select authorization file\n"
                         "-nolisten protocol     Don't listen on protocol\n"
-                        "-listen protocol       Listen on protocol\n"
+                        "%s"
                         "-background [none]     Create root window with no background\n"
                         "-nr                    (Ubuntu-specific) Synonym for -background none\n"
                         "-query host-name       Contact named host for XDMCP\n"
                         "-broadcast             Broadcast for XDMCP\n"
                         "-port port-num         UDP port number to send messages to\n"
                         "-seat string           seat to run on\n"
+                        "%s"
                         "-mir id                Mir ID to use\n"
                         "-mirSocket name        Mir socket to use\n"
                         "-version               show the server version\n"
                         "vtxx                   Use virtual terminal xx instead of the next available\n",
-                        arg, argv[0]);
+                        arg, argv[0],
+                        version_compare (1, 17) >= 0 ? "-listen protocol       Listen on protocol\n" : "",
+                        g_key_file_get_boolean (config, "test-xserver-config", "displayfd", NULL) ? "-displayfd fd          file descriptor to write display number to when ready\n" : "");
             return EXIT_FAILURE;
         }
     }
 
+    /* Like Xorg, search for a free display number if asked to report it.
+     * Start further up to simulate displays LightDM doesn't know about */
+    if (!have_display_number && display_fd >= 0)
+    {
+        display_number = g_key_file_get_integer (config, "test-xserver-config", "first-display-number", NULL);
+        while (TRUE)
+        {
+            g_autofree gchar *lock_filename = g_strdup_printf (".X%d-lock", display_number);
+            g_autofree gchar *path = g_build_filename (g_getenv ("LIGHTDM_TEST_ROOT"), "tmp", lock_filename, NULL);
+            if (!g_file_test (path, G_FILE_TEST_EXISTS))
+                break;
+            display_number++;
+        }
+    }
+
     id = g_strdup_printf ("XSERVER-%d", display_number);
 
     status_connect (request_cb, id);
@@ -584,6 +639,23 @@ main (int argc, char **argv)
     if (!x_server_start (xserver))
         return EXIT_FAILURE;
 
+#ifdef __linux__
+    /* Switch to our VT on start like Xorg does */
+    if (vt_number >= 0 && g_key_file_get_boolean (config, "test-xserver-config", "activate-vt", NULL))
+    {
+        int tty_fd = open ("/dev/tty0", O_RDONLY);
+        if (tty_fd >= 0)
+        {
+            ioctl (tty_fd, VT_ACTIVATE, vt_number);
+            close (tty_fd);
+        }
+    }
+#endif
+
+    /* Simulate the time a real X server takes to initialize */
+    if (g_key_file_has_key (config, "test-xserver-config", "ready-delay", NULL))
+        g_timeout_add (g_key_file_get_integer (config, "test-xserver-config", "ready-delay", NULL), ready_timeout_cb, NULL);
+
     /* Enable XDMCP */
     if (do_xdmcp)
     {
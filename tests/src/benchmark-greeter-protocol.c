@@ -0,0 +1,294 @@
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <glib.h>
+
+#include "greeter.h"
+#include "fake-session.h"
+
+/* Message IDs from src/greeter.c */
+#define GREETER_MESSAGE_CONNECT 0
+#define GREETER_MESSAGE_AUTHENTICATE 1
+#define GREETER_MESSAGE_CONTINUE_AUTHENTICATION 3
+#define GREETER_MESSAGE_START_SESSION 4
+#define SERVER_MESSAGE_PROMPT_AUTHENTICATION 1
+#define SERVER_MESSAGE_END_AUTHENTICATION 2
+#define SERVER_MESSAGE_SESSION_RESULT 3
+#define SERVER_MESSAGE_CONNECTED_V2 7
+
+#define HEADER_SIZE 8
+#define MAX_MESSAGE_LENGTH 1024
+
+/* Messages exchanged in each connection */
+#define MESSAGES_PER_ITERATION 8
+
+static gint iterations = 10000;
+
+/* Counted only while the daemon side is running. The client side of the
+ * benchmark uses send ()/recv () and stack buffers so it doesn't show up. */
+static gboolean counting = FALSE;
+static guint64 n_syscalls = 0;
+static guint64 n_allocations = 0;
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+void *
+malloc (size_t size)
+{
+    if (counting)
+        n_allocations++;
+    return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size)
+{
+    if (counting)
+        n_allocations++;
+    return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+    if (counting)
+        n_allocations++;
+    return __libc_realloc (ptr, size);
+}
+
+ssize_t
+read (int fd, void *buf, size_t count)
+{
+    static ssize_t (*_read) (int fd, void *buf, size_t count) = NULL;
+    if (!_read)
+        _read = (ssize_t (*)(int fd, void *buf, size_t count)) dlsym (RTLD_NEXT, "read");
+    if (counting)
+        n_syscalls++;
+    return _read (fd, buf, count);
+}
+
+ssize_t
+write (int fd, const void *buf, size_t count)
+{
+    static ssize_t (*_write) (int fd, const void *buf, size_t count) = NULL;
+    if (!_write)
+        _write = (ssize_t (*)(int fd, const void *buf, size_t count)) dlsym (RTLD_NEXT, "write");
+    if (counting)
+        n_syscalls++;
+    return _write (fd, buf, count);
+}
+
+int
+poll (struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    static int (*_poll) (struct pollfd *fds, nfds_t nfds, int timeout) = NULL;
+    if (!_poll)
+        _poll = (int (*)(struct pollfd *fds, nfds_t nfds, int timeout)) dlsym (RTLD_NEXT, "poll");
+    if (counting)
+        n_syscalls++;
+    return _poll (fds, nfds, timeout);
+}
+
+static void
+write_int (guint8 *buffer, gsize *offset, guint32 value)
+{
+    buffer[*offset] = value >> 24;
+    buffer[*offset + 1] = (value >> 16) & 0xFF;
+    buffer[*offset + 2] = (value >> 8) & 0xFF;
+    buffer[*offset + 3] = value & 0xFF;
+    *offset += 4;
+}
+
+static void
+write_string (guint8 *buffer, gsize *offset, const gchar *value)
+{
+    gsize length = strlen (value);
+    write_int (buffer, offset, length);
+    memcpy (buffer + *offset, value, length);
+    *offset += length;
+}
+
+static guint32
+read_int (const guint8 *buffer, gsize offset)
+{
+    return buffer[offset] << 24 | buffer[offset + 1] << 16 | buffer[offset + 2] << 8 | buffer[offset + 3];
+}
+
+/* Fill in the header once the payload is written */
+static void
+send_message (int fd, guint8 *buffer, guint32 id, gsize length)
+{
+    gsize offset = 0;
+    write_int (buffer, &offset, id);
+    write_int (buffer, &offset, length - HEADER_SIZE);
+    if (send (fd, buffer, length, 0) != (ssize_t) length)
+    {
+        g_printerr ("Failed to send message %u to daemon\n", id);
+        exit (EXIT_FAILURE);
+    }
+}
+
+/* Run the daemon until it replies, then return the message ID */
+static guint32
+receive_message (int fd, guint8 *buffer)
+{
+    gsize n_read = 0, length = HEADER_SIZE;
+    while (n_read < length)
+    {
+        ssize_t n = recv (fd, buffer + n_read, length - n_read, MSG_DONTWAIT);
+        if (n > 0)
+        {
+            n_read += n;
+            if (n_read == HEADER_SIZE)
+                length = HEADER_SIZE + read_int (buffer, 4);
+            if (length > MAX_MESSAGE_LENGTH)
+            {
+                g_printerr ("Daemon sent message of %zu octets\n", length);
+                exit (EXIT_FAILURE);
+            }
+            continue;
+        }
+        if (n == 0)
+        {
+            g_printerr ("Daemon closed connection\n");
+            exit (EXIT_FAILURE);
+        }
+
+        counting = TRUE;
+        g_main_context_iteration (NULL, TRUE);
+        counting = FALSE;
+    }
+
+    return read_int (buffer, 0);
+}
+
+static void
+expect_message (int fd, guint8 *buffer, guint32 id)
+{
+    guint32 got = receive_message (fd, buffer);
+    if (got != id)
+    {
+        g_printerr ("Expected message %u from daemon, got %u\n", id, got);
+        exit (EXIT_FAILURE);
+    }
+}
+
+static Session *
+create_session_cb (Greeter *greeter)
+{
+    return session_new ();
+}
+
+static gboolean
+start_session_cb (Greeter *greeter, SessionType type, const gchar *session)
+{
+    return TRUE;
+}
+
+static void
+run_connection (void)
+{
+    int fds[2];
+    if (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    {
+        g_printerr ("Failed to make socket pair\n");
+        exit (EXIT_FAILURE);
+    }
+
+    counting = TRUE;
+    Greeter *greeter = greeter_new ();
+    g_signal_connect (greeter, GREETER_SIGNAL_CREATE_SESSION, G_CALLBACK (create_session_cb), NULL);
+    g_signal_connect (greeter, GREETER_SIGNAL_START_SESSION, G_CALLBACK (start_session_cb), NULL);
+    greeter_set_file_descriptors (greeter, fds[0], dup (fds[0]));
+    counting = FALSE;
+
+    guint8 buffer[MAX_MESSAGE_LENGTH];
+    gsize offset;
+
+    /* API version 1 so the user list isn't sent */
+    offset = HEADER_SIZE;
+    write_string (buffer, &offset, "benchmark");
+    write_int (buffer, &offset, 0);
+    write_int (buffer, &offset, 1);
+    send_message (fds[1], buffer, GREETER_MESSAGE_CONNECT, offset);
+    expect_message (fds[1], buffer, SERVER_MESSAGE_CONNECTED_V2);
+
+    offset = HEADER_SIZE;
+    write_int (buffer, &offset, 1);
+    write_string (buffer, &offset, "user");
+    send_message (fds[1], buffer, GREETER_MESSAGE_AUTHENTICATE, offset);
+    expect_message (fds[1], buffer, SERVER_MESSAGE_PROMPT_AUTHENTICATION);
+
+    offset = HEADER_SIZE;
+    write_int (buffer, &offset, 1);
+    write_string (buffer, &offset, FAKE_SESSION_PASSWORD);
+    send_message (fds[1], buffer, GREETER_MESSAGE_CONTINUE_AUTHENTICATION, offset);
+    expect_message (fds[1], buffer, SERVER_MESSAGE_END_AUTHENTICATION);
+    /* Sequence number, username, result */
+    if (read_int (buffer, HEADER_SIZE + 8 + read_int (buffer, HEADER_SIZE + 4)) != PAM_SUCCESS)
+    {
+        g_printerr ("Authentication failed\n");
+        exit (EXIT_FAILURE);
+    }
+
+    offset = HEADER_SIZE;
+    write_string (buffer, &offset, "");
+    send_message (fds[1], buffer, GREETER_MESSAGE_START_SESSION, offset);
+    expect_message (fds[1], buffer, SERVER_MESSAGE_SESSION_RESULT);
+    if (read_int (buffer, HEADER_SIZE) != 0)
+    {
+        g_printerr ("Session failed to start\n");
+        exit (EXIT_FAILURE);
+    }
+
+    counting = TRUE;
+    g_object_unref (greeter);
+    counting = FALSE;
+    close (fds[1]);
+}
+
+int
+main (int argc, char **argv)
+{
+    GOptionEntry options[] =
+    {
+        { "iterations", 'i', 0, G_OPTION_ARG_INT, &iterations, "Number of connections to run", "COUNT" },
+        { NULL }
+    };
+    g_autoptr(GOptionContext) context = g_option_context_new ("- benchmark the greeter protocol");
+    g_option_context_add_main_entries (context, options, NULL);
+    g_autoptr(GError) error = NULL;
+    if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+        g_printerr ("%s\n", error->message);
+        return EXIT_FAILURE;
+    }
+    if (iterations <= 0)
+    {
+        g_printerr ("Need at least one iteration\n");
+        return EXIT_FAILURE;
+    }
+
+    /* Warm up types and the main context */
+    run_connection ();
+    n_syscalls = 0;
+    n_allocations = 0;
+
+    gint64 start_time = g_get_monotonic_time ();
+    for (int i = 0; i < iterations; i++)
+        run_connection ();
+    gint64 duration = g_get_monotonic_time () - start_time;
+
+    guint64 n_messages = (guint64) iterations * MESSAGES_PER_ITERATION;
+    g_print ("%d connections, %" G_GUINT64_FORMAT " messages in %.3fs\n", iterations, n_messages, duration / 1e6);
+    g_print ("messages/s: %.0f\n", n_messages * 1e6 / MAX (duration, 1));
+    g_print ("syscalls/message: %.2f\n", (gdouble) n_syscalls / n_messages);
+    g_print ("allocations/message: %.2f\n", (gdouble) n_allocations / n_messages);
+
+    return EXIT_SUCCESS;
+}
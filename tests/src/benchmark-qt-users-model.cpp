@@ -0,0 +1,110 @@
+#include <QtTest/QtTest>
+#include <QLightDM/UsersModel>
+
+#include <lightdm.h>
+
+#define N_USERS 1000
+
+class UsersModelBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void load();
+    void changeUnmodified();
+    void removeAndAdd();
+
+private:
+    void verifySorted(QLightDM::UsersModel &model);
+};
+
+void UsersModelBenchmark::initTestCase()
+{
+    QDir root(QString::fromLocal8Bit(qgetenv("LIGHTDM_TEST_ROOT")));
+    QVERIFY(root.exists());
+    QVERIFY(root.mkpath(QLatin1String("etc")));
+
+    /* Real names are in a different order to user names so sorting matters */
+    QFile passwd(root.filePath(QLatin1String("etc/passwd")));
+    QVERIFY(passwd.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    for (int i = 0; i < N_USERS; i++) {
+        QByteArray line = QString::fromLatin1("user%1:x:%2:%2:Real Name %3:/home/user%1:/bin/sh\n")
+            .arg(i, 4, 10, QLatin1Char('0')).arg(1000 + i).arg((i * 7919) % N_USERS, 4, 10, QLatin1Char('0')).toLatin1();
+        passwd.write(line);
+    }
+    passwd.close();
+
+    QCOMPARE(lightdm_user_list_get_length(lightdm_user_list_get_instance()), N_USERS);
+}
+
+void UsersModelBenchmark::verifySorted(QLightDM::UsersModel &model)
+{
+    QByteArray last;
+    for (int i = 0; i < model.rowCount(QModelIndex()); i++) {
+        QByteArray name = model.data(model.index(i, 0), Qt::DisplayRole).toString().toUtf8();
+        QVERIFY(qstrcmp(last, name) <= 0);
+        last = name;
+    }
+}
+
+void UsersModelBenchmark::load()
+{
+    QBENCHMARK {
+        QLightDM::UsersModel model;
+        QCOMPARE(model.rowCount(QModelIndex()), N_USERS);
+    }
+}
+
+void UsersModelBenchmark::changeUnmodified()
+{
+    QLightDM::UsersModel model;
+    QSignalSpy changed(&model, SIGNAL(dataChanged(QModelIndex,QModelIndex)));
+    LightDMUserList *user_list = lightdm_user_list_get_instance();
+    GList *users = lightdm_user_list_get_users(user_list);
+
+    /* Change notifications that don't change anything shouldn't reach views */
+    QBENCHMARK {
+        for (GList *link = users; link; link = link->next) {
+            g_signal_emit_by_name(user_list, LIGHTDM_USER_LIST_SIGNAL_USER_CHANGED, link->data);
+        }
+    }
+    QCOMPARE(changed.count(), 0);
+}
+
+void UsersModelBenchmark::removeAndAdd()
+{
+    QLightDM::UsersModel model;
+    QSignalSpy inserted(&model, SIGNAL(rowsInserted(QModelIndex,int,int)));
+    QSignalSpy removed(&model, SIGNAL(rowsRemoved(QModelIndex,int,int)));
+    LightDMUserList *user_list = lightdm_user_list_get_instance();
+
+    /* Take a contiguous block of rows so each burst is a single range */
+    QList<LightDMUser *> block;
+    for (int i = N_USERS / 4; i < N_USERS * 3 / 4; i++) {
+        QString name = model.data(model.index(i, 0), QLightDM::UsersModel::NameRole).toString();
+        block.append(lightdm_user_list_get_user_by_name(user_list, name.toUtf8().constData()));
+    }
+
+    int iterations = 0;
+    QBENCHMARK {
+        Q_FOREACH (LightDMUser *user, block) {
+            g_signal_emit_by_name(user_list, LIGHTDM_USER_LIST_SIGNAL_USER_REMOVED, user);
+        }
+        QTRY_COMPARE(model.rowCount(QModelIndex()), N_USERS - block.size());
+
+        Q_FOREACH (LightDMUser *user, block) {
+            g_signal_emit_by_name(user_list, LIGHTDM_USER_LIST_SIGNAL_USER_ADDED, user);
+        }
+        QTRY_COMPARE(model.rowCount(QModelIndex()), N_USERS);
+        iterations++;
+    }
+
+    QCOMPARE(removed.count(), iterations);
+    QCOMPARE(inserted.count(), iterations);
+    verifySorted(model);
+}
+
+QTEST_GUILESS_MAIN(UsersModelBenchmark)
+
+#include "benchmark-qt5-users-model_moc5.cpp"
@@ -0,0 +1,207 @@
+#include <string.h>
+
+#include "session.h"
+#include "shared-data-manager.h"
+#include "fake-session.h"
+
+struct SessionPrivate
+{
+    gchar *username;
+    struct pam_message messages[1];
+    gboolean authenticated;
+    int authentication_result;
+};
+
+G_DEFINE_TYPE (Session, session, G_TYPE_OBJECT)
+G_DEFINE_TYPE (User, user, G_TYPE_OBJECT)
+
+enum {
+    GOT_MESSAGES,
+    AUTHENTICATION_COMPLETE,
+    LAST_SIGNAL
+};
+static guint signals[LAST_SIGNAL] = { 0 };
+
+static User *fake_user = NULL;
+
+Session *
+session_new (void)
+{
+    return g_object_new (SESSION_TYPE, NULL);
+}
+
+void
+session_set_pam_service (Session *session, const gchar *pam_service)
+{
+}
+
+void
+session_set_username (Session *session, const gchar *username)
+{
+    g_free (session->priv->username);
+    session->priv->username = g_strdup (username);
+}
+
+void
+session_set_do_authenticate (Session *session, gboolean do_authenticate)
+{
+}
+
+void
+session_set_is_interactive (Session *session, gboolean is_interactive)
+{
+}
+
+void
+session_set_is_guest (Session *session, gboolean is_guest)
+{
+}
+
+gboolean
+session_start (Session *session)
+{
+    /* Prompt straight away, as PAM would for a password */
+    g_signal_emit (session, signals[GOT_MESSAGES], 0);
+    return TRUE;
+}
+
+void
+session_stop (Session *session)
+{
+}
+
+const gchar *
+session_get_username (Session *session)
+{
+    return session->priv->username;
+}
+
+User *
+session_get_user (Session *session)
+{
+    if (!session->priv->authenticated)
+        return NULL;
+    if (!fake_user)
+        fake_user = g_object_new (USER_TYPE, NULL);
+    return fake_user;
+}
+
+void
+session_respond (Session *session, struct pam_response *response)
+{
+    session->priv->authenticated = strcmp (response[0].resp, FAKE_SESSION_PASSWORD) == 0;
+    session->priv->authentication_result = session->priv->authenticated ? PAM_SUCCESS : PAM_AUTH_ERR;
+    g_signal_emit (session, signals[AUTHENTICATION_COMPLETE], 0);
+}
+
+void
+session_respond_error (Session *session, int error)
+{
+    session->priv->authenticated = FALSE;
+    session->priv->authentication_result = error;
+    g_signal_emit (session, signals[AUTHENTICATION_COMPLETE], 0);
+}
+
+int
+session_get_messages_length (Session *session)
+{
+    return G_N_ELEMENTS (session->priv->messages);
+}
+
+const struct pam_message *
+session_get_messages (Session *session)
+{
+    return session->priv->messages;
+}
+
+gboolean
+session_get_is_authenticated (Session *session)
+{
+    return session && session->priv->authenticated;
+}
+
+int
+session_get_authentication_result (Session *session)
+{
+    return session->priv->authentication_result;
+}
+
+const gchar *
+session_get_authentication_result_string (Session *session)
+{
+    return session->priv->authentication_result == PAM_SUCCESS ? "PAM_SUCCESS" : "PAM_AUTH_ERR";
+}
+
+static void
+session_init (Session *session)
+{
+    session->priv = G_TYPE_INSTANCE_GET_PRIVATE (session, SESSION_TYPE, SessionPrivate);
+    session->priv->messages[0].msg_style = PAM_PROMPT_ECHO_OFF;
+    session->priv->messages[0].msg = "Password:";
+    session->priv->authentication_result = PAM_AUTH_ERR;
+}
+
+static void
+session_finalize (GObject *object)
+{
+    Session *self = SESSION (object);
+
+    g_clear_pointer (&self->priv->username, g_free);
+
+    G_OBJECT_CLASS (session_parent_class)->finalize (object);
+}
+
+static void
+session_class_init (SessionClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->finalize = session_finalize;
+
+    signals[GOT_MESSAGES] =
+        g_signal_new (SESSION_SIGNAL_GOT_MESSAGES,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (SessionClass, got_messages),
+                      NULL, NULL,
+                      NULL,
+                      G_TYPE_NONE, 0);
+
+    signals[AUTHENTICATION_COMPLETE] =
+        g_signal_new (SESSION_SIGNAL_AUTHENTICATION_COMPLETE,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (SessionClass, authentication_complete),
+                      NULL, NULL,
+                      NULL,
+                      G_TYPE_NONE, 0);
+
+    g_type_class_add_private (klass, sizeof (SessionPrivate));
+}
+
+void
+user_set_language (User *user, const gchar *language)
+{
+}
+
+static void
+user_init (User *user)
+{
+}
+
+static void
+user_class_init (UserClass *klass)
+{
+}
+
+SharedDataManager *
+shared_data_manager_get_instance (void)
+{
+    return NULL;
+}
+
+gchar *
+shared_data_manager_ensure_user_dir (SharedDataManager *manager, const gchar *user)
+{
+    return g_build_filename ("/var/lib/lightdm-data", user, NULL);
+}
@@ -0,0 +1,10 @@
+#ifndef FAKE_SESSION_H_
+#define FAKE_SESSION_H_
+
+/* Stand-ins for the daemon objects src/greeter.c uses, so a Greeter can be
+ * driven without PAM or session processes.  Every session prompts once for a
+ * password and accepts FAKE_SESSION_PASSWORD. */
+
+#define FAKE_SESSION_PASSWORD "password"
+
+#endif /* FAKE_SESSION_H_ */
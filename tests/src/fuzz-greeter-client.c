@@ -0,0 +1,52 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include <lightdm.h>
+
+/* libFuzzer entry point for the liblightdm-gobject side of the greeter
+ * protocol.  Build with --enable-fuzzers and run as
+ * ./src/fuzz-greeter-client CORPUS_DIR */
+
+/* The input is written to the pipe up front so it has to fit */
+#define PIPE_CAPACITY 65536
+
+int
+LLVMFuzzerTestOneInput (const uint8_t *data, size_t size)
+{
+    if (size > PIPE_CAPACITY)
+        return 0;
+
+    int to_server[2], from_server[2];
+    if (pipe (to_server) < 0)
+        return 0;
+    if (pipe (from_server) < 0)
+    {
+        close (to_server[0]);
+        close (to_server[1]);
+        return 0;
+    }
+
+    if (write (from_server[1], data, size) != (ssize_t) size)
+        g_error ("Failed to write fuzz input");
+    close (from_server[1]);
+
+    gchar fd[16];
+    snprintf (fd, sizeof (fd), "%d", to_server[1]);
+    g_setenv ("LIGHTDM_TO_SERVER_FD", fd, TRUE);
+    snprintf (fd, sizeof (fd), "%d", from_server[0]);
+    g_setenv ("LIGHTDM_FROM_SERVER_FD", fd, TRUE);
+
+    /* Connecting reads up to CONNECTED, anything after is handled from the main loop */
+    LightDMGreeter *greeter = lightdm_greeter_new ();
+    if (lightdm_greeter_connect_to_daemon_sync (greeter, NULL))
+        while (g_main_context_iteration (NULL, FALSE));
+
+    g_object_unref (greeter);
+    close (to_server[0]);
+    close (to_server[1]);
+    close (from_server[0]);
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <glib.h>
+
+#include "greeter.h"
+#include "fake-session.h"
+
+/* libFuzzer entry point for the daemon side of the greeter protocol.  Build
+ * with --enable-fuzzers and run as ./src/fuzz-greeter-daemon CORPUS_DIR */
+
+static Session *
+create_session_cb (Greeter *greeter)
+{
+    return session_new ();
+}
+
+static gboolean
+start_session_cb (Greeter *greeter, SessionType type, const gchar *session)
+{
+    return TRUE;
+}
+
+int
+LLVMFuzzerTestOneInput (const uint8_t *data, size_t size)
+{
+    int fds[2];
+    if (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        return 0;
+
+    Greeter *greeter = greeter_new ();
+    g_signal_connect (greeter, GREETER_SIGNAL_CREATE_SESSION, G_CALLBACK (create_session_cb), NULL);
+    g_signal_connect (greeter, GREETER_SIGNAL_START_SESSION, G_CALLBACK (start_session_cb), NULL);
+    greeter_set_file_descriptors (greeter, fds[0], dup (fds[0]));
+
+    /* Replies are discarded, so drain them as we go to stop the socket filling */
+    while (size > 0)
+    {
+        ssize_t n_written = send (fds[1], data, size, MSG_DONTWAIT);
+        if (n_written > 0)
+        {
+            data += n_written;
+            size -= n_written;
+        }
+        else if (!g_main_context_iteration (NULL, FALSE))
+            break;
+
+        guint8 reply[1024];
+        while (recv (fds[1], reply, sizeof (reply), MSG_DONTWAIT) > 0);
+    }
+    shutdown (fds[1], SHUT_WR);
+
+    /* Run until the daemon has processed everything */
+    gboolean did_work = TRUE;
+    while (did_work)
+    {
+        did_work = g_main_context_iteration (NULL, FALSE);
+
+        guint8 reply[1024];
+        while (recv (fds[1], reply, sizeof (reply), MSG_DONTWAIT) > 0)
+            did_work = TRUE;
+    }
+
+    g_object_unref (greeter);
+    close (fds[1]);
+
+    return 0;
+}
@@ -11,7 +11,9 @@
 #include <sys/stat.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/mman.h>
 #include <sys/un.h>
+#include <stddef.h>
 #include <netinet/in.h>
 #include <pwd.h>
 #include <unistd.h>
@@ -27,6 +29,7 @@
 #endif
 #include <glib.h>
 #include <xcb/xcb.h>
+#include <xcb/xcbext.h>
 #include <gio/gunixsocketaddress.h>
 
 #if HAVE_LIBAUDIT
@@ -39,13 +42,15 @@
 
 static int tty_fd = -1;
 
+/* Login record file being written, it goes to /dev/null and the records are reported instead */
+static int wtmp_fd = -1;
+static gchar *wtmp_path = NULL;
+
 static GList *user_entries = NULL;
 static GList *getpwent_link = NULL;
 
 static GList *group_entries = NULL;
 
-static int active_vt = 7;
-
 static gboolean status_connected = FALSE;
 static GKeyFile *config;
 
@@ -213,6 +218,25 @@ redirect_path (const gchar *path)
     return g_strdup (path);
 }
 
+/* The active VT is shared by all processes, so keep it in a file */
+static int
+get_active_vt (void)
+{
+    g_autofree gchar *path = g_build_filename (g_getenv ("LIGHTDM_TEST_ROOT"), "active-vt", NULL);
+    g_autofree gchar *contents = NULL;
+    if (!g_file_get_contents (path, &contents, NULL, NULL))
+        return 7;
+    return atoi (contents);
+}
+
+static void
+set_active_vt (int vt)
+{
+    g_autofree gchar *path = g_build_filename (g_getenv ("LIGHTDM_TEST_ROOT"), "active-vt", NULL);
+    g_autofree gchar *contents = g_strdup_printf ("%d", vt);
+    g_file_set_contents (path, contents, -1, NULL);
+}
+
 #ifdef __linux__
 static int
 open_wrapper (const char *func, const char *pathname, int flags, mode_t mode)
@@ -229,6 +253,18 @@ open_wrapper (const char *func, const char *pathname, int flags, mode_t mode)
         return tty_fd;
     }
 
+    if (strcmp (pathname, "/var/log/wtmp") == 0 || strcmp (pathname, "/var/log/btmp") == 0)
+    {
+        int fd = _open ("/dev/null", flags, mode);
+        if (fd >= 0)
+        {
+            wtmp_fd = fd;
+            g_free (wtmp_path);
+            wtmp_path = g_strdup (pathname);
+        }
+        return fd;
+    }
+
     g_autofree gchar *new_path = redirect_path (pathname);
     return _open (new_path, flags, mode);
 }
@@ -413,17 +449,17 @@ ioctl (int d, unsigned long request, ...)
             va_start (ap, request);
             struct vt_stat *vt_state = va_arg (ap, struct vt_stat *);
             va_end (ap);
-            vt_state->v_active = active_vt;
+            vt_state->v_active = get_active_vt ();
             break;
         case VT_ACTIVATE:
             va_start (ap, request);
             int vt = va_arg (ap, int);
             va_end (ap);
-            if (vt != active_vt)
+            if (vt != get_active_vt ())
             {
-                active_vt = vt;
+                set_active_vt (vt);
                 connect_status ();
-                status_notify ("VT ACTIVATE VT=%d", active_vt);
+                status_notify ("VT ACTIVATE VT=%d", vt);
             }
             break;
         case VT_WAITACTIVE:
@@ -548,6 +584,7 @@ connect (int sockfd, const struct sockaddr *addr, socklen_t addrlen)
     int (*_connect) (int sockfd, const struct sockaddr *addr, socklen_t addrlen) = dlsym (RTLD_NEXT, "connect");
 
     const struct sockaddr *modified_addr = addr;
+    socklen_t modified_addrlen = addrlen;
     struct sockaddr_in temp_addr_in;
     struct sockaddr_in6 temp_addr_in6;
     struct sockaddr_un temp_addr_un;
@@ -564,6 +601,17 @@ connect (int sockfd, const struct sockaddr *addr, socklen_t addrlen)
             strncpy (temp_addr_un.sun_path, new_path, sizeof (temp_addr_un.sun_path) - 1);
             modified_addr = (struct sockaddr *) &temp_addr_un;
         }
+        /* Plymouth listens on an abstract socket, use the test one instead */
+        else if (addrlen >= offsetof (struct sockaddr_un, sun_path) + 1 + strlen ("/org/freedesktop/plymouthd") &&
+                 strncmp (path + 1, "/org/freedesktop/plymouthd", addrlen - offsetof (struct sockaddr_un, sun_path) - 1) == 0)
+        {
+            g_autofree gchar *new_path = g_build_filename (g_getenv ("LIGHTDM_TEST_ROOT"), "run", "plymouthd", NULL);
+            memset (&temp_addr_un, 0, sizeof (temp_addr_un));
+            temp_addr_un.sun_family = AF_UNIX;
+            strncpy (temp_addr_un.sun_path, new_path, sizeof (temp_addr_un.sun_path) - 1);
+            modified_addr = (struct sockaddr *) &temp_addr_un;
+            modified_addrlen = sizeof (temp_addr_un);
+        }
         break;
     case AF_INET:
         port = ntohs (((const struct sockaddr_in *) addr)->sin_port);
@@ -587,7 +635,7 @@ connect (int sockfd, const struct sockaddr *addr, socklen_t addrlen)
         break;
     }
 
-    return _connect (sockfd, modified_addr, addrlen);
+    return _connect (sockfd, modified_addr, modified_addrlen);
 }
 
 ssize_t
@@ -643,6 +691,8 @@ close (int fd)
 {
     if (fd > 0 && fd == tty_fd)
         return 0;
+    if (fd >= 0 && fd == wtmp_fd)
+        wtmp_fd = -1;
 
     int (*_close) (int fd) = dlsym (RTLD_NEXT, "close");
     return _close (fd);
@@ -1166,17 +1216,22 @@ pam_getenvlist (pam_handle_t *pamh)
 int
 pam_set_item (pam_handle_t *pamh, int item_type, const void *item)
 {
-    if (item == NULL)
-        return PAM_SYSTEM_ERR;
-
     switch (item_type)
     {
     case PAM_TTY:
+        if (item == NULL)
+            return PAM_SYSTEM_ERR;
         if (pamh->tty)
             free (pamh->tty);
         pamh->tty = strdup ((const char *) item);
         return PAM_SUCCESS;
 
+    case PAM_AUTHTOK:
+        if (pamh->authtok)
+            free (pamh->authtok);
+        pamh->authtok = item ? strdup ((const char *) item) : NULL;
+        return PAM_SUCCESS;
+
     default:
         return PAM_BAD_ITEM;
     }
@@ -1575,48 +1630,76 @@ endutxent (void)
 {
 }
 
+static void
+notify_wtmp (const char *wtmp_file, const struct utmp *ut)
+{
+    g_autoptr(GString) status = g_string_new ("WTMP");
+    g_string_append_printf (status, " FILE=%s", wtmp_file);
+    switch (ut->ut_type)
+    {
+    case INIT_PROCESS:
+        g_string_append_printf (status, " TYPE=INIT_PROCESS");
+        break;
+    case LOGIN_PROCESS:
+        g_string_append_printf (status, " TYPE=LOGIN_PROCESS");
+        break;
+    case USER_PROCESS:
+        g_string_append_printf (status, " TYPE=USER_PROCESS");
+        break;
+    case DEAD_PROCESS:
+        g_string_append_printf (status, " TYPE=DEAD_PROCESS");
+        break;
+    default:
+        g_string_append_printf (status, " TYPE=%d", ut->ut_type);
+    }
+    if (ut->ut_line)
+        g_string_append_printf (status, " LINE=%s", ut->ut_line);
+    if (ut->ut_id)
+        g_string_append_printf (status, " ID=%s", ut->ut_id);
+    if (ut->ut_user)
+        g_string_append_printf (status, " USER=%s", ut->ut_user);
+    if (ut->ut_host)
+        g_string_append_printf (status, " HOST=%s", ut->ut_host);
+    status_notify ("%s", status->str);
+}
+
 void
 updwtmp (const char *wtmp_file, const struct utmp *ut)
 {
     connect_status ();
     if (g_key_file_get_boolean (config, "test-utmp-config", "check-events", NULL))
+        notify_wtmp (wtmp_file, ut);
+}
+
+#ifdef __linux__
+ssize_t
+write (int fd, const void *buf, size_t count)
+{
+    ssize_t (*_write) (int fd, const void *buf, size_t count) = dlsym (RTLD_NEXT, "write");
+
+    /* Report each batch written to a login record file and the records in it */
+    if (fd >= 0 && fd == wtmp_fd)
     {
-        g_autoptr(GString) status = g_string_new ("WTMP");
-        g_string_append_printf (status, " FILE=%s", wtmp_file);
-        switch (ut->ut_type)
+        connect_status ();
+        if (g_key_file_get_boolean (config, "test-utmp-config", "check-events", NULL))
         {
-        case INIT_PROCESS:
-            g_string_append_printf (status, " TYPE=INIT_PROCESS");
-            break;
-        case LOGIN_PROCESS:
-            g_string_append_printf (status, " TYPE=LOGIN_PROCESS");
-            break;
-        case USER_PROCESS:
-            g_string_append_printf (status, " TYPE=USER_PROCESS");
-            break;
-        case DEAD_PROCESS:
-            g_string_append_printf (status, " TYPE=DEAD_PROCESS");
-            break;
-        default:
-            g_string_append_printf (status, " TYPE=%d", ut->ut_type);
+            status_notify ("WTMP WRITE FILE=%s RECORDS=%zu", wtmp_path, count / sizeof (struct utmp));
+            for (size_t offset = 0; offset + sizeof (struct utmp) <= count; offset += sizeof (struct utmp))
+                notify_wtmp (wtmp_path, (const struct utmp *) ((const guint8 *) buf + offset));
         }
-        if (ut->ut_line)
-            g_string_append_printf (status, " LINE=%s", ut->ut_line);
-        if (ut->ut_id)
-            g_string_append_printf (status, " ID=%s", ut->ut_id);
-        if (ut->ut_user)
-            g_string_append_printf (status, " USER=%s", ut->ut_user);
-        if (ut->ut_host)
-            g_string_append_printf (status, " HOST=%s", ut->ut_host);
-        status_notify ("%s", status->str);
     }
+
+    return _write (fd, buf, count);
 }
+#endif
 
 struct xcb_connection_t
 {
     gchar *display;
     int error;
     GSocket *socket;
+    unsigned int sequence;
+    unsigned int n_replies;
 };
 
 xcb_connection_t *
@@ -1625,6 +1708,8 @@ xcb_connect_to_display_with_auth_info (const char *display, xcb_auth_info_t *aut
     xcb_connection_t *c = malloc (sizeof (xcb_connection_t));
     c->display = g_strdup (display);
     c->error = 0;
+    c->sequence = 0;
+    c->n_replies = 0;
 
     if (display == NULL)
         display = getenv ("DISPLAY");
@@ -1676,6 +1761,63 @@ xcb_connection_has_error (xcb_connection_t *c)
     return c->error;
 }
 
+xcb_generic_event_t *
+xcb_poll_for_event (xcb_connection_t *c)
+{
+    if (c->error)
+        return NULL;
+
+    /* No events are sent, but count replies and notice if the server has closed the connection */
+    gchar buffer[1024];
+    g_autoptr(GError) error = NULL;
+    gssize n_read;
+    while ((n_read = g_socket_receive_with_blocking (c->socket, buffer, sizeof (buffer), FALSE, NULL, &error)) > 0)
+    {
+        for (gssize i = 0; i < n_read; i++)
+            if (buffer[i] == '\n')
+                c->n_replies++;
+    }
+    if (n_read == 0 || !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
+        c->error = XCB_CONN_ERROR;
+
+    return NULL;
+}
+
+xcb_get_input_focus_cookie_t
+xcb_get_input_focus (xcb_connection_t *c)
+{
+    xcb_get_input_focus_cookie_t cookie = { 0 };
+
+    if (c->error)
+        return cookie;
+
+    /* Every request gets a reply, so the sequence number is the number of replies to wait for */
+    const gchar *request = "GET-INPUT-FOCUS\n";
+    if (g_socket_send (c->socket, request, strlen (request), NULL, NULL) != strlen (request))
+        c->error = XCB_CONN_ERROR;
+    c->sequence++;
+    cookie.sequence = c->sequence;
+
+    return cookie;
+}
+
+int
+xcb_flush (xcb_connection_t *c)
+{
+    return c->error == 0;
+}
+
+int
+xcb_poll_for_reply (xcb_connection_t *c, unsigned int request, void **reply, xcb_generic_error_t **error)
+{
+    *reply = NULL;
+    if (error)
+        *error = NULL;
+
+    /* Replies that will never come are returned as empty */
+    return c->error || c->n_replies >= request;
+}
+
 void
 xcb_disconnect (xcb_connection_t *c)
 {
@@ -1729,3 +1871,14 @@ audit_log_acct_message (int audit_fd, int type, const char *pgname,
 }
 
 #endif
+
+int
+munlockall (void)
+{
+    connect_status ();
+    if (g_key_file_get_boolean (config, "test-memory-config", "check-events", NULL))
+        status_notify ("MEMORY MUNLOCKALL");
+
+    int (*_munlockall) (void) = dlsym (RTLD_NEXT, "munlockall");
+    return _munlockall ();
+}
@@ -1,5 +1,8 @@
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
 #include <glib.h>
 #include <glib-object.h>
 
@@ -7,53 +10,152 @@
 
 static GKeyFile *config;
 
-int
-main (int argc, char **argv)
-{
-#if !defined(GLIB_VERSION_2_36)
-    g_type_init ();
-#endif
+static GMainLoop *loop;
 
-    status_connect (NULL, NULL);
+typedef struct
+{
+    int fd;
+    GByteArray *buffer;
+} Client;
 
-    config = g_key_file_new ();
-    g_key_file_load_from_file (config, g_build_filename (g_getenv ("LIGHTDM_TEST_ROOT"), "script", NULL), G_KEY_FILE_NONE, NULL);
+static void
+send_response (Client *client, gboolean success)
+{
+    /* Act like a daemon that has stopped responding */
+    if (g_key_file_get_boolean (config, "test-plymouth-config", "hang", NULL))
+        return;
 
-    if (!g_key_file_get_boolean (config, "test-plymouth-config", "enabled", NULL))
-        return EXIT_FAILURE;
+    /* ACK or NAK */
+    guint8 response = success ? '\006' : '\025';
+    if (write (client->fd, &response, 1) != 1)
+        g_printerr ("Failed to write response: %s\n", strerror (errno));
+}
 
-    if (argc == 2 && strcmp (argv[1], "--ping") == 0)
+static void
+handle_request (Client *client, guint8 command, const gchar *argument)
+{
+    switch (command)
     {
+    case 'P':
         if (g_key_file_get_boolean (config, "test-plymouth-config", "active", NULL))
         {
             status_notify ("PLYMOUTH PING ACTIVE=TRUE");
-            return EXIT_SUCCESS;
+            send_response (client, TRUE);
         }
         else
         {
             status_notify ("PLYMOUTH PING ACTIVE=FALSE");
-            return EXIT_FAILURE;
+            send_response (client, FALSE);
         }
-    }
-    if (argc == 2 && strcmp (argv[1], "--has-active-vt") == 0)
-    {
+        break;
+    case 'V':
         if (g_key_file_get_boolean (config, "test-plymouth-config", "has-active-vt", NULL))
         {
             status_notify ("PLYMOUTH HAS-ACTIVE-VT=TRUE");
-            return EXIT_SUCCESS;
+            send_response (client, TRUE);
         }
         else
         {
             status_notify ("PLYMOUTH HAS-ACTIVE-VT=FALSE");
-            return EXIT_FAILURE;
+            send_response (client, FALSE);
         }
-    }
-    if (argc == 2 && strcmp (argv[1], "deactivate") == 0)
+        break;
+    case 'D':
         status_notify ("PLYMOUTH DEACTIVATE");
-    if (argc == 2 && strcmp (argv[1], "quit") == 0)
-        status_notify ("PLYMOUTH QUIT RETAIN-SPLASH=FALSE");
-    if (argc == 3 && strcmp (argv[1], "quit") == 0 && strcmp (argv[2], "--retain-splash") == 0)
-        status_notify ("PLYMOUTH QUIT RETAIN-SPLASH=TRUE");
+        send_response (client, TRUE);
+        break;
+    case 'Q':
+        status_notify ("PLYMOUTH QUIT RETAIN-SPLASH=%s", argument && argument[0] != '\0' ? "TRUE" : "FALSE");
+        send_response (client, TRUE);
+        g_main_loop_quit (loop);
+        break;
+    default:
+        send_response (client, FALSE);
+        break;
+    }
+}
+
+static gboolean
+client_read_cb (GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+    Client *client = data;
+
+    guint8 buffer[1024];
+    ssize_t n_read = read (client->fd, buffer, sizeof (buffer));
+    if (n_read <= 0)
+    {
+        close (client->fd);
+        g_byte_array_unref (client->buffer);
+        g_free (client);
+        return G_SOURCE_REMOVE;
+    }
+    g_byte_array_append (client->buffer, buffer, n_read);
+
+    /* Requests are a command byte, then either a nul or an argument with a length prefix */
+    while (client->buffer->len >= 2)
+    {
+        guint8 *request = client->buffer->data;
+        gsize request_length = 2;
+        g_autofree gchar *argument = NULL;
+        if (request[1] == '\002')
+        {
+            if (client->buffer->len < 3 || client->buffer->len < 3 + request[2])
+                break;
+            argument = g_strndup ((const gchar *) request + 3, request[2]);
+            request_length = 3 + request[2];
+        }
+
+        handle_request (client, request[0], argument);
+        g_byte_array_remove_range (client->buffer, 0, request_length);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+accept_cb (GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+    int listen_fd = GPOINTER_TO_INT (data);
+
+    int fd = accept (listen_fd, NULL, NULL);
+    if (fd < 0)
+        return G_SOURCE_CONTINUE;
+
+    Client *client = g_malloc0 (sizeof (Client));
+    client->fd = fd;
+    client->buffer = g_byte_array_new ();
+    g_autoptr(GIOChannel) client_channel = g_io_channel_unix_new (fd);
+    g_io_add_watch (client_channel, G_IO_IN | G_IO_HUP, client_read_cb, client);
+
+    return G_SOURCE_CONTINUE;
+}
+
+int
+main (int argc, char **argv)
+{
+#if !defined(GLIB_VERSION_2_36)
+    g_type_init ();
+#endif
+
+    /* Plymouth daemon stand-in, the test runner has already set up the socket */
+    if (argc != 3 || strcmp (argv[1], "--listen-fd") != 0)
+    {
+        g_printerr ("Usage %s --listen-fd fd\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int listen_fd = atoi (argv[2]);
+
+    loop = g_main_loop_new (NULL, FALSE);
+
+    status_connect (NULL, NULL);
+
+    config = g_key_file_new ();
+    g_key_file_load_from_file (config, g_build_filename (g_getenv ("LIGHTDM_TEST_ROOT"), "script", NULL), G_KEY_FILE_NONE, NULL);
+
+    g_autoptr(GIOChannel) channel = g_io_channel_unix_new (listen_fd);
+    g_io_add_watch (channel, G_IO_IN, accept_cb, GINT_TO_POINTER (listen_fd));
+
+    g_main_loop_run (loop);
 
     return EXIT_SUCCESS;
 }
@@ -110,6 +110,14 @@ user_changed_cb (LightDMUser *user)
     status_notify ("%s USER-CHANGED USERNAME=%s", greeter_id, lightdm_user_get_name (user));
 }
 
+static void
+power_notify_cb (LightDMPower *power, GParamSpec *pspec)
+{
+    gboolean allowed;
+    g_object_get (power, pspec->name, &allowed, NULL);
+    status_notify ("%s POWER-CHANGED PROPERTY=%s ALLOWED=%s", greeter_id, pspec->name, allowed ? "TRUE" : "FALSE");
+}
+
 static void
 start_session_finished (GObject *object, GAsyncResult *result, gpointer data)
 {
@@ -223,6 +231,16 @@ request_cb (const gchar *name, GHashTable *params)
     else if (strcmp (name, "START-SESSION") == 0)
         lightdm_greeter_start_session (greeter, g_hash_table_lookup (params, "SESSION"), NULL, start_session_finished, NULL);
 
+    else if (strcmp (name, "START-SESSION-SYNC") == 0)
+    {
+        const gchar *timeout = g_hash_table_lookup (params, "TIMEOUT");
+        g_autoptr(GError) error = NULL;
+        if (lightdm_greeter_start_session_sync_with_timeout (greeter, g_hash_table_lookup (params, "SESSION"), timeout ? atoi (timeout) : -1, &error))
+            status_notify ("%s START-SESSION-SYNC RESULT=TRUE", greeter_id);
+        else
+            status_notify ("%s START-SESSION-SYNC ERROR=%s", greeter_id, error->message);
+    }
+
     else if (strcmp (name, "LOG-DEFAULT-SESSION") == 0)
         status_notify ("%s LOG-DEFAULT-SESSION SESSION=%s", greeter_id, lightdm_greeter_get_default_session_hint (greeter));
 
@@ -238,6 +256,17 @@ request_cb (const gchar *name, GHashTable *params)
     else if (strcmp (name, "READ-SHARED-DATA") == 0)
         lightdm_greeter_ensure_shared_data_dir (greeter, g_hash_table_lookup (params, "USERNAME"), NULL, read_shared_data_finished, NULL);
 
+    else if (strcmp (name, "ENSURE-SHARED-DATA-DIR-SYNC") == 0)
+    {
+        const gchar *timeout = g_hash_table_lookup (params, "TIMEOUT");
+        g_autoptr(GError) error = NULL;
+        g_autofree gchar *dir = lightdm_greeter_ensure_shared_data_dir_sync_with_timeout (greeter, g_hash_table_lookup (params, "USERNAME"), timeout ? atoi (timeout) : -1, &error);
+        if (dir)
+            status_notify ("%s ENSURE-SHARED-DATA-DIR-SYNC DIR=%s", greeter_id, dir);
+        else
+            status_notify ("%s ENSURE-SHARED-DATA-DIR-SYNC ERROR=%s", greeter_id, error->message);
+    }
+
     else if (strcmp (name, "WATCH-USER") == 0)
     {
         const gchar *username = g_hash_table_lookup (params, "USERNAME");
@@ -319,6 +348,13 @@ request_cb (const gchar *name, GHashTable *params)
         }
     }
 
+    else if (strcmp (name, "WATCH-POWER") == 0)
+    {
+        LightDMPower *power = lightdm_power_get_instance ();
+        g_signal_connect (power, "notify", G_CALLBACK (power_notify_cb), NULL);
+        status_notify ("%s WATCH-POWER CAN-SUSPEND=%s", greeter_id, lightdm_power_get_can_suspend (power) ? "TRUE" : "FALSE");
+    }
+
     else if (strcmp (name, "GET-CAN-SUSPEND") == 0)
     {
         gboolean can_suspend = lightdm_get_can_suspend ();
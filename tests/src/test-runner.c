@@ -9,6 +9,8 @@
 #include <gio/gio.h>
 #include <gio/gunixsocketaddress.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <pwd.h>
 
 /* Timeout in ms waiting for the status we expect */
@@ -17,6 +19,9 @@ static int status_timeout_ms = 4000;
 /* Timeout in ms to wait for SIGTERM to be handled by a child process */
 #define KILL_TIMEOUT 2000
 
+/* Depth of shared data trees, more than the default limit of open file descriptors */
+#define SHARED_DATA_TREE_DEPTH 1500
+
 static gchar *test_runner_command;
 static gchar *config_path;
 static GKeyFile *config;
@@ -103,6 +108,42 @@ typedef struct
 } StatusClient;
 static GList *status_clients = NULL;
 
+/* Time the last switch was requested and how long until its VT was activated */
+static gint64 switch_start_time = 0;
+static gint64 switch_latency = -1;
+
+/* Scale benchmark run instead of a script, configured in [test-runner-scale] */
+typedef struct
+{
+    gint n_seats;
+    gint n_xdmcp_clients;
+    gint n_vnc_clients;
+    gint n_logins;
+    gint n_users;
+    gint xdmcp_display_base;
+    gint next_xdmcp_display;
+    gint n_logins_started;
+    gint n_logins_completed;
+    gint next_user;
+    gboolean finished;
+    /* Display ID -> time authentication was started */
+    GHashTable *logins;
+    /* Xvnc servers that have had the VNC handshake started */
+    GHashTable *vnc_servers;
+    GArray *login_times;
+    GArray *latencies;
+    gint64 start_time;
+    gint64 latency_start_time;
+    guint latency_timeout;
+} ScaleBenchmark;
+static ScaleBenchmark *scale = NULL;
+
+/* First display number used for the local X seats */
+#define SCALE_DISPLAY_BASE 100
+
+/* Interval in ms between main loop latency probes of the daemon */
+#define SCALE_LATENCY_INTERVAL 100
+
 static void ready (void);
 static void quit (int status);
 static gboolean status_timeout_cb (gpointer data);
@@ -111,6 +152,8 @@ static AccountsUser *get_accounts_user_by_uid (guint uid);
 static AccountsUser *get_accounts_user_by_name (const gchar *username);
 static void accounts_user_set_hidden (AccountsUser *user, gboolean hidden, gboolean emit_signal);
 static Login1Session *find_login1_session (const gchar *id);
+static void scale_handle_status (const gchar *status);
+static void scale_start (void);
 
 static gboolean
 kill_timeout_cb (gpointer data)
@@ -341,6 +384,12 @@ switch_to_guest_done_cb (GObject *bus, GAsyncResult *result, gpointer data)
     }
 }
 
+static gint
+compare_strings (gconstpointer a, gconstpointer b)
+{
+    return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
 static void
 handle_command (const gchar *command)
 {
@@ -621,6 +670,61 @@ handle_command (const gchar *command)
 
         check_status (status->str);
     }
+    else if (strcmp (name, "LIST-OBJECTS") == 0)
+    {
+        g_autoptr(GError) error = NULL;
+        g_autoptr(GVariant) result = g_dbus_connection_call_sync (g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL),
+                                                                  "org.freedesktop.DisplayManager",
+                                                                  "/org/freedesktop/DisplayManager",
+                                                                  "org.freedesktop.DBus.ObjectManager",
+                                                                  "GetManagedObjects",
+                                                                  NULL,
+                                                                  G_VARIANT_TYPE ("(a{oa{sa{sv}}})"),
+                                                                  G_DBUS_CALL_FLAGS_NONE,
+                                                                  G_MAXINT,
+                                                                  NULL,
+                                                                  &error);
+
+        g_autoptr(GString) status = g_string_new ("RUNNER LIST-OBJECTS");
+        if (result)
+        {
+            g_string_append (status, " OBJECTS=");
+
+            /* Sort by path so the output doesn't depend on the order the daemon stores objects */
+            g_autoptr(GPtrArray) objects = g_ptr_array_new_with_free_func (g_free);
+            GVariantIter *iter;
+            g_variant_get (result, "(a{oa{sa{sv}}})", &iter);
+            const gchar *path;
+            GVariant *interfaces;
+            while (g_variant_iter_loop (iter, "{&o@a{sa{sv}}}", &path, &interfaces))
+            {
+                g_autoptr(GVariant) session_properties = g_variant_lookup_value (interfaces, "org.freedesktop.DisplayManager.Session", G_VARIANT_TYPE ("a{sv}"));
+                const gchar *username = NULL;
+                if (session_properties && g_variant_lookup (session_properties, "UserName", "&s", &username))
+                    g_ptr_array_add (objects, g_strdup_printf ("%s:%s", path, username));
+                else
+                    g_ptr_array_add (objects, g_strdup (path));
+            }
+            g_variant_iter_free (iter);
+            g_ptr_array_sort (objects, compare_strings);
+
+            for (guint i = 0; i < objects->len; i++)
+            {
+                if (i != 0)
+                    g_string_append (status, ",");
+                g_string_append (status, (const gchar *) objects->pdata[i]);
+            }
+        }
+        else
+        {
+            if (g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_SERVICE_UNKNOWN))
+                g_string_append_printf (status, " ERROR=SERVICE_UNKNOWN");
+            else
+                g_string_append_printf (status, " ERROR=%s", error->message);
+        }
+
+        check_status (status->str);
+    }
     else if (strcmp (name, "SEAT-CAN-SWITCH") == 0)
     {
         g_autoptr(GError) error = NULL;
@@ -687,6 +791,8 @@ handle_command (const gchar *command)
     }
     else if (strcmp (name, "SWITCH-TO-GREETER") == 0)
     {
+        switch_start_time = g_get_monotonic_time ();
+        switch_latency = -1;
         g_dbus_connection_call (g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL),
                                 "org.freedesktop.DisplayManager",
                                 "/org/freedesktop/DisplayManager/Seat0",
@@ -702,6 +808,8 @@ handle_command (const gchar *command)
     }
     else if (strcmp (name, "SWITCH-TO-USER") == 0)
     {
+        switch_start_time = g_get_monotonic_time ();
+        switch_latency = -1;
         const gchar *username = g_hash_table_lookup (params, "USERNAME");
         g_dbus_connection_call (g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL),
                                 "org.freedesktop.DisplayManager",
@@ -718,6 +826,8 @@ handle_command (const gchar *command)
     }
     else if (strcmp (name, "SWITCH-TO-GUEST") == 0)
     {
+        switch_start_time = g_get_monotonic_time ();
+        switch_latency = -1;
         g_dbus_connection_call (g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL),
                                 "org.freedesktop.DisplayManager",
                                 "/org/freedesktop/DisplayManager/Seat0",
@@ -733,6 +843,190 @@ handle_command (const gchar *command)
     }
     else if (strcmp (name, "STOP-DAEMON") == 0)
         stop_process (lightdm_process);
+    else if (strcmp (name, "PAUSE-DAEMON") == 0)
+        kill (lightdm_process->pid, SIGSTOP);
+    else if (strcmp (name, "RESUME-DAEMON") == 0)
+        kill (lightdm_process->pid, SIGCONT);
+    else if (strcmp (name, "RELOAD-CONFIG") == 0)
+    {
+        /* Add another configuration file then have the daemon reload */
+        const gchar *file = g_hash_table_lookup (params, "FILE");
+        if (file)
+        {
+            g_autofree gchar *dir = g_build_filename (temp_dir, "etc", "xdg", "lightdm", "lightdm.conf.d", NULL);
+            g_mkdir_with_parents (dir, 0755);
+
+            g_autofree gchar *source_path = g_build_filename (SRCDIR, "tests", "scripts", file, NULL);
+            g_autofree gchar *dest_path = g_build_filename (dir, file, NULL);
+            g_autoptr(GFile) source = g_file_new_for_path (source_path);
+            g_autoptr(GFile) dest = g_file_new_for_path (dest_path);
+            g_autoptr(GError) error = NULL;
+            if (!g_file_copy (source, dest, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, &error))
+                g_warning ("Failed to copy configuration %s: %s", source_path, error->message);
+        }
+        kill (lightdm_process->pid, SIGHUP);
+    }
+    else if (strcmp (name, "REPORT-SWITCH-LATENCY") == 0)
+    {
+        /* Exact times vary from run to run, so scripts check against a limit instead */
+        const gchar *v = g_hash_table_lookup (params, "MAX-MS");
+        gint max_ms = v ? atoi (v) : -1;
+
+        g_autofree gchar *status = NULL;
+        if (switch_latency < 0)
+            status = g_strdup ("RUNNER SWITCH-LATENCY NONE");
+        else if (max_ms >= 0 && switch_latency / 1000 <= max_ms)
+            status = g_strdup_printf ("RUNNER SWITCH-LATENCY WITHIN MAX-MS=%d", max_ms);
+        else
+            status = g_strdup_printf ("RUNNER SWITCH-LATENCY MS=%d", (int) (switch_latency / 1000));
+        check_status (status);
+    }
+    else if (strcmp (name, "REPORT-SESSION-MEMORY") == 0)
+    {
+        int n_sessions = 0, total_rss = 0, total_locked = 0;
+
+        /* Session children are the daemon's children running "lightdm --session-child" */
+        g_autoptr(GDir) dir = g_dir_open ("/proc", 0, NULL);
+        const gchar *entry;
+        while (lightdm_process && dir && (entry = g_dir_read_name (dir)))
+        {
+            if (!g_ascii_isdigit (entry[0]))
+                continue;
+
+            g_autofree gchar *cmdline_path = g_build_filename ("/proc", entry, "cmdline", NULL);
+            g_autofree gchar *cmdline = NULL;
+            gsize cmdline_length;
+            if (!g_file_get_contents (cmdline_path, &cmdline, &cmdline_length, NULL))
+                continue;
+            const gchar *arg1 = cmdline + strlen (cmdline) + 1;
+            if (arg1 >= cmdline + cmdline_length || strcmp (arg1, "--session-child") != 0)
+                continue;
+
+            g_autofree gchar *status_path = g_build_filename ("/proc", entry, "status", NULL);
+            g_autofree gchar *status = NULL;
+            if (!g_file_get_contents (status_path, &status, NULL, NULL))
+                continue;
+            g_auto(GStrv) lines = g_strsplit (status, "\n", -1);
+            int ppid = 0, rss = 0, locked = 0;
+            for (int i = 0; lines[i]; i++)
+            {
+                if (g_str_has_prefix (lines[i], "PPid:"))
+                    ppid = atoi (lines[i] + strlen ("PPid:"));
+                else if (g_str_has_prefix (lines[i], "VmRSS:"))
+                    rss = atoi (lines[i] + strlen ("VmRSS:"));
+                else if (g_str_has_prefix (lines[i], "VmLck:"))
+                    locked = atoi (lines[i] + strlen ("VmLck:"));
+            }
+            if (ppid != lightdm_process->pid)
+                continue;
+
+            if (getenv ("DEBUG"))
+                g_print ("Session child %s: RSS=%dkB LOCKED=%dkB\n", entry, rss, locked);
+            n_sessions++;
+            total_rss += rss;
+            total_locked += locked;
+        }
+        if (n_sessions > 0)
+            g_print ("Memory per session: RSS=%dkB LOCKED=%dkB\n", total_rss / n_sessions, total_locked / n_sessions);
+
+        g_autofree gchar *status = g_strdup_printf ("RUNNER SESSION-MEMORY SESSIONS=%d RSS=%d LOCKED=%d", n_sessions, total_rss, total_locked);
+        check_status (status);
+    }
+    else if (strcmp (name, "GET-MAIN-LOOP-STATISTICS") == 0)
+    {
+        g_autoptr(GVariant) result = g_dbus_connection_call_sync (g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL),
+                                                                  "org.freedesktop.DisplayManager",
+                                                                  "/org/freedesktop/DisplayManager",
+                                                                  "org.freedesktop.DisplayManager",
+                                                                  "GetMainLoopStatistics",
+                                                                  NULL,
+                                                                  G_VARIANT_TYPE ("(a(ut)tu)"),
+                                                                  G_DBUS_CALL_FLAGS_NONE,
+                                                                  G_MAXINT,
+                                                                  NULL,
+                                                                  NULL);
+
+        g_autofree gchar *status = NULL;
+        if (result)
+        {
+            g_autoptr(GVariantIter) iter = NULL;
+            guint64 n_stalls;
+            guint32 max_latency;
+            g_variant_get (result, "(a(ut)tu)", &iter, &n_stalls, &max_latency);
+            guint64 n_dispatches = 0, count;
+            while (g_variant_iter_loop (iter, "(ut)", NULL, &count))
+                n_dispatches += count;
+            if (getenv ("DEBUG"))
+                g_print ("Longest main loop dispatch: %uus\n", max_latency);
+            status = g_strdup_printf ("RUNNER MAIN-LOOP-STATISTICS DISPATCHES=%" G_GUINT64_FORMAT " STALLS=%" G_GUINT64_FORMAT, n_dispatches, n_stalls);
+        }
+        else
+            status = g_strdup ("RUNNER MAIN-LOOP-STATISTICS FAILED");
+        check_status (status);
+    }
+    else if (strcmp (name, "GET-XDMCP-SESSIONS-BY-STATE") == 0)
+    {
+        g_autoptr(GVariant) result = g_dbus_connection_call_sync (g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL),
+                                                                  "org.freedesktop.DisplayManager",
+                                                                  "/org/freedesktop/DisplayManager",
+                                                                  "org.freedesktop.DisplayManager",
+                                                                  "GetXDMCPSessionsByState",
+                                                                  NULL,
+                                                                  G_VARIANT_TYPE ("(a{st})"),
+                                                                  G_DBUS_CALL_FLAGS_NONE,
+                                                                  G_MAXINT,
+                                                                  NULL,
+                                                                  NULL);
+
+        g_autofree gchar *status = NULL;
+        if (result)
+        {
+            g_autoptr(GVariant) sessions = g_variant_get_child_value (result, 0);
+            guint64 pending = 0, running = 0, idle = 0, expired = 0, reaped = 0;
+            g_variant_lookup (sessions, "pending", "t", &pending);
+            g_variant_lookup (sessions, "running", "t", &running);
+            g_variant_lookup (sessions, "idle", "t", &idle);
+            g_variant_lookup (sessions, "expired", "t", &expired);
+            g_variant_lookup (sessions, "reaped", "t", &reaped);
+            status = g_strdup_printf ("RUNNER XDMCP-SESSIONS-BY-STATE PENDING=%" G_GUINT64_FORMAT " RUNNING=%" G_GUINT64_FORMAT " IDLE=%" G_GUINT64_FORMAT " EXPIRED=%" G_GUINT64_FORMAT " REAPED=%" G_GUINT64_FORMAT,
+                                      pending, running, idle, expired, reaped);
+        }
+        else
+            status = g_strdup ("RUNNER XDMCP-SESSIONS-BY-STATE FAILED");
+        check_status (status);
+    }
+    else if (strcmp (name, "GET-VNC-STATISTICS") == 0)
+    {
+        g_autoptr(GVariant) result = g_dbus_connection_call_sync (g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL),
+                                                                  "org.freedesktop.DisplayManager",
+                                                                  "/org/freedesktop/DisplayManager",
+                                                                  "org.freedesktop.DisplayManager",
+                                                                  "GetVNCStatistics",
+                                                                  NULL,
+                                                                  G_VARIANT_TYPE ("(a{st})"),
+                                                                  G_DBUS_CALL_FLAGS_NONE,
+                                                                  G_MAXINT,
+                                                                  NULL,
+                                                                  NULL);
+
+        g_autofree gchar *status = NULL;
+        if (result)
+        {
+            g_autoptr(GVariant) statistics = g_variant_get_child_value (result, 0);
+            guint64 active = 0, starting = 0, queued = 0, accepted = 0, rate_limited = 0, rejected = 0;
+            g_variant_lookup (statistics, "active", "t", &active);
+            g_variant_lookup (statistics, "starting", "t", &starting);
+            g_variant_lookup (statistics, "queued", "t", &queued);
+            g_variant_lookup (statistics, "accepted", "t", &accepted);
+            g_variant_lookup (statistics, "rate-limited", "t", &rate_limited);
+            g_variant_lookup (statistics, "rejected", "t", &rejected);
+            status = g_strdup_printf ("RUNNER VNC-STATISTICS ACTIVE=%" G_GUINT64_FORMAT " STARTING=%" G_GUINT64_FORMAT " QUEUED=%" G_GUINT64_FORMAT " ACCEPTED=%" G_GUINT64_FORMAT " RATE-LIMITED=%" G_GUINT64_FORMAT " REJECTED=%" G_GUINT64_FORMAT,
+                                      active, starting, queued, accepted, rate_limited, rejected);
+        }
+        else
+            status = g_strdup ("RUNNER VNC-STATISTICS FAILED");
+        check_status (status);
+    }
     // FIXME: Make generic RUN-COMMAND
     else if (strcmp (name, "START-XSERVER") == 0)
     {
@@ -778,6 +1072,27 @@ handle_command (const gchar *command)
             g_hash_table_insert (children, GINT_TO_POINTER (process->pid), process);
         }
     }
+    else if (strcmp (name, "HIDE-SESSION") == 0)
+    {
+        /* Modify the session file in place so the directory mtime doesn't change */
+        const gchar *key = g_hash_table_lookup (params, "KEY");
+        g_autofree gchar *path = g_strdup_printf ("%s/usr/share/lightdm/sessions/%s.desktop", temp_dir, key);
+        FILE *file = fopen (path, "a");
+        if (file)
+        {
+            fprintf (file, "NoDisplay=true\n");
+            fclose (file);
+        }
+        else
+            g_warning ("Failed to open session file %s: %s", path, strerror (errno));
+    }
+    else if (strcmp (name, "CHECK-PATH") == 0)
+    {
+        const gchar *path = g_hash_table_lookup (params, "PATH");
+        g_autofree gchar *full_path = g_build_filename (temp_dir, path, NULL);
+        g_autofree gchar *status_text = g_strdup_printf ("RUNNER CHECK-PATH PATH=%s EXISTS=%s", path, g_file_test (full_path, G_FILE_TEST_EXISTS) ? "TRUE" : "FALSE");
+        check_status (status_text);
+    }
     else if (strcmp (name, "ADD-USER") == 0)
     {
         const gchar *username = g_hash_table_lookup (params, "USERNAME");
@@ -943,6 +1258,13 @@ status_timeout_cb (gpointer data)
 {
     status_timeout = 0;
 
+    if (scale)
+    {
+        g_autofree gchar *expected = g_strdup_printf ("%d logins, got %d", scale->n_logins, scale->n_logins_completed);
+        fail ("(timeout)", expected);
+        return G_SOURCE_REMOVE;
+    }
+
     ScriptLine *line = get_script_line (NULL);
     fail ("(timeout)", line ? line->text : NULL);
 
@@ -957,9 +1279,22 @@ check_status (const gchar *status)
 
     statuses = g_list_append (statuses, g_strdup (status));
 
+    if (switch_start_time > 0 && switch_latency < 0 && g_str_has_prefix (status, "VT ACTIVATE "))
+        switch_latency = g_get_monotonic_time () - switch_start_time;
+
     if (getenv ("DEBUG"))
         g_print ("%s\n", status);
 
+    /* Scale benchmarks drive themselves from events rather than following a script */
+    if (scale)
+    {
+        if (status_timeout)
+            g_source_remove (status_timeout);
+        status_timeout = g_timeout_add (status_timeout_ms, status_timeout_cb, NULL);
+        scale_handle_status (status);
+        return;
+    }
+
     /* Try and match against expected */
     g_autofree gchar *prefix = get_prefix (status);
     gboolean result = FALSE;
@@ -988,6 +1323,311 @@ check_status (const gchar *status)
     run_commands ();
 }
 
+static gint
+compare_times (gconstpointer a, gconstpointer b)
+{
+    gint64 time_a = *(const gint64 *) a, time_b = *(const gint64 *) b;
+    return time_a < time_b ? -1 : time_a > time_b ? 1 : 0;
+}
+
+/* Append mean, percentiles and maximum in ms of a set of times in us */
+static void
+append_time_summary (GString *text, const gchar *name, GArray *times)
+{
+    g_array_sort (times, compare_times);
+
+    gint64 total = 0;
+    for (guint i = 0; i < times->len; i++)
+        total += g_array_index (times, gint64, i);
+
+    gdouble mean = 0, p50 = 0, p95 = 0, p99 = 0, max = 0;
+    if (times->len > 0)
+    {
+        mean = total / 1000.0 / times->len;
+        p50 = g_array_index (times, gint64, times->len * 50 / 100) / 1000.0;
+        p95 = g_array_index (times, gint64, times->len * 95 / 100) / 1000.0;
+        p99 = g_array_index (times, gint64, times->len * 99 / 100) / 1000.0;
+        max = g_array_index (times, gint64, times->len - 1) / 1000.0;
+    }
+
+    g_string_append_printf (text, ", \"%s\": {\"samples\": %u, \"mean\": %.1f, \"p50\": %.1f, \"p95\": %.1f, \"p99\": %.1f, \"max\": %.1f}",
+                            name, times->len, mean, p50, p95, p99, max);
+}
+
+static void
+scale_latency_cb (GObject *bus, GAsyncResult *result, gpointer data)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GVariant) r = g_dbus_connection_call_finish (G_DBUS_CONNECTION (bus), result, &error);
+    if (r && scale)
+    {
+        gint64 latency = g_get_monotonic_time () - scale->latency_start_time;
+        g_array_append_val (scale->latencies, latency);
+    }
+    else if (error)
+        g_warning ("Failed to probe daemon: %s", error->message);
+    if (scale)
+        scale->latency_start_time = 0;
+}
+
+/* Property reads are handled in the daemon main loop, so time how long one takes to be answered */
+static gboolean
+scale_latency_timeout_cb (gpointer data)
+{
+    if (scale->latency_start_time != 0)
+        return G_SOURCE_CONTINUE;
+
+    scale->latency_start_time = g_get_monotonic_time ();
+    g_dbus_connection_call (g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL),
+                            "org.freedesktop.DisplayManager",
+                            "/org/freedesktop/DisplayManager",
+                            "org.freedesktop.DBus.Properties",
+                            "Get",
+                            g_variant_new ("(ss)", "org.freedesktop.DisplayManager", "Seats"),
+                            G_VARIANT_TYPE ("(v)"),
+                            G_DBUS_CALL_FLAGS_NONE,
+                            G_MAXINT,
+                            NULL,
+                            scale_latency_cb,
+                            NULL);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+scale_finish (void)
+{
+    scale->finished = TRUE;
+    if (scale->latency_timeout)
+        g_source_remove (scale->latency_timeout);
+    scale->latency_timeout = 0;
+    gint64 duration = g_get_monotonic_time () - scale->start_time;
+
+    /* Measure the daemon before it is stopped */
+    g_return_if_fail (lightdm_process != NULL);
+    int rss = 0, peak_rss = 0;
+    gdouble cpu_time = 0;
+    g_autofree gchar *status_path = g_strdup_printf ("/proc/%d/status", lightdm_process->pid);
+    g_autofree gchar *status = NULL;
+    if (g_file_get_contents (status_path, &status, NULL, NULL))
+    {
+        g_auto(GStrv) lines = g_strsplit (status, "\n", -1);
+        for (int i = 0; lines[i]; i++)
+        {
+            if (g_str_has_prefix (lines[i], "VmRSS:"))
+                rss = atoi (lines[i] + strlen ("VmRSS:"));
+            else if (g_str_has_prefix (lines[i], "VmHWM:"))
+                peak_rss = atoi (lines[i] + strlen ("VmHWM:"));
+        }
+    }
+    g_autofree gchar *stat_path = g_strdup_printf ("/proc/%d/stat", lightdm_process->pid);
+    g_autofree gchar *stat_data = NULL;
+    if (g_file_get_contents (stat_path, &stat_data, NULL, NULL))
+    {
+        /* Skip the command name as it may contain spaces, utime and stime are the 12th and 13th fields after it */
+        const gchar *fields_start = strrchr (stat_data, ')');
+        g_auto(GStrv) fields = g_strsplit (fields_start ? fields_start + 2 : "", " ", -1);
+        if (g_strv_length (fields) > 12)
+            cpu_time = (g_ascii_strtoull (fields[11], NULL, 10) + g_ascii_strtoull (fields[12], NULL, 10)) * 1000.0 / sysconf (_SC_CLK_TCK);
+    }
+
+    g_autoptr(GString) result = g_string_new ("");
+    g_string_append_printf (result, "{\"seats\": %d, \"xdmcp-clients\": %d, \"vnc-clients\": %d, \"logins\": %d",
+                            scale->n_seats, scale->n_xdmcp_clients, scale->n_vnc_clients, scale->n_logins_completed);
+    g_string_append_printf (result, ", \"duration-ms\": %.1f, \"daemon-rss-kb\": %d, \"daemon-peak-rss-kb\": %d, \"daemon-cpu-ms\": %.1f",
+                            duration / 1000.0, rss, peak_rss, cpu_time);
+    append_time_summary (result, "main-loop-latency-ms", scale->latencies);
+    append_time_summary (result, "login-ms", scale->login_times);
+    g_string_append (result, "}\n");
+
+    g_print ("%s", result->str);
+    const gchar *results_path = g_getenv ("LIGHTDM_TEST_SCALE_RESULTS");
+    if (results_path)
+    {
+        g_autoptr(GError) error = NULL;
+        if (!g_file_set_contents (results_path, result->str, -1, &error))
+            g_warning ("Failed to write scale results: %s", error->message);
+    }
+
+    quit (EXIT_SUCCESS);
+}
+
+/* Each XDMCP server gets a new display number so it doesn't wait on the lock of one that is exiting */
+static void
+scale_start_xdmcp_client (void)
+{
+    g_autofree gchar *command = g_strdup_printf ("START-XSERVER ARGS=\":%d -query 127.0.0.1 -nolisten unix -terminate\"", scale->next_xdmcp_display);
+    scale->next_xdmcp_display++;
+    handle_command (command);
+}
+
+static void
+scale_display_appeared_cb (GDBusConnection *connection, const gchar *name, const gchar *name_owner, gpointer data)
+{
+    if (scale->start_time != 0)
+        return;
+    scale->start_time = g_get_monotonic_time ();
+    scale->latency_timeout = g_timeout_add (SCALE_LATENCY_INTERVAL, scale_latency_timeout_cb, NULL);
+
+    /* Local seats are added once their X server is running */
+    for (int i = 0; i < scale->n_seats; i++)
+    {
+        g_autofree gchar *command = g_strdup_printf ("START-XSERVER ARGS=\":%d\"", SCALE_DISPLAY_BASE + i);
+        handle_command (command);
+    }
+    for (int i = 0; i < scale->n_xdmcp_clients; i++)
+        scale_start_xdmcp_client ();
+    for (int i = 0; i < scale->n_vnc_clients; i++)
+        handle_command ("START-VNC-CLIENT");
+}
+
+static void
+scale_start (void)
+{
+    status_timeout = g_timeout_add (status_timeout_ms, status_timeout_cb, NULL);
+    handle_command ("START-DAEMON");
+    g_bus_watch_name (G_BUS_TYPE_SYSTEM,
+                      "org.freedesktop.DisplayManager",
+                      G_BUS_NAME_WATCHER_FLAGS_NONE,
+                      scale_display_appeared_cb,
+                      NULL,
+                      NULL,
+                      NULL);
+}
+
+static void
+scale_handle_xserver_status (const gchar *id, const gchar *event)
+{
+    gint display_number = atoi (id);
+
+    if (strcmp (event, "START") == 0)
+    {
+        g_autofree gchar *command = NULL;
+        if (display_number < scale->xdmcp_display_base)
+            command = g_strdup_printf ("ADD-LOCAL-X-SEAT DISPLAY=%d", display_number);
+        else
+            command = g_strdup_printf ("XSERVER-%d SEND-QUERY", display_number);
+        handle_command (command);
+    }
+    else if (strcmp (event, "GOT-WILLING") == 0)
+    {
+        g_autofree gchar *command = g_strdup_printf ("XSERVER-%d SEND-REQUEST ADDRESSES=\"127.0.0.1\" AUTHORIZATION-NAMES=\"MIT-MAGIC-COOKIE-1\"", display_number);
+        handle_command (command);
+    }
+    else if (strcmp (event, "GOT-ACCEPT") == 0)
+    {
+        g_autofree gchar *command = g_strdup_printf ("XSERVER-%d SEND-MANAGE", display_number);
+        handle_command (command);
+    }
+    /* XDMCP servers exit when the session logs out, so connect another */
+    else if (strcmp (event, "TERMINATE") == 0 && display_number >= scale->xdmcp_display_base)
+        scale_start_xdmcp_client ();
+}
+
+static void
+scale_handle_xvnc_status (const gchar *id, const gchar *event)
+{
+    if (strcmp (event, "START") == 0)
+    {
+        g_autofree gchar *command = g_strdup_printf ("XVNC-%s INDICATE-READY", id);
+        handle_command (command);
+    }
+    /* The first connection is the daemon checking the server is up */
+    else if (strcmp (event, "ACCEPT-CONNECT") == 0 && !g_hash_table_contains (scale->vnc_servers, id))
+    {
+        g_hash_table_add (scale->vnc_servers, g_strdup (id));
+        g_autofree gchar *command = g_strdup_printf ("XVNC-%s START-VNC", id);
+        handle_command (command);
+    }
+    else if (strcmp (event, "TERMINATE") == 0)
+        g_hash_table_remove (scale->vnc_servers, id);
+}
+
+static void
+scale_handle_greeter_status (const gchar *id, const gchar *event, const gchar *status)
+{
+    g_autofree gchar *command = NULL;
+
+    if (strcmp (event, "CONNECTED-TO-DAEMON") == 0)
+    {
+        if (scale->n_logins_started >= scale->n_logins)
+            return;
+        scale->n_logins_started++;
+
+        gint64 *start_time = g_new (gint64, 1);
+        *start_time = g_get_monotonic_time ();
+        g_hash_table_insert (scale->logins, g_strdup (id), start_time);
+
+        command = g_strdup_printf ("GREETER-X-%s AUTHENTICATE USERNAME=scale-user%d", id, scale->next_user);
+        scale->next_user = (scale->next_user + 1) % scale->n_users;
+    }
+    else if (strcmp (event, "SHOW-PROMPT") == 0)
+        command = g_strdup_printf ("GREETER-X-%s RESPOND TEXT=\"password\"", id);
+    else if (strcmp (event, "AUTHENTICATION-COMPLETE") == 0)
+    {
+        if (!strstr (status, " AUTHENTICATED=TRUE"))
+        {
+            fail (status, "AUTHENTICATED=TRUE");
+            return;
+        }
+        command = g_strdup_printf ("GREETER-X-%s START-SESSION", id);
+    }
+
+    if (command)
+        handle_command (command);
+}
+
+static void
+scale_handle_session_status (const gchar *id, const gchar *event)
+{
+    if (strcmp (event, "CONNECT-XSERVER") != 0)
+        return;
+
+    gint64 *start_time = g_hash_table_lookup (scale->logins, id);
+    if (!start_time)
+        return;
+    gint64 login_time = g_get_monotonic_time () - *start_time;
+    g_array_append_val (scale->login_times, login_time);
+    g_hash_table_remove (scale->logins, id);
+    scale->n_logins_completed++;
+
+    if (scale->n_logins_completed >= scale->n_logins)
+    {
+        scale_finish ();
+        return;
+    }
+
+    /* Log straight out again so the next login can start */
+    g_autofree gchar *command = g_strdup_printf ("SESSION-X-%s LOGOUT", id);
+    handle_command (command);
+}
+
+static void
+scale_handle_status (const gchar *status)
+{
+    if (scale->finished)
+        return;
+
+    g_autofree gchar *prefix = get_prefix (status);
+    const gchar *event_start = status + strlen (prefix);
+    while (isspace (*event_start))
+        event_start++;
+    g_autofree gchar *event = get_prefix (event_start);
+
+    if (g_str_has_prefix (prefix, "XSERVER-"))
+        scale_handle_xserver_status (prefix + strlen ("XSERVER-"), event);
+    else if (g_str_has_prefix (prefix, "XVNC-"))
+        scale_handle_xvnc_status (prefix + strlen ("XVNC-"), event);
+    else if (g_str_has_prefix (prefix, "GREETER-X-"))
+        scale_handle_greeter_status (prefix + strlen ("GREETER-X-"), event, status);
+    else if (g_str_has_prefix (prefix, "SESSION-X-"))
+        scale_handle_session_status (prefix + strlen ("SESSION-X-"), event);
+    else if (strcmp (prefix, "VNC-CLIENT") == 0 && strcmp (event, "DISCONNECTED") == 0)
+        handle_command ("START-VNC-CLIENT");
+    else if (strcmp (prefix, "RUNNER") == 0 && (strcmp (event, "DAEMON-EXIT") == 0 || strcmp (event, "DAEMON-TERMINATE") == 0))
+        fail (status, "daemon to keep running");
+}
+
 static gboolean
 status_message_cb (GSocket *socket, GIOCondition condition, StatusClient *client)
 {
@@ -2310,7 +2950,10 @@ start_accounts_service_daemon (void)
 static void
 ready (void)
 {
-    run_commands ();
+    if (scale)
+        scale_start ();
+    else
+        run_commands ();
 }
 
 static gboolean
@@ -2385,6 +3028,42 @@ dbus_signal_cb (GDBusConnection *connection,
     check_status (status->str);
 }
 
+static void
+start_plymouth_daemon (void)
+{
+    /* Listen before starting the daemon so LightDM can always connect */
+    g_autofree gchar *path = g_build_filename (temp_dir, "run", "plymouthd", NULL);
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GSocket) socket = g_socket_new (G_SOCKET_FAMILY_UNIX, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT, &error);
+    g_autoptr(GSocketAddress) address = g_unix_socket_address_new (path);
+    if (!socket ||
+        !g_socket_bind (socket, address, FALSE, &error) ||
+        !g_socket_listen (socket, &error))
+    {
+        g_warning ("Error creating Plymouth socket %s: %s", path, error->message);
+        quit (EXIT_FAILURE);
+        return;
+    }
+
+    /* Pass the socket to the daemon */
+    int fd = g_socket_get_fd (socket);
+    fcntl (fd, F_SETFD, 0);
+    g_autofree gchar *command_line = g_strdup_printf ("%s/tests/src/plymouth --listen-fd %d", BUILDDIR, fd);
+
+    gchar **argv;
+    GPid pid;
+    if (!g_shell_parse_argv (command_line, NULL, &argv, &error) ||
+        !g_spawn_async (NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_LEAVE_DESCRIPTORS_OPEN, NULL, NULL, &pid, &error))
+    {
+        g_printerr ("Error starting Plymouth: %s", error->message);
+        quit (EXIT_FAILURE);
+        return;
+    }
+
+    Process *process = watch_process (pid);
+    g_hash_table_insert (children, GINT_TO_POINTER (process->pid), process);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -2413,6 +3092,23 @@ main (int argc, char **argv)
 
     load_script (config_path);
 
+    if (g_key_file_has_group (config, "test-runner-scale"))
+    {
+        scale = g_malloc0 (sizeof (ScaleBenchmark));
+        scale->n_seats = MAX (g_key_file_get_integer (config, "test-runner-scale", "seats", NULL), 0);
+        scale->n_xdmcp_clients = MAX (g_key_file_get_integer (config, "test-runner-scale", "xdmcp-clients", NULL), 0);
+        scale->n_vnc_clients = MAX (g_key_file_get_integer (config, "test-runner-scale", "vnc-clients", NULL), 0);
+        scale->n_logins = MAX (g_key_file_get_integer (config, "test-runner-scale", "logins", NULL), 1);
+        /* Enough accounts that each concurrent login can use a different one */
+        scale->n_users = MAX (2 * (scale->n_seats + scale->n_xdmcp_clients + scale->n_vnc_clients), 1);
+        scale->xdmcp_display_base = SCALE_DISPLAY_BASE + scale->n_seats;
+        scale->next_xdmcp_display = scale->xdmcp_display_base;
+        scale->logins = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+        scale->vnc_servers = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+        scale->login_times = g_array_new (FALSE, FALSE, sizeof (gint64));
+        scale->latencies = g_array_new (FALSE, FALSE, sizeof (gint64));
+    }
+
     gchar cwd[1024];
     if (!getcwd (cwd, 1024))
     {
@@ -2544,6 +3240,40 @@ main (int argc, char **argv)
         }
     }
 
+    /* Directories too deep to delete while holding a file descriptor per level */
+    if (g_key_file_has_key (config, "test-runner-config", "shared-data-trees", NULL))
+    {
+        g_autofree gchar *link_target = g_strdup_printf ("%s/shared-data-link-target", temp_dir);
+        g_mkdir_with_parents (link_target, 0755);
+        g_autofree gchar *link_target_file = g_build_filename (link_target, "file", NULL);
+        g_file_set_contents (link_target_file, "", -1, NULL);
+
+        g_autofree gchar *tree_string = g_key_file_get_string (config, "test-runner-config", "shared-data-trees", NULL);
+        g_auto(GStrv) trees = g_strsplit (tree_string, " ", -1);
+        for (int i = 0; trees[i]; i++)
+        {
+            g_autofree gchar *path = g_strdup_printf ("%s/var/lib/lightdm-data/%s", temp_dir, trees[i]);
+            g_mkdir (path, 0755);
+            g_autofree gchar *link_path = g_build_filename (path, "link", NULL);
+            if (symlink (link_target, link_path) < 0)
+                g_warning ("symlink (%s) failed: %s", link_path, strerror (errno));
+
+            int fd = open (path, O_RDONLY | O_DIRECTORY);
+            for (int depth = 0; fd >= 0 && depth < SHARED_DATA_TREE_DEPTH; depth++)
+            {
+                int file_fd = openat (fd, "file", O_WRONLY | O_CREAT, 0644);
+                if (file_fd >= 0)
+                    close (file_fd);
+                mkdirat (fd, "dir", 0755);
+                int child_fd = openat (fd, "dir", O_RDONLY | O_DIRECTORY);
+                close (fd);
+                fd = child_fd;
+            }
+            if (fd >= 0)
+                close (fd);
+        }
+    }
+
     /* Always copy the script */
     if (system (g_strdup_printf ("cp %s %s/script", config_path, temp_dir)))
         perror ("Failed to copy configuration");
@@ -2701,6 +3431,21 @@ main (int argc, char **argv)
         /* Add group file entry */
         g_string_append_printf (group_data, "%s:x:%d:%s\n", users[i].user_name, users[i].uid, users[i].user_name);
     }
+    /* Accounts for the scale benchmark to log in with */
+    for (int i = 0; scale && i < scale->n_users; i++)
+    {
+        g_autofree gchar *user_name = g_strdup_printf ("scale-user%d", i);
+        int uid = 2000 + i;
+
+        g_autofree gchar *path = g_build_filename (home_dir, user_name, NULL);
+        g_mkdir_with_parents (path, 0755);
+        if (chown (path, uid, uid) < 0)
+          g_debug ("chown (%s) failed: %s", path, strerror (errno));
+
+        g_string_append_printf (passwd_data, "%s:password:%d:%d:Scale User %d:%s/home/%s:/bin/sh\n", user_name, uid, uid, i, temp_dir, user_name);
+        g_string_append_printf (group_data, "%s:x:%d:%s\n", user_name, uid, user_name);
+    }
+
     g_autofree gchar *passwd_path = g_build_filename (temp_dir, "etc", "passwd", NULL);
     g_file_set_contents (passwd_path, passwd_data->str, -1, NULL);
 
@@ -2723,6 +3468,10 @@ main (int argc, char **argv)
     if (!g_key_file_get_boolean (config, "test-runner-config", "disable-accounts-service", NULL))
         start_accounts_service_daemon ();
 
+    /* Start Plymouth */
+    if (g_key_file_get_boolean (config, "test-plymouth-config", "enabled", NULL))
+        start_plymouth_daemon ();
+
     /* Listen for daemon bus events */
     if (g_key_file_get_boolean (config, "test-runner-config", "log-dbus", NULL))
     {
@@ -47,19 +47,32 @@ typedef enum
 } USCMessageID;
 
 static void
-write_message (guint16 id, const guint8 *payload, guint16 payload_length)
+write_messages (guint16 id, const guint8 *payload, guint16 payload_length, int count)
 {
-    gsize data_length = 4 + payload_length;
+    /* Multiple messages are sent in one write to check the daemon handles them all */
+    gsize message_length = 4 + payload_length;
+    gsize data_length = message_length * count;
     guint8 *data = g_malloc (data_length);
-    data[0] = id >> 8;
-    data[1] = id & 0xFF;
-    data[2] = payload_length >> 8;
-    data[3] = payload_length & 0xFF;
-    if (payload)
-        memcpy (data + 4, payload, payload_length);
+    for (int i = 0; i < count; i++)
+    {
+        guint8 *message = data + message_length * i;
+        message[0] = id >> 8;
+        message[1] = id & 0xFF;
+        message[2] = payload_length >> 8;
+        message[3] = payload_length & 0xFF;
+        if (payload)
+            memcpy (message + 4, payload, payload_length);
+    }
 
     if (write (to_dm_fd, data, data_length) < 0)
         fprintf (stderr, "Failed to write to daemon: %s\n", strerror (errno));
+    g_free (data);
+}
+
+static void
+write_message (guint16 id, const guint8 *payload, guint16 payload_length)
+{
+    write_messages (id, payload, payload_length, 1);
 }
 
 static gboolean
@@ -96,6 +109,10 @@ read_message_cb (GIOChannel *channel, GIOCondition condition, gpointer data)
     {
     case USC_MESSAGE_PING:
         status_notify ("UNITY-SYSTEM-COMPOSITOR PING");
+        write_message (USC_MESSAGE_PONG, NULL, 0);
+        break;
+    case USC_MESSAGE_PONG:
+        status_notify ("UNITY-SYSTEM-COMPOSITOR PONG");
         break;
     case USC_MESSAGE_SET_ACTIVE_SESSION:
         status_notify ("UNITY-SYSTEM-COMPOSITOR SET-ACTIVE-SESSION ID=%s", (gchar *)payload);
@@ -123,7 +140,10 @@ request_cb (const gchar *name, GHashTable *params)
     }
 
     if (strcmp (name, "PING") == 0)
-        write_message (USC_MESSAGE_PING, NULL, 0);
+    {
+        const gchar *v = g_hash_table_lookup (params, "COUNT");
+        write_messages (USC_MESSAGE_PING, NULL, 0, v ? atoi (v) : 1);
+    }
 
     else if (strcmp (name, "PONG") == 0)
         write_message (USC_MESSAGE_PONG, NULL, 0);
@@ -18,6 +18,16 @@ main (int argc, char **argv)
 
     status_connect (NULL, NULL);
 
+    guint port = 5900;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp (argv[i], "-port") == 0 && i + 1 < argc)
+        {
+            port = atoi (argv[i+1]);
+            i++;
+        }
+    }
+
     status_notify ("VNC-CLIENT START");
 
     config = g_key_file_new ();
@@ -33,7 +43,7 @@ main (int argc, char **argv)
         return EXIT_FAILURE;
     }
 
-    g_autoptr(GSocketAddress) address = g_inet_socket_address_new (g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4), 5900);
+    g_autoptr(GSocketAddress) address = g_inet_socket_address_new (g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4), port);
     gboolean result = g_socket_connect (socket, address, NULL, &error);
     if (!result)
     {
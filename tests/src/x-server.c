@@ -29,6 +29,9 @@ struct XServerPrivate
 {
     gint display_number;
 
+    /* TRUE if replying to requests */
+    gboolean responding;
+
     gchar *socket_path;
     GSocket *socket;
     GIOChannel *channel;
@@ -106,13 +109,13 @@ static gboolean
 client_read_cb (GIOChannel *channel, GIOCondition condition, gpointer data)
 {
     XClient *client = data;
+    XServer *server = client->priv->server;
 
-    g_autofree gchar *d = NULL;
-    gsize d_length;
-    if (g_io_channel_read_to_end (channel, &d, &d_length, NULL) == G_IO_STATUS_NORMAL && d_length == 0)
+    gchar buffer[1024];
+    g_autoptr(GError) error = NULL;
+    gssize n_read = g_socket_receive (client->priv->socket, buffer, sizeof (buffer), NULL, &error);
+    if (n_read == 0 || (n_read < 0 && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)))
     {
-        XServer *server = client->priv->server;
-
         g_signal_emit (client, x_client_signals[X_CLIENT_DISCONNECTED], 0);
         g_signal_emit (server, x_server_signals[X_SERVER_CLIENT_DISCONNECTED], 0, client);
 
@@ -124,6 +127,18 @@ client_read_cb (GIOChannel *channel, GIOCondition condition, gpointer data)
         return G_SOURCE_REMOVE;
     }
 
+    /* Each request is a line and gets a one line reply */
+    for (gssize i = 0; i < n_read; i++)
+    {
+        if (buffer[i] != '\n' || !server->priv->responding)
+            continue;
+
+        const gchar *reply = "REPLY\n";
+        errno = 0;
+        if (send (g_io_channel_unix_get_fd (client->priv->channel), reply, strlen (reply), 0) != strlen (reply))
+            g_printerr ("Failed to send REPLY: %s\n", strerror (errno));
+    }
+
     return G_SOURCE_CONTINUE;
 }
 
@@ -172,6 +187,12 @@ x_server_start (XServer *server)
     return TRUE;
 }
 
+void
+x_server_set_responding (XServer *server, gboolean responding)
+{
+    server->priv->responding = responding;
+}
+
 gsize
 x_server_get_n_clients (XServer *server)
 {
@@ -182,6 +203,7 @@ static void
 x_server_init (XServer *server)
 {
     server->priv = G_TYPE_INSTANCE_GET_PRIVATE (server, x_server_get_type (), XServerPrivate);
+    server->priv->responding = TRUE;
     server->priv->clients = g_hash_table_new_full (g_direct_hash, g_direct_equal, (GDestroyNotify) g_io_channel_unref, g_object_unref);
 }
 
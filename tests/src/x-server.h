@@ -48,6 +48,8 @@ XServer *x_server_new (gint display_number);
 
 gboolean x_server_start (XServer *server);
 
+void x_server_set_responding (XServer *server, gboolean responding);
+
 gsize x_server_get_n_clients (XServer *server);
 
 GType x_client_get_type (void);